@@ -139,15 +139,15 @@ syntax keyword vifmOption contained aproposprg autochpos caseoptions cdpath cd
 		\ chaselinks classify columns co confirm cf cpoptions cpo cvoptions
 		\ deleteprg dotdirs dotfiles dirsize fastrun fillchars fcs findprg
 		\ followlinks fusehome gdefault grepprg histcursor history hi hlsearch hls
-		\ iec ignorecase ic iooptions incsearch is laststatus lines locateprg ls
-		\ lsoptions lsview mediaprg milleroptions millerview mintimeoutlen number nu
-		\ numberwidth nuw previewprg quickview relativenumber rnu rulerformat ruf
-		\ runexec scrollbind scb scrolloff so sort sortgroups sortorder sortnumbers
-		\ shell sh shellflagcmd shcf shortmess shm showtabline stal sizefmt slowfs
-		\ smartcase scs statusline stl suggestoptions syncregs syscalls tabscope
-		\ tabstop timefmt timeoutlen title tm trash trashdir ts tuioptions to
-		\ undolevels ul vicmd viewcolumns vifminfo vimhelp vixcmd wildmenu wmnu
-		\ wildstyle wordchars wrap wrapscan ws
+		\ iec ignorecase ic iooptions iothreads incsearch is laststatus lines
+		\ locateprg ls lsoptions lsview mediaprg milleroptions millerview
+		\ mimecachesize mintimeoutlen number nu numberwidth nuw previewprg quickview
+		\ relativenumber rnu rulerformat ruf runexec scrollbind scb scrolloff so
+		\ sort sortgroups sortorder sortnumbers shell sh shellflagcmd shcf shortmess
+		\ shm showtabline stal sizefmt slowfs smartcase scs statusline stl
+		\ suggestoptions syncregs syscalls tabscope tabstop timefmt timeoutlen title
+		\ tm trash trashdir ts tuioptions to undolevels ul vicmd viewcolumns
+		\ vifminfo vimhelp vixcmd wildmenu wmnu wildstyle wordchars wrap wrapscan ws
 
 " Disabled boolean options
 syntax keyword vifmOption contained noautochpos nocf nochaselinks nodotfiles
@@ -24,24 +24,30 @@
 #endif
 
 #include <fcntl.h> /* open() */
-#include <sys/stat.h> /* O_RDONLY */
+#include <sys/stat.h> /* O_RDONLY stat */
 #include <sys/types.h> /* pid_t ssize_t */
 #ifndef _WIN32
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h> /* EPOLL* epoll_create1() epoll_ctl() epoll_wait() */
+#include <sys/eventfd.h> /* EFD_* eventfd() */
+#else
 #include <sys/select.h> /* FD_* select */
 #include <sys/time.h> /* timeval */
+#endif
 #include <sys/wait.h> /* WEXITSTATUS() WIFEXITED() waitpid() */
 #endif
 #include <signal.h> /* kill() */
-#include <unistd.h> /* execve() fork() select() */
+#include <unistd.h> /* close() execve() fork() read() select() write() */
 
 #include <assert.h> /* assert() */
-#include <errno.h> /* errno */
+#include <errno.h> /* EAGAIN EINTR EWOULDBLOCK errno */
 #include <stddef.h> /* NULL wchar_t */
-#include <stdint.h> /* uintptr_t */
-#include <stdlib.h> /* EXIT_FAILURE _Exit() free() malloc() */
+#include <stdint.h> /* uint64_t uintptr_t */
+#include <stdlib.h> /* EXIT_FAILURE _Exit() calloc() free() malloc() */
 #include <string.h> /* memcpy() */
 
 #include "cfg/config.h"
+#include "compat/os.h"
 #include "compat/pthread.h"
 #include "modes/dialogs/msg_dialog.h"
 #include "ui/cancellation.h"
@@ -66,15 +72,30 @@
  *
  * All jobs can be viewed via :jobs menu.
  *
+ * Tasks and operations are run by a bounded pool of worker threads.  Each
+ * device on which they operate has its own queue ordered by scheduling class.
+ * A task is started on a device only if no task of the same or higher priority
+ * is running there and no task of higher priority is waiting to be started.
+ * This prevents many copies to the same disk from competing with each other
+ * and with more important work like calculation of directory sizes, while
+ * tasks of higher priority don't wait for less important ones to finish.  Jobs
+ * can be paused, which for running ones happens when they check for
+ * cancellation.  Device of a task is determined by a worker thread as querying
+ * it can block on an unresponsive file system, until then the task waits in a
+ * separate queue.
+ *
  * Tasks and operations can provide progress information for displaying it in
  * UI.
  *
  * Operations are displayed on designated job bar.
  *
  * On non-Windows systems background thread reads data from error streams of
- * external applications, which are then displayed by main thread.  This thread
- * maintains its own list of jobs (via err_next field), which is added to by
- * building a temporary list with new_err_jobs pointing to its head.  Every job
+ * external applications, which are then displayed by main thread.  New jobs
+ * are passed to this thread by building a temporary list (via err_next field)
+ * with new_err_jobs pointing to its head.  Where epoll is available, each job
+ * is registered in an epoll instance and the thread is woken up via eventfd
+ * when new jobs are added, otherwise (or if setting up epoll fails) the thread
+ * maintains its own list of jobs which is polled with select().  Every job
  * that has associated external process has the following life cycle:
  *  1. Created by main thread and passed to error thread through new_err_jobs.
  *  2. Either gets marked by signal handler or its stream reaches EOF.
@@ -100,30 +121,74 @@
 #define NO_JOB_ID INVALID_HANDLE_VALUE
 #endif
 
-/* Structure with passed to background_task_bootstrap() so it can perform
- * correct initialization/cleanup. */
-typedef struct
+/* Maximum number of worker threads that run tasks at the same time (paused
+ * tasks aren't counted). */
+#define MAX_WORKERS 8
+
+struct dev_queue_t;
+
+/* Task scheduled for execution by a worker thread.  Fields other than func,
+ * args and job are guarded by sched_lock. */
+typedef struct bg_task_t
 {
-	bg_task_func func; /* Function to execute in a background thread. */
-	void *args;        /* Argument to pass. */
-	bg_job_t *job;     /* Job identifier that corresponds to the task. */
+	bg_task_func func;         /* Function to execute in a background thread. */
+	void *args;                /* Argument to pass. */
+	bg_job_t *job;             /* Job identifier that corresponds to the task. */
+	BgJobClass cls;            /* Scheduling class of the task. */
+	struct dev_queue_t *queue; /* Queue of the device of the task. */
+	char *path;                /* Path to determine device by or NULL. */
+	int resolving;             /* Whether device is being determined. */
+	int queued;                /* Whether the task is still in the queue. */
+	struct bg_task_t *next;    /* Next task in the queue. */
 }
-background_task_args;
+bg_task_t;
+
+/* Queue of tasks that operate on the same device. */
+typedef struct dev_queue_t
+{
+	dev_t dev;                 /* Identifier of the device. */
+	bg_task_t *head;           /* Tasks waiting to be run. */
+	int running[BJC_COUNT];    /* Number of running tasks of each class. */
+	int ntasks;                /* Number of tasks that refer to the queue. */
+	struct dev_queue_t *next;  /* Next queue in the list. */
+}
+dev_queue_t;
 
 static void job_check(bg_job_t *job);
 static void job_free(bg_job_t *job);
 #ifndef _WIN32
 static void * error_thread(void *p);
+#ifdef HAVE_EPOLL
+static int setup_epoll(void);
+static void epoll_error_loop(int epfd);
+static void watch_error_jobs(int epfd, bg_job_t **drained);
+#endif
+static void select_error_loop(void);
 static int update_error_jobs(bg_job_t **jobs, fd_set *set);
-static void free_drained_jobs(bg_job_t **jobs);
 static void import_error_jobs(bg_job_t **jobs);
 static int make_ready_list(bg_job_t **jobs, fd_set *set);
+static void notify_error_thread(void);
+static bg_job_t * take_new_err_jobs(int wait);
+static int read_job_errors(bg_job_t *job);
+static void release_job(bg_job_t *job);
+static void free_drained_jobs(bg_job_t **jobs);
 static void report_error_msg(const char title[], const char text[]);
 static void append_error_msg(bg_job_t *job, const char err_msg[]);
 #endif
 static bg_job_t * add_background_job(pid_t pid, const char cmd[],
 		uintptr_t data, BgJobType type);
-static void * background_task_bootstrap(void *arg);
+static bg_task_t * take_unresolved_task(void);
+static void resolve_task(bg_task_t *task);
+static dev_queue_t * get_dev_queue(dev_t dev);
+static void release_dev_queue(dev_queue_t *queue);
+static void enqueue_task(bg_task_t *task);
+static int wake_worker(void);
+static void * worker_thread(void *arg);
+static bg_task_t * pick_task(void);
+static int is_class_blocked(const dev_queue_t *queue, BgJobClass cls);
+static void run_task(bg_task_t *task);
+static void wait_while_paused(bg_job_t *job);
+static bg_task_t ** find_task_link(bg_task_t *task);
 static void set_current_job(bg_job_t *job);
 static void make_current_job_key(void);
 static int bg_op_cancel(bg_op_t *bg_op);
@@ -135,19 +200,55 @@ bg_job_t *bg_jobs = NULL;
 static bg_job_t *new_err_jobs;
 /* Mutex to protect new_err_jobs. */
 static pthread_mutex_t new_err_jobs_lock = PTHREAD_MUTEX_INITIALIZER;
-/* Conditional variable to signal availability of new jobs in new_err_jobs. */
+#ifdef HAVE_EPOLL
+/* Event file descriptor to signal availability of new jobs in new_err_jobs or
+ * -1 if epoll isn't used. */
+static int new_err_jobs_event = -1;
+/* Epoll instance of error thread or -1 if select() is used instead. */
+static int err_epfd = -1;
+#endif
+/* Conditional variable to signal availability of new jobs in new_err_jobs when
+ * select() is used. */
 static pthread_cond_t new_err_jobs_cond = PTHREAD_COND_INITIALIZER;
 #endif
 
 /* Thread local storage for bg_job_t associated with active thread. */
 static pthread_key_t current_job;
 
+/* Guards state of the scheduler below and scheduling fields of jobs. */
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signals idle workers that there might be a task for them. */
+static pthread_cond_t sched_cond = PTHREAD_COND_INITIALIZER;
+/* Signals paused tasks that they might have been resumed. */
+static pthread_cond_t pause_cond = PTHREAD_COND_INITIALIZER;
+/* Queue of tasks whose device isn't known yet, it's not in dev_queues. */
+static dev_queue_t unresolved_queue;
+/* Queue of tasks without a device, which is never freed. */
+static dev_queue_t nodev_queue;
+/* List of queues of devices, queues without tasks are freed. */
+static dev_queue_t *dev_queues = &nodev_queue;
+/* Number of workers that aren't idle and aren't paused. */
+static int nworking;
+/* Number of workers waiting for tasks. */
+static int nidle;
+/* Number of idle workers that were signaled but haven't woken up yet. */
+static int nwakeups;
+
 void
 bg_init(void)
 {
 #ifndef _WIN32
 	pthread_t id;
-	const int err = pthread_create(&id, NULL, &error_thread, NULL);
+	int err;
+
+#ifdef HAVE_EPOLL
+	if(setup_epoll() != 0)
+	{
+		LOG_INFO_MSG("Falling back to select() for reading error streams");
+	}
+#endif
+
+	err = pthread_create(&id, NULL, &error_thread, NULL);
 	assert(err == 0);
 	(void)err;
 #endif
@@ -395,11 +496,154 @@ bg_and_wait_for_errors(char cmd[], const struct cancellation_t *cancellation)
 static void *
 error_thread(void *p)
 {
-	bg_job_t *jobs = NULL;
-
 	(void)pthread_detach(pthread_self());
 	block_all_thread_signals();
 
+#ifdef HAVE_EPOLL
+	if(err_epfd != -1)
+	{
+		epoll_error_loop(err_epfd);
+	}
+#endif
+	select_error_loop();
+	return NULL;
+}
+
+#ifdef HAVE_EPOLL
+/* Creates event file descriptor and epoll instance for the error thread.
+ * Returns zero on success, otherwise non-zero is returned and select() is to be
+ * used. */
+static int
+setup_epoll(void)
+{
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+
+	new_err_jobs_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(new_err_jobs_event == -1)
+	{
+		LOG_SERROR_MSG(errno, "Failed to create eventfd");
+		return 1;
+	}
+
+	err_epfd = epoll_create1(EPOLL_CLOEXEC);
+	if(err_epfd == -1 ||
+			epoll_ctl(err_epfd, EPOLL_CTL_ADD, new_err_jobs_event, &event) != 0)
+	{
+		LOG_SERROR_MSG(errno, "Failed to set up epoll for error streams");
+		if(err_epfd != -1)
+		{
+			(void)close(err_epfd);
+			err_epfd = -1;
+		}
+		(void)close(new_err_jobs_event);
+		new_err_jobs_event = -1;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Reads error streams of jobs registered in epoll instance.  Does not
+ * return. */
+static void
+epoll_error_loop(int epfd)
+{
+	enum { MAX_EVENTS = 64 };
+
+	/* Jobs whose streams failed, but processes might still be running. */
+	bg_job_t *drained = NULL;
+	struct epoll_event events[MAX_EVENTS];
+
+	while(1)
+	{
+		int i;
+		/* Drained jobs are checked periodically, otherwise wait for events. */
+		const int nevents = epoll_wait(epfd, events, MAX_EVENTS,
+				drained == NULL ? -1 : 250);
+
+		for(i = 0; i < nevents; ++i)
+		{
+			bg_job_t *const j = events[i].data.ptr;
+			int status;
+
+			if(j == NULL)
+			{
+				watch_error_jobs(epfd, &drained);
+				continue;
+			}
+
+			/* Stream stays registered until it's closed or fails for good. */
+			status = read_job_errors(j);
+			if(status <= 0)
+			{
+				(void)epoll_ctl(epfd, EPOLL_CTL_DEL, j->fd, NULL);
+			}
+
+			if(status == 0)
+			{
+				/* Reached EOF, allow deletion of the job. */
+				release_job(j);
+			}
+			else if(status < 0)
+			{
+				j->drained = 1;
+				j->err_next = drained;
+				drained = j;
+			}
+		}
+
+		free_drained_jobs(&drained);
+	}
+}
+
+/* Registers newly added jobs in the epoll instance.  Jobs that can't be
+ * registered are added to *drained list. */
+static void
+watch_error_jobs(int epfd, bg_job_t **drained)
+{
+	uint64_t counter;
+	bg_job_t *new_jobs;
+
+	/* Reset the event before taking the list to not miss any jobs.  EAGAIN means
+	 * that the event was already reset. */
+	if(read(new_err_jobs_event, &counter, sizeof(counter)) == -1 &&
+			errno != EAGAIN)
+	{
+		LOG_SERROR_MSG(errno, "Failed to reset eventfd");
+	}
+
+	new_jobs = take_new_err_jobs(0);
+	while(new_jobs != NULL)
+	{
+		bg_job_t *const new_job = new_jobs;
+		struct epoll_event event = { .events = EPOLLIN, .data.ptr = new_job };
+		new_jobs = new_jobs->err_next;
+
+		assert(new_job->type == BJT_COMMAND &&
+				"Only external commands should be here.");
+
+		/* Mark a this job as an interesting one to avoid it being killed until we
+		 * have a chance to read error stream. */
+		new_job->drained = 0;
+
+		if(epoll_ctl(epfd, EPOLL_CTL_ADD, new_job->fd, &event) != 0)
+		{
+			LOG_SERROR_MSG(errno, "Failed to watch error stream of %s",
+					new_job->cmd);
+			new_job->drained = 1;
+			new_job->err_next = *drained;
+			*drained = new_job;
+		}
+	}
+}
+#endif
+
+/* Reads error streams of jobs polled with select().  Does not return. */
+static void
+select_error_loop(void)
+{
+	bg_job_t *jobs = NULL;
+
 	while(1)
 	{
 		fd_set active, ready;
@@ -415,37 +659,31 @@ error_thread(void *p)
 			while(*job != NULL)
 			{
 				bg_job_t *const j = *job;
-				char err_msg[ERR_MSG_LEN];
-				ssize_t nread;
+				int status;
 
 				if(!FD_ISSET(j->fd, &ready))
 				{
 					goto next_job;
 				}
 
-				nread = read(j->fd, err_msg, sizeof(err_msg) - 1U);
-				if(nread < 0)
+				status = read_job_errors(j);
+				if(status < 0)
 				{
 					need_update_list = 1;
 					j->drained = 1;
 					goto next_job;
 				}
 
-				if(nread == 0)
+				if(status == 0)
 				{
 					/* Reached EOF, exclude corresponding file descriptor from the set,
 					 * cut the job out of our list and allow its deletion. */
 					FD_CLR(j->fd, &active);
 					*job = j->err_next;
-					pthread_spin_lock(&j->status_lock);
-					j->in_use = 0;
-					pthread_spin_unlock(&j->status_lock);
+					release_job(j);
 					continue;
 				}
 
-				err_msg[nread] = '\0';
-				append_error_msg(j, err_msg);
-
 			next_job:
 				job = &j->err_next;
 			}
@@ -464,7 +702,6 @@ error_thread(void *p)
 			ts = timeout;
 		}
 	}
-	return NULL;
 }
 
 /* Updates *jobs by removing finished tasks and adding new ones.  Initializes
@@ -477,48 +714,12 @@ update_error_jobs(bg_job_t **jobs, fd_set *set)
 	return make_ready_list(jobs, set);
 }
 
-/* Updates *jobs by removing finished tasks. */
-static void
-free_drained_jobs(bg_job_t **jobs)
-{
-	bg_job_t **job = jobs;
-	while(*job != NULL)
-	{
-		bg_job_t *const j = *job;
-
-		if(j->drained)
-		{
-			pthread_spin_lock(&j->status_lock);
-			/* If finished, reset in_use mark and drop it from the list. */
-			if(!j->running)
-			{
-				j->in_use = 0;
-				*job = j->err_next;
-				pthread_spin_unlock(&j->status_lock);
-				continue;
-			}
-			pthread_spin_unlock(&j->status_lock);
-		}
-
-		job = &j->err_next;
-	}
-}
-
 /* Updates *jobs by adding new tasks. */
 static void
 import_error_jobs(bg_job_t **jobs)
 {
-	bg_job_t *new_jobs;
-
 	/* Add new tasks to internal list, wait if there are no jobs. */
-	pthread_mutex_lock(&new_err_jobs_lock);
-	while(*jobs == NULL && new_err_jobs == NULL)
-	{
-		pthread_cond_wait(&new_err_jobs_cond, &new_err_jobs_lock);
-	}
-	new_jobs = new_err_jobs;
-	new_err_jobs = NULL;
-	pthread_mutex_unlock(&new_err_jobs_lock);
+	bg_job_t *new_jobs = take_new_err_jobs(*jobs == NULL);
 
 	/* Prepend new jobs to the list. */
 	while(new_jobs != NULL)
@@ -563,6 +764,121 @@ make_ready_list(bg_job_t **jobs, fd_set *set)
 	return max_fd;
 }
 
+/* Wakes up error thread to let it know about new jobs in new_err_jobs. */
+static void
+notify_error_thread(void)
+{
+#ifdef HAVE_EPOLL
+	const uint64_t one = 1;
+
+	if(new_err_jobs_event != -1)
+	{
+		/* EAGAIN means that counter is about to overflow, which can be ignored as
+		 * the event is signaled anyway. */
+		while(write(new_err_jobs_event, &one, sizeof(one)) == -1)
+		{
+			if(errno != EINTR)
+			{
+				if(errno != EAGAIN)
+				{
+					LOG_SERROR_MSG(errno, "Failed to signal eventfd");
+				}
+				break;
+			}
+		}
+		return;
+	}
+#endif
+
+	pthread_cond_signal(&new_err_jobs_cond);
+}
+
+/* Takes list of newly added jobs away from other threads.  Waits for them to
+ * appear if wait is non-zero.  Returns the list. */
+static bg_job_t *
+take_new_err_jobs(int wait)
+{
+	bg_job_t *new_jobs;
+
+	pthread_mutex_lock(&new_err_jobs_lock);
+	while(wait && new_err_jobs == NULL)
+	{
+		pthread_cond_wait(&new_err_jobs_cond, &new_err_jobs_lock);
+	}
+	new_jobs = new_err_jobs;
+	new_err_jobs = NULL;
+	pthread_mutex_unlock(&new_err_jobs_lock);
+
+	return new_jobs;
+}
+
+/* Reads next portion of error stream of the job.  Returns positive number if
+ * something was read or there is nothing to read yet, zero on reaching end of
+ * the stream and negative number on a fatal error. */
+static int
+read_job_errors(bg_job_t *job)
+{
+	char err_msg[ERR_MSG_LEN];
+	ssize_t nread;
+
+	do
+	{
+		nread = read(job->fd, err_msg, sizeof(err_msg) - 1U);
+	}
+	while(nread == -1 && errno == EINTR);
+
+	if(nread < 0)
+	{
+		/* Stream is still alive, it just has no data at the moment. */
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+	}
+	if(nread == 0)
+	{
+		return 0;
+	}
+
+	err_msg[nread] = '\0';
+	append_error_msg(job, err_msg);
+	return 1;
+}
+
+/* Lets main thread know that error stream of the job is of no interest
+ * anymore. */
+static void
+release_job(bg_job_t *job)
+{
+	pthread_spin_lock(&job->status_lock);
+	job->in_use = 0;
+	pthread_spin_unlock(&job->status_lock);
+}
+
+/* Updates *jobs by removing finished tasks. */
+static void
+free_drained_jobs(bg_job_t **jobs)
+{
+	bg_job_t **job = jobs;
+	while(*job != NULL)
+	{
+		bg_job_t *const j = *job;
+
+		if(j->drained)
+		{
+			pthread_spin_lock(&j->status_lock);
+			/* If finished, reset in_use mark and drop it from the list. */
+			if(!j->running)
+			{
+				j->in_use = 0;
+				*job = j->err_next;
+				pthread_spin_unlock(&j->status_lock);
+				continue;
+			}
+			pthread_spin_unlock(&j->status_lock);
+		}
+
+		job = &j->err_next;
+	}
+}
+
 /* Either displays error message to the user for foreground operations or saves
  * it for displaying on the next invocation of bg_check(). */
 static void
@@ -902,51 +1218,376 @@ bg_run_external(const char cmd[], int skip_errors, ShellRequester by)
 }
 
 int
-bg_execute(const char descr[], const char op_descr[], int total, int important,
-		bg_task_func task_func, void *args)
+bg_execute(const char descr[], const char op_descr[], int total,
+		BgJobClass cls, const char path[], bg_task_func task_func, void *args)
 {
-	pthread_t id;
-	int ret;
+	int failed;
 
-	background_task_args *const task_args = malloc(sizeof(*task_args));
-	if(task_args == NULL)
+	bg_task_t *const task = malloc(sizeof(*task));
+	if(task == NULL)
 	{
 		return 1;
 	}
 
-	task_args->func = task_func;
-	task_args->args = args;
-	task_args->job = add_background_job(WRONG_PID, descr, (uintptr_t)NO_JOB_ID,
-			important ? BJT_OPERATION : BJT_TASK);
+	task->func = task_func;
+	task->args = args;
+	task->cls = cls;
+	task->path = NULL;
+	task->resolving = 0;
+	task->queue = &nodev_queue;
+	task->job = add_background_job(WRONG_PID, descr, (uintptr_t)NO_JOB_ID,
+			cls == BJC_BULK_IO ? BJT_OPERATION : BJT_TASK);
 
-	if(task_args->job == NULL)
+	if(task->job == NULL)
 	{
-		free(task_args);
+		free(task);
 		return 1;
 	}
 
-	replace_string(&task_args->job->bg_op.descr, op_descr);
-	task_args->job->bg_op.total = total;
+	if(path != NULL && (task->path = strdup(path)) != NULL)
+	{
+		/* Device will be determined by a worker. */
+		task->queue = &unresolved_queue;
+	}
+
+	replace_string(&task->job->bg_op.descr, op_descr);
+	task->job->bg_op.total = total;
+
+	if(task->job->type == BJT_OPERATION)
+	{
+		ui_stat_job_bar_add(&task->job->bg_op);
+	}
 
-	if(task_args->job->type == BJT_OPERATION)
+	pthread_mutex_lock(&sched_lock);
+	++task->queue->ntasks;
+	enqueue_task(task);
+	failed = (wake_worker() != 0 && nworking == 0 && nidle == 0);
+	if(failed)
 	{
-		ui_stat_job_bar_add(&task_args->job->bg_op);
+		/* There is no worker to run the task. */
+		*find_task_link(task) = task->next;
+		task->job->task = NULL;
+		--task->queue->ntasks;
 	}
+	pthread_mutex_unlock(&sched_lock);
 
-	ret = 0;
-	if(pthread_create(&id, NULL, &background_task_bootstrap, task_args) != 0)
+	if(failed)
 	{
 		/* Mark job as finished with error. */
-		pthread_spin_lock(&task_args->job->status_lock);
-		task_args->job->running = 0;
-		task_args->job->exit_code = 1;
-		pthread_spin_unlock(&task_args->job->status_lock);
+		pthread_spin_lock(&task->job->status_lock);
+		task->job->running = 0;
+		task->job->exit_code = 1;
+		pthread_spin_unlock(&task->job->status_lock);
+
+		free(task->path);
+		free(task);
+	}
+
+	return failed;
+}
+
+/* Takes task whose device isn't known and isn't being determined by another
+ * worker.  Must be called with sched_lock held.  Returns the task, which stays
+ * in the queue, or NULL. */
+static bg_task_t *
+take_unresolved_task(void)
+{
+	bg_task_t *task = unresolved_queue.head;
+	while(task != NULL && task->resolving)
+	{
+		task = task->next;
+	}
+
+	if(task != NULL)
+	{
+		task->resolving = 1;
+	}
+	return task;
+}
+
+/* Determines device of the task and moves it to the queue of that device.
+ * Must be called with sched_lock held, which is released while device is being
+ * queried. */
+static void
+resolve_task(bg_task_t *task)
+{
+	struct stat st;
+	int have_dev;
+	dev_queue_t *queue;
+
+	pthread_mutex_unlock(&sched_lock);
+	have_dev = (os_stat(task->path, &st) == 0);
+	pthread_mutex_lock(&sched_lock);
+
+	queue = (have_dev ? get_dev_queue(st.st_dev) : &nodev_queue);
+
+	*find_task_link(task) = task->next;
+	--unresolved_queue.ntasks;
+	free(task->path);
+	task->path = NULL;
+	task->resolving = 0;
+
+	task->queue = queue;
+	++queue->ntasks;
+	enqueue_task(task);
+}
+
+/* Finds or creates queue of the device.  Falls back to the queue of tasks
+ * without a device on failure.  Must be called with sched_lock held.  Returns
+ * the queue. */
+static dev_queue_t *
+get_dev_queue(dev_t dev)
+{
+	dev_queue_t *queue;
+
+	for(queue = dev_queues; queue != NULL; queue = queue->next)
+	{
+		if(queue != &nodev_queue && queue->dev == dev)
+		{
+			return queue;
+		}
+	}
+
+	queue = calloc(1, sizeof(*queue));
+	if(queue == NULL)
+	{
+		return &nodev_queue;
+	}
+
+	queue->dev = dev;
+	queue->next = dev_queues;
+	dev_queues = queue;
+	return queue;
+}
+
+/* Drops reference of a task to the queue freeing the queue if it's not used
+ * anymore.  Must be called with sched_lock held. */
+static void
+release_dev_queue(dev_queue_t *queue)
+{
+	dev_queue_t **link;
+
+	if(--queue->ntasks != 0 || queue == &nodev_queue ||
+			queue == &unresolved_queue)
+	{
+		return;
+	}
+
+	link = &dev_queues;
+	while(*link != queue)
+	{
+		link = &(*link)->next;
+	}
+	*link = queue->next;
+	free(queue);
+}
+
+/* Puts the task into its queue after all tasks of the same or higher priority.
+ * Must be called with sched_lock held. */
+static void
+enqueue_task(bg_task_t *task)
+{
+	bg_task_t **link = &task->queue->head;
+	while(*link != NULL && (*link)->cls <= task->cls)
+	{
+		link = &(*link)->next;
+	}
+
+	task->next = *link;
+	task->queued = 1;
+	*link = task;
+	task->job->task = task;
+}
+
+/* Makes one more worker look for a task if limit on number of workers allows
+ * it.  Must be called with sched_lock held.  Returns zero on success and
+ * non-zero if new worker couldn't be started. */
+static int
+wake_worker(void)
+{
+	pthread_t id;
+
+	if(nworking >= MAX_WORKERS)
+	{
+		return 0;
+	}
+
+	if(nidle > 0)
+	{
+		--nidle;
+		++nwakeups;
+		++nworking;
+		pthread_cond_signal(&sched_cond);
+		return 0;
+	}
+
+	if(pthread_create(&id, NULL, &worker_thread, NULL) != 0)
+	{
+		return 1;
+	}
+	++nworking;
+	return 0;
+}
 
-		free(task_args);
-		ret = 1;
+/* Entry point of a worker thread, which runs tasks one by one.  Returns NULL.
+ */
+static void *
+worker_thread(void *arg)
+{
+	(void)pthread_detach(pthread_self());
+	block_all_thread_signals();
+
+	pthread_mutex_lock(&sched_lock);
+	while(1)
+	{
+		bg_task_t *task = take_unresolved_task();
+		if(task != NULL)
+		{
+			resolve_task(task);
+			continue;
+		}
+
+		task = pick_task();
+		if(task == NULL)
+		{
+			--nworking;
+			++nidle;
+			while(nwakeups == 0)
+			{
+				pthread_cond_wait(&sched_cond, &sched_lock);
+			}
+			--nwakeups;
+			continue;
+		}
+
+		pthread_mutex_unlock(&sched_lock);
+		run_task(task);
+		pthread_mutex_lock(&sched_lock);
 	}
 
-	return ret;
+	return NULL;
+}
+
+/* Picks the task to be run next: the first task of each queue that isn't
+ * paused is of the highest priority among tasks that wait for the device and
+ * it's a candidate unless its class is blocked on the device.  The candidate of
+ * the highest priority wins.  Must be called with sched_lock held.  Returns the
+ * task, which is removed from its queue, or NULL. */
+static bg_task_t *
+pick_task(void)
+{
+	bg_task_t **best = NULL;
+	bg_task_t *task;
+	dev_queue_t *queue;
+
+	for(queue = dev_queues; queue != NULL; queue = queue->next)
+	{
+		bg_task_t **link = &queue->head;
+		while(*link != NULL && (*link)->job->paused)
+		{
+			link = &(*link)->next;
+		}
+
+		if(*link != NULL && !is_class_blocked(queue, (*link)->cls) &&
+				(best == NULL || (*link)->cls < (*best)->cls))
+		{
+			best = link;
+		}
+	}
+
+	if(best == NULL)
+	{
+		return NULL;
+	}
+
+	task = *best;
+	*best = task->next;
+	task->next = NULL;
+	task->queued = 0;
+	++task->queue->running[task->cls];
+	return task;
+}
+
+/* Checks whether task of the class can't be started on the device because a
+ * task of the same or higher priority is running there.  Must be called with
+ * sched_lock held.  Returns non-zero if so, otherwise zero is returned. */
+static int
+is_class_blocked(const dev_queue_t *queue, BgJobClass cls)
+{
+	int i;
+	for(i = 0; i <= (int)cls; ++i)
+	{
+		if(queue->running[i] != 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Runs the task on current thread and performs correct startup/exit with
+ * related updates of internal data structures.  Frees the task. */
+static void
+run_task(bg_task_t *task)
+{
+	bg_job_t *const job = task->job;
+
+	set_current_job(job);
+	task->func(&job->bg_op, task->args);
+	set_current_job(NULL);
+
+	pthread_mutex_lock(&sched_lock);
+	--task->queue->running[task->cls];
+	release_dev_queue(task->queue);
+	job->task = NULL;
+	pthread_mutex_unlock(&sched_lock);
+
+	free(task);
+
+	/* Mark task as finished normally.  The job can be freed after this. */
+	pthread_spin_lock(&job->status_lock);
+	job->running = 0;
+	job->exit_code = 0;
+	pthread_spin_unlock(&job->status_lock);
+}
+
+/* Blocks current thread while the job that runs on it is paused.  Slot of the
+ * task is released for the time of the pause. */
+static void
+wait_while_paused(bg_job_t *job)
+{
+	bg_task_t *task;
+
+	pthread_mutex_lock(&sched_lock);
+	task = job->task;
+	if(job->paused && task != NULL)
+	{
+		--task->queue->running[task->cls];
+		--nworking;
+		(void)wake_worker();
+
+		while(job->paused)
+		{
+			pthread_cond_wait(&pause_cond, &sched_lock);
+		}
+
+		++nworking;
+		++task->queue->running[task->cls];
+	}
+	pthread_mutex_unlock(&sched_lock);
+}
+
+/* Finds link to the task in its queue.  Must be called with sched_lock held.
+ * Returns pointer to the link. */
+static bg_task_t **
+find_task_link(bg_task_t *task)
+{
+	bg_task_t **link = &task->queue->head;
+	while(*link != task)
+	{
+		link = &(*link)->next;
+	}
+	return link;
 }
 
 /* Creates structure that describes background job and registers it in the list
@@ -985,7 +1626,7 @@ add_background_job(pid_t pid, const char cmd[], uintptr_t data, BgJobType type)
 		new->err_next = new_err_jobs;
 		new_err_jobs = new;
 		pthread_mutex_unlock(&new_err_jobs_lock);
-		pthread_cond_signal(&new_err_jobs_cond);
+		notify_error_thread();
 	}
 #else
 	new->hprocess = (HANDLE)data;
@@ -995,6 +1636,8 @@ add_background_job(pid_t pid, const char cmd[], uintptr_t data, BgJobType type)
 	{
 		pthread_spin_init(&new->bg_op_lock, PTHREAD_PROCESS_PRIVATE);
 	}
+	new->task = NULL;
+	new->paused = 0;
 	new->bg_op.total = 0;
 	new->bg_op.done = 0;
 	new->bg_op.progress = -1;
@@ -1005,31 +1648,6 @@ add_background_job(pid_t pid, const char cmd[], uintptr_t data, BgJobType type)
 	return new;
 }
 
-/* pthreads entry point for a new background task.  Performs correct
- * startup/exit with related updates of internal data structures.  Returns
- * result for this thread. */
-static void *
-background_task_bootstrap(void *arg)
-{
-	background_task_args *const task_args = arg;
-
-	(void)pthread_detach(pthread_self());
-	block_all_thread_signals();
-	set_current_job(task_args->job);
-
-	task_args->func(&task_args->job->bg_op, task_args->args);
-
-	/* Mark task as finished normally. */
-	pthread_spin_lock(&task_args->job->status_lock);
-	task_args->job->running = 0;
-	task_args->job->exit_code = 0;
-	pthread_spin_unlock(&task_args->job->status_lock);
-
-	free(task_args);
-
-	return NULL;
-}
-
 /* Stores pointer to the job in a thread-local storage. */
 static void
 set_current_job(bg_job_t *job)
@@ -1146,6 +1764,101 @@ bg_job_is_running(bg_job_t *job)
 	return running;
 }
 
+int
+bg_job_set_paused(bg_job_t *job, int paused)
+{
+	if(job->type == BJT_COMMAND)
+	{
+		return 1;
+	}
+
+	pthread_mutex_lock(&sched_lock);
+	job->paused = (paused != 0);
+	if(!job->paused)
+	{
+		pthread_cond_broadcast(&pause_cond);
+		if(job->task != NULL && job->task->queued)
+		{
+			(void)wake_worker();
+		}
+	}
+	pthread_mutex_unlock(&sched_lock);
+	return 0;
+}
+
+int
+bg_job_is_paused(bg_job_t *job)
+{
+	int paused;
+	pthread_mutex_lock(&sched_lock);
+	paused = job->paused;
+	pthread_mutex_unlock(&sched_lock);
+	return paused;
+}
+
+int
+bg_job_queue_pos(bg_job_t *job)
+{
+	int pos = 0;
+
+	pthread_mutex_lock(&sched_lock);
+	if(job->task != NULL && job->task->queued)
+	{
+		bg_task_t *task = job->task->queue->head;
+		for(pos = 1; task != job->task; task = task->next)
+		{
+			++pos;
+		}
+	}
+	pthread_mutex_unlock(&sched_lock);
+
+	return pos;
+}
+
+int
+bg_job_move(bg_job_t *job, int towards)
+{
+	bg_task_t *task;
+	bg_task_t **link;
+	int failed = 1;
+
+	pthread_mutex_lock(&sched_lock);
+	task = job->task;
+	if(task != NULL && task->queued)
+	{
+		link = find_task_link(task);
+		/* Moving a task past task of another class would break ordering of the
+		 * queue by class. */
+		if(towards > 0 && task->next != NULL && task->next->cls == task->cls)
+		{
+			/* A -> task -> B -> C  =>  A -> B -> task -> C */
+			*link = task->next;
+			task->next = (*link)->next;
+			(*link)->next = task;
+			failed = 0;
+		}
+		else if(towards < 0 && link != &task->queue->head)
+		{
+			/* A -> B -> task -> C  =>  A -> task -> B -> C */
+			bg_task_t **prev_link = &task->queue->head;
+			while(&(*prev_link)->next != link)
+			{
+				prev_link = &(*prev_link)->next;
+			}
+			if((*prev_link)->cls == task->cls)
+			{
+				*link = task->next;
+				task->next = *prev_link;
+				*prev_link = task;
+				failed = 0;
+			}
+		}
+	}
+	pthread_mutex_unlock(&sched_lock);
+
+	return failed;
+}
+
 void
 bg_op_lock(bg_op_t *bg_op)
 {
@@ -1188,6 +1901,9 @@ bg_op_cancel(bg_op_t *bg_op)
 	bg_op->cancelled = 1;
 	bg_op_unlock(bg_op);
 
+	/* Paused task needs to run to completion to be cancelled. */
+	(void)bg_job_set_paused(STRUCT_FROM_FIELD(bg_job_t, bg_op, bg_op), 0);
+
 	bg_op_changed(bg_op);
 	return was_cancelled;
 }
@@ -1196,6 +1912,13 @@ int
 bg_op_cancelled(bg_op_t *bg_op)
 {
 	int cancelled;
+	bg_job_t *const job = STRUCT_FROM_FIELD(bg_job_t, bg_op, bg_op);
+
+	/* Pausing happens only on the thread of the job. */
+	if(pthread_getspecific(current_job) == job)
+	{
+		wait_while_paused(job);
+	}
 
 	bg_op_lock(bg_op);
 	cancelled = bg_op->cancelled;
@@ -45,6 +45,17 @@ typedef enum
 }
 BgJobType;
 
+/* Scheduling class of background operations and tasks.  Classes are listed in
+ * order of decreasing priority. */
+typedef enum
+{
+	BJC_INTERACTIVE, /* Work user is waiting for, e.g. preparing a preview. */
+	BJC_SIZE_CALC,   /* Calculation of sizes of directories. */
+	BJC_BULK_IO,     /* Processing of files, e.g. copying or deletion. */
+	BJC_COUNT        /* Number of classes. */
+}
+BgJobClass;
+
 /* Auxiliary structure to be updated by background tasks while they progress. */
 typedef struct bg_op_t
 {
@@ -86,6 +97,11 @@ typedef struct bg_job_t
 	pthread_spinlock_t bg_op_lock;
 	bg_op_t bg_op;
 
+	/* Scheduling state of operations and tasks guarded by lock of the
+	 * scheduler. */
+	struct bg_task_t *task; /* Scheduled task or NULL after it's finished. */
+	int paused;             /* Whether job was paused by the user. */
+
 #ifndef _WIN32
 	int fd;
 #else
@@ -135,10 +151,13 @@ void bg_process_finished_cb(pid_t pid, int exit_code);
  * needed. */
 void bg_check(void);
 
-/* Starts new background task, which is run in a separate thread.  Returns zero
- * on success, otherwise non-zero is returned. */
+/* Schedules new background task, which is run by one of worker threads after
+ * tasks of higher priority.  Tasks of the same class that operate on the same
+ * device (identified by path, which can be NULL) are run one at a time.  Tasks
+ * of BJC_BULK_IO class are operations.  Returns zero on success, otherwise
+ * non-zero is returned. */
 int bg_execute(const char descr[], const char op_descr[], int total,
-		int important, bg_task_func task_func, void *args);
+		BgJobClass cls, const char path[], bg_task_func task_func, void *args);
 
 /* Checks whether there are any internal jobs (not external applications tracked
  * by vifm) running in background. */
@@ -164,6 +183,25 @@ int bg_job_cancelled(bg_job_t *job);
  * zero is returned. */
 int bg_job_is_running(bg_job_t *job);
 
+/* Pauses or resumes operation or task.  Task that has already started is
+ * paused on its next check for cancellation.  Returns zero on success and
+ * non-zero if the job can't be paused. */
+int bg_job_set_paused(bg_job_t *job, int paused);
+
+/* Checks whether the job is paused.  Returns non-zero if so, otherwise zero is
+ * returned. */
+int bg_job_is_paused(bg_job_t *job);
+
+/* Retrieves position of the job in queue of its device.  Returns one-based
+ * position or zero if the job isn't waiting to be started. */
+int bg_job_queue_pos(bg_job_t *job);
+
+/* Moves job that's waiting to be started one position closer to the head
+ * (towards is negative) or to the tail (towards is positive) of its queue.
+ * Jobs can't be moved past jobs of another class.  Returns zero on success and
+ * non-zero if the job can't be moved. */
+int bg_job_move(bg_job_t *job, int towards);
+
 /* Temporary locks bg_op_t structure to ensure that it's not modified by
  * anyone during reading/updating its fields.  The structure must be part of
  * bg_job_t. */
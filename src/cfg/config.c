@@ -34,6 +34,10 @@
 #define SAMPLE_MEDIAPRG "vifm-media-osx"
 #endif
 
+/* Upper limit on automatically chosen number of threads for reading file
+ * system, more of them rarely help and just compete for the same devices. */
+#define MAX_AUTO_READ_THREADS 16
+
 #ifdef _WIN32
 #define FIND_DEFAULT_PREDICATE "-iname"
 #else
@@ -215,6 +219,8 @@ cfg_init(void)
 	cfg.name_dec_count = 0;
 
 	cfg.fast_file_cloning = 0;
+	cfg.io_threads = 0;
+	cfg.mime_cache_size = 1024;
 	cfg.cvoptions = 0;
 
 	cfg.case_override = 0;
@@ -936,5 +942,15 @@ cfg_ch_pos_on(ChposWhen when)
 	return cfg.auto_ch_pos && (cfg.ch_pos_on & when);
 }
 
+int
+cfg_read_threads(void)
+{
+	if(cfg.io_threads > 0)
+	{
+		return cfg.io_threads;
+	}
+	return MIN((int)get_cpu_count(), MAX_AUTO_READ_THREADS);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -129,7 +129,9 @@ enum
 	VINFO_PHISTORY  = 1 << 13, /* Prompt history. */
 	VINFO_SHISTORY  = 1 << 14, /* Search history. */
 	VINFO_SAVEDIRS  = 1 << 15, /* Restore last used directories on startup. */
-	NUM_VINFO       = 16,      /* Number of VINFO_* constants. */
+	VINFO_DCACHE    = 1 << 16, /* Cached sizes of directories. */
+	VINFO_DIGESTS   = 1 << 17, /* Cached digests of file contents. */
+	NUM_VINFO       = 18,      /* Number of VINFO_* constants. */
 };
 
 /* When cursor position should be adjusted according to directory history. */
@@ -293,6 +295,13 @@ typedef struct config_t
 	/* Controls use of fast file cloning for file systems that support it. */
 	int fast_file_cloning;
 
+	/* Maximum number of files copied or moved concurrently and number of threads
+	 * used for reading file system.  Zero means automatic value. */
+	int io_threads;
+
+	/* Maximum number of entries in cache of mime-types. */
+	int mime_cache_size;
+
 	/* Whether various things should be reset on entering/leaving custom views. */
 	int cvoptions;
 
@@ -378,6 +387,11 @@ int cfg_confirm_delete(int to_trash);
  * Returns non-zero if so, otherwise zero is returned. */
 int cfg_ch_pos_on(ChposWhen when);
 
+/* Retrieves number of threads to be used by operations that only read file
+ * system, which is either the value of 'iothreads' or number of processors if
+ * it's zero.  Returns the number. */
+int cfg_read_threads(void);
+
 #endif /* VIFM__CFG__CONFIG_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -0,0 +1,404 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "dcache_file.h"
+
+#ifndef _WIN32
+#include <sys/mman.h> /* MAP_* PROT_* mmap() munmap() */
+#include <sys/stat.h> /* fstat() stat */
+#include <fcntl.h> /* O_RDONLY open() */
+#include <unistd.h> /* close() */
+#endif
+
+#include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h> /* FILE fclose() fread() fseek() ftell() fwrite() remove()
+                      snprintf() */
+#include <stdlib.h> /* free() malloc() */
+#include <string.h> /* memcmp() memcpy() strcmp() strlen() */
+
+#include "../compat/fs_limits.h"
+#include "../compat/os.h"
+#include "../compat/reallocarray.h"
+#include "../utils/fs.h"
+#include "../utils/utils.h"
+
+/* Identifies file format and its version. */
+#define MAGIC "VIFMDC01"
+
+/* Header of the file, which is followed by an array of offsets of records
+ * sorted by their paths. */
+typedef struct
+{
+	char magic[8];  /* Always equal to MAGIC. */
+	uint64_t count; /* Number of records. */
+}
+header_t;
+
+/* Record as it's stored in the file.  Records are aligned at 8 bytes. */
+typedef struct
+{
+	dcache_record_t data; /* Information about the directory. */
+	uint64_t path_len;    /* Length of the path that follows the record. */
+	char path[];          /* Nul-terminated path of the directory. */
+}
+entry_t;
+
+/* Loaded file. */
+struct dcache_file_t
+{
+	const char *data;        /* Contents of the file. */
+	size_t size;             /* Size of the data. */
+	const uint64_t *offsets; /* Sorted offsets of records. */
+	uint64_t count;          /* Number of records. */
+};
+
+/* Path with its record for sorting them before writing. */
+typedef struct
+{
+	const char *path;              /* Path of the record. */
+	const dcache_record_t *record; /* The record. */
+}
+sort_item_t;
+
+static int map_file(const char path[], const char **data, size_t *size);
+static void unmap_file(const char data[], size_t size);
+static const entry_t * get_entry(const dcache_file_t *file, uint64_t idx);
+static int sort_item_cmp(const void *a, const void *b);
+static int write_entries(FILE *fp, const sort_item_t items[], int count);
+static size_t entry_size(const char path[]);
+
+dcache_file_t *
+dcache_file_open(const char path[])
+{
+	header_t header;
+	const char *data;
+	size_t size;
+	dcache_file_t *file;
+
+	if(map_file(path, &data, &size) != 0)
+	{
+		return NULL;
+	}
+
+	memcpy(&header, data, sizeof(header));
+	if(memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 ||
+			header.count > (size - sizeof(header))/sizeof(uint64_t))
+	{
+		unmap_file(data, size);
+		return NULL;
+	}
+
+	file = malloc(sizeof(*file));
+	if(file == NULL)
+	{
+		unmap_file(data, size);
+		return NULL;
+	}
+
+	file->data = data;
+	file->size = size;
+	file->offsets = (const uint64_t *)(data + sizeof(header));
+	file->count = header.count;
+	return file;
+}
+
+void
+dcache_file_close(dcache_file_t *file)
+{
+	if(file != NULL)
+	{
+		unmap_file(file->data, file->size);
+		free(file);
+	}
+}
+
+/* Makes contents of a file available in memory.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+map_file(const char path[], const char **data, size_t *size)
+{
+#ifndef _WIN32
+	struct stat st;
+	void *mapped;
+
+	const int fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		return 1;
+	}
+
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header_t))
+	{
+		close(fd);
+		return 1;
+	}
+
+	/* Writers replace the file via rename() instead of changing it in place, so
+	 * a private mapping of the current file stays intact. */
+	mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapped == MAP_FAILED)
+	{
+		return 1;
+	}
+
+	*data = mapped;
+	*size = st.st_size;
+	return 0;
+#else
+	char *buf;
+	long len;
+
+	FILE *const fp = os_fopen(path, "rb");
+	if(fp == NULL)
+	{
+		return 1;
+	}
+
+	if(fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < (long)sizeof(header_t)
+			|| fseek(fp, 0, SEEK_SET) != 0)
+	{
+		fclose(fp);
+		return 1;
+	}
+
+	buf = malloc(len);
+	if(buf == NULL || fread(buf, len, 1, fp) != 1)
+	{
+		free(buf);
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	*data = buf;
+	*size = len;
+	return 0;
+#endif
+}
+
+/* Frees resources allocated by map_file(). */
+static void
+unmap_file(const char data[], size_t size)
+{
+#ifndef _WIN32
+	(void)munmap((void *)data, size);
+#else
+	free((void *)data);
+#endif
+}
+
+int
+dcache_file_find(const dcache_file_t *file, const char path[],
+		dcache_record_t *record)
+{
+	uint64_t l = 0U, u = file->count;
+	while(l < u)
+	{
+		const uint64_t m = l + (u - l)/2U;
+		const entry_t *const entry = get_entry(file, m);
+		int cmp;
+
+		if(entry == NULL)
+		{
+			return 1;
+		}
+
+		cmp = strcmp(path, entry->path);
+		if(cmp == 0)
+		{
+			*record = entry->data;
+			return 0;
+		}
+
+		if(cmp < 0)
+		{
+			u = m;
+		}
+		else
+		{
+			l = m + 1U;
+		}
+	}
+	return 1;
+}
+
+int
+dcache_file_count(const dcache_file_t *file)
+{
+	return file->count;
+}
+
+const char *
+dcache_file_get(const dcache_file_t *file, int idx, dcache_record_t *record)
+{
+	const entry_t *entry;
+
+	if(idx < 0 || (uint64_t)idx >= file->count)
+	{
+		return NULL;
+	}
+
+	entry = get_entry(file, idx);
+	if(entry == NULL)
+	{
+		return NULL;
+	}
+
+	*record = entry->data;
+	return entry->path;
+}
+
+/* Retrieves entry by its index in the sorted table validating that it's fully
+ * within the file.  Returns pointer to the entry or NULL if file is broken. */
+static const entry_t *
+get_entry(const dcache_file_t *file, uint64_t idx)
+{
+	const entry_t *entry;
+	const uint64_t offset = file->offsets[idx];
+
+	if(offset % sizeof(uint64_t) != 0U || offset > file->size ||
+			file->size - offset < sizeof(*entry))
+	{
+		return NULL;
+	}
+
+	entry = (const entry_t *)(file->data + offset);
+	if(entry->path_len >= file->size - offset - sizeof(*entry) ||
+			entry->path[entry->path_len] != '\0')
+	{
+		return NULL;
+	}
+
+	return entry;
+}
+
+int
+dcache_file_write(const char path[], const char *paths[],
+		const dcache_record_t records[], int count)
+{
+	char tmp_file[PATH_MAX + 16];
+	sort_item_t *items;
+	FILE *fp;
+	int i;
+	int error;
+
+	items = reallocarray(NULL, count, sizeof(*items));
+	if(items == NULL && count != 0)
+	{
+		return 1;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		items[i].path = paths[i];
+		items[i].record = &records[i];
+	}
+	safe_qsort(items, count, sizeof(*items), &sort_item_cmp);
+
+	snprintf(tmp_file, sizeof(tmp_file), "%s_%u", path, get_pid());
+	fp = os_fopen(tmp_file, "wb");
+	if(fp == NULL)
+	{
+		free(items);
+		return 1;
+	}
+
+	error = write_entries(fp, items, count);
+	error |= (fclose(fp) != 0);
+	free(items);
+
+	if(error || rename_file(tmp_file, path) != 0)
+	{
+		(void)remove(tmp_file);
+		return 1;
+	}
+	return 0;
+}
+
+/* qsort() comparer that orders items by their paths.  Returns standard -1, 0, 1
+ * for comparisons. */
+static int
+sort_item_cmp(const void *a, const void *b)
+{
+	const sort_item_t *const item_a = a;
+	const sort_item_t *const item_b = b;
+	return strcmp(item_a->path, item_b->path);
+}
+
+/* Writes header, offsets and records to the file.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+write_entries(FILE *fp, const sort_item_t items[], int count)
+{
+	static const char padding[sizeof(uint64_t)];
+
+	header_t header;
+	uint64_t offset;
+	int i;
+
+	memcpy(header.magic, MAGIC, sizeof(header.magic));
+	header.count = count;
+	if(fwrite(&header, sizeof(header), 1, fp) != 1)
+	{
+		return 1;
+	}
+
+	offset = sizeof(header) + count*sizeof(uint64_t);
+	for(i = 0; i < count; ++i)
+	{
+		if(fwrite(&offset, sizeof(offset), 1, fp) != 1)
+		{
+			return 1;
+		}
+		offset += entry_size(items[i].path);
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		entry_t entry;
+		const size_t path_len = strlen(items[i].path);
+		const size_t len = sizeof(entry) + path_len + 1U;
+		const size_t padding_len = entry_size(items[i].path) - len;
+
+		entry.data = *items[i].record;
+		entry.path_len = path_len;
+
+		if(fwrite(&entry, sizeof(entry), 1, fp) != 1 ||
+				fwrite(items[i].path, path_len + 1U, 1, fp) != 1 ||
+				fwrite(padding, padding_len, 1, fp) != (padding_len != 0U))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Computes size of an entry in the file including padding for alignment.
+ * Returns the size. */
+static size_t
+entry_size(const char path[])
+{
+	const size_t len = sizeof(entry_t) + strlen(path) + 1U;
+	return (len + sizeof(uint64_t) - 1U)/sizeof(uint64_t)*sizeof(uint64_t);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
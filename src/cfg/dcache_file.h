@@ -0,0 +1,73 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__CFG__DCACHE_FILE_H__
+#define VIFM__CFG__DCACHE_FILE_H__
+
+#include <stdint.h> /* int64_t uint64_t */
+
+/* Persistent storage of directory information between runs.  The file is a
+ * sorted by path table of fixed-size records, which is mapped into memory and
+ * searched in place without parsing it as a whole. */
+
+/* Information about a single directory. */
+typedef struct
+{
+	uint64_t size;     /* Size of the directory. */
+	uint64_t nitems;   /* Number of items in the directory. */
+	int64_t size_ts;   /* When size was computed. */
+	int64_t nitems_ts; /* When number of items was computed. */
+	int64_t mtime;     /* Modification time of the directory at the moment. */
+	uint64_t inode;    /* Inode number of the directory. */
+	uint64_t dev;      /* Device of the directory. */
+}
+dcache_record_t;
+
+/* Opaque handle of a loaded file. */
+typedef struct dcache_file_t dcache_file_t;
+
+/* Maps existing file into memory.  Returns the handle or NULL if the file is
+ * missing or is not a valid dcache file. */
+dcache_file_t * dcache_file_open(const char path[]);
+
+/* Frees resources of the file.  file can be NULL. */
+void dcache_file_close(dcache_file_t *file);
+
+/* Looks up record by path of the directory.  Returns zero and fills *record if
+ * it was found, otherwise non-zero is returned. */
+int dcache_file_find(const dcache_file_t *file, const char path[],
+		dcache_record_t *record);
+
+/* Retrieves number of records in the file.  Returns the number. */
+int dcache_file_count(const dcache_file_t *file);
+
+/* Retrieves record by its index.  Returns path of the record or NULL on invalid
+ * index. */
+const char * dcache_file_get(const dcache_file_t *file, int idx,
+		dcache_record_t *record);
+
+/* Writes count records into a file replacing it atomically.  paths and records
+ * are parallel arrays, which don't need to be sorted.  Returns zero on success,
+ * otherwise non-zero is returned. */
+int dcache_file_write(const char path[], const char *paths[],
+		const dcache_record_t records[], int count);
+
+#endif /* VIFM__CFG__DCACHE_FILE_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -49,6 +49,7 @@
 #include "../utils/utils.h"
 #include "../bmarks.h"
 #include "../cmd_core.h"
+#include "../digests.h"
 #include "../dir_stack.h"
 #include "../filelist.h"
 #include "../flist_hist.h"
@@ -520,6 +521,9 @@ write_info_file(void)
 			(void)remove(tmp_file);
 		}
 	}
+
+	dcache_save();
+	digests_save();
 }
 
 /* Copies the src file to the dst location.  Returns zero on success. */
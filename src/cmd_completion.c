@@ -92,6 +92,7 @@ static void complete_winrun(const char str[]);
 static void complete_from_string_list(const char str[], const char *items[][2],
 		size_t item_count, int ignore_case);
 static void complete_command_name(const char beginning[]);
+static void complete_execs(char *names[], int count, int skip_hidden);
 static int filename_completion_in_dir(const char path[], const char str[],
 		CompletionType type);
 static void filename_completion_internal(DIR *dir, const char dir_path[],
@@ -878,16 +879,52 @@ complete_command_name(const char beginning[])
 	paths = get_paths(&paths_count);
 	for(i = 0U; i < paths_count; ++i)
 	{
-		if(vifm_chdir(paths[i]) == 0)
+		char **names;
+		int count;
+
+		if(vifm_chdir(paths[i]) != 0)
+		{
+			continue;
+		}
+
+		if(list_path_entries(i, beginning, &names, &count) != 0)
 		{
 			filename_completion(beginning, CT_EXECONLY, 1);
+			continue;
 		}
+
+		complete_execs(names, count, beginning[0] == '\0');
 	}
 	vle_compl_add_last_path_match(beginning);
 
 	restore_cwd(cwd);
 }
 
+/* Adds executables from the list of names of files in current directory to
+ * completion list.  Dot files are skipped if skip_hidden is non-zero. */
+static void
+complete_execs(char *names[], int count, int skip_hidden)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		if(skip_hidden && names[i][0] == '.')
+		{
+			continue;
+		}
+
+#ifndef _WIN32
+		if(executable_exists(names[i]))
+#else
+		if(is_win_executable(names[i]))
+#endif
+		{
+			vle_compl_add_path_match(names[i]);
+		}
+	}
+	vle_compl_finish_group();
+}
+
 /* Does filename completion outside current working directory.  Returns
  * completion start offset. */
 static int
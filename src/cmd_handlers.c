@@ -826,7 +826,7 @@ const cmd_add_t cmds_list[] = {
 	{ .name = "tree",              .abbr = NULL,    .id = -1,
 	  .descr = "display filesystem as a tree",
 	  .flags = HAS_EMARK | HAS_COMMENT,
-	  .handler = &tree_cmd,        .min_args = 0,   .max_args = 0, },
+	  .handler = &tree_cmd,        .min_args = 0,   .max_args = 1, },
 	{ .name = "undolist",          .abbr = "undol", .id = -1,
 	  .descr = "display list of operations",
 	  .flags = HAS_EMARK | HAS_COMMENT,
@@ -4352,13 +4352,24 @@ tree_cmd(const cmd_info_t *cmd_info)
 	int in_tree = flist_custom_active(curr_view)
 	           && cv_tree(curr_view->custom.type);
 
+	int depth = 0;
+	if(cmd_info->argc != 0)
+	{
+		const char *arg = cmd_info->argv[0];
+		if(!skip_prefix(&arg, "depth=") || !read_int(arg, &depth) || depth <= 0)
+		{
+			ui_sb_errf("Invalid argument: %s", cmd_info->argv[0]);
+			return CMDS_ERR_CUSTOM;
+		}
+	}
+
 	if(cmd_info->emark && in_tree)
 	{
 		cd_updir(curr_view, 1);
 	}
 	else
 	{
-		(void)flist_load_tree(curr_view, flist_get_dir(curr_view));
+		(void)flist_load_tree(curr_view, flist_get_dir(curr_view), depth);
 	}
 	return 0;
 }
@@ -19,14 +19,19 @@
 #include "compare.h"
 
 #include <assert.h> /* assert() */
+#include <sys/time.h> /* gettimeofday() timeval */
+
 #include <stddef.h> /* size_t */
-#include <stdint.h> /* INTPTR_MAX INT64_MAX */
-#include <stdio.h> /* FILE fclose() feof() fopen() fread() */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h> /* snprintf() */
 #include <stdlib.h> /* free() malloc() */
-#include <string.h> /* memcmp() */
+#include <string.h> /* strcmp() strlen() */
+#include <time.h> /* timespec */
 
+#include "cfg/config.h"
 #include "compat/fs_limits.h"
 #include "compat/os.h"
+#include "compat/pthread.h"
 #include "compat/reallocarray.h"
 #include "modes/dialogs/msg_dialog.h"
 #include "ui/cancellation.h"
@@ -41,20 +46,15 @@
 #include "utils/string_array.h"
 #include "utils/trie.h"
 #include "utils/utils.h"
+#include "digests.h"
 #include "filelist.h"
 #include "fops_cpmv.h"
 #include "fops_misc.h"
 #include "running.h"
 
-/* This is the only unit that uses xxhash, so import it directly here. */
-#define XXH_PRIVATE_API
-#include "utils/xxhash.h"
-
-/* Amount of data to read at once. */
-#define BLOCK_SIZE (32*1024)
-
-/* Amount of data to hash for coarse comparison. */
-#define PREFIX_SIZE (256*1024)
+/* How often progress is updated and cancellation is checked while waiting for
+ * comparison pipeline (in milliseconds). */
+#define PROGRESS_PERIOD_MS 100
 
 /* Entry in singly-bounded list of files that have matched fingerprints. */
 typedef struct compare_record_t
@@ -65,6 +65,45 @@ typedef struct compare_record_t
 }
 compare_record_t;
 
+/* State of hashing of a listed file. */
+typedef enum
+{
+	HS_PENDING, /* Digest isn't computed yet. */
+	HS_DONE,    /* Digest is available (or isn't needed). */
+	HS_FAILED,  /* File couldn't be read. */
+}
+HashState;
+
+/* Result of hashing a single listed file. */
+typedef struct
+{
+	uint64_t digest; /* Digest of leading part of the file. */
+	HashState state; /* Whether digest is available. */
+}
+hash_slot_t;
+
+/* State of comparison pipeline shared by its threads.  Files are listed by one
+ * thread, hashed by a pool of threads and merged into a list of entries in
+ * order of listing by the thread that started the comparison. */
+typedef struct
+{
+	const char *root;     /* Directory to list or NULL if files are known. */
+	int skip_dot_files;   /* Whether dot files should be skipped. */
+	int hash;             /* Whether files need to be hashed. */
+	struct timeval last_report; /* When progress was reported last time. */
+
+	pthread_mutex_t lock; /* Protects fields below. */
+	pthread_cond_t has_work;    /* Signaled when files are listed or on stop. */
+	pthread_cond_t has_results; /* Signaled when files are listed or hashed. */
+	strlist_t files;      /* Listed files. */
+	hash_slot_t *slots;   /* Hashing results for each of the files. */
+	int capacity;         /* Number of allocated elements of files and slots. */
+	int next;             /* Index of the next file to hash. */
+	int listed;           /* Whether listing is done. */
+	int stop;             /* Whether pipeline should stop. */
+}
+pipeline_t;
+
 static void make_unique_lists(entries_t curr, entries_t other);
 static void leave_only_dups(entries_t *curr, entries_t *other);
 static int is_not_duplicate(view_t *view, const dir_entry_t *entry, void *arg);
@@ -73,18 +112,35 @@ static int id_sorter(const void *first, const void *second);
 static void put_or_free(view_t *view, dir_entry_t *entry, int id, int take);
 static entries_t make_diff_list(trie_t *trie, view_t *view, int *next_id,
 		CompareType ct, int skip_empty, int dups_only);
+static void run_pipeline(pipeline_t *p, view_t *view, CompareType ct,
+		int skip_empty, entries_t *r, strlist_t *fingerprints);
+static void wait_for_results(pipeline_t *p);
+static void check_progress(pipeline_t *p, int merged);
+static void add_listed_file(view_t *view, entries_t *r,
+		strlist_t *fingerprints, const char path[], int idx,
+		const hash_slot_t *slot, CompareType ct, int skip_empty);
+static void * lister_main(void *arg);
+static void * hasher_main(void *arg);
+static void hash_file(const char path[], hash_slot_t *slot);
+static int pipeline_add_files(pipeline_t *p, char *files[], int count);
+static int pipeline_reserve(pipeline_t *p, int count);
+static int pipeline_stopped(pipeline_t *p);
+static void prefetch_digests(trie_t *trie, const entries_t *list,
+		char *fingerprints[], char *paths[]);
+static void add_colliding(strlist_t *list, trie_t *added, const char path[]);
 static void list_view_entries(const view_t *view, strlist_t *list);
 static int append_valid_nodes(const char name[], int valid,
 		const void *parent_data, void *data, void *arg);
 static void list_files_recursively(const char path[], int skip_dot_files,
-		strlist_t *list);
+		pipeline_t *p);
 static char * get_file_fingerprint(const char path[], const dir_entry_t *entry,
 		CompareType ct);
 static char * get_contents_fingerprint(const char path[],
 		const dir_entry_t *entry);
+static char * format_contents_fingerprint(const dir_entry_t *entry,
+		uint64_t digest);
 static int get_file_id(trie_t *trie, const char path[],
 		const char fingerprint[], int *id, CompareType ct);
-static int files_are_identical(const char a[], const char b[]);
 static void put_file_id(trie_t *trie, const char path[],
 		const char fingerprint[], int id, CompareType ct);
 static void free_compare_records(void *ptr);
@@ -497,51 +553,46 @@ make_diff_list(trie_t *trie, view_t *view, int *next_id, CompareType ct,
 		int skip_empty, int dups_only)
 {
 	int i;
-	strlist_t files = {};
 	entries_t r = {};
-	int last_progress = 0;
+	strlist_t fingerprints = {};
+	pipeline_t p = {
+		.hash = (ct == CT_CONTENTS),
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.has_work = PTHREAD_COND_INITIALIZER,
+		.has_results = PTHREAD_COND_INITIALIZER,
+	};
 
 	show_progress("Listing...", 0);
 	if(flist_custom_active(view) &&
 			ONE_OF(view->custom.type, CV_REGULAR, CV_VERY))
 	{
+		strlist_t files = {};
 		list_view_entries(view, &files);
+		(void)pipeline_add_files(&p, files.items, files.nitems);
+		free(files.items);
+		p.listed = 1;
 	}
 	else
 	{
-		list_files_recursively(flist_get_dir(view), view->hide_dot, &files);
+		p.root = flist_get_dir(view);
+		p.skip_dot_files = view->hide_dot;
 	}
 
-	show_progress("Querying...", 0);
-	for(i = 0; i < files.nitems && !ui_cancellation_requested(); ++i)
-	{
-		int progress;
-		int existing_id;
-		char *fingerprint;
-		const char *const path = files.items[i];
-		dir_entry_t *const entry = entry_list_add(view, &r.entries, &r.nentries,
-				path);
+	run_pipeline(&p, view, ct, skip_empty, &r, &fingerprints);
 
-		if(skip_empty && entry->size == 0)
-		{
-			fentry_free(view, entry);
-			--r.nentries;
-			continue;
-		}
+	if(ct == CT_CONTENTS && !ui_cancellation_requested())
+	{
+		show_progress("Hashing...", 0);
+		prefetch_digests(trie, &r, fingerprints.items, p.files.items);
+	}
 
-		fingerprint = get_file_fingerprint(path, entry, ct);
-		/* In case we couldn't obtain fingerprint (e.g., comparing by contents and
-		 * files isn't readable), ignore the file and keep going. */
-		if(is_null_or_empty(fingerprint))
-		{
-			free(fingerprint);
-			fentry_free(view, entry);
-			--r.nentries;
-			continue;
-		}
+	for(i = 0; i < r.nentries; ++i)
+	{
+		int existing_id;
+		dir_entry_t *const entry = &r.entries[i];
+		const char *const path = p.files.items[entry->tag];
 
-		entry->tag = i;
-		if(get_file_id(trie, path, fingerprint, &existing_id, ct))
+		if(get_file_id(trie, path, fingerprints.items[i], &existing_id, ct))
 		{
 			entry->id = existing_id;
 		}
@@ -553,25 +604,437 @@ make_diff_list(trie_t *trie, view_t *view, int *next_id, CompareType ct,
 		{
 			entry->id = *next_id;
 			++*next_id;
-			put_file_id(trie, path, fingerprint, entry->id, ct);
+			put_file_id(trie, path, fingerprints.items[i], entry->id, ct);
+		}
+	}
+
+	free_string_array(fingerprints.items, fingerprints.nitems);
+	free_string_array(p.files.items, p.files.nitems);
+	free(p.slots);
+	pthread_cond_destroy(&p.has_results);
+	pthread_cond_destroy(&p.has_work);
+	pthread_mutex_destroy(&p.lock);
+	return r;
+}
+
+/* Lists and hashes files in parallel merging results in order of listing into
+ * the list of entries and their fingerprints.  Files that can't be queried are
+ * skipped. */
+static void
+run_pipeline(pipeline_t *p, view_t *view, CompareType ct, int skip_empty,
+		entries_t *r, strlist_t *fingerprints)
+{
+	pthread_t lister;
+	int nworkers = (p->hash ? cfg_read_threads() : 0);
+	pthread_t *hashers = NULL;
+	int nhashers;
+	int has_lister = 0;
+	int merged = 0;
+	int i;
+
+	if(nworkers != 0)
+	{
+		hashers = reallocarray(NULL, nworkers, sizeof(*hashers));
+		if(hashers == NULL)
+		{
+			nworkers = 0;
+		}
+	}
+
+	for(nhashers = 0; nhashers < nworkers; ++nhashers)
+	{
+		if(pthread_create(&hashers[nhashers], NULL, &hasher_main, p) != 0)
+		{
+			break;
+		}
+	}
+
+	if(p->root != NULL)
+	{
+		has_lister = (pthread_create(&lister, NULL, &lister_main, p) == 0);
+		if(!has_lister)
+		{
+			/* Do listing on this thread. */
+			(void)lister_main(p);
+		}
+	}
+
+	show_progress("Querying...", 0);
+
+	pthread_mutex_lock(&p->lock);
+	while(!p->stop)
+	{
+		hash_slot_t slot;
+		const char *path;
+
+		check_progress(p, merged);
+		if(p->stop)
+		{
+			break;
+		}
+
+		if(merged == p->files.nitems || (p->slots[merged].state == HS_PENDING &&
+					nhashers != 0))
+		{
+			if(p->listed && merged == p->files.nitems)
+			{
+				break;
+			}
+
+			wait_for_results(p);
+			continue;
 		}
 
+		/* Pointers to strings remain valid even if array is reallocated. */
+		path = p->files.items[merged];
+		slot = p->slots[merged];
+		pthread_mutex_unlock(&p->lock);
+
+		if(slot.state == HS_PENDING)
+		{
+			/* There are no hashers, so do it here. */
+			hash_file(path, &slot);
+		}
+		add_listed_file(view, r, fingerprints, path, merged, &slot, ct,
+				skip_empty);
+		++merged;
+
+		pthread_mutex_lock(&p->lock);
+	}
+	p->stop = 1;
+	pthread_cond_broadcast(&p->has_work);
+	pthread_mutex_unlock(&p->lock);
+
+	if(has_lister)
+	{
+		(void)pthread_join(lister, NULL);
+	}
+	for(i = 0; i < nhashers; ++i)
+	{
+		(void)pthread_join(hashers[i], NULL);
+	}
+	free(hashers);
+}
+
+/* Waits for more results of the pipeline, but not longer than until it's time
+ * to report progress.  Should be called with the lock of the pipeline held. */
+static void
+wait_for_results(pipeline_t *p)
+{
+	struct timeval tv;
+	struct timespec deadline;
+
+	gettimeofday(&tv, NULL);
+	deadline.tv_sec = tv.tv_sec;
+	deadline.tv_nsec = (tv.tv_usec + PROGRESS_PERIOD_MS*1000L)*1000L;
+	deadline.tv_sec += deadline.tv_nsec/1000000000L;
+	deadline.tv_nsec %= 1000000000L;
+
+	(void)pthread_cond_timedwait(&p->has_results, &p->lock, &deadline);
+}
+
+/* Reports progress and checks for cancellation once in a while, the latter
+ * stops the pipeline.  Should be called with the lock of the pipeline held. */
+static void
+check_progress(pipeline_t *p, int merged)
+{
+	struct timeval now;
+	long elapsed_ms;
+	int listed, total;
+	char progress_msg[128];
+
+	gettimeofday(&now, NULL);
+	elapsed_ms = (now.tv_sec - p->last_report.tv_sec)*1000L
+	           + (now.tv_usec - p->last_report.tv_usec)/1000L;
+	if(elapsed_ms < PROGRESS_PERIOD_MS)
+	{
+		return;
+	}
+	p->last_report = now;
+
+	listed = p->listed;
+	total = p->files.nitems;
+	pthread_mutex_unlock(&p->lock);
+
+	if(listed)
+	{
+		snprintf(progress_msg, sizeof(progress_msg), "Querying... %d (% 2d%%)",
+				merged, (total == 0 ? 100 : (merged*100)/total));
+	}
+	else
+	{
+		snprintf(progress_msg, sizeof(progress_msg), "Listing... %d", total);
+	}
+	show_progress(progress_msg, -1);
+
+	pthread_mutex_lock(&p->lock);
+	if(ui_cancellation_requested())
+	{
+		p->stop = 1;
+	}
+}
+
+/* Adds listed file to the list of entries along with its fingerprint. */
+static void
+add_listed_file(view_t *view, entries_t *r, strlist_t *fingerprints,
+		const char path[], int idx, const hash_slot_t *slot, CompareType ct,
+		int skip_empty)
+{
+	char *fingerprint;
+	int nfingerprints;
+	dir_entry_t *const entry = entry_list_add(view, &r->entries, &r->nentries,
+			path);
+	if(entry == NULL)
+	{
+		return;
+	}
+
+	if(skip_empty && entry->size == 0)
+	{
+		fentry_free(view, entry);
+		--r->nentries;
+		return;
+	}
+
+	fingerprint = (ct == CT_CONTENTS)
+	            ? (slot->state == HS_DONE
+	                ? format_contents_fingerprint(entry, slot->digest)
+	                : NULL)
+	            : get_file_fingerprint(path, entry, ct);
+
+	/* In case we couldn't obtain fingerprint (e.g., comparing by contents and
+	 * files isn't readable), ignore the file and keep going. */
+	if(is_null_or_empty(fingerprint))
+	{
+		free(fingerprint);
+		fentry_free(view, entry);
+		--r->nentries;
+		return;
+	}
+
+	nfingerprints = put_into_string_array(&fingerprints->items,
+			fingerprints->nitems, fingerprint);
+	if(nfingerprints == fingerprints->nitems)
+	{
 		free(fingerprint);
+		fentry_free(view, entry);
+		--r->nentries;
+		return;
+	}
+	fingerprints->nitems = nfingerprints;
+
+	entry->tag = idx;
+}
+
+/* Entry point of the thread that lists files.  Returns NULL. */
+static void *
+lister_main(void *arg)
+{
+	pipeline_t *const p = arg;
+
+	list_files_recursively(p->root, p->skip_dot_files, p);
+
+	pthread_mutex_lock(&p->lock);
+	p->listed = 1;
+	pthread_cond_broadcast(&p->has_work);
+	pthread_cond_signal(&p->has_results);
+	pthread_mutex_unlock(&p->lock);
 
-		progress = (i*100)/files.nitems;
-		if(progress != last_progress)
+	return NULL;
+}
+
+/* Entry point of a thread that hashes files.  Returns NULL. */
+static void *
+hasher_main(void *arg)
+{
+	pipeline_t *const p = arg;
+
+	pthread_mutex_lock(&p->lock);
+	while(1)
+	{
+		int idx;
+		const char *path;
+		hash_slot_t slot;
+
+		if(p->stop || (p->listed && p->next == p->files.nitems))
 		{
-			char progress_msg[128];
+			break;
+		}
 
-			last_progress = progress;
-			snprintf(progress_msg, sizeof(progress_msg), "Querying... %d (% 2d%%)", i,
-					progress);
-			show_progress(progress_msg, -1);
+		if(p->next == p->files.nitems)
+		{
+			pthread_cond_wait(&p->has_work, &p->lock);
+			continue;
 		}
+
+		idx = p->next++;
+		path = p->files.items[idx];
+		pthread_mutex_unlock(&p->lock);
+
+		hash_file(path, &slot);
+
+		pthread_mutex_lock(&p->lock);
+		p->slots[idx] = slot;
+		pthread_cond_signal(&p->has_results);
 	}
+	pthread_mutex_unlock(&p->lock);
 
-	free_string_array(files.items, files.nitems);
-	return r;
+	return NULL;
+}
+
+/* Computes digest of leading part of a file. */
+static void
+hash_file(const char path[], hash_slot_t *slot)
+{
+	slot->state = (digests_get_prefix(path, &slot->digest) == 0)
+	            ? HS_DONE
+	            : HS_FAILED;
+}
+
+/* Appends files to the pipeline taking ownership of non-NULL elements of the
+ * array.  Returns zero on success, otherwise non-zero is returned. */
+static int
+pipeline_add_files(pipeline_t *p, char *files[], int count)
+{
+	int i;
+	int error = 0;
+
+	pthread_mutex_lock(&p->lock);
+	if(pipeline_reserve(p, count) != 0)
+	{
+		for(i = 0; i < count; ++i)
+		{
+			free(files[i]);
+		}
+		error = 1;
+		count = 0;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		if(files[i] != NULL)
+		{
+			p->files.items[p->files.nitems] = files[i];
+			p->slots[p->files.nitems].state = (p->hash ? HS_PENDING : HS_DONE);
+			++p->files.nitems;
+		}
+	}
+	pthread_cond_broadcast(&p->has_work);
+	pthread_cond_signal(&p->has_results);
+	pthread_mutex_unlock(&p->lock);
+
+	return error;
+}
+
+/* Makes sure that lists of files and slots can hold count more elements
+ * growing them geometrically.  Must be called with the lock held.  Returns zero
+ * on success, otherwise non-zero is returned. */
+static int
+pipeline_reserve(pipeline_t *p, int count)
+{
+	char **new_items;
+	hash_slot_t *new_slots;
+	int capacity;
+
+	if(p->files.nitems + count <= p->capacity)
+	{
+		return 0;
+	}
+
+	capacity = MAX(p->capacity*2, p->files.nitems + count);
+
+	new_items = reallocarray(p->files.items, capacity, sizeof(*p->files.items));
+	if(new_items == NULL)
+	{
+		return 1;
+	}
+	p->files.items = new_items;
+
+	new_slots = reallocarray(p->slots, capacity, sizeof(*p->slots));
+	if(new_slots == NULL)
+	{
+		return 1;
+	}
+	p->slots = new_slots;
+
+	p->capacity = capacity;
+	return 0;
+}
+
+/* Checks whether pipeline was stopped.  Returns non-zero if so, otherwise zero
+ * is returned. */
+static int
+pipeline_stopped(pipeline_t *p)
+{
+	int stopped;
+	pthread_mutex_lock(&p->lock);
+	stopped = p->stop;
+	pthread_mutex_unlock(&p->lock);
+	return stopped;
+}
+
+/* Computes full digests of files whose fingerprints collide with each other or
+ * with fingerprints of files in the trie in parallel, because they will be
+ * needed to tell whether those files are identical. */
+static void
+prefetch_digests(trie_t *trie, const entries_t *list, char *fingerprints[],
+		char *paths[])
+{
+	int i;
+	strlist_t colliding = {};
+	trie_t *const seen = trie_create();
+	trie_t *const added = trie_create();
+
+	if(cfg_read_threads() <= 1 || seen == NULL || added == NULL)
+	{
+		trie_free(seen);
+		trie_free(added);
+		return;
+	}
+
+	for(i = 0; i < list->nentries; ++i)
+	{
+		void *data;
+		const char *const path = paths[list->entries[i].tag];
+
+		if(trie_get(trie, fingerprints[i], &data) == 0)
+		{
+			const compare_record_t *record = data;
+			add_colliding(&colliding, added, path);
+			for(; record != NULL; record = record->next)
+			{
+				add_colliding(&colliding, added, record->path);
+			}
+		}
+
+		if(trie_get(seen, fingerprints[i], &data) == 0)
+		{
+			const int first = (int)(size_t)data - 1;
+			add_colliding(&colliding, added, paths[list->entries[first].tag]);
+			add_colliding(&colliding, added, path);
+		}
+		else
+		{
+			(void)trie_set(seen, fingerprints[i], (void *)(size_t)(i + 1));
+		}
+	}
+
+	digests_prefetch(colliding.items, colliding.nitems, cfg_read_threads(),
+			&ui_cancellation_info);
+
+	free_string_array(colliding.items, colliding.nitems);
+	trie_free(seen);
+	trie_free(added);
+}
+
+/* Appends path to the list unless it was already added. */
+static void
+add_colliding(strlist_t *list, trie_t *added, const char path[])
+{
+	if(trie_put(added, path) == 0)
+	{
+		list->nitems = add_to_string_array(&list->items, list->nitems, 1, path);
+	}
 }
 
 /* Fills the list with entries of the view in hierarchical order (pre-order tree
@@ -618,9 +1081,10 @@ append_valid_nodes(const char name[], int valid, const void *parent_data,
 	return 0;
 }
 
-/* Collects files under specified file system tree. */
+/* Collects files under specified file system tree adding them to the
+ * pipeline. */
 static void
-list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
+list_files_recursively(const char path[], int skip_dot_files, pipeline_t *p)
 {
 	int i;
 
@@ -633,7 +1097,7 @@ list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
 	}
 
 	/* Visit all subdirectories ignoring symbolic links to directories. */
-	for(i = 0; i < len && !ui_cancellation_requested(); ++i)
+	for(i = 0; i < len && !pipeline_stopped(p); ++i)
 	{
 		char *full_path;
 		if(skip_dot_files && lst[i][0] == '.')
@@ -647,7 +1111,7 @@ list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
 		{
 			if(!is_symlink(full_path))
 			{
-				list_files_recursively(full_path, skip_dot_files, list);
+				list_files_recursively(full_path, skip_dot_files, p);
 			}
 			free(full_path);
 			update_string(&lst[i], NULL);
@@ -657,19 +1121,17 @@ list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
 			free(lst[i]);
 			lst[i] = full_path;
 		}
-
-		show_progress("Listing...", 1000);
 	}
 
-	/* Append files. */
-	for(i = 0; i < len; ++i)
+	if(i < len)
 	{
-		if(lst[i] != NULL)
-		{
-			list->nitems = put_into_string_array(&list->items, list->nitems, lst[i]);
-		}
+		/* Listing was stopped, the rest of the array holds file names. */
+		free_string_array(lst, len);
+		return;
 	}
 
+	/* Append files. */
+	(void)pipeline_add_files(p, lst, len);
 	free(lst);
 }
 
@@ -705,46 +1167,22 @@ get_file_fingerprint(const char path[], const dir_entry_t *entry,
 static char *
 get_contents_fingerprint(const char path[], const dir_entry_t *entry)
 {
-#if INTPTR_MAX == INT64_MAX
-#define XX_BITS 64
-#else
-#define XX_BITS 32
-#endif
-#define XX__(name, bits) XXH ## bits ## _ ## name
-#define XX_(name, bits) XX__(name, bits)
-#define XX(name) XX_(name, XX_BITS)
-
-	XX(state_t) st;
-	char block[BLOCK_SIZE];
-	size_t to_read = PREFIX_SIZE;
-	FILE *in = os_fopen(path, "rb");
-	if(in == NULL)
+	uint64_t digest;
+	if(digests_get_prefix(path, &digest) != 0)
 	{
 		return strdup("");
 	}
 
-	XX(reset)(&st, 0U);
-	while(to_read != 0U)
-	{
-		const size_t portion = MIN(sizeof(block), to_read);
-		const size_t nread = fread(&block, 1, portion, in);
-		if(nread == 0U)
-		{
-			break;
-		}
-
-		XX(update)(&st, block, nread);
-		to_read -= nread;
-	}
-	fclose(in);
+	return format_contents_fingerprint(entry, digest);
+}
 
+/* Formats fingerprint of file contents from digest of its leading part.
+ * Returns the fingerprint as a string, which is NULL on error. */
+static char *
+format_contents_fingerprint(const dir_entry_t *entry, uint64_t digest)
+{
 	return format_str("%" PRINTF_ULL "|%" PRINTF_ULL,
-			(unsigned long long)entry->size, (unsigned long long)XX(digest)(&st));
-
-#undef XX_BITS
-#undef XX__
-#undef XX_
-#undef XX
+			(unsigned long long)entry->size, (unsigned long long)digest);
 }
 
 /* Retrieves file from the trie by its fingerprint.  Returns non-zero if it was
@@ -773,7 +1211,7 @@ get_file_id(trie_t *trie, const char path[], const char fingerprint[], int *id,
 	 * identical content. */
 	do
 	{
-		if(files_are_identical(path, record->path))
+		if(digests_match(path, record->path))
 		{
 			*id = record->id;
 			return 1;
@@ -785,52 +1223,6 @@ get_file_id(trie_t *trie, const char path[], const char fingerprint[], int *id,
 	return 0;
 }
 
-/* Checks whether two files specified by their names hold identical content.
- * Returns non-zero if so, otherwise zero is returned. */
-static int
-files_are_identical(const char a[], const char b[])
-{
-	char a_block[BLOCK_SIZE], b_block[BLOCK_SIZE];
-	FILE *const a_file = fopen(a, "rb");
-	FILE *const b_file = fopen(b, "rb");
-
-	if(a_file == NULL || b_file == NULL)
-	{
-		if(a_file != NULL)
-		{
-			fclose(a_file);
-		}
-		if(b_file != NULL)
-		{
-			fclose(b_file);
-		}
-		return 0;
-	}
-
-	while(1)
-	{
-		const size_t a_read = fread(&a_block, 1, sizeof(a_block), a_file);
-		const size_t b_read = fread(&b_block, 1, sizeof(b_block), b_file);
-		if(a_read == 0U && b_read == 0U && feof(a_file) && feof(b_file))
-		{
-			/* Ends of both files are reached. */
-			break;
-		}
-
-		if(a_read == 0 || b_read == 0U || a_read != b_read ||
-				memcmp(a_block, b_block, a_read) != 0)
-		{
-			fclose(a_file);
-			fclose(b_file);
-			return 0;
-		}
-	}
-
-	fclose(a_file);
-	fclose(b_file);
-	return 1;
-}
-
 /* Stores id of a file with given fingerprint in the trie. */
 static void
 put_file_id(trie_t *trie, const char path[], const char fingerprint[], int id,
@@ -945,7 +1337,7 @@ compare_move(view_t *from, view_t *to)
 		int match = (strcmp(from_fingerprint, to_fingerprint) == 0);
 		if(match && ct == CT_CONTENTS)
 		{
-			match = files_are_identical(from_path, to_path);
+			match = digests_match(from_path, to_path);
 		}
 		if(match)
 		{
@@ -0,0 +1,637 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "digests.h"
+
+#include <sys/stat.h> /* stat */
+
+#include <stddef.h> /* NULL offsetof() size_t */
+#include <stdint.h> /* INTPTR_MAX INT64_MAX int64_t uint32_t uint64_t */
+#include <stdio.h> /* FILE fclose() ferror() fread() fwrite() remove()
+                      snprintf() */
+#include <stdlib.h> /* calloc() free() */
+#include <string.h> /* memcmp() memcpy() memset() */
+#include <time.h> /* time() */
+
+#include "cfg/config.h"
+#include "compat/fs_limits.h"
+#include "compat/os.h"
+#include "compat/pthread.h"
+#include "compat/reallocarray.h"
+#include "utils/cancellation.h"
+#include "utils/fs.h"
+#include "utils/log.h"
+#include "utils/macros.h"
+#include "utils/utils.h"
+
+/* This is the only unit that uses xxhash, so import it directly here. */
+#define XXH_PRIVATE_API
+#include "utils/xxhash.h"
+
+#if INTPTR_MAX == INT64_MAX
+#define XX_BITS 64
+#else
+#define XX_BITS 32
+#endif
+/* Full digests are always 64-bit as they are the only thing that identifies
+ * contents, the native width is used only for coarse prefix digests. */
+#define XX__(name, bits) XXH ## bits ## _ ## name
+#define XX_(name, bits) XX__(name, bits)
+#define XX(name) XX_(name, XX_BITS)
+
+/* Amount of data to read at once. */
+#define BLOCK_SIZE (32*1024)
+
+/* Amount of data to hash for coarse comparison. */
+#define PREFIX_SIZE (256*1024)
+
+/* Identifies file format and its version. */
+#define MAGIC "VIFMHD01"
+
+/* Records that weren't used for this number of seconds aren't saved. */
+#define MAX_AGE (90*24*60*60)
+
+/* Flags of a record. */
+enum
+{
+	HAS_PREFIX = 1 << 0, /* Digest of the prefix is set. */
+	HAS_FULL   = 1 << 1, /* Digest of the whole file is set. */
+};
+
+/* Cached digests of a single file.  Fields up to and including mtime_nsec form
+ * a key.  The structure is stored in the file as is. */
+typedef struct
+{
+	uint64_t dev;       /* Device of the file. */
+	uint64_t inode;     /* Inode number of the file. */
+	uint64_t size;      /* Size of the file. */
+	int64_t mtime_sec;  /* Modification time of the file. */
+	int64_t mtime_nsec; /* Nanosecond part of modification time if available. */
+	uint64_t prefix;    /* Digest of the first PREFIX_SIZE bytes. */
+	uint64_t full;      /* Digest of the whole file. */
+	int64_t used;       /* When the record was last used. */
+	uint64_t flags;     /* Combination of HAS_* flags. */
+}
+record_t;
+
+/* Header of the file, which is followed by an array of records. */
+typedef struct
+{
+	char magic[8];  /* Always equal to MAGIC. */
+	uint64_t count; /* Number of records. */
+}
+header_t;
+
+/* State of digests_prefetch() shared by all of its threads. */
+typedef struct
+{
+	char **paths;         /* Files to process. */
+	int count;            /* Number of files. */
+	pthread_mutex_t lock; /* Protects fields below. */
+	int next;             /* Index of the next file to process. */
+	int stop;             /* Whether processing was cancelled. */
+}
+prefetch_t;
+
+static int get_record(const char path[], int flags, record_t *record);
+static int make_key(const char path[], record_t *key);
+static int hash_file(const char path[], int full, record_t *record);
+static int find_record(const record_t *key);
+static int add_record(const record_t *record);
+static int grow_index(void);
+static void index_record(int idx);
+static uint32_t hash_key(const record_t *key);
+static void ensure_loaded(void);
+static void load_records(const char path[]);
+static int write_records(FILE *fp, int64_t now);
+static void * prefetch_worker(void *arg);
+static int prefetch_next(prefetch_t *state);
+
+/* Guards all of the state below. */
+static pthread_mutex_t digests_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Known records. */
+static record_t *records;
+/* Number of elements in records. */
+static int nrecords;
+/* Capacity of records. */
+static int records_cap;
+/* Open addressing hash table of indexes of records plus one (zero marks an
+ * empty slot). */
+static int *index_table;
+/* Size of index_table, always a power of two. */
+static int index_size;
+/* Whether stored records were loaded. */
+static int loaded;
+
+int
+digests_get_prefix(const char path[], uint64_t *digest)
+{
+	record_t record;
+	if(get_record(path, HAS_PREFIX, &record) != 0)
+	{
+		return 1;
+	}
+
+	*digest = record.prefix;
+	return 0;
+}
+
+int
+digests_get_full(const char path[], uint64_t *digest)
+{
+	record_t record;
+	if(get_record(path, HAS_FULL, &record) != 0)
+	{
+		return 1;
+	}
+
+	*digest = record.full;
+	return 0;
+}
+
+int
+digests_match(const char a[], const char b[])
+{
+	record_t a_record, b_record;
+	return get_record(a, HAS_FULL, &a_record) == 0
+	    && get_record(b, HAS_FULL, &b_record) == 0
+	    && a_record.size == b_record.size
+	    && a_record.full == b_record.full;
+}
+
+/* Retrieves record of the file making sure that it has specified digests.
+ * Returns zero on success, otherwise non-zero is returned. */
+static int
+get_record(const char path[], int flags, record_t *record)
+{
+	int idx;
+	/* Without inode number file can't be reliably identified. */
+	const int cacheable = (make_key(path, record) == 0 && record->inode != 0U);
+
+	if(cacheable)
+	{
+		pthread_mutex_lock(&digests_lock);
+		ensure_loaded();
+		idx = find_record(record);
+		if(idx >= 0 && (records[idx].flags & flags) == (uint64_t)flags)
+		{
+			records[idx].used = time(NULL);
+			*record = records[idx];
+			pthread_mutex_unlock(&digests_lock);
+			return 0;
+		}
+		pthread_mutex_unlock(&digests_lock);
+	}
+
+	/* Hashing is done without holding the lock. */
+	if(hash_file(path, flags & HAS_FULL, record) != 0)
+	{
+		return 1;
+	}
+
+	if(cacheable)
+	{
+		pthread_mutex_lock(&digests_lock);
+		idx = find_record(record);
+		if(idx < 0)
+		{
+			record->used = time(NULL);
+			(void)add_record(record);
+		}
+		else
+		{
+			records[idx].prefix = record->prefix;
+			records[idx].full = record->full;
+			records[idx].flags |= record->flags;
+			records[idx].used = time(NULL);
+			*record = records[idx];
+		}
+		pthread_mutex_unlock(&digests_lock);
+	}
+
+	return 0;
+}
+
+/* Fills key part of the record.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+make_key(const char path[], record_t *key)
+{
+	struct stat st;
+	if(os_stat(path, &st) != 0)
+	{
+		return 1;
+	}
+
+	memset(key, 0, sizeof(*key));
+	key->dev = st.st_dev;
+	key->inode = st.st_ino;
+	key->size = st.st_size;
+	key->mtime_sec = st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+	key->mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+	return 0;
+}
+
+/* Reads file and computes its digests.  Prefix digest is always computed,
+ * digest of the whole file only when requested.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+hash_file(const char path[], int full, record_t *record)
+{
+	XX(state_t) prefix_st;
+	XXH64_state_t full_st;
+	char block[BLOCK_SIZE];
+	size_t prefix_left = PREFIX_SIZE;
+	int error;
+
+	FILE *const in = os_fopen(path, "rb");
+	if(in == NULL)
+	{
+		return 1;
+	}
+
+	XX(reset)(&prefix_st, 0U);
+	XXH64_reset(&full_st, 0U);
+	while(prefix_left != 0U || full)
+	{
+		const size_t portion = full ? sizeof(block)
+		                            : MIN(sizeof(block), prefix_left);
+		const size_t nread = fread(&block, 1, portion, in);
+		if(nread == 0U)
+		{
+			break;
+		}
+
+		if(prefix_left != 0U)
+		{
+			const size_t prefix_part = MIN(nread, prefix_left);
+			XX(update)(&prefix_st, block, prefix_part);
+			prefix_left -= prefix_part;
+		}
+		if(full)
+		{
+			XXH64_update(&full_st, block, nread);
+		}
+	}
+	error = ferror(in);
+	fclose(in);
+
+	if(error)
+	{
+		return 1;
+	}
+
+	record->prefix = XX(digest)(&prefix_st);
+	record->flags = HAS_PREFIX;
+	if(full)
+	{
+		record->full = XXH64_digest(&full_st);
+		record->flags |= HAS_FULL;
+	}
+	return 0;
+}
+
+/* Looks up record by the key.  Should be called with digests_lock held.
+ * Returns index of the record or -1 if there is none. */
+static int
+find_record(const record_t *key)
+{
+	uint32_t slot;
+
+	if(index_size == 0)
+	{
+		return -1;
+	}
+
+	slot = hash_key(key) & (index_size - 1);
+	while(index_table[slot] != 0)
+	{
+		const int idx = index_table[slot] - 1;
+		if(memcmp(&records[idx], key, offsetof(record_t, prefix)) == 0)
+		{
+			return idx;
+		}
+		slot = (slot + 1) & (index_size - 1);
+	}
+	return -1;
+}
+
+/* Appends record to the list and indexes it.  Should be called with
+ * digests_lock held.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+add_record(const record_t *record)
+{
+	if(nrecords == records_cap)
+	{
+		const int new_cap = (records_cap == 0 ? 256 : records_cap*2);
+		record_t *const new_records = reallocarray(records, new_cap,
+				sizeof(*records));
+		if(new_records == NULL)
+		{
+			return 1;
+		}
+		records = new_records;
+		records_cap = new_cap;
+	}
+
+	/* Keep load factor of the index under one half. */
+	if((nrecords + 1)*2 > index_size && grow_index() != 0)
+	{
+		return 1;
+	}
+
+	records[nrecords] = *record;
+	index_record(nrecords);
+	++nrecords;
+	return 0;
+}
+
+/* Doubles size of the index and rebuilds it.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+grow_index(void)
+{
+	const int new_size = (index_size == 0 ? 512 : index_size*2);
+	int *const new_table = calloc(new_size, sizeof(*new_table));
+	int i;
+
+	if(new_table == NULL)
+	{
+		return 1;
+	}
+
+	free(index_table);
+	index_table = new_table;
+	index_size = new_size;
+
+	for(i = 0; i < nrecords; ++i)
+	{
+		index_record(i);
+	}
+	return 0;
+}
+
+/* Puts record with specified index into the index. */
+static void
+index_record(int idx)
+{
+	uint32_t slot = hash_key(&records[idx]) & (index_size - 1);
+	while(index_table[slot] != 0)
+	{
+		slot = (slot + 1) & (index_size - 1);
+	}
+	index_table[slot] = idx + 1;
+}
+
+/* Computes hash of key part of a record.  Returns the hash. */
+static uint32_t
+hash_key(const record_t *key)
+{
+	return XXH32(key, offsetof(record_t, prefix), 0U);
+}
+
+/* Loads stored records on first call.  Should be called with digests_lock
+ * held. */
+static void
+ensure_loaded(void)
+{
+	if(!loaded)
+	{
+		loaded = 1;
+		if(cfg.vifm_info & VINFO_DIGESTS)
+		{
+			char path[PATH_MAX + 16];
+			snprintf(path, sizeof(path), "%s/digests", cfg.config_dir);
+			load_records(path);
+		}
+	}
+}
+
+/* Reads records from a file adding them to the list. */
+static void
+load_records(const char path[])
+{
+	header_t header;
+	uint64_t i;
+
+	FILE *const fp = os_fopen(path, "rb");
+	if(fp == NULL)
+	{
+		return;
+	}
+
+	if(fread(&header, sizeof(header), 1, fp) != 1 ||
+			memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0)
+	{
+		fclose(fp);
+		return;
+	}
+
+	for(i = 0U; i < header.count; ++i)
+	{
+		record_t record;
+		if(fread(&record, sizeof(record), 1, fp) != 1 ||
+				find_record(&record) >= 0 || add_record(&record) != 0)
+		{
+			break;
+		}
+	}
+
+	fclose(fp);
+}
+
+void
+digests_save(void)
+{
+	char path[PATH_MAX + 16];
+	char tmp_file[PATH_MAX + 32];
+	FILE *fp;
+	int error;
+
+	if(!(cfg.vifm_info & VINFO_DIGESTS))
+	{
+		return;
+	}
+
+	snprintf(path, sizeof(path), "%s/digests", cfg.config_dir);
+	snprintf(tmp_file, sizeof(tmp_file), "%s_%u", path, get_pid());
+
+	fp = os_fopen(tmp_file, "wb");
+	if(fp == NULL)
+	{
+		LOG_ERROR_MSG("Failed to open digests file for writing: %s", tmp_file);
+		return;
+	}
+
+	pthread_mutex_lock(&digests_lock);
+	/* Don't lose records that weren't used during this session. */
+	ensure_loaded();
+	error = write_records(fp, time(NULL));
+	pthread_mutex_unlock(&digests_lock);
+
+	error |= (fclose(fp) != 0);
+	if(error || rename_file(tmp_file, path) != 0)
+	{
+		LOG_ERROR_MSG("Failed to write digests file: %s", path);
+		(void)remove(tmp_file);
+	}
+}
+
+/* Writes header followed by records that were used recently.  Should be called
+ * with digests_lock held.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+write_records(FILE *fp, int64_t now)
+{
+	header_t header;
+	int i;
+
+	memcpy(header.magic, MAGIC, sizeof(header.magic));
+	header.count = 0U;
+	for(i = 0; i < nrecords; ++i)
+	{
+		header.count += (now - records[i].used <= MAX_AGE);
+	}
+
+	if(fwrite(&header, sizeof(header), 1, fp) != 1)
+	{
+		return 1;
+	}
+
+	for(i = 0; i < nrecords; ++i)
+	{
+		if(now - records[i].used <= MAX_AGE &&
+				fwrite(&records[i], sizeof(records[i]), 1, fp) != 1)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void
+digests_reset(void)
+{
+	pthread_mutex_lock(&digests_lock);
+	free(records);
+	records = NULL;
+	nrecords = 0;
+	records_cap = 0;
+	free(index_table);
+	index_table = NULL;
+	index_size = 0;
+	loaded = 0;
+	pthread_mutex_unlock(&digests_lock);
+}
+
+void
+digests_prefetch(char *paths[], int count, int nthreads,
+		const cancellation_t *cancellation)
+{
+	prefetch_t state = {
+		.paths = paths,
+		.count = count,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	};
+	pthread_t *threads;
+	int max_started;
+	int nstarted;
+	int i;
+
+	/* Digests are computed on demand anyway, this is only to do it faster. */
+	if(nthreads <= 1 || count <= 1)
+	{
+		return;
+	}
+
+	/* The calling thread is one of the workers. */
+	max_started = MIN(nthreads, count) - 1;
+	threads = reallocarray(NULL, max_started, sizeof(*threads));
+	if(threads == NULL)
+	{
+		max_started = 0;
+	}
+
+	for(nstarted = 0; nstarted < max_started; ++nstarted)
+	{
+		if(pthread_create(&threads[nstarted], NULL, &prefetch_worker,
+					&state) != 0)
+		{
+			break;
+		}
+	}
+
+	/* The calling thread works too, but also checks for cancellation. */
+	while(prefetch_next(&state))
+	{
+		if(cancellation_requested(cancellation))
+		{
+			pthread_mutex_lock(&state.lock);
+			state.stop = 1;
+			pthread_mutex_unlock(&state.lock);
+		}
+	}
+
+	for(i = 0; i < nstarted; ++i)
+	{
+		(void)pthread_join(threads[i], NULL);
+	}
+	free(threads);
+
+	pthread_mutex_destroy(&state.lock);
+}
+
+/* Entry point of a thread of digests_prefetch().  Returns NULL. */
+static void *
+prefetch_worker(void *arg)
+{
+	prefetch_t *const state = arg;
+	while(prefetch_next(state))
+	{
+		/* Do nothing. */
+	}
+	return NULL;
+}
+
+/* Computes digest of the next file in the list.  Returns zero when there are
+ * no more files to process, otherwise non-zero is returned. */
+static int
+prefetch_next(prefetch_t *state)
+{
+	uint64_t digest;
+	int idx;
+
+	pthread_mutex_lock(&state->lock);
+	idx = (state->stop || state->next >= state->count) ? -1 : state->next++;
+	pthread_mutex_unlock(&state->lock);
+
+	if(idx < 0)
+	{
+		return 0;
+	}
+
+	(void)digests_get_full(state->paths[idx], &digest);
+	return 1;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
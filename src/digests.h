@@ -0,0 +1,59 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__DIGESTS_H__
+#define VIFM__DIGESTS_H__
+
+#include <stdint.h> /* uint64_t */
+
+struct cancellation_t;
+
+/* Digests of file contents cached by identity of files (device, inode, size
+ * and modification time), so that contents of unchanged files is read at most
+ * once.  Functions of this unit are thread-safe. */
+
+/* Retrieves digest of a leading part of file contents.  Returns zero on
+ * success, otherwise non-zero is returned. */
+int digests_get_prefix(const char path[], uint64_t *digest);
+
+/* Retrieves digest of the whole contents of a file.  Returns zero on success,
+ * otherwise non-zero is returned. */
+int digests_get_full(const char path[], uint64_t *digest);
+
+/* Checks whether two files have identical contents judging by their sizes and
+ * full digests, which are 64-bit on all platforms.  Returns non-zero if so,
+ * otherwise zero is returned. */
+int digests_match(const char a[], const char b[]);
+
+/* Computes full digests of files that aren't cached yet using up to nthreads
+ * threads.  Cancellation is checked on the calling thread, which stops the
+ * process early. */
+void digests_prefetch(char *paths[], int count, int nthreads,
+		const struct cancellation_t *cancellation);
+
+/* Stores cached digests in configuration directory if that's enabled via
+ * 'vifminfo'.  Stored data is loaded on first use. */
+void digests_save(void);
+
+/* Drops all cached digests from memory. */
+void digests_reset(void);
+
+#endif /* VIFM__DIGESTS_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -40,7 +40,9 @@
 
 typedef struct
 {
-	cmd_t head;
+	cmd_t **cmds; /* Commands sorted by name for binary search. */
+	int ncmds;    /* Number of commands. */
+	int capacity; /* Capacity of cmds array. */
 	cmd_add_t user_cmd_handler;
 	cmd_handler command_handler;
 	int udf_count;
@@ -61,6 +63,8 @@ static const char * get_cmd_name(const char cmd[], char buf[], size_t buf_len);
 static void init_cmd_info(cmd_info_t *cmd_info);
 static const char * skip_prefix_commands(const char cmd[]);
 static cmd_t * find_cmd(const char name[]);
+static int lower_bound(const char name[]);
+static int prefix_end(const char prefix[], int from);
 static const char * parse_range(const char cmd[], cmd_info_t *cmd_info);
 static const char * parse_range_elem(const char cmd[], cmd_info_t *cmd_info,
 		char last_sep);
@@ -74,7 +78,8 @@ static void init_command_flags(cmd_t *cmd, int flags);
 static const char * get_user_cmd_name(const char cmd[], char buf[],
 		size_t buf_len);
 static int is_valid_udc_name(const char name[]);
-static cmd_t * insert_cmd(cmd_t *after);
+static cmd_t * insert_cmd(int pos);
+static void remove_cmd(int pos);
 static int delcommand_cmd(const cmd_info_t *cmd_info);
 TSTATIC char ** dispatch_line(const char args[], int *count, char sep,
 		int regexp, int quotes, int noescaping, int comments, int *last_arg,
@@ -131,18 +136,18 @@ vle_cmds_init(int udf, cmds_conf_t *conf)
 void
 vle_cmds_reset(void)
 {
-	cmd_t *cur = inner->head.next;
-
-	while(cur != NULL)
+	int i;
+	for(i = 0; i < inner->ncmds; ++i)
 	{
-		cmd_t *next = cur->next;
+		cmd_t *const cur = inner->cmds[i];
 		free(cur->cmd);
 		free(cur->name);
 		free(cur);
-		cur = next;
 	}
 
-	inner->head.next = NULL;
+	free(inner->cmds);
+	inner->cmds = NULL;
+	inner->ncmds = 0;
 	inner->user_cmd_handler.handler = NULL;
 
 	free(inner);
@@ -339,35 +344,23 @@ correct_limit(const char cmd[], cmd_info_t *cmd_info)
 static int
 udf_is_ambiguous(const char name[])
 {
-	size_t len;
-	int count;
-	cmd_t *cur;
+	const size_t len = strlen(name);
+	const int begin = lower_bound(name);
+	const int end = prefix_end(name, begin);
+	int count = 0;
+	int i;
 
-	len = strlen(name);
-	count = 0;
-	cur = inner->head.next;
-	while(cur != NULL)
+	for(i = begin; i < end && count < 2; ++i)
 	{
-		int cmp;
-
-		cmp = strncmp(cur->name, name, len);
-		if(cmp == 0)
-		{
-			if(cur->name[len] == '\0')
-				return 0;
-			if(cur->type == USER_CMD)
-			{
-				char c = cur->name[strlen(cur->name) - 1];
-				if(c != '!' && c != '?')
-					count++;
-			}
-		}
-		else if(cmp > 0)
+		const cmd_t *const cur = inner->cmds[i];
+		if(cur->name[len] == '\0')
+			return 0;
+		if(cur->type == USER_CMD)
 		{
-			break;
+			char c = cur->name[strlen(cur->name) - 1];
+			if(c != '!' && c != '?')
+				count++;
 		}
-
-		cur = cur->next;
 	}
 	return (count > 1);
 }
@@ -549,23 +542,63 @@ skip_prefix_commands(const char cmd[])
 	return cmd;
 }
 
+/* Finds the first command which name starts with the specified one.  Returns
+ * the command or NULL. */
 static cmd_t *
 find_cmd(const char name[])
 {
-	cmd_t *cmd;
-
-	cmd = inner->head.next;
-	while(cmd != NULL && strcmp(cmd->name, name) < 0)
+	const int pos = lower_bound(name);
+	if(pos < inner->ncmds &&
+			strncmp(name, inner->cmds[pos]->name, strlen(name)) == 0)
 	{
-		cmd = cmd->next;
+		return inner->cmds[pos];
 	}
+	return NULL;
+}
 
-	if(cmd != NULL && strncmp(name, cmd->name, strlen(name)) != 0)
+/* Finds position of the first command which name isn't less than the specified
+ * one.  Returns the position, which is the number of commands if there is no
+ * such command. */
+static int
+lower_bound(const char name[])
+{
+	int lo = 0, hi = inner->ncmds;
+	while(lo < hi)
 	{
-		cmd = NULL;
+		const int mid = lo + (hi - lo)/2;
+		if(strcmp(inner->cmds[mid]->name, name) < 0)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
 	}
+	return lo;
+}
 
-	return cmd;
+/* Finds end of the range of commands which names start with the prefix and
+ * which begins at the from position.  Returns position past the last command
+ * of the range. */
+static int
+prefix_end(const char prefix[], int from)
+{
+	const size_t len = strlen(prefix);
+	int lo = from, hi = inner->ncmds;
+	while(lo < hi)
+	{
+		const int mid = lo + (hi - lo)/2;
+		if(strncmp(inner->cmds[mid]->name, prefix, len) == 0)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo;
 }
 
 /* Parses whole command range (e.g. "<val>;+<val>,,-<val>").  Returns advanced
@@ -707,40 +740,37 @@ get_cmd_name(const char cmd[], char buf[], size_t buf_len)
 	buf[len] = '\0';
 	if(*t == '?' || *t == '!')
 	{
-		int cmp;
-		cmd_t *cur;
+		const cmd_t *cur = NULL;
+		const int end = prefix_end(buf, lower_bound(buf));
+		int i;
 
-		cur = inner->head.next;
-		while(cur != NULL && (cmp = strncmp(cur->name, buf, len)) <= 0)
+		for(i = lower_bound(buf); i < end; ++i)
 		{
-			if(cmp == 0)
+			cur = inner->cmds[i];
+
+			/* Complete match for a builtin with a custom separator. */
+			if(cur->cust_sep && cur->name[len] == '\0')
 			{
-				/* Complete match for a builtin with a custom separator. */
-				if(cur->cust_sep && cur->name[len] == '\0')
-				{
-					strncpy(buf, cur->name, buf_len);
-					break;
-				}
-				/* Check for user-defined command that ends with the char ('!' or
-				 * '?', see above). */
-				if(cur->type == USER_CMD && cur->name[strlen(cur->name) - 1] == *t)
-				{
-					strncpy(buf, cur->name, buf_len);
-					break;
-				}
-				/* Or builtin abbreviation that supports the mark. */
-				if(cur->type == BUILTIN_ABBR &&
-						((*t == '!' && cur->emark) || (*t == '?' && cur->qmark)))
-				{
-					strncpy(buf, cur->name, buf_len);
-					break;
-				}
+				strncpy(buf, cur->name, buf_len);
+				break;
+			}
+			/* Check for user-defined command that ends with the char ('!' or '?',
+			 * see above). */
+			if(cur->type == USER_CMD && cur->name[strlen(cur->name) - 1] == *t)
+			{
+				strncpy(buf, cur->name, buf_len);
+				break;
+			}
+			/* Or builtin abbreviation that supports the mark. */
+			if(cur->type == BUILTIN_ABBR &&
+					((*t == '!' && cur->emark) || (*t == '?' && cur->qmark)))
+			{
+				strncpy(buf, cur->name, buf_len);
+				break;
 			}
-			cur = cur->next;
 		}
 
-		if(cur != NULL && cur->type == USER_CMD &&
-				strncmp(cur->name, buf, len) == 0)
+		if(i < end && cur->type == USER_CMD && strncmp(cur->name, buf, len) == 0)
 		{
 			/* For user-defined commands, the char is part of the name. */
 			++t;
@@ -798,16 +828,13 @@ complete_cmd_args(cmd_t *cur, const char args[], cmd_info_t *cmd_info,
 static void
 complete_cmd_name(const char cmd_name[], int user_only)
 {
-	cmd_t *cur;
-	size_t len;
-
-	cur = inner->head.next;
-	while(cur != NULL && strcmp(cur->name, cmd_name) < 0)
-		cur = cur->next;
+	const int begin = lower_bound(cmd_name);
+	const int end = prefix_end(cmd_name, begin);
+	int i;
 
-	len = strlen(cmd_name);
-	while(cur != NULL && strncmp(cur->name, cmd_name, len) == 0)
+	for(i = begin; i < end; ++i)
 	{
+		const cmd_t *const cur = inner->cmds[i];
 		if(cur->type == BUILTIN_ABBR)
 			;
 		else if(cur->type != USER_CMD && user_only)
@@ -818,7 +845,6 @@ complete_cmd_name(const char cmd_name[], int user_only)
 			vle_compl_add_match(cur->name, cur->cmd);
 		else
 			vle_compl_add_match(cur->name, cur->descr);
-		cur = cur->next;
 	}
 
 	vle_compl_add_last_match(cmd_name);
@@ -860,9 +886,8 @@ vle_cmds_add(const cmd_add_t cmds[], int count)
 TSTATIC int
 add_builtin_cmd(const char name[], int abbr, const cmd_add_t *conf)
 {
-	int cmp;
+	int pos;
 	cmd_t *new;
-	cmd_t *cur = &inner->head;
 
 	if(strcmp(name, "<USERCMD>") == 0)
 	{
@@ -884,14 +909,10 @@ add_builtin_cmd(const char name[], int abbr, const cmd_add_t *conf)
 		}
 	}
 
-	cmp = -1;
-	while(cur->next != NULL && (cmp = strcmp(cur->next->name, name)) < 0)
-	{
-		cur = cur->next;
-	}
+	pos = lower_bound(name);
 
 	/* Command with the same name already exists. */
-	if(cmp == 0)
+	if(pos < inner->ncmds && strcmp(inner->cmds[pos]->name, name) == 0)
 	{
 		if(strncmp(name, "command", strlen(name)) == 0)
 		{
@@ -901,7 +922,7 @@ add_builtin_cmd(const char name[], int abbr, const cmd_add_t *conf)
 		return -1;
 	}
 
-	new = insert_cmd(cur);
+	new = insert_cmd(pos);
 	if(new == NULL)
 	{
 		return -1;
@@ -925,31 +946,28 @@ add_builtin_cmd(const char name[], int abbr, const cmd_add_t *conf)
 static int
 comclear_cmd(const cmd_info_t *cmd_info)
 {
-	cmd_t *cur = &inner->head;
-
-	while(cur->next != NULL)
+	int i, j;
+	for(i = 0, j = 0; i < inner->ncmds; ++i)
 	{
-		if(cur->next->type == USER_CMD)
+		cmd_t *const this = inner->cmds[i];
+		if(this->type != USER_CMD)
 		{
-			cmd_t *this = cur->next;
-			cur->next = this->next;
+			inner->cmds[j++] = this;
+			continue;
+		}
 
-			free(this->cmd);
-			free(this->name);
-			if(this->passed == 0)
-			{
-				free(this);
-			}
-			else
-			{
-				this->deleted = 1;
-			}
+		free(this->cmd);
+		free(this->name);
+		if(this->passed == 0)
+		{
+			free(this);
 		}
 		else
 		{
-			cur = cur->next;
+			this->deleted = 1;
 		}
 	}
+	inner->ncmds = j;
 	inner->udf_count = 0;
 	return 0;
 }
@@ -963,6 +981,7 @@ command_cmd(const cmd_info_t *cmd_info)
 	cmd_t *new, *cur;
 	size_t len;
 	int has_emark, has_qmark;
+	int pos;
 
 	if(cmd_info->argc < 2)
 	{
@@ -983,28 +1002,35 @@ command_cmd(const cmd_info_t *cmd_info)
 	has_emark = (len > 0 && cmd_name[len - 1] == '!');
 	has_qmark = (len > 0 && cmd_name[len - 1] == '?');
 
-	cmp = -1;
-	cur = &inner->head;
-	while(cur->next != NULL && (cmp = strcmp(cur->next->name, cmd_name)) < 0)
+	pos = lower_bound(cmd_name);
+	cmp = (pos < inner->ncmds && strcmp(inner->cmds[pos]->name, cmd_name) == 0)
+	    ? 0
+	    : -1;
+
+	/* Names which are less than the new one and match it without the trailing
+	 * mark immediately precede it. */
+	if(has_emark || has_qmark)
 	{
-		if(has_emark && cur->next->type == BUILTIN_CMD && cur->next->emark &&
-				strncmp(cmd_name, cur->next->name, len - 1) == 0)
-		{
-			cmp = 0;
-			break;
-		}
-		if(has_qmark && cur->next->type == BUILTIN_CMD && cur->next->qmark &&
-				strncmp(cmd_name, cur->next->name, len - 1) == 0)
+		char prefix[MAX_CMD_NAME_LEN];
+		int i;
+
+		copy_str(prefix, len, cmd_name);
+		for(i = lower_bound(prefix); i < pos; ++i)
 		{
-			cmp = 0;
-			break;
+			cur = inner->cmds[i];
+			if(cur->type == BUILTIN_CMD &&
+					((has_emark && cur->emark) || (has_qmark && cur->qmark)))
+			{
+				pos = i;
+				cmp = 0;
+				break;
+			}
 		}
-		cur = cur->next;
 	}
 
 	if(cmp == 0)
 	{
-		cur = cur->next;
+		cur = inner->cmds[pos];
 		if(cur->type == BUILTIN_CMD)
 			return CMDS_ERR_NO_BUILTIN_REDEFINE;
 		if(!cmd_info->emark)
@@ -1015,7 +1041,7 @@ command_cmd(const cmd_info_t *cmd_info)
 	}
 	else
 	{
-		if((new = insert_cmd(cur)) == NULL)
+		if((new = insert_cmd(pos)) == NULL)
 		{
 			return CMDS_ERR_NO_MEM;
 		}
@@ -1119,40 +1145,59 @@ is_valid_udc_name(const char name[])
 	return 1;
 }
 
-/* Allocates new command node and inserts it after the specified one.  Returns
- * new uninitialized node or NULL on error. */
+/* Allocates new command node and inserts it at the specified position.
+ * Returns new uninitialized node or NULL on error. */
 static cmd_t *
-insert_cmd(cmd_t *after)
+insert_cmd(int pos)
 {
-	cmd_t *const new = malloc(sizeof(*new));
+	cmd_t *new;
+
+	if(inner->ncmds == inner->capacity)
+	{
+		const int capacity = (inner->capacity == 0) ? 64 : inner->capacity*2;
+		cmd_t **const cmds = reallocarray(inner->cmds, capacity, sizeof(*cmds));
+		if(cmds == NULL)
+		{
+			return NULL;
+		}
+		inner->cmds = cmds;
+		inner->capacity = capacity;
+	}
+
+	new = malloc(sizeof(*new));
 	if(new == NULL)
 	{
 		return NULL;
 	}
 
-	new->next = after->next;
-	after->next = new;
+	memmove(&inner->cmds[pos + 1], &inner->cmds[pos],
+			sizeof(*inner->cmds)*(inner->ncmds - pos));
+	inner->cmds[pos] = new;
+	++inner->ncmds;
 	return new;
 }
 
+/* Removes command node at the specified position without freeing it. */
+static void
+remove_cmd(int pos)
+{
+	--inner->ncmds;
+	memmove(&inner->cmds[pos], &inner->cmds[pos + 1],
+			sizeof(*inner->cmds)*(inner->ncmds - pos));
+}
+
 static int
 delcommand_cmd(const cmd_info_t *cmd_info)
 {
-	int cmp;
-	cmd_t *cur;
+	const int pos = lower_bound(cmd_info->argv[0]);
 	cmd_t *cmd;
 
-	cmp = -1;
-	cur = &inner->head;
-	while(cur->next != NULL &&
-			(cmp = strcmp(cur->next->name, cmd_info->argv[0])) < 0)
-		cur = cur->next;
-
-	if(cur->next == NULL || cmp != 0)
+	if(pos == inner->ncmds ||
+			strcmp(inner->cmds[pos]->name, cmd_info->argv[0]) != 0)
 		return CMDS_ERR_NO_SUCH_UDF;
 
-	cmd = cur->next;
-	cur->next = cmd->next;
+	cmd = inner->cmds[pos];
+	remove_cmd(pos);
 	free(cmd->name);
 	free(cmd->cmd);
 	free(cmd);
@@ -1389,7 +1434,7 @@ char **
 vle_cmds_list_udcs(void)
 {
 	char **p;
-	cmd_t *cur;
+	int i;
 
 	char **const list = reallocarray(NULL, inner->udf_count*2 + 1, sizeof(*list));
 	if(list == NULL)
@@ -1399,15 +1444,14 @@ vle_cmds_list_udcs(void)
 
 	p = list;
 
-	cur = inner->head.next;
-	while(cur != NULL)
+	for(i = 0; i < inner->ncmds; ++i)
 	{
+		const cmd_t *const cur = inner->cmds[i];
 		if(cur->type == USER_CMD)
 		{
 			*p++ = strdup(cur->name);
 			*p++ = strdup(cur->cmd);
 		}
-		cur = cur->next;
 	}
 
 	*p = NULL;
@@ -1418,21 +1462,20 @@ vle_cmds_list_udcs(void)
 char *
 vle_cmds_print_udcs(const char beginning[])
 {
-	size_t len;
-	cmd_t *cur;
 	char *content = NULL;
 	size_t content_len = 0;
+	const int begin = lower_bound(beginning);
+	const int end = prefix_end(beginning, begin);
+	int i;
 
-	cur = inner->head.next;
-	len = strlen(beginning);
-	while(cur != NULL)
+	for(i = begin; i < end; ++i)
 	{
 		void *ptr;
 		size_t new_size;
+		const cmd_t *const cur = inner->cmds[i];
 
-		if(strncmp(cur->name, beginning, len) != 0 || cur->type != USER_CMD)
+		if(cur->type != USER_CMD)
 		{
-			cur = cur->next;
 			continue;
 		}
 
@@ -1449,7 +1492,6 @@ vle_cmds_print_udcs(const char beginning[])
 			content_len += sprintf(content + content_len, "\n%-*s %s", 10, cur->name,
 					cur->cmd);
 		}
-		cur = cur->next;
 	}
 
 	return content;
@@ -133,8 +133,6 @@ typedef struct cmd_t
 	unsigned int macros_for_cmd : 1;   /* Expand macros w/o special escaping. */
 	unsigned int macros_for_shell : 1; /* Expand macros with shell escaping. */
 	unsigned int : 0;                  /* Padding. */
-
-	struct cmd_t *next; /* Pointer to the next structure or NULL. */
 }
 cmd_t;
 
@@ -35,8 +35,10 @@
 #include <wctype.h> /* iswdigit() */
 #include <wchar.h> /* wcscat() wcslen() */
 
+#include "../compat/reallocarray.h"
 #include "../utils/macros.h"
 #include "../utils/str.h"
+#include "../utils/test_helpers.h"
 #include "mode.h"
 
 /* Type of key chunk. */
@@ -52,7 +54,14 @@ KeyType;
 typedef struct key_chunk_t
 {
 	wchar_t key;
+	/* Number of mappings in the subtree. */
 	size_t children_count;
+	/* Children sorted by their keys for binary search. */
+	struct key_chunk_t **children;
+	/* Number of elements in children array and its capacity. */
+	int nchildren, capacity;
+	/* Number of children of BUILTIN_NIM_KEYS type. */
+	int nim_children;
 	/* Number of current uses.  To prevent stack overflow and manager lifetime. */
 	int enters;
 	/* General key type. */
@@ -67,9 +76,7 @@ typedef struct key_chunk_t
 	 * wait instead. */
 	unsigned int wait : 1;
 	key_conf_t conf;
-	struct key_chunk_t *child;
 	struct key_chunk_t *parent;
-	struct key_chunk_t *prev, *next;
 }
 key_chunk_t;
 
@@ -90,10 +97,16 @@ static size_t enters_counter;
 static int inside_mapping;
 /* User-provided callback for silencing UI. */
 static vle_silence_func silence_ui;
+/* Number of children examined by find_child() so far. */
+TSTATIC size_t child_probes;
 
 static void free_forest(key_chunk_t *forest, size_t size);
 static void free_tree(key_chunk_t *root);
 static void free_chunk(key_chunk_t *chunk);
+static key_chunk_t * find_child(const key_chunk_t *chunk, wchar_t key,
+		int *pos);
+static int insert_child(key_chunk_t *chunk, key_chunk_t *child, int pos);
+static void remove_child(key_chunk_t *chunk, const key_chunk_t *child);
 static int execute_keys_general_wrapper(const wchar_t keys[], int timed_out,
 		int mapped, int no_remap);
 static int execute_keys_general(const wchar_t keys[], int timed_out, int mapped,
@@ -213,17 +226,17 @@ free_forest(key_chunk_t *forest, size_t size)
 static void
 free_tree(key_chunk_t *root)
 {
-	if(root->child != NULL)
+	int i;
+	for(i = 0; i < root->nchildren; ++i)
 	{
-		free_tree(root->child);
-		free_chunk(root->child);
+		free_tree(root->children[i]);
+		free_chunk(root->children[i]);
 	}
 
-	if(root->next != NULL)
-	{
-		free_tree(root->next);
-		free_chunk(root->next);
-	}
+	free(root->children);
+	root->children = NULL;
+	root->nchildren = 0;
+	root->capacity = 0;
 
 	if(root->type == USER_CMD)
 	{
@@ -244,6 +257,81 @@ free_chunk(key_chunk_t *chunk)
 	}
 }
 
+/* Looks up child of the chunk by its key.  Sets *pos to index of the child or
+ * to where it should be inserted, pos can be NULL.  Returns the child or NULL
+ * if there is none. */
+static key_chunk_t *
+find_child(const key_chunk_t *chunk, wchar_t key, int *pos)
+{
+	int lo = 0, hi = chunk->nchildren;
+	while(lo < hi)
+	{
+		const int mid = lo + (hi - lo)/2;
+		const wchar_t mid_key = chunk->children[mid]->key;
+		++child_probes;
+		if(mid_key == key)
+		{
+			lo = mid;
+			break;
+		}
+
+		if(mid_key < key)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if(pos != NULL)
+	{
+		*pos = lo;
+	}
+	return (lo < chunk->nchildren && chunk->children[lo]->key == key)
+	     ? chunk->children[lo]
+	     : NULL;
+}
+
+/* Inserts child at specified position among children of the chunk.  Returns
+ * zero on success, otherwise non-zero is returned. */
+static int
+insert_child(key_chunk_t *chunk, key_chunk_t *child, int pos)
+{
+	if(chunk->nchildren == chunk->capacity)
+	{
+		const int capacity = (chunk->capacity == 0 ? 4 : chunk->capacity*2);
+		key_chunk_t **const children = reallocarray(chunk->children, capacity,
+				sizeof(*children));
+		if(children == NULL)
+		{
+			return 1;
+		}
+		chunk->children = children;
+		chunk->capacity = capacity;
+	}
+
+	memmove(&chunk->children[pos + 1], &chunk->children[pos],
+			sizeof(*chunk->children)*(chunk->nchildren - pos));
+	chunk->children[pos] = child;
+	++chunk->nchildren;
+	return 0;
+}
+
+/* Removes child from the list of children of the chunk without freeing it. */
+static void
+remove_child(key_chunk_t *chunk, const key_chunk_t *child)
+{
+	int pos;
+	if(find_child(chunk, child->key, &pos) == child)
+	{
+		--chunk->nchildren;
+		memmove(&chunk->children[pos], &chunk->children[pos + 1],
+				sizeof(*chunk->children)*(chunk->nchildren - pos));
+	}
+}
+
 void
 vle_keys_set_def_handler(int mode, default_handler handler)
 {
@@ -368,30 +456,14 @@ dispatch_keys_at_root(const wchar_t keys[], keys_info_t *keys_info,
 	curr = root;
 	while(*keys != L'\0')
 	{
-		key_chunk_t *p;
-		int number_in_the_middle = 0;
-
-		for(p = curr->child; p != NULL && p->key < *keys; p = p->next)
+		key_chunk_t *const p = find_child(curr, *keys, NULL);
+		if(p == NULL)
 		{
-			if(p->type == BUILTIN_NIM_KEYS)
-			{
-				number_in_the_middle = 1;
-			}
-		}
+			const int number_in_the_middle = (curr->nim_children != 0);
 
-		if(p == NULL || p->key != *keys)
-		{
 			if(curr == root)
 				return KEYS_UNKNOWN;
 
-			for(; p != NULL; p = p->next)
-			{
-				if(p->type == BUILTIN_NIM_KEYS)
-				{
-					number_in_the_middle = 1;
-				}
-			}
-
 			if(curr->conf.followed != FOLLOWED_BY_NONE &&
 					(!number_in_the_middle || !is_at_count(keys)))
 			{
@@ -474,13 +546,8 @@ dispatch_selector(const wchar_t keys[], keys_info_t *keys_info,
 	 * shortcuts. */
 	while(*keys != L'\0')
 	{
-		key_chunk_t *p;
-
-		for(p = curr->child; p != NULL && p->key < *keys; p = p->next)
-		{
-			/* Advance. */
-		}
-		if(p == NULL || p->key != *keys)
+		key_chunk_t *const p = find_child(curr, *keys, NULL);
+		if(p == NULL)
 		{
 			break;
 		}
@@ -571,13 +638,8 @@ contains_chain(key_chunk_t *root, const wchar_t *begin, const wchar_t *end)
 	curr = root;
 	while(begin != end)
 	{
-		key_chunk_t *p;
-
-		p = curr->child;
-		while(p != NULL && p->key < *begin)
-			p = p->next;
-
-		if(p == NULL || p->key != *begin)
+		key_chunk_t *const p = find_child(curr, *begin, NULL);
+		if(p == NULL)
 			return 0;
 
 		begin++;
@@ -642,14 +704,16 @@ execute_next_keys(key_chunk_t *curr, const wchar_t keys[], key_info_t *key_info,
 static int
 needs_waiting(const key_chunk_t *curr)
 {
+	int i;
+
 	if(curr->wait)
 	{
 		return 1;
 	}
 
-	for(curr = curr->child; curr != NULL; curr = curr->next)
+	for(i = 0; i < curr->nchildren; ++i)
 	{
-		if(needs_waiting(curr))
+		if(needs_waiting(curr->children[i]))
 		{
 			return 1;
 		}
@@ -971,12 +1035,10 @@ vle_keys_user_remove(const wchar_t keys[], int mode)
 	do
 	{
 		key_chunk_t *const parent = curr->parent;
-		if(curr->prev != NULL)
-			curr->prev->next = curr->next;
-		else
-			parent->child = curr->next;
-		if(curr->next != NULL)
-			curr->next->prev = curr->prev;
+		remove_child(parent, curr);
+		free(curr->children);
+		curr->children = NULL;
+		curr->capacity = 0;
 		free_chunk(curr);
 		curr = parent;
 	}
@@ -999,10 +1061,8 @@ find_user_keys(const wchar_t *keys, int mode)
 
 	while(*keys != L'\0')
 	{
-		key_chunk_t *p = curr->child;
-		while(p != NULL && p->key < *keys)
-			p = p->next;
-		if(p == NULL || p->key != *keys)
+		key_chunk_t *const p = find_child(curr, *keys, NULL);
+		if(p == NULL)
 			return NULL;
 		curr = p;
 		keys++;
@@ -1039,10 +1099,16 @@ add_list_of_keys(key_chunk_t *root, keys_add_info_t cmds[], size_t len)
 			continue;
 		}
 
+		if(curr->type == BUILTIN_NIM_KEYS)
+		{
+			--curr->parent->nim_children;
+		}
+
 		curr->conf = cmds[i].info;
 		if(curr->conf.nim)
 		{
 			curr->type = BUILTIN_NIM_KEYS;
+			++curr->parent->nim_children;
 		}
 		else
 		{
@@ -1061,15 +1127,9 @@ add_keys_inner(key_chunk_t *root, const wchar_t *keys)
 	key_chunk_t *curr = root;
 	while(*keys != L'\0')
 	{
-		key_chunk_t *prev, *p;
-		prev = NULL;
-		p = curr->child;
-		while(p != NULL && p->key < *keys)
-		{
-			prev = p;
-			p = p->next;
-		}
-		if(p == NULL || p->key != *keys)
+		int pos;
+		key_chunk_t *p = find_child(curr, *keys, &pos);
+		if(p == NULL)
 		{
 			key_chunk_t *c = malloc(sizeof(*c));
 			if(c == NULL)
@@ -1083,9 +1143,10 @@ add_keys_inner(key_chunk_t *root, const wchar_t *keys)
 			c->conf.descr = NULL;
 			c->conf.nim = 0;
 			c->conf.skip_suggestion = 0;
-			c->prev = prev;
-			c->next = p;
-			c->child = NULL;
+			c->children = NULL;
+			c->nchildren = 0;
+			c->capacity = 0;
+			c->nim_children = 0;
 			c->parent = curr;
 			c->children_count = 0;
 			c->enters = 0;
@@ -1093,12 +1154,11 @@ add_keys_inner(key_chunk_t *root, const wchar_t *keys)
 			c->no_remap = 1;
 			c->silent = 0;
 			c->wait = 0;
-			if(prev == NULL)
-				curr->child = c;
-			else
-				prev->next = c;
-			if(p != NULL)
-				p->prev = c;
+			if(insert_child(curr, c, pos) != 0)
+			{
+				free(c);
+				return NULL;
+			}
 
 			if(keys[1] == L'\0')
 			{
@@ -1239,21 +1299,12 @@ keys_suggest(const key_chunk_t *root, const wchar_t keys[],
 
 	while(*keys != L'\0')
 	{
-		const key_chunk_t *p;
-		int number_in_the_middle = 0;
-
-		/* Look up current key among children of current node (might be root), while
-		 * inspecting NIM as well. */
-		for(p = curr->child; p != NULL && p->key < *keys; p = p->next)
-		{
-			if(p->type == BUILTIN_NIM_KEYS)
-			{
-				number_in_the_middle = 1;
-			}
-		}
+		/* Look up current key among children of current node (might be root). */
+		const key_chunk_t *const p = find_child(curr, *keys, NULL);
+		const int number_in_the_middle = (curr->nim_children != 0);
 
 		/* Go to the next character if a match found. */
-		if(p != NULL && p->key == *keys)
+		if(p != NULL)
 		{
 			++keys;
 			curr = p;
@@ -1266,15 +1317,6 @@ keys_suggest(const key_chunk_t *root, const wchar_t keys[],
 			return;
 		}
 
-		/* Need to inspect all children for NIM. */
-		for(; p != NULL && !number_in_the_middle; p = p->next)
-		{
-			if(p->type == BUILTIN_NIM_KEYS)
-			{
-				number_in_the_middle = 1;
-			}
-		}
-
 		/* Give up if this isn't one of cases where next character is not presented
 		 * in the tree by design. */
 		if(curr->conf.followed != FOLLOWED_BY_NONE &&
@@ -1327,15 +1369,16 @@ static void
 suggest_children(const key_chunk_t *chunk, const wchar_t prefix[],
 		vle_keys_list_cb cb, int fold_subkeys)
 {
-	const key_chunk_t *child;
+	int i;
 
 	const size_t prefix_len = wcslen(prefix);
 	wchar_t item[prefix_len + 1U + 1U];
 	wcscpy(item, prefix);
 	item[prefix_len + 1U] = L'\0';
 
-	for(child = chunk->child; child != NULL; child = child->next)
+	for(i = 0; i < chunk->nchildren; ++i)
 	{
+		const key_chunk_t *const child = chunk->children[i];
 		if(!fold_subkeys || child->children_count <= 1)
 		{
 			traverse_children(child, prefix, &suggest_chunk, cb);
@@ -1356,7 +1399,7 @@ static void
 traverse_children(const key_chunk_t *chunk, const wchar_t prefix[],
 		traverse_func cb, void *param)
 {
-	const key_chunk_t *child;
+	int i;
 
 	const size_t prefix_len = wcslen(prefix);
 	wchar_t item[prefix_len + 1U + 1U];
@@ -1366,9 +1409,9 @@ traverse_children(const key_chunk_t *chunk, const wchar_t prefix[],
 
 	cb(chunk, item, param);
 
-	for(child = chunk->child; child != NULL; child = child->next)
+	for(i = 0; i < chunk->nchildren; ++i)
 	{
-		traverse_children(child, item, cb, param);
+		traverse_children(chunk->children[i], item, cb, param);
 	}
 }
 
@@ -21,6 +21,8 @@
 
 #include <stddef.h> /* size_t wchar_t */
 
+#include "../utils/test_helpers.h"
+
 enum
 {
 	NO_COUNT_GIVEN = -1,
@@ -200,6 +202,10 @@ int vle_keys_inside_mapping(void);
 void vle_keys_suggest(const wchar_t keys[], vle_keys_list_cb cb,
 		int custom_only, int fold_subkeys);
 
+TSTATIC_DEFS(
+	extern size_t child_probes;
+)
+
 #endif /* VIFM__ENGINE__KEYS_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0: */
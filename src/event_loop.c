@@ -34,6 +34,7 @@
 #include "engine/completion.h"
 #include "engine/keys.h"
 #include "engine/mode.h"
+#include "menus/menus.h"
 #include "modes/dialogs/msg_dialog.h"
 #include "modes/modes.h"
 #include "modes/wk.h"
@@ -331,6 +332,7 @@ ensure_term_is_ready(void)
  * performing the following tasks while waiting for input:
  *  - checks for new IPC messages;
  *  - checks whether contents of displayed directories changed;
+ *  - loads output of external commands into menus;
  *  - redraws UI if requested.
  * Returns KEY_CODE_YES for functional keys (preprocesses *c in this case), OK
  * for wide character and ERR otherwise (e.g. after timeout). */
@@ -355,6 +357,15 @@ get_char_async_loop(WINDOW *win, wint_t *c, int timeout)
 			check_view_for_changes(other_view);
 		}
 
+		menus_check_for_updates();
+
+		/* Other modes might rely on positions of entries. */
+		if(vle_mode_is(NORMAL_MODE))
+		{
+			(void)flist_continue_tree(curr_view);
+			(void)flist_continue_tree(other_view);
+		}
+
 		process_scheduled_updates();
 
 		for(i = 0; i < IPC_F && timeout > 0; ++i)
@@ -29,10 +29,11 @@
 #include <curses.h>
 
 #include <sys/stat.h> /* stat */
+#include <sys/time.h> /* gettimeofday() timeval */
 
 #include <assert.h> /* assert() */
 #include <errno.h> /* errno */
-#include <limits.h> /* INT_MIN */
+#include <limits.h> /* INT_MAX INT_MIN */
 #include <stddef.h> /* NULL size_t */
 #include <stdint.h> /* intptr_t uint64_t */
 #include <stdio.h> /* snprintf() */
@@ -56,6 +57,7 @@
 #include "ui/statusline.h"
 #include "ui/tabs.h"
 #include "ui/ui.h"
+#include "utils/dir_scan.h"
 #include "utils/dynarray.h"
 #include "utils/env.h"
 #include "utils/fs.h"
@@ -85,15 +87,51 @@
 #include "status.h"
 #include "types.h"
 
+/* Number of levels of a tree loaded right away when its depth isn't limited
+ * explicitly, deeper levels are loaded by flist_continue_tree(). */
+#define TREE_INITIAL_DEPTH 3
+
+/* Maximum time in milliseconds spent by a single flist_continue_tree() call. */
+#define TREE_STEP_MS 50
+
+/* Parameters of building tree-view. */
+typedef struct
+{
+	trie_t *excluded_paths; /* Paths that should be ignored with nested paths. */
+	trie_t *folds;          /* Folding state of directories set by the user. */
+	int max_depth;          /* Depth starting with which directories are folded
+	                           by default. */
+	int hide_dot;           /* Whether dot directories are skipped. */
+	dir_scan_t *scan;       /* Reads directories ahead of time or NULL. */
+}
+tree_params_t;
+
+/* Contents of a folded directory of tree-view, which is read, but not yet put
+ * into the list of entries. */
+typedef struct
+{
+	int pos;              /* Position of the directory in the list. */
+	dir_entry_t *entries; /* Sorted subtree of the directory (dynarray). */
+	int nentries;         /* Number of elements in entries. */
+	int nfiltered;        /* Number of entries that were filtered out. */
+}
+tree_unfold_t;
+
 static void init_flist(view_t *view);
 static void reset_view(view_t *view);
 static void init_view_history(view_t *view);
 static int navigate_to_file_in_custom_view(view_t *view, const char dir[],
 		const char file[]);
+static dir_entry_t * custom_add(view_t *view, const char path[],
+		const dir_scan_entry_t *data);
 static int fill_dir_entry_by_path(dir_entry_t *entry, const char path[]);
+static int fill_dir_entry_by_scan(dir_entry_t *entry, const char path[],
+		const dir_scan_entry_t *data);
 #ifndef _WIN32
 static int fill_dir_entry(dir_entry_t *entry, const char path[],
 		const struct dirent *d);
+static int fill_dir_entry_by_stat(dir_entry_t *entry, const char path[],
+		const struct stat *s, const struct dirent *d);
 static int data_is_dir_entry(const struct dirent *d, const char path[]);
 #else
 static int fill_dir_entry(dir_entry_t *entry, const char path[],
@@ -143,7 +181,16 @@ static int correct_pos(view_t *view, int pos, int dist, int closest);
 static int rescue_from_empty_filelist(view_t *view);
 static void add_parent_entry(view_t *view, dir_entry_t **entries, int *count);
 static void init_dir_entry(view_t *view, dir_entry_t *entry, const char name[]);
+static dir_entry_t * entry_list_add_scanned(view_t *view, dir_entry_t **list,
+		int *list_size, const char path[], const dir_scan_entry_t *data);
 static dir_entry_t * alloc_dir_entry(dir_entry_t **list, int list_size);
+static int apply_fs_deltas(view_t *view, const fswatch_delta_t deltas[],
+		int count);
+static int take_out_touched(view_t *view, trie_t *touched,
+		dir_entry_t **updated, int *nupdated);
+static int add_touched(view_t *view, trie_t *touched,
+		const fswatch_delta_t deltas[], int count, dir_entry_t **updated,
+		int *nupdated);
 static int tree_has_changed(const dir_entry_t *entries, size_t nchildren);
 static void find_dir_in_cdpath(const char base_dir[], const char dst[],
 		char buf[], size_t buf_size);
@@ -157,17 +204,35 @@ static int iter_entries(view_t *view, dir_entry_t **entry,
 static void clear_marking(view_t *view);
 static int set_position_by_path(view_t *view, const char path[]);
 static int flist_load_tree_internal(view_t *view, const char path[],
-		int reload);
+		int reload, int depth);
 static int make_tree(view_t *view, const char path[], int reload,
-		trie_t *excluded_paths);
+		const tree_params_t *params);
 static void tree_from_cv(view_t *view);
 static int complete_tree(const char name[], int valid, const void *parent_data,
 		void *data, void *arg);
 static void reset_entry_list(view_t *view, dir_entry_t **entries, int *count);
 static void drop_tops(view_t *view, dir_entry_t *entries, int *nentries,
 		int extra);
+static int build_tree(view_t *view, const char path[],
+		const tree_params_t *params);
+static int tree_scan_pred(const char path[], int depth, void *arg);
 static int add_files_recursively(view_t *view, const char path[],
-		trie_t *excluded_paths, int parent_pos, int no_direct_parent);
+		const tree_params_t *params, dir_scan_node_t *node, int parent_pos,
+		int no_direct_parent, int depth);
+static int list_tree_dir(const tree_params_t *params, dir_scan_node_t *node,
+		const char path[], dir_scan_entry_t **entries, int *count);
+static void drop_tree_dir(const tree_params_t *params, dir_scan_node_t *node);
+static int is_folded(const tree_params_t *params, const char path[],
+		int depth);
+static int get_max_depth(int depth);
+static int unfold_tree_dir(view_t *view, int pos);
+static int read_tree_dir(view_t *view, int pos, tree_unfold_t *unfold);
+static int splice_tree_dirs(view_t *view, tree_unfold_t unfolds[], int count);
+static int count_inserted(const tree_unfold_t unfolds[], const int offsets[],
+		int count, int pos);
+static void fold_tree_dir(view_t *view, int pos);
+static void resize_subtree(view_t *view, int pos, int delta);
+static int get_tree_level(const view_t *view, int pos);
 static int file_is_visible(view_t *view, const char name[], int is_dir,
 		const void *data, int apply_local_filter);
 static int add_directory_leaf(view_t *view, const char path[], int parent_pos);
@@ -215,6 +280,9 @@ init_flist(view_t *view)
 	view->custom.entry_count = 0;
 	view->custom.orig_dir = NULL;
 	view->custom.title = NULL;
+	view->custom.tree_depth = INT_MAX;
+	view->custom.tree_loading = 0;
+	view->custom.tree_cursor = 0;
 
 	/* Load fake empty element to make dir_entry valid. */
 	view->dir_entry = dynarray_extend(NULL, sizeof(dir_entry_t));
@@ -255,8 +323,10 @@ flist_free_view(view_t *view)
 	update_string(&view->custom.orig_dir, NULL);
 	update_string(&view->custom.title, NULL);
 	trie_free(view->custom.excluded_paths);
+	trie_free(view->custom.folds);
 	trie_free(view->custom.paths_cache);
 	view->custom.excluded_paths = NULL;
+	view->custom.folds = NULL;
 	view->custom.paths_cache = NULL;
 
 	for(i = 0; i < view->local_filter.entry_count; ++i)
@@ -278,6 +348,14 @@ flist_free_view(view_t *view)
 	free(view->local_filter.poshist);
 	view->local_filter.poshist = NULL;
 
+	for(i = 0; i < (int)view->local_filter.match_names_len; ++i)
+	{
+		free(view->local_filter.match_names[i]);
+	}
+	free(view->local_filter.match_names);
+	view->local_filter.match_names = NULL;
+	view->local_filter.match_names_len = 0U;
+
 	filter_dispose(&view->local_filter.filter);
 	filter_dispose(&view->auto_filter);
 	matcher_free(view->manual_filter);
@@ -317,6 +395,7 @@ flist_free_view(view_t *view)
 	view->vi = NULL;
 
 	regfree(&view->primary_group);
+	sort_drop_group_keys(view);
 }
 
 void
@@ -821,6 +900,14 @@ flist_custom_start(view_t *view, const char title[])
 
 dir_entry_t *
 flist_custom_add(view_t *view, const char path[])
+{
+	return custom_add(view, path, NULL);
+}
+
+/* Adds an entry to custom view list.  data is optional source of file
+ * attributes.  Returns the entry or NULL on error. */
+static dir_entry_t *
+custom_add(view_t *view, const char path[], const dir_scan_entry_t *data)
 {
 	char canonic_path[PATH_MAX + 1];
 	to_canonic_path(path, flist_get_dir(view), canonic_path,
@@ -832,8 +919,8 @@ flist_custom_add(view_t *view, const char path[])
 		return NULL;
 	}
 
-	return entry_list_add(view, &view->custom.entries, &view->custom.entry_count,
-			canonic_path);
+	return entry_list_add_scanned(view, &view->custom.entries,
+			&view->custom.entry_count, canonic_path, data);
 }
 
 dir_entry_t *
@@ -895,7 +982,27 @@ fill_dir_entry(dir_entry_t *entry, const char path[], const struct dirent *d)
 		return 1;
 	}
 
-	entry->type = get_type_from_mode(s.st_mode);
+	return fill_dir_entry_by_stat(entry, path, &s, d);
+}
+
+/* Fills directory entry with information about file that was obtained by
+ * scanning its directory.  Returns non-zero on error, otherwise zero is
+ * returned. */
+static int
+fill_dir_entry_by_scan(dir_entry_t *entry, const char path[],
+		const dir_scan_entry_t *data)
+{
+	return fill_dir_entry_by_stat(entry, path, &data->stat, NULL);
+}
+
+/* Fills fields of the entry from result of lstat() on the file specified by its
+ * path.  d is optional source of file type.  Returns zero on success, otherwise
+ * non-zero is returned. */
+static int
+fill_dir_entry_by_stat(dir_entry_t *entry, const char path[],
+		const struct stat *s, const struct dirent *d)
+{
+	entry->type = get_type_from_mode(s->st_mode);
 	if(entry->type == FT_UNK)
 	{
 		entry->type = (d == NULL) ? FT_UNK : type_from_dir_entry(d, path);
@@ -906,27 +1013,27 @@ fill_dir_entry(dir_entry_t *entry, const char path[], const struct dirent *d)
 		return 1;
 	}
 
-	entry->size = (uintmax_t)s.st_size;
-	entry->uid = s.st_uid;
-	entry->gid = s.st_gid;
-	entry->mode = s.st_mode;
-	entry->inode = s.st_ino;
-	entry->mtime = s.st_mtime;
-	entry->atime = s.st_atime;
-	entry->ctime = s.st_ctime;
-	entry->nlinks = s.st_nlink;
+	entry->size = (uintmax_t)s->st_size;
+	entry->uid = s->st_uid;
+	entry->gid = s->st_gid;
+	entry->mode = s->st_mode;
+	entry->inode = s->st_ino;
+	entry->mtime = s->st_mtime;
+	entry->atime = s->st_atime;
+	entry->ctime = s->st_ctime;
+	entry->nlinks = s->st_nlink;
 
 	if(entry->type == FT_LINK)
 	{
-		struct stat s;
+		struct stat target;
 
 		const SymLinkType symlink_type = get_symlink_type(path);
 		entry->dir_link = (symlink_type != SLT_UNKNOWN);
 
 		/* Query mode of symbolic link target. */
-		if(symlink_type != SLT_SLOW && os_stat(entry->name, &s) == 0)
+		if(symlink_type != SLT_SLOW && os_stat(entry->name, &target) == 0)
 		{
-			entry->mode = s.st_mode;
+			entry->mode = target.st_mode;
 		}
 	}
 
@@ -968,6 +1075,17 @@ fill_dir_entry_by_path(dir_entry_t *entry, const char path[])
 	return 0;
 }
 
+/* Fills directory entry with information about file that was obtained by
+ * scanning its directory.  Returns non-zero on error, otherwise zero is
+ * returned. */
+static int
+fill_dir_entry_by_scan(dir_entry_t *entry, const char path[],
+		const dir_scan_entry_t *data)
+{
+	/* Scanning doesn't collect all the necessary data on Windows. */
+	return fill_dir_entry_by_path(entry, path);
+}
+
 /* Fills fields of the entry from *ffd fields for the file specified by its
  * path.  type_hint is additional source of file type.  Returns zero on success,
  * Returns zero on success, otherwise non-zero is returned. */
@@ -1778,7 +1896,8 @@ populate_custom_view(view_t *view, int reload)
 		int prev_list_rows, result;
 
 		start_dir_list_change(view, &prev_dir_entries, &prev_list_rows, reload);
-		result = flist_load_tree_internal(view, flist_get_dir(view), 1);
+		result = flist_load_tree_internal(view, flist_get_dir(view), 1,
+				view->custom.tree_depth);
 
 		if(view->dir_entry == NULL)
 		{
@@ -2552,8 +2671,10 @@ init_dir_entry(view_t *view, dir_entry_t *entry, const char name[])
 
 	entry->type = FT_UNK;
 	entry->dir_link = 0;
+	entry->folded = 0;
 	entry->hi_num = -1;
 	entry->name_dec_num = -1;
+	entry->group_key = -1;
 
 	entry->child_count = 0;
 	entry->child_pos = 0;
@@ -2648,6 +2769,15 @@ add_dir_entry(dir_entry_t **list, size_t *list_size, const dir_entry_t *entry)
 dir_entry_t *
 entry_list_add(view_t *view, dir_entry_t **list, int *list_size,
 		const char path[])
+{
+	return entry_list_add_scanned(view, list, list_size, path, NULL);
+}
+
+/* Same as entry_list_add(), but data is an optional source of file
+ * attributes.  Returns the entry or NULL on error. */
+static dir_entry_t *
+entry_list_add_scanned(view_t *view, dir_entry_t **list, int *list_size,
+		const char path[], const dir_scan_entry_t *data)
 {
 	dir_entry_t *const dir_entry = alloc_dir_entry(list, *list_size);
 	if(dir_entry == NULL)
@@ -2660,7 +2790,8 @@ entry_list_add(view_t *view, dir_entry_t **list, int *list_size,
 	dir_entry->origin = strdup(path);
 	remove_last_path_component(dir_entry->origin);
 
-	if(fill_dir_entry_by_path(dir_entry, path) != 0)
+	if((data == NULL ? fill_dir_entry_by_path(dir_entry, path)
+	                 : fill_dir_entry_by_scan(dir_entry, path, data)) != 0)
 	{
 		fentry_free(view, dir_entry);
 		return NULL;
@@ -2689,6 +2820,8 @@ void
 check_if_filelist_has_changed(view_t *view)
 {
 	int failed, changed;
+	fswatch_delta_t *deltas = NULL;
+	int ndeltas = 0;
 	const char *const curr_dir = flist_get_dir(view);
 
 	if(view->on_slow_fs ||
@@ -2708,7 +2841,15 @@ check_if_filelist_has_changed(view_t *view)
 	}
 	else
 	{
-		changed = fswatch_changed(view->watch, &failed);
+		const FSWatchState state = fswatch_poll(view->watch, &deltas, &ndeltas);
+		failed = (state == FSWS_ERROR);
+		changed = (state != FSWS_UNCHANGED);
+
+		if(changed && !failed)
+		{
+			/* Sizes of this directory and all of its parents are now outdated. */
+			dcache_invalidate(curr_dir);
+		}
 	}
 
 	/* Check if we still have permission to visit this directory. */
@@ -2721,6 +2862,8 @@ check_if_filelist_has_changed(view_t *view)
 
 		show_error_msgf("Directory Change Check", "Cannot open %s", curr_dir);
 
+		fswatch_free_deltas(deltas, ndeltas);
+
 		leave_invalid_dir(view);
 		(void)change_directory(view, curr_dir);
 		flist_sel_stash(view);
@@ -2730,7 +2873,15 @@ check_if_filelist_has_changed(view_t *view)
 
 	if(changed)
 	{
-		ui_view_schedule_reload(view);
+		if(deltas != NULL && apply_fs_deltas(view, deltas, ndeltas) == 0)
+		{
+			ui_view_schedule_redraw(view);
+		}
+		else
+		{
+			ui_view_schedule_reload(view);
+		}
+		fswatch_free_deltas(deltas, ndeltas);
 	}
 	else if(flist_custom_active(view) && cv_tree(view->custom.type))
 	{
@@ -2751,6 +2902,216 @@ check_if_filelist_has_changed(view_t *view)
 	}
 }
 
+/* Updates file list of the view according to changes reported by directory
+ * watcher without re-reading whole directory: only touched entries are queried
+ * and then inserted at their sorted positions.  Returns zero on success and
+ * non-zero if full reload is necessary. */
+static int
+apply_fs_deltas(view_t *view, const fswatch_delta_t deltas[], int count)
+{
+	trie_t *touched;
+	char *saved_cwd;
+	char full_path[PATH_MAX + 1];
+	dir_entry_t *updated = NULL;
+	int nupdated = 0;
+	int i;
+	int failed;
+	const int top_delta = view->list_pos - view->top_line;
+
+	/* Empty list might require adding or removing of "..", so let regular reload
+	 * take care of it. */
+	if(flist_custom_active(view) || view->local_filter.in_progress ||
+			curr_stats.load_stage < 2 || !window_shows_dirlist(view) ||
+			view->list_rows < 2)
+	{
+		return 1;
+	}
+
+	/* Map each touched name onto its first event. */
+	touched = trie_create();
+	for(i = 0; i < count; ++i)
+	{
+		void *data;
+		if(trie_get(touched, deltas[i].name, &data) != 0 &&
+				trie_set(touched, deltas[i].name, &deltas[i]) < 0)
+		{
+			trie_free(touched);
+			return 1;
+		}
+	}
+
+	saved_cwd = save_cwd();
+	/* This is needed for lstat() of symbolic link targets. */
+	if(vifm_chdir(view->curr_dir) != 0)
+	{
+		restore_cwd(saved_cwd);
+		trie_free(touched);
+		return 1;
+	}
+
+	get_current_full_path(view, sizeof(full_path), full_path);
+
+	failed = take_out_touched(view, touched, &updated, &nupdated)
+	      || add_touched(view, touched, deltas, count, &updated, &nupdated)
+	      || sort_insert_entries(view, updated, nupdated) != 0;
+
+	trie_free(touched);
+	restore_cwd(saved_cwd);
+
+	if(failed)
+	{
+		free_dir_entries(view, &updated, &nupdated);
+		return 1;
+	}
+	dynarray_free(updated);
+
+	if(view->list_rows == 0 ||
+			(view->list_rows == 1 && is_parent_dir(view->dir_entry[0].name)))
+	{
+		return 1;
+	}
+
+	if(set_position_by_path(view, full_path) == 0)
+	{
+		view->top_line = MAX(0, view->list_pos - top_delta);
+	}
+	else if(view->list_pos >= view->list_rows)
+	{
+		view->list_pos = view->list_rows - 1;
+	}
+
+	fview_update_geometry(view);
+	fview_list_updated(view);
+	return 0;
+}
+
+/* Removes touched entries from the list of the view and appends ones that
+ * still exist and are visible to the *updated list after querying their
+ * information anew.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+take_out_touched(view_t *view, trie_t *touched, dir_entry_t **updated,
+		int *nupdated)
+{
+	int i, j;
+
+	j = 0;
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		void *data;
+		dir_entry_t *const entry = &view->dir_entry[i];
+		const FileType type = entry->type;
+
+		if(trie_get(touched, entry->name, &data) != 0 || data == NULL)
+		{
+			view->dir_entry[j++] = *entry;
+			continue;
+		}
+
+		/* Mark entry as processed. */
+		(void)trie_set(touched, entry->name, NULL);
+
+		if(path_exists(entry->name, NODEREF) &&
+				fill_dir_entry_by_path(entry, entry->name) == 0)
+		{
+			if(file_is_visible(view, entry->name, fentry_is_dir(entry), NULL, 1))
+			{
+				dir_entry_t *const new_entry = alloc_dir_entry(updated, *nupdated);
+				if(new_entry == NULL)
+				{
+					view->dir_entry[j++] = *entry;
+					for(++i; i < view->list_rows; ++i)
+					{
+						view->dir_entry[j++] = view->dir_entry[i];
+					}
+					view->list_rows = j;
+					return 1;
+				}
+
+				*new_entry = *entry;
+				if(new_entry->type != type)
+				{
+					new_entry->hi_num = -1;
+					new_entry->name_dec_num = -1;
+				}
+				++*nupdated;
+				continue;
+			}
+
+			++view->filtered;
+		}
+
+		view->selected_files -= (entry->selected != 0);
+		view->matches -= (entry->search_match != 0);
+		fentry_free(view, entry);
+	}
+	view->list_rows = j;
+
+	return 0;
+}
+
+/* Appends entries that were touched, but weren't found in the list of the view
+ * to the *updated list.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+add_touched(view_t *view, trie_t *touched, const fswatch_delta_t deltas[],
+		int count, dir_entry_t **updated, int *nupdated)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		void *data;
+		const fswatch_delta_t *first;
+		int existed;
+		dir_entry_t *entry;
+		const char *const name = deltas[i].name;
+
+		if(trie_get(touched, name, &data) != 0 || data == NULL)
+		{
+			continue;
+		}
+
+		/* Mark entry as processed. */
+		(void)trie_set(touched, name, NULL);
+
+		first = data;
+		existed = (first->event != FSWE_CREATED && first->event != FSWE_MOVED_TO);
+
+		if(!path_exists(name, NODEREF))
+		{
+			/* Entry which existed, but wasn't in the list must have been filtered
+			 * out. */
+			if(existed && view->filtered > 0)
+			{
+				--view->filtered;
+			}
+			continue;
+		}
+
+		entry = alloc_dir_entry(updated, *nupdated);
+		if(entry == NULL)
+		{
+			return 1;
+		}
+
+		init_dir_entry(view, entry, name);
+		if(fill_dir_entry_by_path(entry, name) == 0 &&
+				file_is_visible(view, name, fentry_is_dir(entry), NULL, 1))
+		{
+			++*nupdated;
+			continue;
+		}
+
+		if(!existed)
+		{
+			++view->filtered;
+		}
+		fentry_free(view, entry);
+	}
+
+	return 0;
+}
+
 /* Checks whether tree-view needs a reload (any of subdirectories were changed).
  * Returns non-zero if so, otherwise zero is returned. */
 static int
@@ -3629,12 +3990,12 @@ fentry_is_dir(const dir_entry_t *entry)
 }
 
 int
-flist_load_tree(view_t *view, const char path[])
+flist_load_tree(view_t *view, const char path[], int depth)
 {
 	char full_path[PATH_MAX + 1];
 	get_current_full_path(view, sizeof(full_path), full_path);
 
-	if(flist_load_tree_internal(view, path, 0) != 0)
+	if(flist_load_tree_internal(view, path, 0, depth) != 0)
 	{
 		return 1;
 	}
@@ -3674,7 +4035,13 @@ flist_clone_tree(view_t *to, const view_t *from)
 	}
 	else
 	{
-		if(make_tree(to, flist_get_dir(from), 0, from->custom.excluded_paths) != 0)
+		const tree_params_t params = {
+			.excluded_paths = from->custom.excluded_paths,
+			.folds = from->custom.folds,
+			.max_depth = get_max_depth(from->custom.tree_depth),
+		};
+
+		if(make_tree(to, flist_get_dir(from), 0, &params) != 0)
 		{
 			return 1;
 		}
@@ -3682,17 +4049,188 @@ flist_clone_tree(view_t *to, const view_t *from)
 
 	trie_free(to->custom.excluded_paths);
 	to->custom.excluded_paths = trie_clone(from->custom.excluded_paths);
+	trie_free(to->custom.folds);
+	to->custom.folds = trie_clone(from->custom.folds);
+	to->custom.tree_depth = from->custom.tree_depth;
+	to->custom.tree_loading = (to->custom.type == CV_TREE &&
+			from->custom.tree_depth == 0);
+	to->custom.tree_cursor = 0;
 	return 0;
 }
 
+void
+flist_toggle_fold(view_t *view)
+{
+	char full_path[PATH_MAX + 1];
+	const int pos = view->list_pos;
+	dir_entry_t *const entry = get_current_entry(view);
+	const int folded = entry->folded;
+
+	if(!flist_custom_active(view) || view->custom.type != CV_TREE ||
+			entry->type != FT_DIR || is_parent_dir(entry->name))
+	{
+		return;
+	}
+
+	get_full_path_of(entry, sizeof(full_path), full_path);
+	if(trie_set(view->custom.folds, full_path,
+				folded ? NULL : (void *)(intptr_t)1) < 0)
+	{
+		show_error_msg("Tree View", "Failed to update folding state");
+		return;
+	}
+
+	/* Positions in the list are about to change, so background loading has to
+	 * restart its scan. */
+	view->custom.tree_cursor = 0;
+
+	if(!filter_is_empty(&view->local_filter.filter))
+	{
+		/* Local filter breaks structure of the tree, so just rebuild it. */
+		populate_dir_list(view, 1);
+		(void)set_position_by_path(view, full_path);
+	}
+	else if(folded)
+	{
+		int failed;
+
+		ui_cancellation_reset();
+		ui_cancellation_enable();
+		failed = unfold_tree_dir(view, pos);
+		ui_cancellation_disable();
+
+		if(failed && !ui_cancellation_requested())
+		{
+			show_error_msg("Tree View", "Failed to list directory");
+		}
+	}
+	else
+	{
+		fold_tree_dir(view, pos);
+	}
+
+	ui_view_schedule_redraw(view);
+}
+
+int
+flist_continue_tree(view_t *view)
+{
+	struct timeval start;
+	tree_unfold_t *unfolds = NULL;
+	int nunfolds = 0, capacity = 0;
+	int i;
+	int changed, first_unfolded;
+	int out_of_time = 0, failed = 0;
+	const int cursor = view->custom.tree_cursor;
+
+	if(!flist_custom_active(view) || view->custom.type != CV_TREE ||
+			!view->custom.tree_loading ||
+			!filter_is_empty(&view->local_filter.filter))
+	{
+		return 0;
+	}
+
+	gettimeofday(&start, NULL);
+	ui_cancellation_reset();
+
+	/* Directories are read first and put into the list all at once, so that the
+	 * list is rearranged only once per call. */
+	for(i = MIN(cursor, view->list_rows); i < view->list_rows && !out_of_time;
+			++i)
+	{
+		char full_path[PATH_MAX + 1];
+		struct timeval now;
+		void *folded;
+
+		if(!view->dir_entry[i].folded)
+		{
+			continue;
+		}
+
+		/* Skip directories folded by the user. */
+		get_full_path_of(&view->dir_entry[i], sizeof(full_path), full_path);
+		if(trie_get(view->custom.folds, full_path, &folded) == 0)
+		{
+			continue;
+		}
+
+		if(nunfolds == capacity)
+		{
+			const int new_capacity = (capacity == 0 ? 16 : capacity*2);
+			tree_unfold_t *const new_unfolds = reallocarray(unfolds, new_capacity,
+					sizeof(*unfolds));
+			if(new_unfolds == NULL)
+			{
+				failed = 1;
+				break;
+			}
+			unfolds = new_unfolds;
+			capacity = new_capacity;
+		}
+
+		/* Marking directory as unfolded before reading it makes sure that it won't
+		 * be retried on failure and that it will be read on reload. */
+		if(trie_set(view->custom.folds, full_path, NULL) < 0)
+		{
+			failed = 1;
+			break;
+		}
+
+		if(read_tree_dir(view, i, &unfolds[nunfolds]) == 0)
+		{
+			++nunfolds;
+		}
+
+		gettimeofday(&now, NULL);
+		out_of_time = ((now.tv_sec - start.tv_sec)*1000L +
+				(now.tv_usec - start.tv_usec)/1000L >= TREE_STEP_MS);
+	}
+
+	/* Contents of unfolded directories can have folded directories of its own,
+	 * so continue right after the first of them. */
+	first_unfolded = (nunfolds == 0 ? -1 : unfolds[0].pos);
+	changed = (nunfolds != 0 && splice_tree_dirs(view, unfolds, nunfolds) == 0);
+	free(unfolds);
+
+	if(first_unfolded >= 0)
+	{
+		view->custom.tree_cursor = first_unfolded + 1;
+	}
+	else if(out_of_time)
+	{
+		view->custom.tree_cursor = i;
+	}
+	else if(cursor != 0 && !failed)
+	{
+		/* The list might have been changed behind our back, make sure nothing was
+		 * missed by checking it from the start. */
+		view->custom.tree_cursor = 0;
+	}
+	else
+	{
+		view->custom.tree_loading = 0;
+	}
+
+	if(changed)
+	{
+		ui_view_schedule_redraw(view);
+	}
+	return changed;
+}
+
 /* Implements tree view (re)loading.  Returns zero on success, otherwise
  * non-zero is returned. */
 static int
-flist_load_tree_internal(view_t *view, const char path[], int reload)
+flist_load_tree_internal(view_t *view, const char path[], int reload,
+		int depth)
 {
-	trie_t *excluded_paths = reload ? view->custom.excluded_paths : NULL;
+	const tree_params_t params = {
+		.excluded_paths = reload ? view->custom.excluded_paths : NULL,
+		.folds = reload ? view->custom.folds : NULL,
+		.max_depth = get_max_depth(depth),
+	};
 
-	if(make_tree(view, path, reload, excluded_paths) != 0)
+	if(make_tree(view, path, reload, &params) != 0)
 	{
 		return 1;
 	}
@@ -3701,14 +4239,21 @@ flist_load_tree_internal(view_t *view, const char path[], int reload)
 	{
 		trie_free(view->custom.excluded_paths);
 		view->custom.excluded_paths = trie_create();
+		trie_free(view->custom.folds);
+		view->custom.folds = trie_create();
 	}
+	view->custom.tree_depth = depth;
+	view->custom.tree_loading = (depth == 0);
+	view->custom.tree_cursor = 0;
 	return 0;
 }
 
-/* (Re)loads tree at path into the view using specified list of excluded files.
- * Returns zero on success, otherwise non-zero is returned. */
+/* (Re)loads tree at path into the view using specified list of excluded files
+ * and folding information.  Returns zero on success, otherwise non-zero is
+ * returned. */
 static int
-make_tree(view_t *view, const char path[], int reload, trie_t *excluded_paths)
+make_tree(view_t *view, const char path[], int reload,
+		const tree_params_t *params)
 {
 	char canonic_path[PATH_MAX + 1];
 	int nfiltered;
@@ -3730,7 +4275,7 @@ make_tree(view_t *view, const char path[], int reload, trie_t *excluded_paths)
 	}
 	else
 	{
-		nfiltered = add_files_recursively(view, path, excluded_paths, -1, 0);
+		nfiltered = build_tree(view, path, params);
 		type = CV_TREE;
 	}
 	ui_cancellation_disable();
@@ -3922,48 +4467,100 @@ drop_tops(view_t *view, dir_entry_t *entries, int *nentries, int extra)
 	}
 }
 
-/* Adds custom view entries corresponding to file system tree.  parent_pos is
- * expected to be negative for the outermost invocation.  Returns number of
- * filtered out files on success or partial success and negative value on
+/* Builds tree at the path reading directories ahead of time on several threads
+ * unless 'iothreads' limits their number to one.  Returns number of filtered
+ * out files on success or partial success and negative value on serious
+ * error. */
+static int
+build_tree(view_t *view, const char path[], const tree_params_t *params)
+{
+	int nfiltered;
+	const int nthreads = cfg_read_threads();
+	tree_params_t scan_params = *params;
+	scan_params.hide_dot = view->hide_dot;
+	scan_params.scan = NULL;
+
+	if(nthreads > 1)
+	{
+		scan_params.scan = dir_scan_start(path, nthreads, &tree_scan_pred,
+				&scan_params);
+	}
+
+	nfiltered = add_files_recursively(view, path, &scan_params,
+			(scan_params.scan == NULL ? NULL : dir_scan_root(scan_params.scan)), -1,
+			0, 1);
+
+	dir_scan_free(scan_params.scan);
+	return nfiltered;
+}
+
+/* Decides on a thread of directory scanner whether directory is likely to be
+ * part of the tree.  Returns non-zero if so, otherwise zero is returned. */
+static int
+tree_scan_pred(const char path[], int depth, void *arg)
+{
+	const tree_params_t *const params = arg;
+	void *dummy;
+
+	if(params->hide_dot && get_last_path_component(path)[0] == '.')
+	{
+		return 0;
+	}
+
+	return trie_get(params->excluded_paths, path, &dummy) != 0
+	    && !is_folded(params, path, depth);
+}
+
+/* Adds custom view entries corresponding to file system tree.  node is
+ * directory of the scanner that corresponds to the path and can be NULL.
+ * parent_pos is expected to be negative for the outermost invocation.  depth
+ * is the depth of entries of the path, which starts with one.  Returns number
+ * of filtered out files on success or partial success and negative value on
  * serious error. */
 static int
-add_files_recursively(view_t *view, const char path[], trie_t *excluded_paths,
-		int parent_pos, int no_direct_parent)
+add_files_recursively(view_t *view, const char path[],
+		const tree_params_t *params, dir_scan_node_t *node, int parent_pos,
+		int no_direct_parent, int depth)
 {
 	int i;
 	const int prev_count = view->custom.entry_count;
 	int nfiltered = 0;
 
-	int len;
-	char **lst = list_all_files(path, &len);
-	if(len < 0)
+	int count;
+	dir_scan_entry_t *entries;
+	if(list_tree_dir(params, node, path, &entries, &count) != 0)
 	{
 		return -1;
 	}
 
-	for(i = 0; i < len && !ui_cancellation_requested(); ++i)
+	for(i = 0; i < count && !ui_cancellation_requested(); ++i)
 	{
-		int dir;
 		void *dummy;
 		dir_entry_t *entry;
-		char *const full_path = format_str("%s/%s", path, lst[i]);
+		const dir_scan_entry_t *const data = &entries[i];
+		char *const full_path = format_str("%s/%s", path, data->name);
 
-		if(trie_get(excluded_paths, full_path, &dummy) == 0)
+		if(trie_get(params->excluded_paths, full_path, &dummy) == 0)
 		{
+			drop_tree_dir(params, data->child);
 			free(full_path);
 			continue;
 		}
 
-		dir = is_dir(full_path);
-		if(!file_is_visible(view, lst[i], dir, NULL, 1))
+		if(!file_is_visible(view, data->name, data->is_dir, NULL, 1))
 		{
 			/* Traverse directory (but not symlink to it) even if we're skipping it,
 			 * because we might need files that are inside of it. */
-			if(dir && !is_symlink(full_path) &&
-					file_is_visible(view, lst[i], dir, NULL, 0))
+			if(data->is_dir && !data->is_link &&
+					file_is_visible(view, data->name, data->is_dir, NULL, 0) &&
+					!is_folded(params, full_path, depth))
 			{
-				nfiltered += add_files_recursively(view, full_path, excluded_paths,
-						parent_pos, 1);
+				nfiltered += add_files_recursively(view, full_path, params,
+						data->child, parent_pos, 1, depth + 1);
+			}
+			else
+			{
+				drop_tree_dir(params, data->child);
 			}
 
 			free(full_path);
@@ -3971,11 +4568,11 @@ add_files_recursively(view_t *view, const char path[], trie_t *excluded_paths,
 			continue;
 		}
 
-		entry = flist_custom_add(view, full_path);
+		entry = custom_add(view, full_path, data);
 		if(entry == NULL)
 		{
 			free(full_path);
-			free_string_array(lst, len);
+			dir_scan_free_list(entries, count);
 			return -1;
 		}
 
@@ -3984,13 +4581,18 @@ add_files_recursively(view_t *view, const char path[], trie_t *excluded_paths,
 			entry->child_pos = (view->custom.entry_count - 1) - parent_pos;
 		}
 
-		/* Not using dir variable here, because it is set for symlinks to
+		/* Not using data->is_dir here, because it is set for symlinks to
 		 * directories as well. */
-		if(entry->type == FT_DIR)
+		if(entry->type == FT_DIR && is_folded(params, full_path, depth))
+		{
+			entry->folded = 1;
+			drop_tree_dir(params, data->child);
+		}
+		else if(entry->type == FT_DIR)
 		{
 			const int idx = view->custom.entry_count - 1;
-			const int filtered = add_files_recursively(view, full_path,
-					excluded_paths, idx, 0);
+			const int filtered = add_files_recursively(view, full_path, params,
+					data->child, idx, 0, depth + 1);
 			/* Keep going in case of error and load partial list. */
 			if(filtered >= 0)
 			{
@@ -4007,7 +4609,7 @@ add_files_recursively(view_t *view, const char path[], trie_t *excluded_paths,
 		show_progress("Building tree...", 1000);
 	}
 
-	free_string_array(lst, len);
+	dir_scan_free_list(entries, count);
 
 	/* The prev_count != 0 check is to make sure that we won't create leaf instead
 	 * of the whole tree (this is handled in flist_custom_finish()). */
@@ -4025,6 +4627,333 @@ add_files_recursively(view_t *view, const char path[], trie_t *excluded_paths,
 	return nfiltered;
 }
 
+/* Lists directory of a tree either by retrieving its listing from the scanner
+ * or by reading it right away.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+list_tree_dir(const tree_params_t *params, dir_scan_node_t *node,
+		const char path[], dir_scan_entry_t **entries, int *count)
+{
+	if(node != NULL)
+	{
+		return dir_scan_get(params->scan, node, entries, count);
+	}
+	return dir_scan_list(path, entries, count);
+}
+
+/* Lets the scanner know that directory won't be part of the tree.  node can be
+ * NULL. */
+static void
+drop_tree_dir(const tree_params_t *params, dir_scan_node_t *node)
+{
+	if(node != NULL)
+	{
+		dir_scan_drop(params->scan, node);
+	}
+}
+
+/* Checks whether contents of directory at the path located at the specified
+ * depth of a tree shouldn't be loaded.  Returns non-zero if so, otherwise zero
+ * is returned. */
+static int
+is_folded(const tree_params_t *params, const char path[], int depth)
+{
+	void *folded;
+	if(trie_get(params->folds, path, &folded) == 0)
+	{
+		return (folded != NULL);
+	}
+	return (depth >= params->max_depth);
+}
+
+/* Maps depth of a tree as specified by the user to depth starting with which
+ * directories are folded.  Returns the depth. */
+static int
+get_max_depth(int depth)
+{
+	return (depth == 0 ? TREE_INITIAL_DEPTH : depth);
+}
+
+/* Reads contents of folded directory at the position of the tree-view right
+ * into its list of entries without rebuilding the rest of the tree.  Returns
+ * zero on success, otherwise non-zero is returned. */
+static int
+unfold_tree_dir(view_t *view, int pos)
+{
+	tree_unfold_t unfold;
+	if(read_tree_dir(view, pos, &unfold) != 0)
+	{
+		return 1;
+	}
+	return splice_tree_dirs(view, &unfold, 1);
+}
+
+/* Builds sorted subtree of folded directory at the position of the tree-view.
+ * Returns zero on success, otherwise non-zero is returned. */
+static int
+read_tree_dir(view_t *view, int pos, tree_unfold_t *unfold)
+{
+	char full_path[PATH_MAX + 1];
+	int nfiltered;
+	const tree_params_t params = {
+		.excluded_paths = view->custom.excluded_paths,
+		.folds = view->custom.folds,
+		.max_depth = get_max_depth(view->custom.tree_depth),
+		.hide_dot = view->hide_dot,
+		.scan = NULL,
+	};
+
+	get_full_path_of(&view->dir_entry[pos], sizeof(full_path), full_path);
+
+	/* The subtree is built in the list used to compose custom views, which is
+	 * empty at this point. */
+	view->custom.paths_cache = trie_create();
+	nfiltered = add_files_recursively(view, full_path, &params, NULL, -1, 0,
+			get_tree_level(view, pos) + 1);
+	trie_free(view->custom.paths_cache);
+	view->custom.paths_cache = NULL;
+
+	if(ui_cancellation_requested())
+	{
+		nfiltered = -1;
+	}
+	else if(nfiltered >= 0 && view->custom.entry_count == 0 &&
+			add_directory_leaf(view, full_path, -1) != 0)
+	{
+		nfiltered = -1;
+	}
+
+	if(nfiltered < 0)
+	{
+		free_dir_entries(view, &view->custom.entries, &view->custom.entry_count);
+		return 1;
+	}
+
+	unfold->pos = pos;
+	unfold->entries = view->custom.entries;
+	unfold->nentries = view->custom.entry_count;
+	unfold->nfiltered = nfiltered;
+	view->custom.entries = NULL;
+	view->custom.entry_count = 0;
+
+	sort_tree(view, unfold->entries, unfold->nentries);
+	return 0;
+}
+
+/* Puts contents of directories into the list of entries of tree-view in a
+ * single pass over the list.  Elements of unfolds must be sorted by position.
+ * Frees entries of unfolds.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+splice_tree_dirs(view_t *view, tree_unfold_t unfolds[], int count)
+{
+	int i, k;
+	int end;
+	dir_entry_t *list;
+	/* offsets[k] is the number of entries inserted before unfolds[k]. */
+	int *const offsets = reallocarray(NULL, count + 1, sizeof(*offsets));
+
+	if(offsets != NULL)
+	{
+		offsets[0] = 0;
+		for(k = 0; k < count; ++k)
+		{
+			offsets[k + 1] = offsets[k] + unfolds[k].nentries;
+		}
+	}
+
+	list = (offsets == NULL)
+	     ? NULL
+	     : dynarray_extend(view->dir_entry, offsets[count]*sizeof(*list));
+	if(list == NULL)
+	{
+		for(k = 0; k < count; ++k)
+		{
+			free_dir_entries(view, &unfolds[k].entries, &unfolds[k].nentries);
+		}
+		free(offsets);
+		return 1;
+	}
+	view->dir_entry = list;
+
+	/* Directories and their parents grow. */
+	for(k = 0; k < count; ++k)
+	{
+		dir_entry_t *entry = &list[unfolds[k].pos];
+		while(1)
+		{
+			entry->child_count += unfolds[k].nentries;
+			if(entry->child_pos == 0)
+			{
+				break;
+			}
+			entry -= entry->child_pos;
+		}
+	}
+
+	/* Entries get further away from their parents by the amount of entries
+	 * inserted in between. */
+	for(i = unfolds[0].pos + 1; i < view->list_rows; ++i)
+	{
+		const int child_pos = list[i].child_pos;
+		if(child_pos != 0)
+		{
+			const int parent = i - child_pos;
+			list[i].child_pos += count_inserted(unfolds, offsets, count, i)
+			                   - count_inserted(unfolds, offsets, count, parent);
+		}
+	}
+
+	/* Move pieces of the list starting from the end. */
+	end = view->list_rows;
+	for(k = count - 1; k >= 0; --k)
+	{
+		const int from = unfolds[k].pos + 1;
+		const int pos = unfolds[k].pos + offsets[k];
+
+		memmove(&list[from + offsets[k + 1]], &list[from],
+				sizeof(*list)*(end - from));
+		memcpy(&list[pos + 1], unfolds[k].entries,
+				sizeof(*list)*unfolds[k].nentries);
+		dynarray_free(unfolds[k].entries);
+		unfolds[k].entries = NULL;
+		end = from;
+	}
+
+	/* Directories themselves might have been moved by the loop above, so update
+	 * them only after all the moves. */
+	for(k = 0; k < count; ++k)
+	{
+		const int pos = unfolds[k].pos + offsets[k];
+		for(i = pos + 1; i <= pos + unfolds[k].nentries;
+				i += list[i].child_count + 1)
+		{
+			list[i].child_pos = i - pos;
+		}
+		list[pos].folded = 0;
+		view->filtered += unfolds[k].nfiltered;
+	}
+
+	view->list_rows += offsets[count];
+	view->list_pos += count_inserted(unfolds, offsets, count, view->list_pos);
+	view->top_line += count_inserted(unfolds, offsets, count, view->top_line);
+
+	free(offsets);
+
+	fview_list_updated(view);
+	return 0;
+}
+
+/* Counts entries that are inserted by unfolds before the position.  Returns the
+ * number. */
+static int
+count_inserted(const tree_unfold_t unfolds[], const int offsets[], int count,
+		int pos)
+{
+	/* Find the first element whose position isn't less than pos. */
+	int l = 0, r = count;
+	while(l < r)
+	{
+		const int m = l + (r - l)/2;
+		if(unfolds[m].pos < pos)
+		{
+			l = m + 1;
+		}
+		else
+		{
+			r = m;
+		}
+	}
+	return offsets[l];
+}
+
+/* Drops contents of directory at the position of the tree-view from its list of
+ * entries. */
+static void
+fold_tree_dir(view_t *view, int pos)
+{
+	int i;
+	const int nentries = view->dir_entry[pos].child_count;
+
+	for(i = pos + 1; i <= pos + nentries; ++i)
+	{
+		fentry_free(view, &view->dir_entry[i]);
+	}
+
+	memmove(&view->dir_entry[pos + 1], &view->dir_entry[pos + 1 + nentries],
+			sizeof(*view->dir_entry)*(view->list_rows - (pos + 1 + nentries)));
+
+	view->dir_entry[pos].folded = 1;
+	resize_subtree(view, pos, -nentries);
+
+	if(view->list_pos > pos + nentries)
+	{
+		view->list_pos -= nentries;
+	}
+	else if(view->list_pos > pos)
+	{
+		view->list_pos = pos;
+	}
+	if(view->top_line > pos + nentries)
+	{
+		view->top_line -= nentries;
+	}
+	else if(view->top_line > pos)
+	{
+		view->top_line = pos;
+	}
+
+	flist_sel_recount(view);
+	fview_list_updated(view);
+}
+
+/* Updates tree structure after contents of directory at the position has
+ * already been grown or shrunk by delta entries in the list. */
+static void
+resize_subtree(view_t *view, int pos, int delta)
+{
+	int i;
+	dir_entry_t *entry;
+	const int end = pos + 1 + view->dir_entry[pos].child_count + delta;
+
+	view->list_rows += delta;
+
+	/* Entries that follow the subtree, but whose parents precede it. */
+	for(i = end; i < view->list_rows; ++i)
+	{
+		entry = &view->dir_entry[i];
+		if(entry->child_pos != 0 && (i - delta) - entry->child_pos <= pos)
+		{
+			entry->child_pos += delta;
+		}
+	}
+
+	entry = &view->dir_entry[pos];
+	while(1)
+	{
+		entry->child_count += delta;
+		if(entry->child_pos == 0)
+		{
+			break;
+		}
+		entry -= entry->child_pos;
+	}
+}
+
+/* Computes depth of an entry of the tree-view, which starts with one.  Returns
+ * the depth. */
+static int
+get_tree_level(const view_t *view, int pos)
+{
+	int level = 1;
+	while(view->dir_entry[pos].child_pos != 0)
+	{
+		pos -= view->dir_entry[pos].child_pos;
+		++level;
+	}
+	return level;
+}
+
 /* Checks whether file is visible according to dot and filename filters.  is_dir
  * is used when data is NULL, otherwise data_is_dir_entry() called (this is an
  * optimization).  Returns non-zero if so, otherwise zero is returned. */
@@ -288,8 +288,19 @@ int fentry_is_valid(const dir_entry_t *entry);
  * directories).  Returns non-zero if so, otherwise zero is returned. */
 int fentry_is_dir(const dir_entry_t *entry);
 /* Loads directory tree specified by its path into the view.  Considers various
- * filters.  Returns zero on success, otherwise non-zero is returned. */
-int flist_load_tree(view_t *view, const char path[]);
+ * filters.  Directories at the depth (starting with one) and deeper are folded
+ * and aren't read until unfolded, INT_MAX means no limit.  Zero depth loads
+ * first few levels and leaves the rest to flist_continue_tree().  Returns zero
+ * on success, otherwise non-zero is returned. */
+int flist_load_tree(view_t *view, const char path[], int depth);
+/* Folds or unfolds directory under the cursor in tree-view.  Contents of a
+ * directory is read on unfolding and is inserted into the list without
+ * rebuilding the rest of the tree. */
+void flist_toggle_fold(view_t *view);
+/* Unfolds directories of tree-view that were left folded only because of the
+ * default depth limit.  Spends limited amount of time per call.  Returns
+ * non-zero if list of the view has changed, otherwise zero is returned. */
+int flist_continue_tree(view_t *view);
 /* Makes to contain tree with the same root as from including copying list of
  * excluded files.  Returns zero on success, otherwise non-zero is returned. */
 int flist_clone_tree(view_t *to, const view_t *from);
@@ -28,11 +28,14 @@
 #include "compat/fs_limits.h"
 #include "compat/reallocarray.h"
 #include "modes/dialogs/msg_dialog.h"
+#include "utils/matcher_set.h"
 #include "utils/matchers.h"
 #include "utils/str.h"
 #include "utils/string_array.h"
 #include "utils/utils.h"
 
+static int find_match(const assoc_list_t *record_list, const char file[],
+		int from);
 static const char * find_existing_cmd(const assoc_list_t *record_list,
 		const char file[]);
 static assoc_record_t find_existing_cmd_record(const assoc_records_t *records);
@@ -43,6 +46,7 @@ static void register_assoc(assoc_t assoc, int for_x, int in_x);
 static assoc_records_t clone_all_matching_records(const char file[],
 		const assoc_list_t *record_list);
 static void add_assoc(assoc_list_t *assoc_list, assoc_t assoc);
+static void update_set(assoc_list_t *assoc_list);
 static void assoc_viewers(matchers_t *matchers, const assoc_records_t *viewers);
 static assoc_records_t clone_assoc_records(const assoc_records_t *records,
 		const char pattern[], const assoc_list_t *dst);
@@ -111,16 +115,12 @@ find_existing_cmd(const assoc_list_t *record_list, const char file[])
 {
 	int i;
 
-	for(i = 0; i < record_list->count; ++i)
+	for(i = find_match(record_list, file, 0); i != -1;
+			i = find_match(record_list, file, i + 1))
 	{
 		assoc_record_t prog;
 		assoc_t *const assoc = &record_list->list[i];
 
-		if(!matchers_match(assoc->matchers, file))
-		{
-			continue;
-		}
-
 		prog = find_existing_cmd_record(&assoc->records);
 		if(!is_assoc_record_empty(&prog))
 		{
@@ -131,6 +131,28 @@ find_existing_cmd(const assoc_list_t *record_list, const char file[])
 	return NULL;
 }
 
+/* Finds association which pattern matches given file starting with the one at
+ * specified index.  Returns index of the association or -1. */
+static int
+find_match(const assoc_list_t *record_list, const char file[], int from)
+{
+	int i;
+
+	if(record_list->set != NULL)
+	{
+		return matcher_set_find(record_list->set, file, from);
+	}
+
+	for(i = from; i < record_list->count; ++i)
+	{
+		if(matchers_match(record_list->list[i].matchers, file))
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
 /* Finds record that corresponds to an external command that is available.
  * Returns the record on success or an empty record on failure. */
 static assoc_record_t
@@ -243,13 +265,10 @@ clone_all_matching_records(const char file[], const assoc_list_t *record_list)
 	int i;
 	assoc_records_t result = {};
 
-	for(i = 0; i < record_list->count; ++i)
+	for(i = find_match(record_list, file, 0); i != -1;
+			i = find_match(record_list, file, i + 1))
 	{
-		assoc_t *const assoc = &record_list->list[i];
-		if(matchers_match(assoc->matchers, file))
-		{
-			ft_assoc_record_add_all(&result, &assoc->records);
-		}
+		ft_assoc_record_add_all(&result, &record_list->list[i].records);
 	}
 
 	return result;
@@ -310,6 +329,29 @@ add_assoc(assoc_list_t *assoc_list, assoc_t assoc)
 	assoc_list->list = p;
 	assoc_list->list[assoc_list->count] = assoc;
 	assoc_list->count++;
+
+	update_set(assoc_list);
+}
+
+/* Adds matchers of the last association to the set of the list.  Either keeps
+ * the set in sync with the list or gets rid of it, in which case matchers are
+ * tried one by one until the list is reset. */
+static void
+update_set(assoc_list_t *assoc_list)
+{
+	const assoc_t *const last = &assoc_list->list[assoc_list->count - 1];
+
+	if(assoc_list->count == 1)
+	{
+		assoc_list->set = matcher_set_alloc();
+	}
+
+	if(assoc_list->set != NULL &&
+			matcher_set_add(assoc_list->set, last->matchers) != 0)
+	{
+		matcher_set_free(assoc_list->set);
+		assoc_list->set = NULL;
+	}
 }
 
 ViewerKind
@@ -372,6 +414,9 @@ reset_list_head(assoc_list_t *assoc_list)
 	free(assoc_list->list);
 	assoc_list->list = NULL;
 	assoc_list->count = 0;
+
+	matcher_set_free(assoc_list->set);
+	assoc_list->set = NULL;
 }
 
 static void
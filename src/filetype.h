@@ -22,6 +22,7 @@
 
 #define VIFM_PSEUDO_CMD "vifm"
 
+struct matcher_set_t;
 struct matchers_t;
 
 /* Type of file association by its source. */
@@ -70,6 +71,8 @@ typedef struct
 {
 	assoc_t *list;
 	int count;
+	/* Matchers of the list compiled for lookup or NULL to try them in order. */
+	struct matcher_set_t *set;
 }
 assoc_list_t;
 
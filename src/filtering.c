@@ -20,7 +20,8 @@
 #include "filtering.h"
 
 #include <assert.h> /* assert() */
-#include <string.h> /* strdup() */
+#include <stdlib.h> /* calloc() free() */
+#include <string.h> /* strdup() strlen() strncmp() strpbrk() */
 
 #include "cfg/config.h"
 #include "compat/reallocarray.h"
@@ -43,7 +44,11 @@ static int get_unfiltered_pos(const view_t *view, int pos);
 static int load_unfiltered_list(view_t *view);
 static int list_is_incomplete(view_t *view);
 static void store_local_filter_position(view_t *view, int pos);
-static int update_filtering_lists(view_t *view, int add, int clear);
+static int is_narrowing(const filter_t *filter, const char new_raw[]);
+static int update_filtering_lists(view_t *view, int add, int clear,
+		int narrow);
+static const char * get_match_name(view_t *view, size_t i, char buf[],
+		size_t buf_size);
 static void reparent_tree_node(dir_entry_t *original, dir_entry_t *filtered);
 static void ensure_filtered_list_not_empty(view_t *view,
 		dir_entry_t *parent_entry);
@@ -51,6 +56,7 @@ static int extract_previously_selected_pos(view_t *view);
 static void clear_local_filter_hist_after(view_t *view, int pos);
 static int find_nearest_neighour(const view_t *view);
 static void local_filter_finish(view_t *view);
+static void free_match_names(view_t *view);
 static void append_slash(const char name[], char buf[], size_t buf_size);
 
 void
@@ -70,6 +76,7 @@ filters_view_reset(view_t *view)
 	view->local_filter.saved = NULL;
 	view->local_filter.poshist = NULL;
 	view->local_filter.poshist_len = 0U;
+	free_match_names(view);
 }
 
 /* Resets filter to empty state (either initializes or clears it). */
@@ -371,6 +378,10 @@ int
 local_filter_set(view_t *view, const char filter[])
 {
 	int result;
+	int narrow = view->local_filter.in_progress
+	          && is_narrowing(&view->local_filter.filter, filter);
+	const int was_case_sensitive =
+		!(view->local_filter.filter.cflags & REG_ICASE);
 	const int current_file_pos = view->local_filter.in_progress
 	                           ? get_unfiltered_pos(view, view->list_pos)
 	                           : load_unfiltered_list(view);
@@ -383,13 +394,37 @@ local_filter_set(view_t *view, const char filter[])
 	result = (filter_change(&view->local_filter.filter, filter,
 			!regexp_should_ignore_case(filter)) ? -1 : 0);
 
-	if(update_filtering_lists(view, 1, 0) != 0 && result == 0)
+	/* Invalid filter matches everything and case-insensitive one can match more
+	 * than case-sensitive one. */
+	if(!view->local_filter.filter.is_regex_valid ||
+			(was_case_sensitive && (view->local_filter.filter.cflags & REG_ICASE)))
+	{
+		narrow = 0;
+	}
+
+	if(update_filtering_lists(view, 1, 0, narrow) != 0 && result == 0)
 	{
 		result = 1;
 	}
 	return result;
 }
 
+/* Checks whether new value of the filter can only match a subset of what its
+ * current value matches, which is the case when the value is extended by
+ * characters that aren't special in regular expressions.  Returns non-zero if
+ * so, otherwise zero is returned. */
+static int
+is_narrowing(const filter_t *filter, const char new_raw[])
+{
+	const size_t len = strlen(filter->raw);
+	if(strncmp(filter->raw, new_raw, len) != 0 || new_raw[len] == '\0')
+	{
+		return 0;
+	}
+
+	return (strpbrk(new_raw + len, "\\^$.[]|()?*+{}") == NULL);
+}
+
 /* Gets position of an item in dir_entry list at position pos in the unfiltered
  * list.  Returns index on success, otherwise -1 is returned. */
 static int
@@ -506,10 +541,12 @@ store_local_filter_position(view_t *view, int pos)
 /* Copies/moves elements of the unfiltered list into dir_entry list.  add
  * parameter controls whether entries matching filter are copied into dir_entry
  * list.  clear parameter controls whether entries not matching filter are
- * cleared in unfiltered list.  Returns zero unless addition is performed in
+ * cleared in unfiltered list.  narrow parameter specifies that filter could
+ * only become more strict since previous call, so entries that didn't pass it
+ * then needn't be matched again.  Returns zero unless addition is performed in
  * which case can return non-zero when all files got filtered out. */
 static int
-update_filtering_lists(view_t *view, int add, int clear)
+update_filtering_lists(view_t *view, int add, int clear, int narrow)
 {
 	/* filters_drop_temporaries() is a similar function. */
 
@@ -517,8 +554,12 @@ update_filtering_lists(view_t *view, int add, int clear)
 	size_t list_size = 0U;
 	dir_entry_t *parent_entry = NULL;
 	int parent_added = 0;
+	const size_t count = view->local_filter.unfiltered_count;
+	/* Position of the closest ancestor that passed the filter in the list of
+	 * visible files for each unfiltered entry or -1. */
+	int *const ancestors = add ? reallocarray(NULL, count, sizeof(int)) : NULL;
 
-	for(i = 0; i < view->local_filter.unfiltered_count; ++i)
+	for(i = 0; i < count; ++i)
 	{
 		/* FIXME: some very long file names won't be matched against some
 		 * regexps. */
@@ -526,6 +567,15 @@ update_filtering_lists(view_t *view, int add, int clear)
 
 		dir_entry_t *const entry = &view->local_filter.unfiltered[i];
 		const char *name = entry->name;
+		const int passed_before = (entry->tag >= 0);
+
+		if(ancestors != NULL)
+		{
+			const dir_entry_t *const parent = entry - entry->child_pos;
+			ancestors[i] = (parent == entry) ? -1
+			             : (parent->tag >= 0) ? parent->tag
+			             : ancestors[parent - view->local_filter.unfiltered];
+		}
 
 		if(is_parent_dir(name))
 		{
@@ -542,6 +592,7 @@ update_filtering_lists(view_t *view, int add, int clear)
 			}
 			else if(!filter_is_empty(&view->local_filter.filter))
 			{
+				entry->tag = -1;
 				if(clear)
 				{
 					fentry_free(view, entry);
@@ -550,15 +601,20 @@ update_filtering_lists(view_t *view, int add, int clear)
 			}
 		}
 
-		if(fentry_is_dir(entry))
-		{
-			append_slash(name, name_with_slash, sizeof(name_with_slash));
-			name = name_with_slash;
-		}
-
 		/* tag links to position of nodes passed through filter in list of visible
 		 * files.  Nodes that didn't pass have -1. */
 		entry->tag = -1;
+
+		if(narrow && !passed_before)
+		{
+			if(clear)
+			{
+				fentry_free(view, entry);
+			}
+			continue;
+		}
+
+		name = get_match_name(view, i, name_with_slash, sizeof(name_with_slash));
 		if(filter_matches(&view->local_filter.filter, name) != 0)
 		{
 			if(add)
@@ -567,9 +623,17 @@ update_filtering_lists(view_t *view, int add, int clear)
 				if(e != NULL)
 				{
 					entry->tag = list_size - 1U;
-					/* We basically grow the tree node by node while performing
-					 * reparenting. */
-					reparent_tree_node(entry, e);
+					if(ancestors == NULL)
+					{
+						/* We basically grow the tree node by node while performing
+						 * reparenting. */
+						reparent_tree_node(entry, e);
+					}
+					else
+					{
+						e->child_pos = (ancestors[i] < 0 ? 0 : entry->tag - ancestors[i]);
+						e->child_count = 0;
+					}
 				}
 			}
 		}
@@ -592,6 +656,21 @@ update_filtering_lists(view_t *view, int add, int clear)
 			fentry_free(view, parent_entry);
 		}
 	}
+	if(ancestors != NULL)
+	{
+		/* Sizes of subtrees are accumulated from leaves towards roots in a single
+		 * pass. */
+		i = list_size;
+		while(i-- > 0U)
+		{
+			dir_entry_t *const e = &view->dir_entry[i];
+			if(e->child_pos != 0)
+			{
+				(e - e->child_pos)->child_count += 1 + e->child_count;
+			}
+		}
+		free(ancestors);
+	}
 	if(add)
 	{
 		view->list_rows = list_size;
@@ -605,6 +684,44 @@ update_filtering_lists(view_t *view, int add, int clear)
 	return 0;
 }
 
+/* Retrieves name of i-th unfiltered entry to be matched against the filter,
+ * which for directories has a trailing slash.  Such names are built once per
+ * filtering session.  Returns pointer to the name. */
+static const char *
+get_match_name(view_t *view, size_t i, char buf[], size_t buf_size)
+{
+	struct local_filter_t *const filter = &view->local_filter;
+	const dir_entry_t *const entry = &filter->unfiltered[i];
+
+	if(!fentry_is_dir(entry))
+	{
+		return entry->name;
+	}
+
+	if(filter->match_names == NULL && filter->unfiltered_count != 0U)
+	{
+		filter->match_names = calloc(filter->unfiltered_count, sizeof(char *));
+		filter->match_names_len = (filter->match_names == NULL)
+		                        ? 0U
+		                        : filter->unfiltered_count;
+	}
+
+	if(i < filter->match_names_len)
+	{
+		if(filter->match_names[i] == NULL)
+		{
+			filter->match_names[i] = format_str("%s/", entry->name);
+		}
+		if(filter->match_names[i] != NULL)
+		{
+			return filter->match_names[i];
+		}
+	}
+
+	append_slash(entry->name, buf, buf_size);
+	return buf;
+}
+
 /* Reparents *filtered node by attaching it to the closes ancestor of *original
  * mapped onto the list of filtered nodes.  tag field of entries is used to
  * perform the mapping. */
@@ -754,7 +871,8 @@ local_filter_accept(view_t *view)
 		return;
 	}
 
-	update_filtering_lists(view, 0, 1);
+	/* Filter hasn't changed since the last update of the lists. */
+	update_filtering_lists(view, 0, 1, 1);
 
 	local_filter_finish(view);
 
@@ -803,7 +921,7 @@ local_filter_cancel(view_t *view)
 	view->dir_entry = NULL;
 	view->list_rows = 0;
 
-	update_filtering_lists(view, 1, 1);
+	update_filtering_lists(view, 1, 1, 0);
 	local_filter_finish(view);
 }
 
@@ -811,6 +929,8 @@ local_filter_cancel(view_t *view)
 static void
 local_filter_finish(view_t *view)
 {
+	free_match_names(view);
+
 	dynarray_free(view->local_filter.unfiltered);
 	free(view->local_filter.saved);
 	view->local_filter.in_progress = 0;
@@ -820,6 +940,20 @@ local_filter_finish(view_t *view)
 	view->local_filter.poshist_len = 0U;
 }
 
+/* Frees cached names of directories matched by local filter. */
+static void
+free_match_names(view_t *view)
+{
+	size_t i;
+	for(i = 0U; i < view->local_filter.match_names_len; ++i)
+	{
+		free(view->local_filter.match_names[i]);
+	}
+	free(view->local_filter.match_names);
+	view->local_filter.match_names = NULL;
+	view->local_filter.match_names_len = 0U;
+}
+
 void
 local_filter_remove(view_t *view)
 {
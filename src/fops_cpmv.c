@@ -304,8 +304,8 @@ fops_cpmv_bg(view_t *view, char *list[], int nlines, int move, int force)
 	args->ops = fops_get_bg_ops(move ? OP_MOVE : OP_COPY,
 			move ? "moving" : "copying", args->path);
 
-	if(bg_execute(task_desc, "...", args->sel_list_len, 1, &cpmv_files_in_bg,
-				args) != 0)
+	if(bg_execute(task_desc, "...", args->sel_list_len, BJC_BULK_IO,
+				args->path, &cpmv_files_in_bg, args) != 0)
 	{
 		fops_free_bg_args(args);
 
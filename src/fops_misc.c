@@ -19,12 +19,19 @@
 
 #include "fops_misc.h"
 
+#include <sys/time.h> /* gettimeofday() timeval */
 #include <sys/types.h> /* gid_t uid_t */
 
+#include <errno.h> /* ETIMEDOUT */
+#include <stdlib.h> /* calloc() free() malloc() */
 #include <string.h> /* strdup() strlen() */
+#include <time.h> /* timespec */
 
 #include "cfg/config.h"
+#include "compat/fs_limits.h"
 #include "compat/os.h"
+#include "compat/pthread.h"
+#include "compat/reallocarray.h"
 #include "modes/dialogs/msg_dialog.h"
 #include "ui/cancellation.h"
 #include "ui/fileview.h"
@@ -54,6 +61,62 @@ typedef struct
 }
 dir_size_args_t;
 
+/* Period of progress reporting during parallel size calculation in
+ * milliseconds. */
+#define SIZE_PROGRESS_PERIOD_MS 100
+
+/* Directory that is being processed by parallel size calculation.  Node is
+ * alive until it and all of its subdirectories are processed. */
+typedef struct size_node_t
+{
+	char *path;                 /* Full path to the directory. */
+	struct size_node_t *parent; /* Directory containing this one or NULL. */
+	uint64_t size;              /* Size accumulated so far. */
+	int pending;                /* Number of unprocessed parts: the directory
+	                               itself and its subdirectories. */
+	int failed;                 /* Whether listing the directory has failed. */
+}
+size_node_t;
+
+/* Double-ended queue of directories owned by a worker.  The owner takes items
+ * from the tail, while other workers steal them from the head. */
+typedef struct
+{
+	pthread_mutex_t lock; /* Protects all other fields. */
+	size_node_t **items;  /* Ring buffer of items. */
+	int head;             /* Index of the first item. */
+	int count;            /* Number of items. */
+	int capacity;         /* Size of the items array. */
+}
+size_deque_t;
+
+/* State of parallel size calculation shared by all of its threads. */
+typedef struct
+{
+	int force;             /* Whether cached values should be ignored. */
+	int nworkers;          /* Number of workers and deques. */
+	size_deque_t *deques;  /* Deque per worker. */
+
+	pthread_mutex_t lock;    /* Protects fields down to the end and nodes. */
+	pthread_cond_t has_work; /* Signaled when new work is queued or on quit. */
+	pthread_cond_t finished; /* Signaled when root is processed. */
+	int queued;             /* Number of items in all of the deques. */
+	uint64_t partial;       /* Size found so far. */
+	uint64_t size;          /* Size of the root after it's processed. */
+	int done;               /* Whether root was processed. */
+	int cancelled;          /* Whether calculation was cancelled. */
+	int stop;               /* Whether workers should quit. */
+}
+size_state_t;
+
+/* Arguments of a size calculation worker. */
+typedef struct
+{
+	size_state_t *state; /* Shared state. */
+	int id;              /* Index of worker's deque. */
+}
+size_worker_t;
+
 static int delete_file(dir_entry_t *entry, ops_t *ops, int reg, int use_trash,
 		int nested);
 static const char * get_top_dir(const view_t *view);
@@ -72,6 +135,25 @@ static void update_dir_entry_size(const view_t *view, int index, int force);
 static void start_dir_size_calc(const char path[], int force);
 static void dir_size_bg(bg_op_t *bg_op, void *arg);
 static void dir_size(bg_op_t *bg_op, char path[], int force);
+static uint64_t calc_dir_size(const char path[], int force,
+		const cancellation_t *cancellation, bg_op_t *bg_op);
+static uint64_t seq_dir_size(const char path[], int force_update,
+		const cancellation_t *cancellation);
+static uint64_t par_dir_size(const char path[], int force, int nworkers,
+		const cancellation_t *cancellation, bg_op_t *bg_op);
+static void wait_for_size_calc(size_state_t *state, const char path[],
+		const cancellation_t *cancellation, bg_op_t *bg_op);
+static void * size_worker_main(void *arg);
+static size_node_t * take_size_node(size_state_t *state, int id);
+static void scan_size_node(size_state_t *state, int id, size_node_t *node);
+static int queue_subdir(size_state_t *state, int id, size_node_t *parent,
+		const char path[]);
+static void finish_size_part(size_state_t *state, size_node_t *node,
+		uint64_t size);
+static int size_calc_cancelled(size_state_t *state);
+static int deque_push(size_deque_t *deque, size_node_t *node);
+static size_node_t * deque_pop(size_deque_t *deque);
+static size_node_t * deque_steal(size_deque_t *deque);
 static int bg_cancellation_hook(void *arg);
 static void redraw_after_path_change(view_t *view, const char path[]);
 #ifndef _WIN32
@@ -373,8 +455,8 @@ fops_delete_bg(view_t *view, int use_trash)
 	args->ops = fops_get_bg_ops(use_trash ? OP_REMOVE : OP_REMOVESL,
 			use_trash ? "deleting" : "Deleting", args->path);
 
-	if(bg_execute(task_desc, "...", args->sel_list_len, 1, &delete_files_in_bg,
-				args) != 0)
+	if(bg_execute(task_desc, "...", args->sel_list_len, BJC_BULK_IO,
+				args->path, &delete_files_in_bg, args) != 0)
 	{
 		fops_free_bg_args(args);
 
@@ -1125,8 +1207,8 @@ start_dir_size_calc(const char path[], int force)
 
 	snprintf(task_desc, sizeof(task_desc), "Calculating size: %s", path);
 
-	if(bg_execute(task_desc, path, BG_UNDEFINED_TOTAL, 0, &dir_size_bg,
-				args) != 0)
+	if(bg_execute(task_desc, path, BG_UNDEFINED_TOTAL, BJC_SIZE_CALC, path,
+				&dir_size_bg, args) != 0)
 	{
 		free(args->path);
 		free(args);
@@ -1158,7 +1240,7 @@ dir_size(bg_op_t *bg_op, char path[], int force)
 		.hook = &bg_cancellation_hook,
 	};
 
-	(void)fops_dir_size(path, force, &bg_cancellation_info);
+	(void)calc_dir_size(path, force, &bg_cancellation_info, bg_op);
 
 	remove_last_path_component(path);
 
@@ -1186,6 +1268,30 @@ redraw_after_path_change(view_t *view, const char path[])
 uint64_t
 fops_dir_size(const char path[], int force_update,
 		const cancellation_t *cancellation)
+{
+	return calc_dir_size(path, force_update, cancellation, NULL);
+}
+
+/* Calculates size of a directory sequentially or in parallel depending on
+ * configuration.  bg_op can be NULL, otherwise it's used to report partial
+ * results.  Returns size of a directory or zero on error. */
+static uint64_t
+calc_dir_size(const char path[], int force, const cancellation_t *cancellation,
+		bg_op_t *bg_op)
+{
+	const int nthreads = cfg_read_threads();
+	if(nthreads > 1)
+	{
+		return par_dir_size(path, force, nthreads, cancellation, bg_op);
+	}
+	return seq_dir_size(path, force, cancellation);
+}
+
+/* Calculates size of a directory recursively on the calling thread.  Returns
+ * size of a directory or zero on error. */
+static uint64_t
+seq_dir_size(const char path[], int force_update,
+		const cancellation_t *cancellation)
 {
 	struct dirent *dentry;
 	const char *slash;
@@ -1216,7 +1322,7 @@ fops_dir_size(const char path[], int force_update,
 			dcache_get_at(full_path, &dir_size, NULL);
 			if(dir_size == DCACHE_UNKNOWN || force_update)
 			{
-				dir_size = fops_dir_size(full_path, force_update, cancellation);
+				dir_size = seq_dir_size(full_path, force_update, cancellation);
 			}
 			size += dir_size;
 		}
@@ -1238,6 +1344,460 @@ fops_dir_size(const char path[], int force_update,
 	return size;
 }
 
+/* Calculates size of a directory by distributing its subdirectories among a
+ * pool of workers which steal work from each other.  Sizes are stored in the
+ * dcache bottom-up as soon as a subtree is done.  Cancellation is checked on
+ * the calling thread.  Returns size of a directory or zero on error. */
+static uint64_t
+par_dir_size(const char path[], int force, int nworkers,
+		const cancellation_t *cancellation, bg_op_t *bg_op)
+{
+	pthread_t *threads;
+	size_worker_t *workers;
+	size_deque_t *deques;
+	size_node_t *root;
+	int nthreads;
+	int i;
+
+	size_state_t state = {
+		.force = force,
+		.nworkers = nworkers,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.has_work = PTHREAD_COND_INITIALIZER,
+		.finished = PTHREAD_COND_INITIALIZER,
+	};
+
+	threads = reallocarray(NULL, nworkers, sizeof(*threads));
+	workers = reallocarray(NULL, nworkers, sizeof(*workers));
+	deques = reallocarray(NULL, nworkers, sizeof(*deques));
+	root = calloc(1, sizeof(*root));
+	if(threads == NULL || workers == NULL || deques == NULL || root == NULL ||
+			(root->path = strdup(path)) == NULL)
+	{
+		free(threads);
+		free(workers);
+		free(deques);
+		free(root);
+		return seq_dir_size(path, force, cancellation);
+	}
+	state.deques = deques;
+	root->pending = 1;
+
+	for(i = 0; i < nworkers; ++i)
+	{
+		const size_deque_t empty = { .lock = PTHREAD_MUTEX_INITIALIZER };
+		deques[i] = empty;
+	}
+
+	if(deque_push(&deques[0], root) != 0)
+	{
+		free(threads);
+		free(workers);
+		free(deques);
+		free(root->path);
+		free(root);
+		return seq_dir_size(path, force, cancellation);
+	}
+	state.queued = 1;
+
+	for(nthreads = 0; nthreads < nworkers; ++nthreads)
+	{
+		workers[nthreads].state = &state;
+		workers[nthreads].id = nthreads;
+		if(pthread_create(&threads[nthreads], NULL, &size_worker_main,
+					&workers[nthreads]) != 0)
+		{
+			break;
+		}
+	}
+
+	if(nthreads == 0)
+	{
+		/* Process everything on this thread. */
+		size_worker_t self = { .state = &state, .id = 0 };
+		state.stop = 1;
+		(void)size_worker_main(&self);
+	}
+	else
+	{
+		wait_for_size_calc(&state, path, cancellation, bg_op);
+	}
+
+	pthread_mutex_lock(&state.lock);
+	state.stop = 1;
+	pthread_cond_broadcast(&state.has_work);
+	pthread_mutex_unlock(&state.lock);
+
+	for(i = 0; i < nthreads; ++i)
+	{
+		(void)pthread_join(threads[i], NULL);
+	}
+
+	for(i = 0; i < nworkers; ++i)
+	{
+		free(deques[i].items);
+		pthread_mutex_destroy(&deques[i].lock);
+	}
+	free(threads);
+	free(workers);
+	free(deques);
+	pthread_cond_destroy(&state.finished);
+	pthread_cond_destroy(&state.has_work);
+	pthread_mutex_destroy(&state.lock);
+
+	return (state.cancelled ? 0U : state.size);
+}
+
+/* Waits for parallel size calculation to finish while checking for
+ * cancellation and reporting partial results. */
+static void
+wait_for_size_calc(size_state_t *state, const char path[],
+		const cancellation_t *cancellation, bg_op_t *bg_op)
+{
+	pthread_mutex_lock(&state->lock);
+	while(!state->done)
+	{
+		struct timeval tv;
+		struct timespec deadline;
+
+		gettimeofday(&tv, NULL);
+		deadline.tv_sec = tv.tv_sec;
+		deadline.tv_nsec = (tv.tv_usec + SIZE_PROGRESS_PERIOD_MS*1000L)*1000L;
+		deadline.tv_sec += deadline.tv_nsec/1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+
+		if(pthread_cond_timedwait(&state->finished, &state->lock,
+					&deadline) != ETIMEDOUT || state->done)
+		{
+			continue;
+		}
+
+		if(!state->cancelled)
+		{
+			const uint64_t partial = state->partial;
+			int cancelled;
+
+			pthread_mutex_unlock(&state->lock);
+
+			if(bg_op != NULL)
+			{
+				char size_str[64];
+				char descr[PATH_MAX + 128];
+				(void)friendly_size_notation(partial, sizeof(size_str), size_str);
+				snprintf(descr, sizeof(descr), "%s (%s so far)", path, size_str);
+				bg_op_set_descr(bg_op, descr);
+			}
+			cancelled = cancellation_requested(cancellation);
+
+			pthread_mutex_lock(&state->lock);
+			if(cancelled)
+			{
+				/* Workers will drain queues without doing anything. */
+				state->cancelled = 1;
+			}
+		}
+	}
+	pthread_mutex_unlock(&state->lock);
+}
+
+/* Entry point of a worker of parallel size calculation.  Returns NULL. */
+static void *
+size_worker_main(void *arg)
+{
+	size_worker_t *const worker = arg;
+	size_state_t *const state = worker->state;
+
+	while(1)
+	{
+		size_node_t *const node = take_size_node(state, worker->id);
+		if(node == NULL)
+		{
+			break;
+		}
+
+		scan_size_node(state, worker->id, node);
+	}
+
+	return NULL;
+}
+
+/* Picks next directory to process from own deque or from deque of another
+ * worker.  Blocks until a directory is available.  Returns the directory or
+ * NULL if worker should quit. */
+static size_node_t *
+take_size_node(size_state_t *state, int id)
+{
+	while(1)
+	{
+		size_node_t *node;
+		int i;
+
+		node = deque_pop(&state->deques[id]);
+		for(i = 1; i < state->nworkers && node == NULL; ++i)
+		{
+			node = deque_steal(&state->deques[(id + i)%state->nworkers]);
+		}
+
+		pthread_mutex_lock(&state->lock);
+		if(node != NULL)
+		{
+			--state->queued;
+			pthread_mutex_unlock(&state->lock);
+			return node;
+		}
+
+		while(state->queued == 0 && !state->stop && !state->done)
+		{
+			pthread_cond_wait(&state->has_work, &state->lock);
+		}
+
+		if(state->queued == 0)
+		{
+			pthread_mutex_unlock(&state->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&state->lock);
+	}
+}
+
+/* Sums up sizes of files of a directory and queues its subdirectories with
+ * unknown size for processing. */
+static void
+scan_size_node(size_state_t *state, int id, size_node_t *node)
+{
+	struct dirent *dentry;
+	const char *slash;
+	uint64_t size;
+	int nentries;
+	DIR *dir;
+
+	if(size_calc_cancelled(state) || (dir = os_opendir(node->path)) == NULL)
+	{
+		node->failed = 1;
+		finish_size_part(state, node, 0U);
+		return;
+	}
+
+	slash = (ends_with_slash(node->path) ? "" : "/");
+	size = 0U;
+	nentries = 0;
+	while((dentry = os_readdir(dir)) != NULL)
+	{
+		char full_path[PATH_MAX + 1];
+
+		if(is_builtin_dir(dentry->d_name))
+		{
+			continue;
+		}
+
+		snprintf(full_path, sizeof(full_path), "%s%s%s", node->path, slash,
+				dentry->d_name);
+		if(fops_is_dir_entry(full_path, dentry))
+		{
+			uint64_t dir_size = DCACHE_UNKNOWN;
+			if(!state->force)
+			{
+				dcache_get_at(full_path, &dir_size, NULL);
+			}
+			if(dir_size != DCACHE_UNKNOWN)
+			{
+				size += dir_size;
+			}
+			else if(queue_subdir(state, id, node, full_path) != 0)
+			{
+				node->failed = 1;
+			}
+		}
+		else
+		{
+			size += get_file_size(full_path);
+		}
+
+		/* Cancellation flag is shared, so don't check it too often. */
+		if(++nentries%64 == 0 && size_calc_cancelled(state))
+		{
+			node->failed = 1;
+			break;
+		}
+	}
+
+	os_closedir(dir);
+
+	finish_size_part(state, node, size);
+}
+
+/* Adds subdirectory to the deque of the worker.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+queue_subdir(size_state_t *state, int id, size_node_t *parent,
+		const char path[])
+{
+	size_node_t *const node = calloc(1, sizeof(*node));
+	if(node == NULL || (node->path = strdup(path)) == NULL)
+	{
+		free(node);
+		return 1;
+	}
+	node->parent = parent;
+	node->pending = 1;
+
+	pthread_mutex_lock(&state->lock);
+	++parent->pending;
+	pthread_mutex_unlock(&state->lock);
+
+	if(deque_push(&state->deques[id], node) != 0)
+	{
+		free(node->path);
+		free(node);
+
+		pthread_mutex_lock(&state->lock);
+		--parent->pending;
+		pthread_mutex_unlock(&state->lock);
+		return 1;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	++state->queued;
+	pthread_cond_signal(&state->has_work);
+	pthread_mutex_unlock(&state->lock);
+	return 0;
+}
+
+/* Accounts size of a processed part of the node and propagates sizes of
+ * directories that became complete to their parents. */
+static void
+finish_size_part(size_state_t *state, size_node_t *node, uint64_t size)
+{
+	int complete;
+
+	pthread_mutex_lock(&state->lock);
+	state->partial += size;
+	node->size += size;
+	complete = (--node->pending == 0);
+	pthread_mutex_unlock(&state->lock);
+
+	/* Complete node isn't referenced by anyone else, so it can be accessed
+	 * without locking. */
+	while(complete)
+	{
+		size_node_t *const parent = node->parent;
+
+		/* Size of a partially processed directory is of no use. */
+		if(!node->failed && !size_calc_cancelled(state))
+		{
+			(void)dcache_set_at(node->path, node->size, DCACHE_UNKNOWN);
+		}
+
+		pthread_mutex_lock(&state->lock);
+		if(parent == NULL)
+		{
+			state->size = node->size;
+			state->done = 1;
+			pthread_cond_signal(&state->finished);
+			pthread_cond_broadcast(&state->has_work);
+			complete = 0;
+		}
+		else
+		{
+			parent->size += node->size;
+			parent->failed |= node->failed;
+			complete = (--parent->pending == 0);
+		}
+		pthread_mutex_unlock(&state->lock);
+
+		free(node->path);
+		free(node);
+		node = parent;
+	}
+}
+
+/* Checks whether calculation was cancelled.  Returns non-zero if so, otherwise
+ * zero is returned. */
+static int
+size_calc_cancelled(size_state_t *state)
+{
+	int cancelled;
+	pthread_mutex_lock(&state->lock);
+	cancelled = state->cancelled;
+	pthread_mutex_unlock(&state->lock);
+	return cancelled;
+}
+
+/* Appends node to the tail of the deque.  Returns zero on success, otherwise
+ * non-zero is returned. */
+static int
+deque_push(size_deque_t *deque, size_node_t *node)
+{
+	pthread_mutex_lock(&deque->lock);
+
+	if(deque->count == deque->capacity)
+	{
+		const int new_capacity = (deque->capacity == 0 ? 16 : deque->capacity*2);
+		size_node_t **const items = reallocarray(NULL, new_capacity,
+				sizeof(*items));
+		int i;
+
+		if(items == NULL)
+		{
+			pthread_mutex_unlock(&deque->lock);
+			return 1;
+		}
+
+		for(i = 0; i < deque->count; ++i)
+		{
+			items[i] = deque->items[(deque->head + i)%deque->capacity];
+		}
+		free(deque->items);
+		deque->items = items;
+		deque->head = 0;
+		deque->capacity = new_capacity;
+	}
+
+	deque->items[(deque->head + deque->count)%deque->capacity] = node;
+	++deque->count;
+
+	pthread_mutex_unlock(&deque->lock);
+	return 0;
+}
+
+/* Removes node from the tail of the deque, which is the most recently added
+ * one.  Returns the node or NULL if deque is empty. */
+static size_node_t *
+deque_pop(size_deque_t *deque)
+{
+	size_node_t *node = NULL;
+
+	pthread_mutex_lock(&deque->lock);
+	if(deque->count != 0)
+	{
+		--deque->count;
+		node = deque->items[(deque->head + deque->count)%deque->capacity];
+	}
+	pthread_mutex_unlock(&deque->lock);
+
+	return node;
+}
+
+/* Removes node from the head of the deque, which is the oldest one and thus
+ * likely represents the largest amount of work.  Returns the node or NULL if
+ * deque is empty. */
+static size_node_t *
+deque_steal(size_deque_t *deque)
+{
+	size_node_t *node = NULL;
+
+	pthread_mutex_lock(&deque->lock);
+	if(deque->count != 0)
+	{
+		node = deque->items[deque->head];
+		deque->head = (deque->head + 1)%deque->capacity;
+		--deque->count;
+	}
+	pthread_mutex_unlock(&deque->lock);
+
+	return node;
+}
+
 #ifndef _WIN32
 
 int
@@ -28,20 +28,81 @@
 #include <magic.h>
 #endif
 
-#include <stddef.h> /* size_t */
-#include <stdlib.h> /* free() */
+#include <sys/stat.h> /* stat */
+
+#include <stddef.h> /* NULL offsetof() size_t */
+#include <stdint.h> /* int64_t uint32_t uint64_t */
+#include <stdlib.h> /* calloc() free() malloc() */
 #include <stdio.h> /* popen() */
-#include <string.h> /* strdup() */
+#include <string.h> /* memcmp() memset() strcmp() strdup() */
 
+#include "../cfg/config.h"
+#include "../compat/os.h"
+#include "../compat/pthread.h"
 #include "../utils/fs.h"
+#include "../utils/macros.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
 #include "../filetype.h"
 #include "../status.h"
 #include "desktop.h"
 
+/* Key of a cache entry, which identifies a particular version of a file. */
+typedef struct
+{
+	uint64_t dev;       /* Device of the file. */
+	uint64_t inode;     /* Inode number of the file. */
+	uint64_t size;      /* Size of the file. */
+	int64_t mtime_sec;  /* Modification time of the file. */
+	int64_t mtime_nsec; /* Nanosecond part of modification time if available. */
+	/* Whether the file is a symbolic link to the file described above.  Type of
+	 * a link can be reported differently from type of its target. */
+	uint64_t link;
+	/* Name of the file if its type can be guessed by name, otherwise NULL.  Not
+	 * owned by keys of lookups, but owned by keys of entries. */
+	char *name;
+}
+mime_key_t;
+
+/* Entry of mime-type cache. */
+typedef struct mime_entry_t
+{
+	mime_key_t key;                 /* Identity of the file. */
+	char *mimetype;                 /* Mime-type of the file. */
+	struct mime_entry_t *hash_next; /* Next entry in the same bucket. */
+	struct mime_entry_t *prev;      /* More recently used entry. */
+	struct mime_entry_t *next;      /* Less recently used entry. */
+}
+mime_entry_t;
+
 static assoc_records_t handlers;
 
+/* Guards mime-type cache and its statistics. */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Hash table of cached entries, number of buckets is a power of two. */
+static mime_entry_t **cache_buckets;
+/* Number of buckets in the hash table. */
+static int cache_nbuckets;
+/* Most recently used entry. */
+static mime_entry_t *cache_head;
+/* Least recently used entry. */
+static mime_entry_t *cache_tail;
+/* Statistics of the cache. */
+static mime_cache_stats_t cache_stats;
+
+static const char * query_mimetype(const char file[], char buf[],
+		size_t buf_sz);
+static int make_key(const char file[], mime_key_t *key);
+static int type_depends_on_name(void);
+static int cache_lookup(const mime_key_t *key, char buf[], size_t buf_sz);
+static void cache_store(const mime_key_t *key, const char mimetype[]);
+static int cache_grow(void);
+static void cache_trim(int limit);
+static void cache_unlink(mime_entry_t *entry);
+static void cache_push_front(mime_entry_t *entry);
+static mime_entry_t ** find_slot(const mime_key_t *key);
+static int keys_equal(const mime_key_t *a, const mime_key_t *b);
+static uint32_t hash_key(const mime_key_t *key);
 static int get_gtk_mimetype(const char filename[], char buf[], size_t buf_sz);
 static int get_magic_mimetype(const char filename[], char buf[], size_t buf_sz);
 static int get_file_mimetype(const char filename[], char buf[], size_t buf_sz);
@@ -80,18 +141,324 @@ get_mimetype(const char file[], int resolve_symlinks)
 		free(symlink_base);
 	}
 
-	if(get_gtk_mimetype(file, mimetype, sizeof(mimetype)) == -1)
+	return query_mimetype(file, mimetype, sizeof(mimetype));
+}
+
+/* Retrieves mime-type of a file from the cache or by probing it.  Returns buf
+ * on success and NULL on failure. */
+static const char *
+query_mimetype(const char file[], char buf[], size_t buf_sz)
+{
+	mime_key_t key;
+	/* Without inode number file can't be reliably identified. */
+	const int cacheable = (cfg.mime_cache_size > 0 && make_key(file, &key) == 0
+	                    && key.inode != 0U);
+
+	if(cacheable && cache_lookup(&key, buf, buf_sz) == 0)
+	{
+		return buf;
+	}
+
+	if(get_gtk_mimetype(file, buf, buf_sz) == -1)
 	{
-		if(get_magic_mimetype(file, mimetype, sizeof(mimetype)) == -1)
+		if(get_magic_mimetype(file, buf, buf_sz) == -1)
 		{
-			if(get_file_mimetype(file, mimetype, sizeof(mimetype)) == -1)
+			if(get_file_mimetype(file, buf, buf_sz) == -1)
 			{
 				return NULL;
 			}
 		}
 	}
 
-	return mimetype;
+	if(cacheable)
+	{
+		cache_store(&key, buf);
+	}
+	return buf;
+}
+
+/* Fills cache key for the file.  Identity of symbolic link is that of its
+ * target, but links and targets get distinct keys.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+make_key(const char file[], mime_key_t *key)
+{
+	struct stat st;
+	if(os_stat(file, &st) != 0)
+	{
+		return 1;
+	}
+
+	memset(key, 0, sizeof(*key));
+	key->dev = st.st_dev;
+	key->inode = st.st_ino;
+	key->size = st.st_size;
+	key->mtime_sec = st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+	key->mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+	key->link = is_symlink(file);
+	key->name = type_depends_on_name() ? get_last_path_component(file) : NULL;
+	return 0;
+}
+
+/* Checks whether mime-type of a file can depend on its name (GTK+ guesses type
+ * by name, so renamed file can have a different type).  Returns non-zero if
+ * so, otherwise zero is returned. */
+static int
+type_depends_on_name(void)
+{
+#ifdef HAVE_LIBGTK
+	return curr_stats.gtk_available;
+#else
+	return 0;
+#endif
+}
+
+/* Looks up mime-type in the cache and marks the entry as the most recently
+ * used one.  Returns zero and fills buf on success, otherwise non-zero is
+ * returned. */
+static int
+cache_lookup(const mime_key_t *key, char buf[], size_t buf_sz)
+{
+	mime_entry_t *entry;
+
+	pthread_mutex_lock(&cache_lock);
+	entry = (cache_nbuckets == 0 ? NULL : *find_slot(key));
+	if(entry == NULL)
+	{
+		++cache_stats.misses;
+		pthread_mutex_unlock(&cache_lock);
+		return 1;
+	}
+
+	++cache_stats.hits;
+	cache_unlink(entry);
+	cache_push_front(entry);
+	copy_str(buf, buf_sz, entry->mimetype);
+	pthread_mutex_unlock(&cache_lock);
+	return 0;
+}
+
+/* Adds mime-type to the cache evicting least recently used entries if the
+ * cache is full. */
+static void
+cache_store(const mime_key_t *key, const char mimetype[])
+{
+	mime_entry_t **slot;
+	mime_entry_t *entry;
+
+	pthread_mutex_lock(&cache_lock);
+
+	/* Keep number of entries not greater than number of buckets. */
+	if(cache_stats.size >= cache_nbuckets && cache_grow() != 0)
+	{
+		pthread_mutex_unlock(&cache_lock);
+		return;
+	}
+
+	slot = find_slot(key);
+	if(*slot != NULL)
+	{
+		/* Another thread has already added it. */
+		pthread_mutex_unlock(&cache_lock);
+		return;
+	}
+
+	entry = malloc(sizeof(*entry));
+	if(entry == NULL || (entry->mimetype = strdup(mimetype)) == NULL)
+	{
+		free(entry);
+		pthread_mutex_unlock(&cache_lock);
+		return;
+	}
+
+	entry->key = *key;
+	if(key->name != NULL && (entry->key.name = strdup(key->name)) == NULL)
+	{
+		free(entry->mimetype);
+		free(entry);
+		pthread_mutex_unlock(&cache_lock);
+		return;
+	}
+	entry->hash_next = NULL;
+	*slot = entry;
+	cache_push_front(entry);
+	++cache_stats.size;
+
+	cache_trim(cfg.mime_cache_size);
+
+	pthread_mutex_unlock(&cache_lock);
+}
+
+/* Doubles number of buckets of the hash table.  Should be called with
+ * cache_lock held.  Returns zero on success, otherwise non-zero is returned. */
+static int
+cache_grow(void)
+{
+	const int new_nbuckets = (cache_nbuckets == 0 ? 64 : cache_nbuckets*2);
+	mime_entry_t **const new_buckets = calloc(new_nbuckets,
+			sizeof(*new_buckets));
+	mime_entry_t *entry;
+
+	if(new_buckets == NULL)
+	{
+		return 1;
+	}
+
+	free(cache_buckets);
+	cache_buckets = new_buckets;
+	cache_nbuckets = new_nbuckets;
+
+	for(entry = cache_head; entry != NULL; entry = entry->next)
+	{
+		mime_entry_t **const slot = &cache_buckets[hash_key(&entry->key) &
+			(cache_nbuckets - 1)];
+		entry->hash_next = *slot;
+		*slot = entry;
+	}
+	return 0;
+}
+
+/* Evicts least recently used entries until there are at most limit of them.
+ * Should be called with cache_lock held. */
+static void
+cache_trim(int limit)
+{
+	while(cache_stats.size > limit)
+	{
+		mime_entry_t *const entry = cache_tail;
+		mime_entry_t **slot = find_slot(&entry->key);
+		*slot = entry->hash_next;
+
+		cache_unlink(entry);
+		free(entry->key.name);
+		free(entry->mimetype);
+		free(entry);
+		--cache_stats.size;
+		++cache_stats.evictions;
+	}
+}
+
+/* Removes entry from the list of entries ordered by use. */
+static void
+cache_unlink(mime_entry_t *entry)
+{
+	if(entry->prev == NULL)
+	{
+		cache_head = entry->next;
+	}
+	else
+	{
+		entry->prev->next = entry->next;
+	}
+
+	if(entry->next == NULL)
+	{
+		cache_tail = entry->prev;
+	}
+	else
+	{
+		entry->next->prev = entry->prev;
+	}
+}
+
+/* Makes entry the most recently used one. */
+static void
+cache_push_front(mime_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache_head;
+	if(cache_head == NULL)
+	{
+		cache_tail = entry;
+	}
+	else
+	{
+		cache_head->prev = entry;
+	}
+	cache_head = entry;
+}
+
+/* Finds place in the hash table where entry with the key is or should be.
+ * Should be called with cache_lock held and non-empty table.  Returns pointer
+ * to the pointer to the entry, which is NULL if there is no such entry. */
+static mime_entry_t **
+find_slot(const mime_key_t *key)
+{
+	mime_entry_t **slot = &cache_buckets[hash_key(key) & (cache_nbuckets - 1)];
+	while(*slot != NULL && !keys_equal(&(*slot)->key, key))
+	{
+		slot = &(*slot)->hash_next;
+	}
+	return slot;
+}
+
+/* Compares two cache keys.  Returns non-zero if they are equal, otherwise zero
+ * is returned. */
+static int
+keys_equal(const mime_key_t *a, const mime_key_t *b)
+{
+	if(memcmp(a, b, offsetof(mime_key_t, name)) != 0)
+	{
+		return 0;
+	}
+	if(a->name == NULL || b->name == NULL)
+	{
+		return (a->name == b->name);
+	}
+	return (strcmp(a->name, b->name) == 0);
+}
+
+/* Computes hash of a cache key.  Returns the hash. */
+static uint32_t
+hash_key(const mime_key_t *key)
+{
+	/* FNV-1a. */
+	const unsigned char *const bytes = (const unsigned char *)key;
+	uint32_t hash = 2166136261U;
+	size_t i;
+	for(i = 0U; i < offsetof(mime_key_t, name); ++i)
+	{
+		hash = (hash ^ bytes[i])*16777619U;
+	}
+	if(key->name != NULL)
+	{
+		const unsigned char *name = (const unsigned char *)key->name;
+		while(*name != '\0')
+		{
+			hash = (hash ^ *name++)*16777619U;
+		}
+	}
+	return hash;
+}
+
+void
+mimetype_cache_resize(int limit)
+{
+	pthread_mutex_lock(&cache_lock);
+	cache_trim(MAX(limit, 0));
+	pthread_mutex_unlock(&cache_lock);
+}
+
+void
+mimetype_cache_get_stats(mime_cache_stats_t *stats)
+{
+	pthread_mutex_lock(&cache_lock);
+	*stats = cache_stats;
+	pthread_mutex_unlock(&cache_lock);
+}
+
+void
+mimetype_cache_reset(void)
+{
+	pthread_mutex_lock(&cache_lock);
+	cache_trim(0);
+	free(cache_buckets);
+	cache_buckets = NULL;
+	cache_nbuckets = 0;
+	cache_stats = (mime_cache_stats_t){};
+	pthread_mutex_unlock(&cache_lock);
 }
 
 static int
@@ -21,15 +21,38 @@
 
 #include "../filetype.h"
 
+/* Statistics of mime-type cache. */
+typedef struct
+{
+	unsigned long long hits;      /* Lookups that were served by the cache. */
+	unsigned long long misses;    /* Lookups that required probing a file. */
+	unsigned long long evictions; /* Entries dropped to keep cache in limits. */
+	int size;                     /* Current number of entries. */
+}
+mime_cache_stats_t;
+
 /* Retrieves mime type of the file specified by its path.  The resolve_symlinks
  * argument controls whether mime-type of the link should be that of its target.
- * Returns pointer to a statically allocated buffer. */
+ * Results are cached by identity of a file (device, inode, size, modification
+ * time and also name if type can be guessed by it) with the number of entries
+ * limited by 'mimecachesize'.  Returns pointer to a statically allocated
+ * buffer. */
 const char * get_mimetype(const char file[], int resolve_symlinks);
 
 /* Retrieves system-wide desktop file associations.  Caller shouldn't free
  * anything. */
 assoc_records_t get_magic_handlers(const char file[]);
 
+/* Evicts least recently used entries of mime-type cache to make it contain at
+ * most limit entries. */
+void mimetype_cache_resize(int limit);
+
+/* Retrieves statistics of mime-type cache. */
+void mimetype_cache_get_stats(mime_cache_stats_t *stats);
+
+/* Empties mime-type cache and resets its statistics. */
+void mimetype_cache_reset(void);
+
 #endif /* VIFM__INT__FILE_MAGIC_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
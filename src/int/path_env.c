@@ -19,8 +19,9 @@
 #include "path_env.h"
 
 #include <stdio.h> /* snprintf() sprintf() */
-#include <stdlib.h> /* malloc() free() */
+#include <stdlib.h> /* calloc() malloc() free() */
 #include <string.h> /* strchr() strlen() */
+#include <time.h> /* time_t time() */
 
 #include "../cfg/config.h"
 #include "../compat/dtype.h"
@@ -29,6 +30,7 @@
 #include "../compat/reallocarray.h"
 #include "../engine/variables.h"
 #include "../utils/env.h"
+#include "../utils/filemon.h"
 #include "../utils/fs.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
@@ -39,10 +41,26 @@ static void append_scripts_dirs(void);
 static void add_dirs_to_path(const char *path);
 static void add_to_path(const char *path);
 static void split_path_list(void);
+static void free_indexes(void);
+static const struct path_index_t * get_index(size_t idx);
+
+/* Cached list of entries of a directory from PATH. */
+typedef struct path_index_t
+{
+	char **names;   /* Names of directory entries sorted by stroscmp(). */
+	int count;      /* Number of elements in the names array. */
+	filemon_t mon;  /* Timestamp of the directory at the moment of reading. */
+	time_t checked; /* When the timestamp was compared with the directory. */
+	int loaded;     /* Whether the names are valid. */
+}
+path_index_t;
 
 static char **paths;
 static int paths_count;
 
+/* Indexes of directories from paths array, NULL if there are none. */
+static path_index_t *indexes;
+
 static char *clean_path;
 static char *real_path;
 
@@ -161,6 +179,8 @@ split_path_list(void)
 
 	path = env_get_def("PATH", "");
 
+	free_indexes();
+
 	if(paths != NULL)
 		free_string_array(paths, paths_count);
 
@@ -235,6 +255,146 @@ split_path_list(void)
 	}
 	while(q[0] != '\0');
 	paths_count = i;
+
+	indexes = calloc(paths_count, sizeof(*indexes));
+}
+
+/* Frees indexes of current list of paths. */
+static void
+free_indexes(void)
+{
+	int i;
+
+	if(indexes == NULL)
+	{
+		return;
+	}
+
+	for(i = 0; i < paths_count; ++i)
+	{
+		free_string_array(indexes[i].names, indexes[i].count);
+	}
+	free(indexes);
+	indexes = NULL;
+}
+
+int
+list_path_entries(size_t idx, const char prefix[], char ***names, int *count)
+{
+	const size_t prefix_len = strlen(prefix);
+	int lo, hi;
+
+	const path_index_t *const index = get_index(idx);
+	if(index == NULL)
+	{
+		return 1;
+	}
+
+	/* Names with the same prefix form a range in sorted array. */
+	lo = 0;
+	hi = index->count;
+	while(lo < hi)
+	{
+		const int mid = lo + (hi - lo)/2;
+		if(stroscmp(index->names[mid], prefix) < 0)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	hi = lo;
+	while(hi < index->count &&
+			strnoscmp(index->names[hi], prefix, prefix_len) == 0)
+	{
+		++hi;
+	}
+
+	*names = index->names + lo;
+	*count = hi - lo;
+	return 0;
+}
+
+int
+may_contain_executable(size_t idx, const char name[])
+{
+	const size_t name_len = strlen(name);
+	char **names;
+	int count;
+	int i;
+
+	if(list_path_entries(idx, name, &names, &count) != 0)
+	{
+		return 1;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		const char *const tail = names[i] + name_len;
+		if(tail[0] == '\0')
+		{
+			return 1;
+		}
+#ifdef _WIN32
+		/* Name might be completed with one of extensions from $PATHEXT. */
+		if(tail[0] == '.' && strchr(name, '.') == NULL)
+		{
+			return 1;
+		}
+#endif
+	}
+	return 0;
+}
+
+/* Retrieves up-to-date index of a directory from PATH.  Directories are reread
+ * on change of their modification time, which is checked at most once a
+ * second.  Returns the index or NULL if there is none. */
+static const path_index_t *
+get_index(size_t idx)
+{
+	const time_t now = time(NULL);
+	path_index_t *index;
+	filemon_t mon;
+
+	/* Relative paths depend on current directory and can't be cached. */
+	if(indexes == NULL || idx >= (size_t)paths_count ||
+			!is_path_absolute(paths[idx]))
+	{
+		return NULL;
+	}
+
+	index = &indexes[idx];
+	if(index->loaded && index->checked == now)
+	{
+		return index;
+	}
+	index->checked = now;
+
+	if(filemon_from_file(paths[idx], FMT_MODIFIED, &mon) != 0)
+	{
+		return NULL;
+	}
+
+	if(index->loaded && filemon_equal(&index->mon, &mon))
+	{
+		return index;
+	}
+
+	free_string_array(index->names, index->count);
+	index->names = list_sorted_files(paths[idx], &index->count);
+	index->loaded = (index->count >= 0);
+	if(!index->loaded)
+	{
+		index->names = NULL;
+		index->count = 0;
+		return NULL;
+	}
+
+	filemon_assign(&index->mon, &mon);
+	return index;
 }
 
 void
@@ -29,6 +29,20 @@ void update_path_env(int force);
  * the count argument. */
 char ** get_paths(size_t *count);
 
+/* Retrieves cached names of entries of the directory at index idx in the list
+ * returned by get_paths() that start with the prefix.  Cache is reset when PATH
+ * changes and a directory is reread when its modification time changes.  On
+ * success, *names points to sorted list owned by the cache and *count is set
+ * to its length.  Returns non-zero if directory isn't cached (e.g., it's
+ * relative). */
+int list_path_entries(size_t idx, const char prefix[], char ***names,
+		int *count);
+
+/* Checks using cache of list_path_entries() whether the directory at index idx
+ * in the list returned by get_paths() can have an executable with the name.
+ * Returns non-zero if so, in which case caller needs to check the file. */
+int may_contain_executable(size_t idx, const char name[]);
+
 /* Sets PATH to its value that was set by user or another program. Use
  * load_real_path_env() function to revert this effect. */
 void load_clean_path_env(void);
@@ -114,6 +114,14 @@ struct io_args_t
 	}
 	arg4;
 
+	union
+	{
+		/* Maximum number of files processed concurrently by recursive operations
+		 * (values less than two mean sequential processing). */
+		int max_jobs;
+	}
+	arg5;
+
 	/* Provides means for cancellation checking. */
 	io_cancellation_t cancellation;
 
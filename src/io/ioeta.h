@@ -68,6 +68,11 @@ typedef struct ioeta_estim_t
 
 	/* Provides means for cancellation checking. */
 	io_cancellation_t cancellation;
+
+	/* Estimation that accumulates changes of this one, which happens for items
+	 * that are processed concurrently.  Such estimations don't notify about
+	 * progress on their own, it's done via ioeta_report() on the parent. */
+	struct ioeta_estim_t *parent;
 }
 ioeta_estim_t;
 
@@ -25,15 +25,22 @@
 #include "iop.h"
 
 #ifndef _WIN32
-#include <sys/ioctl.h> /* ioctl() */
+#include <sys/ioctl.h> /* _IOW ioctl() */
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h> /* sendfile() */
+#include <sys/syscall.h> /* SYS_copy_file_range */
 #endif
 #include <sys/stat.h> /* stat */
-#include <sys/types.h> /* mode_t */
-#include <unistd.h> /* rmdir() symlink() unlink() */
+#include <sys/types.h> /* mode_t off_t ssize_t */
+#include <unistd.h> /* SEEK_DATA SEEK_HOLE ftruncate() lseek() read() rmdir()
+                       symlink() syscall() unlink() write() */
 
 #include <assert.h> /* assert() */
-#include <errno.h> /* EEXIST ENOENT EISDIR errno */
+#include <errno.h> /* EBADF EEXIST EINTR EINVAL ENOENT ENOSYS ENXIO EISDIR
+                       EOPNOTSUPP EPERM EXDEV errno */
 #include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* UINT64_MAX uint64_t */
 #include <stdio.h> /* FILE fpos_t fclose() fgetpos() fflush() fread() fseek()
                       fsetpos() fwrite() snprintf() */
 #include <stdlib.h> /* free() */
@@ -56,15 +63,56 @@
 /* Amount of data to transfer at once. */
 #define BLOCK_SIZE 32*1024
 
+/* Amount of data to transfer at once when copying is done by the kernel.  It's
+ * larger than BLOCK_SIZE as there is no user-space buffer involved, but still
+ * small enough to update progress and check for cancellation regularly. */
+#define KERNEL_BLOCK_SIZE 1024*1024
+
+/* Whether holes of sparse files can be detected. */
+#if !defined(_WIN32) && defined(SEEK_DATA) && defined(SEEK_HOLE)
+#define SPARSE_COPY_SUPPORTED
+#endif
+
+/* Result of trying to copy contents of a file within the kernel. */
+typedef enum
+{
+	KC_DONE,        /* Whole file (or requested range) was copied. */
+	KC_UNSUPPORTED, /* Method isn't applicable, nothing was copied. */
+	KC_FAILED,      /* Copying has failed or was cancelled. */
+}
+KernelCopyResult;
+
 /* Type of io function used by retry_wrapper(). */
 typedef int (*iop_func)(io_args_t *args);
 
+/* Type of function that copies at most len bytes from src_fd to dst_fd at
+ * current file positions.  Returns number of copied bytes, zero on end of file
+ * or -1 on error with errno set. */
+typedef ssize_t (*kcopy_func)(int dst_fd, int src_fd, size_t len);
+
 static int iop_mkfile_internal(io_args_t *args);
 static int iop_mkdir_internal(io_args_t *args);
 static int iop_rmfile_internal(io_args_t *args);
 static int iop_rmdir_internal(io_args_t *args);
 static int iop_cp_internal(io_args_t *args);
 static int clone_file(int dst_fd, int src_fd);
+static KernelCopyResult sparse_copy(io_args_t *args, int dst_fd, int src_fd,
+		const struct stat *st);
+#ifdef SPARSE_COPY_SUPPORTED
+static KernelCopyResult copy_range(io_args_t *args, int dst_fd, int src_fd,
+		uint64_t len);
+static KernelCopyResult buffered_copy(io_args_t *args, int dst_fd, int src_fd,
+		uint64_t len);
+#endif
+static KernelCopyResult kernel_copy(io_args_t *args, int dst_fd, int src_fd,
+		uint64_t len);
+#ifdef __linux__
+static KernelCopyResult kernel_copy_loop(io_args_t *args, kcopy_func func,
+		int dst_fd, int src_fd, uint64_t len);
+static int is_kernel_copy_unsupported(int error);
+static ssize_t copy_file_range_chunk(int dst_fd, int src_fd, size_t len);
+static ssize_t sendfile_chunk(int dst_fd, int src_fd, size_t len);
+#endif
 #ifdef _WIN32
 static DWORD CALLBACK win_progress_cb(LARGE_INTEGER total,
 		LARGE_INTEGER transferred, LARGE_INTEGER stream_size,
@@ -195,7 +243,11 @@ iop_rmfile_internal(io_args_t *args)
 
 	ioeta_update(args->estim, path, path, 0, 0);
 
-	size = get_file_size(path);
+	/* Size is needed only to report progress and must match estimation, which
+	 * doesn't count holes, so avoid inspecting the file when it's not used. */
+	size = (args->estim == NULL || args->estim->silent)
+	     ? 0U
+	     : get_file_data_size(path);
 
 #ifndef _WIN32
 	result = unlink(path);
@@ -295,7 +347,7 @@ iop_cp_internal(io_args_t *args)
 	/* Suppress possible false-positive compiler warning. */
 	size_t nread = (size_t)-1;
 	int error;
-	int cloned;
+	int copied;
 	struct stat src_st;
 	const char *open_mode = "wb";
 
@@ -514,7 +566,7 @@ iop_cp_internal(io_args_t *args)
 	}
 
 	error = 0;
-	cloned = 0;
+	copied = 0;
 
 	if(crs == IO_CRS_APPEND_TO_FILES)
 	{
@@ -533,17 +585,39 @@ iop_cp_internal(io_args_t *args)
 			ioeta_update(args->estim, NULL, NULL, 0, orig_out_size);
 		}
 	}
-	else if(args->arg4.fast_file_cloning)
+	else
 	{
-		if(clone_file(fileno(out), fileno(in)) == 0)
+		if(args->arg4.fast_file_cloning)
 		{
-			cloned = 1;
+			copied = (clone_file(fileno(out), fileno(in)) == 0);
 		}
-	}
 
-	/* TODO: use sendfile() if platform supports it. */
+		/* Nothing has been read or written through the streams yet, so it's safe
+		 * to operate on their descriptors directly. */
+		if(!copied && S_ISREG(st.st_mode) && st.st_size != 0)
+		{
+			KernelCopyResult result = sparse_copy(args, fileno(out), fileno(in), &st);
+			if(result == KC_UNSUPPORTED)
+			{
+				result = kernel_copy(args, fileno(out), fileno(in), UINT64_MAX);
+			}
+
+			switch(result)
+			{
+				case KC_DONE:
+					copied = 1;
+					break;
+				case KC_FAILED:
+					error = 1;
+					break;
+				case KC_UNSUPPORTED:
+					/* Fall back to copying through a buffer. */
+					break;
+			}
+		}
+	}
 
-	if(!error && !cloned)
+	if(!error && !copied)
 	{
 		while((nread = fread(&block, 1, sizeof(block), in)) != 0U)
 		{
@@ -629,24 +703,278 @@ iop_cp_internal(io_args_t *args)
 	return error;
 }
 
-/* Try to clone file fast on btrfs.  Returns 0 on success, otherwise non-zero is
- * returned. */
+/* Try to clone file fast on file systems that support reflinks (btrfs, XFS,
+ * etc.).  Returns 0 on success, otherwise non-zero is returned. */
 static int
 clone_file(int dst_fd, int src_fd)
 {
 #ifdef __linux__
-#undef BTRFS_IOCTL_MAGIC
-#define BTRFS_IOCTL_MAGIC 0x94
-#undef BTRFS_IOC_CLONE
-#define BTRFS_IOC_CLONE _IOW(BTRFS_IOCTL_MAGIC, 9, int)
-	return ioctl(dst_fd, BTRFS_IOC_CLONE, src_fd);
+#ifndef FICLONE
+/* This used to be BTRFS_IOC_CLONE before it was made generic. */
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+	return ioctl(dst_fd, FICLONE, src_fd);
+#else
+	(void)dst_fd;
+	(void)src_fd;
+	return -1;
+#endif
+}
+
+/* Copies contents of a sparse file preserving its holes by copying only data
+ * regions found via lseek().  Both descriptors are expected to be positioned
+ * at the beginning of files.  Returns status of the operation. */
+static KernelCopyResult
+sparse_copy(io_args_t *args, int dst_fd, int src_fd, const struct stat *st)
+{
+#ifdef SPARSE_COPY_SUPPORTED
+	const uint64_t size = st->st_size;
+	off_t data = 0;
+
+	/* Only files that occupy less space than their size can contain holes. */
+	if((uint64_t)st->st_blocks*512U >= size)
+	{
+		return KC_UNSUPPORTED;
+	}
+
+	while((uint64_t)data < size)
+	{
+		const off_t from = data;
+		off_t hole;
+
+		data = lseek(src_fd, from, SEEK_DATA);
+		if(data < 0 && errno == ENXIO)
+		{
+			/* The rest of the file is a hole. */
+			break;
+		}
+		if(data < 0 && from == 0 && errno == EINVAL)
+		{
+			/* File system doesn't support hole detection. */
+			return KC_UNSUPPORTED;
+		}
+
+		hole = (data < 0) ? -1 : lseek(src_fd, data, SEEK_HOLE);
+		if(hole < 0 || lseek(src_fd, data, SEEK_SET) < 0 ||
+				lseek(dst_fd, data, SEEK_SET) < 0)
+		{
+			(void)ioe_errlst_append(&args->result.errors, args->arg1.src, errno,
+					"Failed to find data in sparse file");
+			return KC_FAILED;
+		}
+
+		if(copy_range(args, dst_fd, src_fd, hole - data) != KC_DONE)
+		{
+			return KC_FAILED;
+		}
+
+		data = hole;
+	}
+
+	/* Trailing hole has to be created explicitly by extending the file. */
+	if(ftruncate(dst_fd, (off_t)size) != 0)
+	{
+		(void)ioe_errlst_append(&args->result.errors, args->arg2.dst, errno,
+				"Failed to set size of destination file");
+		return KC_FAILED;
+	}
+
+	return KC_DONE;
+#else
+	(void)args;
+	(void)dst_fd;
+	(void)src_fd;
+	(void)st;
+	return KC_UNSUPPORTED;
+#endif
+}
+
+#ifdef SPARSE_COPY_SUPPORTED
+
+/* Copies len bytes at current positions in kernel if possible or through a
+ * buffer otherwise.  Returns status of the operation, which is never
+ * KC_UNSUPPORTED. */
+static KernelCopyResult
+copy_range(io_args_t *args, int dst_fd, int src_fd, uint64_t len)
+{
+	const KernelCopyResult result = kernel_copy(args, dst_fd, src_fd, len);
+	if(result != KC_UNSUPPORTED)
+	{
+		return result;
+	}
+	return buffered_copy(args, dst_fd, src_fd, len);
+}
+
+/* Copies at most len bytes at current positions through a user-space buffer.
+ * Returns status of the operation, which is never KC_UNSUPPORTED. */
+static KernelCopyResult
+buffered_copy(io_args_t *args, int dst_fd, int src_fd, uint64_t len)
+{
+	char block[BLOCK_SIZE];
+
+	while(len != 0U)
+	{
+		ssize_t nread;
+		ssize_t nwritten;
+
+		if(io_cancelled(args))
+		{
+			return KC_FAILED;
+		}
+
+		nread = read(src_fd, block, MIN(len, sizeof(block)));
+		if(nread < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(nread < 0)
+		{
+			(void)ioe_errlst_append(&args->result.errors, args->arg1.src, errno,
+					"Read from source file failed");
+			return KC_FAILED;
+		}
+		if(nread == 0)
+		{
+			break;
+		}
+
+		for(nwritten = 0; nwritten < nread; )
+		{
+			const ssize_t n = write(dst_fd, block + nwritten, nread - nwritten);
+			if(n < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(n < 0)
+			{
+				(void)ioe_errlst_append(&args->result.errors, args->arg2.dst, errno,
+						"Write to destination file failed");
+				return KC_FAILED;
+			}
+			nwritten += n;
+		}
+
+		ioeta_update(args->estim, NULL, NULL, 0, nread);
+		len -= nread;
+	}
+
+	return KC_DONE;
+}
+
+#endif
+
+/* Copies at most len bytes (UINT64_MAX means until the end of source file)
+ * without passing them through user-space by trying copy_file_range() and
+ * then sendfile().  Returns status of the operation. */
+static KernelCopyResult
+kernel_copy(io_args_t *args, int dst_fd, int src_fd, uint64_t len)
+{
+#ifdef __linux__
+	KernelCopyResult result =
+		kernel_copy_loop(args, &copy_file_range_chunk, dst_fd, src_fd, len);
+	if(result == KC_UNSUPPORTED)
+	{
+		result = kernel_copy_loop(args, &sendfile_chunk, dst_fd, src_fd, len);
+	}
+	return result;
 #else
+	(void)args;
 	(void)dst_fd;
 	(void)src_fd;
+	(void)len;
+	return KC_UNSUPPORTED;
+#endif
+}
+
+#ifdef __linux__
+
+/* Copies at most len bytes in blocks via specified function reporting progress
+ * and checking for cancellation in between.  Returns status of the
+ * operation. */
+static KernelCopyResult
+kernel_copy_loop(io_args_t *args, kcopy_func func, int dst_fd, int src_fd,
+		uint64_t len)
+{
+	uint64_t total = 0U;
+
+	while(total < len)
+	{
+		ssize_t ncopied;
+
+		if(io_cancelled(args))
+		{
+			return KC_FAILED;
+		}
+
+		ncopied = func(dst_fd, src_fd, MIN(len - total, KERNEL_BLOCK_SIZE));
+		if(ncopied < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if(ncopied < 0)
+		{
+			if(total == 0U && is_kernel_copy_unsupported(errno))
+			{
+				return KC_UNSUPPORTED;
+			}
+
+			(void)ioe_errlst_append(&args->result.errors, args->arg2.dst, errno,
+					"Write to destination file failed");
+			return KC_FAILED;
+		}
+
+		if(ncopied == 0)
+		{
+			/* Some pseudo file systems report end of file right away, let the caller
+			 * try reading such files in a regular way. */
+			return (total == 0U ? KC_UNSUPPORTED : KC_DONE);
+		}
+
+		total += ncopied;
+		ioeta_update(args->estim, NULL, NULL, 0, ncopied);
+	}
+
+	return KC_DONE;
+}
+
+/* Checks whether error code means that kernel copying can't be performed for
+ * this pair of files.  Returns non-zero if so, otherwise zero is returned. */
+static int
+is_kernel_copy_unsupported(int error)
+{
+	return error == ENOSYS
+	    || error == EXDEV
+	    || error == EINVAL
+	    || error == EBADF
+	    || error == EOPNOTSUPP
+	    || error == EPERM;
+}
+
+/* Copies a block of data via copy_file_range().  Returns number of copied
+ * bytes, zero on end of file or -1 on error. */
+static ssize_t
+copy_file_range_chunk(int dst_fd, int src_fd, size_t len)
+{
+#ifdef SYS_copy_file_range
+	/* Calling system call directly to not depend on newer versions of libc. */
+	return syscall(SYS_copy_file_range, src_fd, NULL, dst_fd, NULL, len, 0U);
+#else
+	errno = ENOSYS;
 	return -1;
 #endif
 }
 
+/* Copies a block of data via sendfile().  Returns number of copied bytes, zero
+ * on end of file or -1 on error. */
+static ssize_t
+sendfile_chunk(int dst_fd, int src_fd, size_t len)
+{
+	return sendfile(dst_fd, src_fd, NULL, len);
+}
+
+#endif
+
 #ifdef _WIN32
 
 static DWORD CALLBACK win_progress_cb(LARGE_INTEGER total,
@@ -19,20 +19,25 @@
 #include "ior.h"
 
 #include <sys/stat.h> /* stat */
+#include <sys/time.h> /* gettimeofday() timeval */
+#include <pthread.h> /* pthread_* */
 #include <unistd.h> /* unlink() */
 
-#include <errno.h> /* EEXIST EISDIR ENOTEMPTY EXDEV errno */
+#include <errno.h> /* EEXIST EISDIR ENOTEMPTY ETIMEDOUT EXDEV errno */
 #include <stddef.h> /* NULL */
 #include <stdio.h> /* remove() snprintf() */
-#include <stdlib.h> /* free() */
-#include <string.h> /* strlen() */
+#include <stdlib.h> /* calloc() free() malloc() */
+#include <string.h> /* strdup() strlen() */
+#include <time.h> /* timespec */
 
 #include "../compat/fs_limits.h"
 #include "../compat/os.h"
+#include "../compat/reallocarray.h"
 #include "../utils/fs.h"
 #include "../utils/log.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
+#include "../utils/string_array.h"
 #include "../utils/utils.h"
 #include "../background.h"
 #include "private/ioc.h"
@@ -42,6 +47,50 @@
 #include "ioc.h"
 #include "iop.h"
 
+/* Period of progress reporting during parallel operations in milliseconds. */
+#define PROGRESS_PERIOD_MS 100
+
+/* Maximum number of unfinished jobs per worker, reaching this number suspends
+ * traversal. */
+#define JOBS_PER_WORKER 8
+
+/* Single file processed by a worker of parallel operation. */
+typedef struct job_t
+{
+	char *src;           /* Source path. */
+	char *dst;           /* Destination path. */
+	int failed;          /* Whether processing has failed. */
+	ioeta_estim_t estim; /* Progress of this job with parent set. */
+	ioeta_estim_t start; /* Initial state of estim for retries. */
+	ioe_errlst_t errors; /* Errors of this job. */
+	struct job_t *next;  /* Next job in a list. */
+}
+job_t;
+
+/* State of parallel copying/moving shared among the thread that traverses
+ * source tree and workers. */
+typedef struct
+{
+	io_args_t *args;   /* Arguments of the whole operation. */
+	int cp;            /* Whether copying rather than moving. */
+	int errors_active; /* Copy of args->result.errors.active for workers. */
+	int max_unfinished; /* Limit on number of jobs, suspends traversal. */
+
+	pthread_mutex_t lock;   /* Protects fields down to the next comment. */
+	pthread_cond_t changed; /* Signaled when any of protected fields changes. */
+	job_t *pending;         /* Queue of jobs that wait for a worker. */
+	job_t **pending_tail;   /* Where to append next pending job. */
+	job_t *done;            /* List of finished jobs. */
+	int unfinished;         /* Number of pending and running jobs. */
+	int stop;               /* Whether workers should quit. */
+
+	/* These are accessed only by the thread that traverses source tree. */
+	int failed;   /* Whether one of the jobs has failed. */
+	char **dirs;  /* Directories to finalize (in post-order). */
+	int ndirs;    /* Number of elements in dirs array. */
+}
+par_state_t;
+
 static VisitResult rm_visitor(const char full_path[], VisitAction action,
 		void *param);
 static VisitResult cp_visitor(const char full_path[], VisitAction action,
@@ -51,6 +100,18 @@ static VisitResult mv_visitor(const char full_path[], VisitAction action,
 		void *param);
 static VisitResult cp_mv_visitor(const char full_path[], VisitAction action,
 		void *param, int cp);
+static int cp_mv_subtree(io_args_t *args, int cp);
+static int par_cp_mv(io_args_t *args, int cp);
+static VisitResult par_visitor(const char full_path[], VisitAction action,
+		void *param);
+static VisitResult schedule_job(par_state_t *state, const char src[]);
+static void * worker_main(void *arg);
+static void run_job(par_state_t *state, job_t *job);
+static int wait_for_jobs(par_state_t *state, int limit);
+static void handle_finished_job(par_state_t *state, job_t *job);
+static void queue_job(par_state_t *state, job_t *job);
+static void free_jobs(job_t *jobs);
+static void free_job(job_t *job);
 
 int
 ior_rm(io_args_t *args)
@@ -150,7 +211,7 @@ ior_cp(io_args_t *args)
 		}
 	}
 
-	return traverse(src, &cp_visitor, args);
+	return cp_mv_subtree(args, 1);
 }
 
 /* Implementation of traverse() visitor for subtree copying.  Returns 0 on
@@ -317,7 +378,7 @@ ior_mv(io_args_t *args)
 					}
 				}
 
-				return traverse(src, &mv_visitor, args);
+				return cp_mv_subtree(args, 0);
 			}
 			/* Break is intentionally omitted. */
 
@@ -452,5 +513,410 @@ cp_mv_visitor(const char full_path[], VisitAction action, void *param, int cp)
 	return result;
 }
 
+/* Copies or moves subtree sequentially or in parallel depending on arguments.
+ * Returns 0 on success, otherwise non-zero is returned. */
+static int
+cp_mv_subtree(io_args_t *args, int cp)
+{
+	const char *const src = args->arg1.src;
+
+	/* Single file can't benefit from parallel processing. */
+	if(args->arg5.max_jobs > 1 && !is_symlink(src) && is_dir(src))
+	{
+		return par_cp_mv(args, cp);
+	}
+
+	return traverse(src, cp ? &cp_visitor : &mv_visitor, args);
+}
+
+/* Copies or moves subtree by traversing it and distributing files among a pool
+ * of workers.  Directories are created before their children and their
+ * attributes are set after all files are processed.  Interaction with the user
+ * and progress reporting happen on the calling thread.  Returns 0 on success,
+ * otherwise non-zero is returned. */
+static int
+par_cp_mv(io_args_t *args, int cp)
+{
+	const int max_workers = args->arg5.max_jobs;
+	pthread_t *workers;
+	int nworkers;
+	int result;
+	int i;
+
+	par_state_t state = {
+		.args = args,
+		.cp = cp,
+		.errors_active = args->result.errors.active,
+		.max_unfinished = max_workers*JOBS_PER_WORKER,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.changed = PTHREAD_COND_INITIALIZER,
+	};
+	state.pending_tail = &state.pending;
+
+	workers = reallocarray(NULL, max_workers, sizeof(*workers));
+	if(workers == NULL)
+	{
+		return traverse(args->arg1.src, cp ? &cp_visitor : &mv_visitor, args);
+	}
+
+	for(nworkers = 0; nworkers < max_workers; ++nworkers)
+	{
+		if(pthread_create(&workers[nworkers], NULL, &worker_main, &state) != 0)
+		{
+			break;
+		}
+	}
+
+	if(nworkers == 0)
+	{
+		free(workers);
+		return traverse(args->arg1.src, cp ? &cp_visitor : &mv_visitor, args);
+	}
+
+	result = traverse(args->arg1.src, &par_visitor, &state);
+	if(wait_for_jobs(&state, 0) != 0 && result == 0)
+	{
+		result = io_cancelled(args) ? VR_CANCELLED : VR_ERROR;
+	}
+
+	pthread_mutex_lock(&state.lock);
+	state.stop = 1;
+	pthread_cond_broadcast(&state.changed);
+	pthread_mutex_unlock(&state.lock);
+
+	for(i = 0; i < nworkers; ++i)
+	{
+		(void)pthread_join(workers[i], NULL);
+	}
+	free(workers);
+
+	/* Leaving directories is postponed until all files are processed. */
+	for(i = 0; i < state.ndirs && result == 0; ++i)
+	{
+		result = cp_mv_visitor(state.dirs[i], VA_DIR_LEAVE, args, cp);
+	}
+
+	free_string_array(state.dirs, state.ndirs);
+	pthread_cond_destroy(&state.changed);
+	pthread_mutex_destroy(&state.lock);
+
+	ioeta_report(args->estim);
+
+	return result;
+}
+
+/* Implementation of traverse() visitor for parallel subtree copying/moving.
+ * Returns 0 on success, otherwise non-zero is returned. */
+static VisitResult
+par_visitor(const char full_path[], VisitAction action, void *param)
+{
+	par_state_t *const state = param;
+	io_args_t *const args = state->args;
+
+	if(wait_for_jobs(state, state->max_unfinished) != 0)
+	{
+		return io_cancelled(args) ? VR_CANCELLED : VR_ERROR;
+	}
+
+	switch(action)
+	{
+		case VA_DIR_ENTER:
+			{
+				/* Estimation is updated concurrently by workers, so don't let it be
+				 * touched here. */
+				io_args_t dir_args = *args;
+				VisitResult result;
+
+				dir_args.estim = NULL;
+				result = cp_mv_visitor(full_path, action, &dir_args, state->cp);
+				args->result = dir_args.result;
+				return result;
+			}
+		case VA_FILE:
+			return schedule_job(state, full_path);
+		case VA_DIR_LEAVE:
+			state->ndirs = add_to_string_array(&state->dirs, state->ndirs, 1,
+					full_path);
+			return VR_OK;
+	}
+
+	return VR_OK;
+}
+
+/* Creates a job for the file and passes it to workers.  Returns visitor
+ * result. */
+static VisitResult
+schedule_job(par_state_t *state, const char src[])
+{
+	io_args_t *const args = state->args;
+	const char *const rel_part = src + strlen(args->arg1.src);
+	const IoCrs crs = args->arg3.crs;
+	job_t *job;
+	char *dst;
+
+	dst = (rel_part[0] == '\0') ? strdup(args->arg2.dst)
+	                            : join_paths(args->arg2.dst, rel_part);
+	if(dst == NULL)
+	{
+		(void)ioe_errlst_append(&args->result.errors, src, IO_ERR_UNKNOWN,
+				"Not enough memory");
+		return VR_ERROR;
+	}
+
+	/* Workers can't interact with the user, so ask about overwriting here. */
+	if(args->confirm != NULL &&
+			(crs == IO_CRS_REPLACE_FILES || crs == IO_CRS_REPLACE_ALL) &&
+			path_exists(dst, state->cp ? NODEREF : DEREF) &&
+			!args->confirm(args, src, dst))
+	{
+		free(dst);
+		return VR_OK;
+	}
+
+	job = calloc(1, sizeof(*job));
+	if(job == NULL || (job->src = strdup(src)) == NULL)
+	{
+		free(job);
+		free(dst);
+		(void)ioe_errlst_append(&args->result.errors, src, IO_ERR_UNKNOWN,
+				"Not enough memory");
+		return VR_ERROR;
+	}
+
+	job->dst = dst;
+	job->estim.parent = args->estim;
+	job->estim.cancellation = args->cancellation;
+	job->start = ioeta_save(&job->estim);
+	job->errors.active = state->errors_active;
+
+	queue_job(state, job);
+	return VR_OK;
+}
+
+/* Entry point of a worker thread of parallel operation.  Returns NULL. */
+static void *
+worker_main(void *arg)
+{
+	par_state_t *const state = arg;
+
+	pthread_mutex_lock(&state->lock);
+	while(1)
+	{
+		job_t *job;
+
+		while(!state->stop && state->pending == NULL)
+		{
+			pthread_cond_wait(&state->changed, &state->lock);
+		}
+
+		job = state->pending;
+		if(job == NULL)
+		{
+			break;
+		}
+
+		state->pending = job->next;
+		if(state->pending == NULL)
+		{
+			state->pending_tail = &state->pending;
+		}
+		pthread_mutex_unlock(&state->lock);
+
+		run_job(state, job);
+
+		pthread_mutex_lock(&state->lock);
+		job->next = state->done;
+		state->done = job;
+		pthread_cond_broadcast(&state->changed);
+	}
+	pthread_mutex_unlock(&state->lock);
+
+	return NULL;
+}
+
+/* Copies or moves single file described by the job. */
+static void
+run_job(par_state_t *state, job_t *job)
+{
+	const io_args_t *const par_args = state->args;
+
+	io_args_t args = {
+		.arg1.src = job->src,
+		.arg2.dst = job->dst,
+		.arg3.crs = par_args->arg3.crs,
+		/* It's safe to always use fast file cloning on moving files. */
+		.arg4.fast_file_cloning = state->cp ? par_args->arg4.fast_file_cloning
+		                                    : 1,
+
+		.cancellation = par_args->cancellation,
+		.estim = (par_args->estim == NULL) ? NULL : &job->estim,
+
+		/* Errors are dispatched after the job is finished. */
+		.result.errors = job->errors,
+	};
+
+	job->failed = ((state->cp ? iop_cp(&args) : ior_mv(&args)) != 0);
+	job->errors = args.result.errors;
+}
+
+/* Handles finished jobs and waits until number of unfinished ones drops to the
+ * limit while reporting progress.  On failure or cancellation, drops pending
+ * jobs and waits for running ones to finish.  Returns non-zero if operation
+ * should be stopped. */
+static int
+wait_for_jobs(par_state_t *state, int limit)
+{
+	io_args_t *const args = state->args;
+
+	pthread_mutex_lock(&state->lock);
+	while(1)
+	{
+		struct timeval tv;
+		struct timespec deadline;
+		job_t *done = state->done;
+
+		if(done != NULL)
+		{
+			state->done = NULL;
+			pthread_mutex_unlock(&state->lock);
+
+			while(done != NULL)
+			{
+				job_t *const next = done->next;
+				handle_finished_job(state, done);
+				done = next;
+			}
+			ioeta_report(args->estim);
+
+			pthread_mutex_lock(&state->lock);
+			continue;
+		}
+
+		if(state->failed || io_cancelled(args))
+		{
+			job_t *const pending = state->pending;
+			state->pending = NULL;
+			state->pending_tail = &state->pending;
+			for(done = pending; done != NULL; done = done->next)
+			{
+				--state->unfinished;
+			}
+			free_jobs(pending);
+
+			if(state->unfinished == 0)
+			{
+				break;
+			}
+		}
+		else if(state->unfinished <= limit)
+		{
+			break;
+		}
+
+		gettimeofday(&tv, NULL);
+		deadline.tv_sec = tv.tv_sec;
+		deadline.tv_nsec = (tv.tv_usec + PROGRESS_PERIOD_MS*1000L)*1000L;
+		deadline.tv_sec += deadline.tv_nsec/1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+
+		if(pthread_cond_timedwait(&state->changed, &state->lock,
+					&deadline) == ETIMEDOUT)
+		{
+			pthread_mutex_unlock(&state->lock);
+			ioeta_report(args->estim);
+			pthread_mutex_lock(&state->lock);
+		}
+	}
+	pthread_mutex_unlock(&state->lock);
+
+	return state->failed || io_cancelled(args);
+}
+
+/* Processes results of a finished job, which includes interaction with the user
+ * on errors. */
+static void
+handle_finished_job(par_state_t *state, job_t *job)
+{
+	io_args_t *const args = state->args;
+
+	if(job->failed && args->result.errors_cb != NULL &&
+			job->errors.error_count != 0U && !io_cancelled(args))
+	{
+		switch(args->result.errors_cb(args, &job->errors.errors[0]))
+		{
+			case IO_ECR_RETRY:
+				ioe_errlst_free(&job->errors);
+				job->errors = (ioe_errlst_t){ .active = state->errors_active };
+				/* Restore previous state of progress before retrying. */
+				ioeta_restore(&job->estim, &job->start);
+				job->failed = 0;
+
+				pthread_mutex_lock(&state->lock);
+				--state->unfinished;
+				pthread_mutex_unlock(&state->lock);
+				queue_job(state, job);
+				return;
+
+			case IO_ECR_IGNORE:
+				job->failed = 0;
+				/* When we ignore a file, in order to make progress look nice pretend
+				 * that this file was processed in full. */
+				ioeta_update(&job->estim, job->estim.item, job->estim.target, 1,
+						job->estim.total_file_bytes - job->estim.current_file_byte);
+				break;
+
+			case IO_ECR_BREAK:
+				break;
+		}
+	}
+
+	state->failed |= job->failed;
+	ioe_errlst_splice(&args->result.errors, &job->errors);
+
+	pthread_mutex_lock(&state->lock);
+	--state->unfinished;
+	pthread_mutex_unlock(&state->lock);
+
+	free_job(job);
+}
+
+/* Appends job to the queue of pending jobs. */
+static void
+queue_job(par_state_t *state, job_t *job)
+{
+	job->next = NULL;
+
+	pthread_mutex_lock(&state->lock);
+	*state->pending_tail = job;
+	state->pending_tail = &job->next;
+	++state->unfinished;
+	pthread_cond_broadcast(&state->changed);
+	pthread_mutex_unlock(&state->lock);
+}
+
+/* Frees list of jobs. */
+static void
+free_jobs(job_t *jobs)
+{
+	while(jobs != NULL)
+	{
+		job_t *const next = jobs->next;
+		free_job(jobs);
+		jobs = next;
+	}
+}
+
+/* Frees single job. */
+static void
+free_job(job_t *job)
+{
+	free(job->src);
+	free(job->dst);
+	ioeta_release(&job->estim);
+	ioeta_release(&job->start);
+	ioe_errlst_free(&job->errors);
+	free(job);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
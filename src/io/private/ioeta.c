@@ -18,6 +18,8 @@
 
 #include "ioeta.h"
 
+#include <pthread.h> /* PTHREAD_MUTEX_INITIALIZER pthread_mutex_* */
+
 #include <stddef.h> /* NULL */
 #include <stdint.h> /* uint64_t */
 #include <stdlib.h> /* free() */
@@ -28,6 +30,12 @@
 #include "../ioeta.h"
 #include "ionotif.h"
 
+static void update(ioeta_estim_t *estim, const char path[],
+		const char target[], int finished, uint64_t bytes, int track_file);
+
+/* Protects estimations that have children from concurrent updates. */
+static pthread_mutex_t parents_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void
 ioeta_release(ioeta_estim_t *estim)
 {
@@ -50,7 +58,8 @@ ioeta_add_file(ioeta_estim_t *estim, const char path[])
 {
 	if(!is_symlink(path))
 	{
-		estim->total_bytes += get_file_size(path);
+		/* Holes of sparse files aren't copied, so don't count them. */
+		estim->total_bytes += get_file_data_size(path);
 	}
 
 	ioeta_add_item(estim, path);
@@ -78,6 +87,27 @@ ioeta_update(ioeta_estim_t *estim, const char path[], const char target[],
 		return;
 	}
 
+	update(estim, path, target, finished, bytes, 1);
+
+	if(estim->parent != NULL)
+	{
+		/* Parent is processing multiple files at once, so it doesn't track size of
+		 * current file. */
+		pthread_mutex_lock(&parents_lock);
+		update(estim->parent, path, target, finished, bytes, 0);
+		pthread_mutex_unlock(&parents_lock);
+		return;
+	}
+
+	ionotif_notify(IO_PS_IN_PROGRESS, estim);
+}
+
+/* Updates fields of the estimation according to the change.  track_file
+ * specifies whether size of the current file should be determined. */
+static void
+update(ioeta_estim_t *estim, const char path[], const char target[],
+		int finished, uint64_t bytes, int track_file)
+{
 	estim->current_byte += bytes;
 	estim->current_file_byte += bytes;
 	if(estim->current_byte > estim->total_bytes)
@@ -97,10 +127,10 @@ ioeta_update(ioeta_estim_t *estim, const char path[], const char target[],
 		estim->current_file_byte = 0U;
 		estim->total_file_bytes = 0U;
 	}
-	else if(estim->inspected_items != estim->current_item + 1)
+	else if(track_file && estim->inspected_items != estim->current_item + 1)
 	{
 		estim->inspected_items = estim->current_item + 1;
-		estim->total_file_bytes = get_file_size(path);
+		estim->total_file_bytes = get_file_data_size(path);
 	}
 
 	if(path != NULL)
@@ -112,8 +142,6 @@ ioeta_update(ioeta_estim_t *estim, const char path[], const char target[],
 	{
 		replace_string(&estim->target, target);
 	}
-
-	ionotif_notify(IO_PS_IN_PROGRESS, estim);
 }
 
 int
@@ -164,10 +192,33 @@ ioeta_restore(ioeta_estim_t *estim, const ioeta_estim_t *save)
 	update_string(&item, save->item);
 	update_string(&target, save->target);
 
+	if(estim->parent != NULL)
+	{
+		ioeta_estim_t *const parent = estim->parent;
+
+		pthread_mutex_lock(&parents_lock);
+		parent->current_byte -= estim->current_byte - save->current_byte;
+		parent->current_item -= estim->current_item - save->current_item;
+		pthread_mutex_unlock(&parents_lock);
+	}
+
 	*estim = *save;
 	estim->item = item;
 	estim->target = target;
 }
 
+void
+ioeta_report(ioeta_estim_t *estim)
+{
+	if(estim == NULL || estim->silent)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&parents_lock);
+	ionotif_notify(IO_PS_IN_PROGRESS, estim);
+	pthread_mutex_unlock(&parents_lock);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
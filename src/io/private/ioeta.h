@@ -44,7 +44,9 @@ void ioeta_add_dir(ioeta_estim_t *estim, const char path[]);
  * processed.
  * Might calculate speed, time, etc.  When estim is NULL, the function just
  * returns.  The path or src can be NULL to indicate that file name didn't
- * change.  Calls progress changed notification handler. */
+ * change.  Calls progress changed notification handler unless estim has a
+ * parent, in which case the change is accumulated in the parent instead.  Safe
+ * to call concurrently for different estimations with the same parent. */
 void ioeta_update(ioeta_estim_t *estim, const char path[], const char target[],
 		int finished, uint64_t bytes);
 
@@ -60,9 +62,14 @@ void ioeta_silent_set(ioeta_estim_t *estim, int silent);
  * multiple times and needs to be freed with ioeta_release() after last use. */
 ioeta_estim_t ioeta_save(const ioeta_estim_t *estim);
 
-/* Restores estimation to its previous state. */
+/* Restores estimation to its previous state.  For estimation with a parent,
+ * the parent is updated accordingly. */
 void ioeta_restore(ioeta_estim_t *estim, const ioeta_estim_t *save);
 
+/* Calls progress changed notification handler for estimation that is a parent
+ * of concurrently updated estimations. */
+void ioeta_report(ioeta_estim_t *estim);
+
 #endif /* VIFM__IO__PRIVATE__IOETA_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
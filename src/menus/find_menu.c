@@ -32,6 +32,11 @@
 #include "../macros.h"
 #include "menus.h"
 
+#ifdef _WIN32
+#define DEFAULT_PREDICATE "-iname"
+#else
+#define DEFAULT_PREDICATE "-name"
+#endif
 
 static int execute_find_cb(view_t *view, menu_data_t *m);
 
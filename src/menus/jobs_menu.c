@@ -21,7 +21,8 @@
 
 #include <stddef.h> /* NULL */
 #include <stdio.h> /* snprintf() */
-#include <string.h> /* strlen() strdup() */
+#include <stdlib.h> /* free() */
+#include <string.h> /* strdup() */
 
 #include "../compat/reallocarray.h"
 #include "../modes/dialogs/msg_dialog.h"
@@ -35,7 +36,11 @@
 static int execute_jobs_cb(view_t *view, menu_data_t *m);
 static KHandlerResponse jobs_khandler(view_t *view, menu_data_t *m,
 		const wchar_t keys[]);
+static char * format_job_item(bg_job_t *job);
 static int cancel_job(menu_data_t *m, bg_job_t *job);
+static int is_valid_job(const bg_job_t *job);
+static int pause_job(bg_job_t *job);
+static void update_items(menu_data_t *m);
 static void show_job_errors(view_t *view, menu_data_t *m, bg_job_t *job);
 static KHandlerResponse errs_khandler(view_t *view, menu_data_t *m,
 		const wchar_t keys[]);
@@ -65,27 +70,9 @@ show_jobs_menu(view_t *view)
 	{
 		if(bg_job_is_running(p))
 		{
-			char info_buf[24];
-			char item_buf[sizeof(info_buf) + strlen(p->cmd) + 1024];
-
-			if(p->type == BJT_COMMAND)
-			{
-				snprintf(info_buf, sizeof(info_buf), "%" PRINTF_ULL,
-						(unsigned long long)p->pid);
-			}
-			else if(p->bg_op.total == BG_UNDEFINED_TOTAL)
-			{
-				snprintf(info_buf, sizeof(info_buf), "n/a");
-			}
-			else
-			{
-				snprintf(info_buf, sizeof(info_buf), "%d/%d", p->bg_op.done + 1,
-						p->bg_op.total);
-			}
-
-			snprintf(item_buf, sizeof(item_buf), "%-8s  %s%s", info_buf, p->cmd,
-					bg_job_cancelled(p) ? " (cancelling...)" : "");
-			i = add_to_string_array(&jobs_m.items, i, 1, item_buf);
+			char *const item = format_job_item(p);
+			i = add_to_string_array(&jobs_m.items, i, 1, item);
+			free(item);
 			jobs_m.void_data = reallocarray(jobs_m.void_data, i,
 					sizeof(*jobs_m.void_data));
 			jobs_m.void_data[i - 1] = p;
@@ -101,6 +88,46 @@ show_jobs_menu(view_t *view)
 	return menus_enter(jobs_m.state, view);
 }
 
+/* Formats menu item that describes the job.  Returns newly allocated string. */
+static char *
+format_job_item(bg_job_t *job)
+{
+	char info_buf[24];
+	char state_buf[32] = "";
+	const int queue_pos = bg_job_queue_pos(job);
+
+	if(job->type == BJT_COMMAND)
+	{
+		snprintf(info_buf, sizeof(info_buf), "%" PRINTF_ULL,
+				(unsigned long long)job->pid);
+	}
+	else if(job->bg_op.total == BG_UNDEFINED_TOTAL)
+	{
+		snprintf(info_buf, sizeof(info_buf), "n/a");
+	}
+	else
+	{
+		snprintf(info_buf, sizeof(info_buf), "%d/%d", job->bg_op.done + 1,
+				job->bg_op.total);
+	}
+
+	if(bg_job_cancelled(job))
+	{
+		snprintf(state_buf, sizeof(state_buf), " (cancelling...)");
+	}
+	else if(queue_pos != 0)
+	{
+		snprintf(state_buf, sizeof(state_buf), " (%s #%d)",
+				bg_job_is_paused(job) ? "paused, queued" : "queued", queue_pos);
+	}
+	else if(bg_job_is_paused(job))
+	{
+		snprintf(state_buf, sizeof(state_buf), " (paused)");
+	}
+
+	return format_str("%-8s  %s%s", info_buf, job->cmd, state_buf);
+}
+
 /* Callback that is called when menu item is selected.  Should return non-zero
  * to stay in menu mode. */
 static int
@@ -131,6 +158,29 @@ jobs_khandler(view_t *view, menu_data_t *m, const wchar_t keys[])
 		show_job_errors(view, m, m->void_data[m->pos]);
 		return KHR_REFRESH_WINDOW;
 	}
+	else if(wcscmp(keys, L"p") == 0)
+	{
+		if(pause_job(m->void_data[m->pos]) != 0)
+		{
+			show_error_msg("Job pausing", "The job can't be paused");
+		}
+		update_items(m);
+		return KHR_REFRESH_WINDOW;
+	}
+	else if(wcscmp(keys, L"J") == 0 || wcscmp(keys, L"K") == 0)
+	{
+		bg_job_t *const job = m->void_data[m->pos];
+
+		bg_jobs_freeze();
+		if(is_valid_job(job))
+		{
+			(void)bg_job_move(job, keys[0] == L'J' ? 1 : -1);
+		}
+		bg_jobs_unfreeze();
+
+		update_items(m);
+		return KHR_REFRESH_WINDOW;
+	}
 	/* TODO: maybe use DD for forced termination? */
 	return KHR_UNHANDLED;
 }
@@ -163,6 +213,63 @@ cancel_job(menu_data_t *m, bg_job_t *job)
 	return (p != NULL);
 }
 
+/* Checks whether the job pointer is still valid and the job is running.  Jobs
+ * list must be frozen.  Returns non-zero if so, otherwise zero is returned. */
+static int
+is_valid_job(const bg_job_t *job)
+{
+	bg_job_t *p;
+	for(p = bg_jobs; p != NULL; p = p->next)
+	{
+		if(p == job)
+		{
+			return bg_job_is_running(p);
+		}
+	}
+	return 0;
+}
+
+/* Pauses running job or resumes paused one.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+pause_job(bg_job_t *job)
+{
+	int failed = 1;
+
+	bg_jobs_freeze();
+	if(is_valid_job(job))
+	{
+		failed = bg_job_set_paused(job, !bg_job_is_paused(job));
+	}
+	bg_jobs_unfreeze();
+
+	return failed;
+}
+
+/* Updates descriptions of jobs that are still running. */
+static void
+update_items(menu_data_t *m)
+{
+	int i;
+
+	bg_jobs_freeze();
+	for(i = 0; i < m->len; ++i)
+	{
+		if(is_valid_job(m->void_data[i]))
+		{
+			char *const item = format_job_item(m->void_data[i]);
+			if(item != NULL)
+			{
+				free(m->items[i]);
+				m->items[i] = item;
+			}
+		}
+	}
+	bg_jobs_unfreeze();
+
+	menus_partial_redraw(m->state);
+}
+
 /* Shows job errors if there is something and the job is still running.
  * Switches to separate menu description. */
 static void
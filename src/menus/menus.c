@@ -21,18 +21,27 @@
 
 #include <curses.h>
 
+#ifndef _WIN32
+#include <sys/types.h> /* pid_t ssize_t */
+#include <fcntl.h> /* F_GETFL F_SETFL O_NONBLOCK fcntl() */
+#include <unistd.h> /* read() */
+#endif
+
 #include <assert.h> /* assert() */
+#include <errno.h> /* EAGAIN EINTR EWOULDBLOCK errno */
+#include <signal.h> /* SIGINT kill() */
 #include <stddef.h> /* NULL size_t */
-#include <stdio.h> /* FILE */
-#include <stdlib.h> /* free() malloc() */
-#include <string.h> /* memmove() memset() strdup() strcat() strncat() strchr()
-                       strlen() strrchr() */
+#include <stdio.h> /* FILE fclose() fileno() */
+#include <stdlib.h> /* free() malloc() realloc() */
+#include <string.h> /* memchr() memcmp() memmove() memset() strdup() strcat()
+                       strncat() strchr() strlen() strrchr() */
 #include <wchar.h> /* wchar_t wcscmp() */
 
 #include "../cfg/config.h"
 #include "../compat/fs_limits.h"
 #include "../compat/os.h"
 #include "../compat/reallocarray.h"
+#include "../engine/mode.h"
 #include "../int/vim.h"
 #include "../modes/dialogs/msg_dialog.h"
 #include "../modes/cmdline.h"
@@ -73,6 +82,12 @@ static void draw_search_match(char str[], int start, int end, int line,
 static void normalize_top(menu_state_t *m);
 static void draw_menu_frame(const menu_state_t *m);
 static void output_handler(const char line[], void *arg);
+#ifndef _WIN32
+static int start_stream(const char cmd[], int user_sh, menu_data_t *m);
+static int read_stream(void);
+static int flush_stream(int eof);
+static void stop_stream(int kill_cmd);
+#endif
 static void append_to_string(char **str, const char suffix[]);
 static char * expand_tabulation_a(const char line[], size_t tab_stops);
 static void init_menu_state(menu_state_t *ms, view_t *view);
@@ -80,6 +95,8 @@ static const char * get_relative_path_base(const menu_data_t *m,
 		const view_t *view);
 static int menu_and_view_are_in_sync(const menu_data_t *m, const view_t *view);
 static int search_menu(menu_state_t *ms, int start_pos, int print_errors);
+static void update_matches(menu_state_t *ms, int from);
+static void match_items(menu_state_t *ms, regex_t *re, int from);
 static int search_menu_forwards(menu_state_t *m, int start_pos);
 static int search_menu_backwards(menu_state_t *m, int start_pos);
 static int navigate_to_match(menu_state_t *m, int pos);
@@ -109,6 +126,23 @@ menu_state;
 /* Temporary storage for data of the last stashable menu. */
 static menu_data_t menu_data_stash;
 
+#ifndef _WIN32
+/* State of loading output of an external command into a menu while the menu is
+ * already displayed. */
+static struct
+{
+	menu_data_t *m; /* Menu that receives lines or NULL if nothing is loaded. */
+	pid_t pid;      /* Process id of the command. */
+	FILE *out;      /* Output stream of the command (in non-blocking mode). */
+	FILE *err;      /* Error stream of the command. */
+	char *buf;      /* Output that doesn't form complete line yet. */
+	size_t len;     /* Number of bytes in the buf. */
+	int null_sep;   /* Whether lines are separated by null character. */
+	int started;    /* Whether any output has been received. */
+}
+stream;
+#endif
+
 void
 menus_remove_current(menu_state_t *ms)
 {
@@ -189,6 +223,15 @@ menus_reset_data(menu_data_t *m)
 		return;
 	}
 
+#ifndef _WIN32
+	if(stream.m == m)
+	{
+		/* Not all of the output is here, stop the command and mark the menu. */
+		stop_stream(1);
+		append_to_string(&m->title, "(cancelled)");
+	}
+#endif
+
 	/* On releasing of non-empty stashable menu, but not the stash. */
 	if(m->stashable && m->len > 0 && m != &menu_data_stash)
 	{
@@ -845,8 +888,12 @@ menus_capture(view_t *view, const char cmd[], int user_sh, menu_data_t *m,
 		return 0;
 	}
 
+#ifndef _WIN32
+	if(start_stream(cmd, user_sh, m) != 0)
+#else
 	if(process_cmd_output("Loading menu", cmd, user_sh, 0, &output_handler,
 				m) != 0)
+#endif
 	{
 		show_error_msgf("Trouble running command", "Unable to run: %s", cmd);
 		return 0;
@@ -861,6 +908,268 @@ menus_capture(view_t *view, const char cmd[], int user_sh, menu_data_t *m,
 	return menus_enter(m->state, view);
 }
 
+void
+menus_check_for_updates(void)
+{
+#ifndef _WIN32
+	menu_data_t *const m = stream.m;
+	int first, eof;
+
+	if(m == NULL)
+	{
+		return;
+	}
+
+	first = m->len;
+	eof = read_stream();
+	if(flush_stream(eof) != 0)
+	{
+		if(m->state != NULL)
+		{
+			update_matches(m->state, first);
+		}
+
+		if(menu_state.d == m && vle_mode_is(MENU_MODE))
+		{
+			menus_partial_redraw(&menu_state);
+			menus_set_pos(&menu_state, m->pos);
+		}
+	}
+
+	if(eof)
+	{
+		stop_stream(0);
+	}
+#endif
+}
+
+#ifndef _WIN32
+/* Starts the command and waits for the first line of its output or its end, the
+ * rest of the output is added to the menu by menus_check_for_updates().
+ * Returns non-zero if the command couldn't be started. */
+static int
+start_stream(const char cmd[], int user_sh, menu_data_t *m)
+{
+	FILE *out, *err;
+	pid_t pid;
+	int fd, flags;
+
+	LOG_INFO_MSG("Capturing output of the command: %s", cmd);
+
+	pid = bg_run_and_capture((char *)cmd, user_sh, &out, &err);
+	if(pid == (pid_t)-1)
+	{
+		return 1;
+	}
+
+	if(stream.m != NULL)
+	{
+		/* Only one menu is loaded at a time. */
+		stop_stream(1);
+	}
+
+	fd = fileno(out);
+	flags = fcntl(fd, F_GETFL);
+	if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+	{
+		LOG_SERROR_MSG(errno, "Failed to make output of the command non-blocking");
+	}
+
+	stream.m = m;
+	stream.pid = pid;
+	stream.out = out;
+	stream.err = err;
+	stream.buf = NULL;
+	stream.len = 0U;
+	stream.null_sep = 0;
+	stream.started = 0;
+
+	ui_cancellation_reset();
+	ui_cancellation_enable();
+
+	show_progress("", 0);
+
+	/* Menu mode can't handle empty menu, so wait for something to show. */
+	while(stream.m == m && m->len == 0)
+	{
+		int eof;
+
+		wait_for_data_from(pid, out, 0, &ui_cancellation_info);
+		eof = read_stream();
+		(void)flush_stream(eof);
+		if(eof)
+		{
+			stop_stream(0);
+		}
+
+		show_progress("Loading menu", -250);
+	}
+
+	ui_cancellation_disable();
+
+	if(stream.m == m && ui_cancellation_requested())
+	{
+		stop_stream(1);
+	}
+
+	return 0;
+}
+
+/* Reads output of the command that is available without blocking into the
+ * buffer.  Returns non-zero on reaching end of the output. */
+static int
+read_stream(void)
+{
+	/* Limits amount of data processed at once to keep UI responsive. */
+	enum { PIECE_LEN = 4096, MAX_PIECES = 64 };
+
+	int i;
+	for(i = 0; i < MAX_PIECES; ++i)
+	{
+		ssize_t nread;
+		char *const buf = realloc(stream.buf, stream.len + PIECE_LEN + 1U);
+		if(buf == NULL)
+		{
+			return 1;
+		}
+		stream.buf = buf;
+
+		nread = read(fileno(stream.out), stream.buf + stream.len, PIECE_LEN);
+		if(nread > 0)
+		{
+			stream.len += nread;
+			continue;
+		}
+
+		if(nread == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		return (nread == 0 || (errno != EAGAIN && errno != EWOULDBLOCK));
+	}
+	return 0;
+}
+
+/* Moves complete lines from the buffer to the menu.  Non-zero eof flag makes
+ * the rest of the buffer the last line.  Lines are split the same way as
+ * read_stream_lines() does it with the exception that null character
+ * separators are recognized starting with the piece of output that contains
+ * the first of them.  Returns number of added lines. */
+static int
+flush_stream(int eof)
+{
+	const int old_len = stream.m->len;
+	size_t start = 0U;
+
+	if(!stream.started && stream.len >= 3U)
+	{
+		stream.started = 1;
+		if(memcmp(stream.buf, "\xef\xbb\xbf", 3U) == 0)
+		{
+			start = 3U;
+		}
+	}
+
+	if(!stream.null_sep && memchr(stream.buf, '\0', stream.len) != NULL)
+	{
+		stream.null_sep = 1;
+	}
+
+	while(start < stream.len)
+	{
+		char *const line = stream.buf + start;
+		const size_t left = stream.len - start;
+		size_t line_len = 0U;
+		size_t next;
+
+		while(line_len < left)
+		{
+			const char c = line[line_len];
+			if(stream.null_sep ? (c == '\0') : (c == '\n' || c == '\r'))
+			{
+				break;
+			}
+			++line_len;
+		}
+
+		next = line_len;
+		if(line_len == left)
+		{
+			if(!eof)
+			{
+				break;
+			}
+		}
+		else if(line[next] == '\n')
+		{
+			next += 1U;
+		}
+		else if(line[next] == '\r')
+		{
+			if(next + 1U == left && !eof)
+			{
+				/* Might be the first half of "\r\n". */
+				break;
+			}
+			next += (next + 1U < left && line[next + 1U] == '\n') ? 2U : 1U;
+		}
+		else
+		{
+			do
+			{
+				++next;
+			}
+			while(next < left && line[next] == '\0');
+		}
+
+		line[line_len] = '\0';
+		output_handler(line, stream.m);
+		start += next;
+	}
+
+	if(start != 0U)
+	{
+		stream.started = 1;
+	}
+
+	memmove(stream.buf, stream.buf + start, stream.len - start);
+	stream.len -= start;
+
+	return stream.m->len - old_len;
+}
+
+/* Finishes loading of the output, possibly killing the command first. */
+static void
+stop_stream(int kill_cmd)
+{
+	FILE *const err = stream.err;
+
+	if(kill_cmd && kill(stream.pid, SIGINT) != 0)
+	{
+		LOG_SERROR_MSG(errno, "Failed to send SIGINT to %" PRINTF_ULL,
+				(unsigned long long)stream.pid);
+	}
+
+	fclose(stream.out);
+	free(stream.buf);
+	stream.m = NULL;
+	stream.out = NULL;
+	stream.err = NULL;
+	stream.buf = NULL;
+	stream.len = 0U;
+
+	/* This can start a nested event loop, hence the state is reset above. */
+	if(kill_cmd)
+	{
+		fclose(err);
+	}
+	else
+	{
+		show_errors_from_file(err, "Loading menu");
+	}
+}
+#endif
+
 void
 menus_search_repeat(menu_state_t *m, int backward)
 {
@@ -933,7 +1242,6 @@ search_menu(menu_state_t *ms, int start_pos, int print_errors)
 	int cflags;
 	regex_t re;
 	int err;
-	int i;
 
 	if(ms->matches == NULL)
 	{
@@ -960,10 +1268,63 @@ search_menu(menu_state_t *ms, int start_pos, int print_errors)
 		return -1;
 	}
 
-	for(i = 0; i < m->len; ++i)
+	match_items(ms, &re, 0);
+	regfree(&re);
+	return 0;
+}
+
+/* Extends search matches of the menu to cover items added to it starting with
+ * the one at the specified index. */
+static void
+update_matches(menu_state_t *ms, int from)
+{
+	menu_data_t *const m = ms->d;
+	short int (*matches)[2];
+	regex_t re;
+
+	if(ms->matches == NULL)
+	{
+		/* No search was performed. */
+		return;
+	}
+
+	matches = reallocarray(ms->matches, m->len, sizeof(*ms->matches));
+	if(matches == NULL)
+	{
+		/* Forget about the search rather than keep matches of wrong size. */
+		free(ms->matches);
+		ms->matches = NULL;
+		ms->matching_entries = 0;
+		return;
+	}
+	ms->matches = matches;
+
+	memset(ms->matches + from, -1, 2*sizeof(**ms->matches)*(m->len - from));
+
+	if(is_null_or_empty(ms->regexp))
+	{
+		return;
+	}
+
+	if(regcomp(&re, ms->regexp, get_regexp_cflags(ms->regexp)) == 0)
+	{
+		match_items(ms, &re, from);
+	}
+	regfree(&re);
+}
+
+/* Marks menu items starting with the one at the specified index that match the
+ * regular expression. */
+static void
+match_items(menu_state_t *ms, regex_t *re, int from)
+{
+	menu_data_t *const m = ms->d;
+	int i;
+
+	for(i = from; i < m->len; ++i)
 	{
 		regmatch_t matches[1];
-		if(regexec(&re, m->items[i], 1, matches, 0) == 0)
+		if(regexec(re, m->items[i], 1, matches, 0) == 0)
 		{
 			ms->matches[i][0] = matches[0].rm_so;
 			ms->matches[i][1] = matches[0].rm_eo;
@@ -971,8 +1332,6 @@ search_menu(menu_state_t *ms, int start_pos, int print_errors)
 			++ms->matching_entries;
 		}
 	}
-	regfree(&re);
-	return 0;
 }
 
 /* Looks for next matching element in forward direction from current position.
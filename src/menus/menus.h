@@ -117,6 +117,10 @@ int menus_to_custom_view(menu_state_t *m, struct view_t *view, int very);
 int menus_capture(struct view_t *view, const char cmd[], int user_sh,
 		menu_data_t *m, int custom_view, int very_custom_view);
 
+/* Appends lines produced by the command of menus_capture() since the last call
+ * to its menu, which is redrawn if visible. */
+void menus_check_for_updates(void);
+
 /* Menu drawing. */
 
 /* Erases current menu item in menu window. */
@@ -23,10 +23,15 @@
 #include <string.h> /* strdup() */
 
 #include "../compat/reallocarray.h"
+#include "../int/file_magic.h"
 #include "../ui/ui.h"
+#include "../utils/str.h"
+#include "../utils/string_array.h"
 #include "../version.h"
 #include "menus.h"
 
+static void add_runtime_info(menu_data_t *m);
+
 int
 show_vifm_menu(view_t *view)
 {
@@ -38,9 +43,24 @@ show_vifm_menu(view_t *view)
 	len = fill_version_info(NULL);
 	m.items = reallocarray(NULL, len, sizeof(char *));
 	m.len = fill_version_info(m.items);
+	add_runtime_info(&m);
 
 	return menus_enter(m.state, view);
 }
 
+/* Appends information about state of the running instance to the menu. */
+static void
+add_runtime_info(menu_data_t *m)
+{
+	mime_cache_stats_t stats;
+	mimetype_cache_get_stats(&stats);
+
+	m->len = add_to_string_array(&m->items, m->len, 1, "");
+	m->len = put_into_string_array(&m->items, m->len,
+			format_str("Mime-type cache: %d entries, %llu hits, %llu misses, "
+				"%llu evictions", stats.size, stats.hits, stats.misses,
+				stats.evictions));
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
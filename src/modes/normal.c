@@ -222,6 +222,7 @@ static void cmd_zf(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zm(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zo(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zr(key_info_t key_info, keys_info_t *keys_info);
+static void cmd_zx(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_left_paren(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_right_paren(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_z_k(key_info_t key_info, keys_info_t *keys_info);
@@ -398,6 +399,7 @@ static keys_add_info_t builtin_cmds[] = {
 	{WK_z WK_o,        {{&cmd_zo}, .descr = "show dot files"}},
 	{WK_z WK_r,        {{&cmd_zr}, .descr = "clear local filter"}},
 	{WK_z WK_t,        {{&normal_cmd_zt},   .descr = "push cursor to the top"}},
+	{WK_z WK_x,        {{&cmd_zx}, .descr = "toggle fold in tree"}},
 	{WK_z WK_z,        {{&normal_cmd_zz},   .descr = "center cursor position"}},
 	{WK_LP,            {{&cmd_left_paren},  .descr = "go to previous group of files"}},
 	{WK_RP,            {{&cmd_right_paren}, .descr = "go to next group of files"}},
@@ -2047,6 +2049,13 @@ cmd_zr(key_info_t key_info, keys_info_t *keys_info)
 	local_filter_remove(curr_view);
 }
 
+/* Folds or unfolds directory under the cursor in tree view. */
+static void
+cmd_zx(key_info_t key_info, keys_info_t *keys_info)
+{
+	flist_toggle_fold(curr_view);
+}
+
 /* Moves cursor to the beginning of the previous group of files defined by the
  * primary sorting key. */
 static void
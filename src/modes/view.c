@@ -21,9 +21,12 @@
 #include <curses.h>
 
 #include <regex.h>
+#include <sys/time.h> /* gettimeofday() timeval */
 #include <unistd.h> /* usleep() */
 
 #include <assert.h> /* assert() */
+#include <errno.h> /* ETIMEDOUT */
+#include <limits.h> /* INT_MAX */
 #include <stddef.h> /* ptrdiff_t size_t */
 #include <string.h> /* memset() strdup() */
 #include <stdio.h>  /* fclose() snprintf() */
@@ -33,6 +36,7 @@
 #include "../compat/curses.h"
 #include "../compat/fs_limits.h"
 #include "../compat/os.h"
+#include "../compat/pthread.h"
 #include "../compat/reallocarray.h"
 #include "../engine/keys.h"
 #include "../engine/mode.h"
@@ -49,10 +53,12 @@
 #include "../utils/filemon.h"
 #include "../utils/fs.h"
 #include "../utils/macros.h"
+#include "../utils/mapped_text.h"
 #include "../utils/path.h"
 #include "../utils/regexp.h"
 #include "../utils/str.h"
 #include "../utils/string_array.h"
+#include "../utils/test_helpers.h"
 #include "../utils/utf8.h"
 #include "../utils/utils.h"
 #include "../filelist.h"
@@ -72,16 +78,57 @@ enum
 	SILENT,   /* Do not display error message dialog. */
 };
 
+/* Number of lines searched between publishing of found matches. */
+#define SEARCH_CHUNK 4096
+
+/* How long search commands wait for background search before returning control
+ * to the user. */
+#define SEARCH_WAIT_MS 200
+
+/* Index of lines that match search pattern, which is built by a background
+ * thread.  Lines are matched the same way search commands do it: by parts that
+ * fit into the window. */
+typedef struct
+{
+	/* Input of the thread, which doesn't change while it's running. */
+	regex_t re;          /* Copy of the pattern owned by the thread. */
+	char **lines;        /* In-memory lines or NULL. */
+	int nlines;          /* Number of in-memory lines. */
+	mapped_text_t *text; /* Mapped text or NULL. */
+	int width;           /* Width of parts. */
+	int wrap;            /* Whether all parts of lines are matched. */
+	int tab_stop;        /* Width of tabulation. */
+
+	pthread_mutex_t lock;    /* Protects fields below. */
+	pthread_cond_t progress; /* Signaled when more lines are processed. */
+	int *matches;            /* Numbers of matching lines in ascending order. */
+	int nmatches;            /* Number of found matches. */
+	int capacity;            /* Number of allocated elements of matches. */
+	int scanned;             /* Number of processed lines. */
+	int complete;            /* Whether processing is over. */
+	int stop;                /* Whether processing should stop. */
+
+	pthread_t thread; /* Searching thread. */
+	int has_thread;   /* Whether the thread was started. */
+}
+search_index_t;
+
 /* Describes view state and its properties. */
 struct view_info_t
 {
 	/* Data of the view. */
-	char **lines;     /* List of real lines. */
-	int (*widths)[2]; /* (virtual line, screen width) pair per real line. */
-	int nlines;       /* Number of real lines. */
-	int nlinesv;      /* Number of virtual (possibly wrapped) lines. */
-	int line;         /* Current real line number. */
-	int linev;        /* Current virtual line number. */
+	char **lines;          /* List of real lines (NULL when text is mapped). */
+	mapped_text_t *text;   /* Mapped file or NULL when lines are in memory. */
+	char *line_buf;        /* Buffer for the last line taken from mapped text. */
+	size_t line_buf_len;   /* Size of the line_buf. */
+	int line_buf_num;      /* Number of line in line_buf or -1. */
+	int (*widths)[2];      /* (virtual line, screen width) pair per real line. */
+	int widths_cap;        /* Number of allocated elements of widths. */
+	int nwidths;           /* Number of lines with computed widths. */
+	int nlines;            /* Number of known real lines. */
+	int nlinesv;           /* Number of virtual lines among first nwidths. */
+	int line;              /* Current real line number. */
+	int linev;             /* Current virtual line number. */
 
 	/* Dimensions, units of actions. */
 	int win_size; /* Scroll window size. */
@@ -94,8 +141,15 @@ struct view_info_t
 
 	/* Related to search. */
 	regex_t re;               /* Search regular expression. */
+	char *pattern;            /* Source of the regular expression. */
 	int last_search_backward; /* Value -1 means no search was performed. */
 	int search_repeat;        /* Saved count prefix of search commands. */
+	search_index_t *index;    /* Lines matching the pattern or NULL. */
+	int search_pending;       /* Repeats of search waiting for the index. */
+	int pending_backward;     /* Direction of the pending search. */
+	int pending_linev;        /* Position at which the search was started. */
+	int shown_matches;        /* Number of matches reported to the user. */
+	int shown_complete;       /* Whether reported number was final. */
 
 	/* The rest of the state. */
 	view_t *view;    /* File view association with the view. */
@@ -122,10 +176,31 @@ static void init_view_info(view_info_t *vi);
 static void free_view_info(view_info_t *vi);
 static void redraw(void);
 static void calc_vlines(void);
-static void calc_vlines_wrapped(view_info_t *vi);
-static void calc_vlines_non_wrapped(view_info_t *vi);
+static void ensure_window(view_info_t *vi);
+static void ensure_lines_after(view_info_t *vi, int line, int n);
+static void ensure_widths(view_info_t *vi, int n);
+static void sync_lines(view_info_t *vi, int n);
+static const char * get_line(view_info_t *vi, int n);
 static void draw(void);
 static int get_part(const char line[], int offset, size_t max_len, char part[]);
+static int ensure_search_index(view_info_t *vi);
+static int start_search_index(view_info_t *vi);
+static void resume_search_index(view_info_t *vi, int first);
+static void run_search_index(search_index_t *idx);
+static void stop_search_index(view_info_t *vi);
+static void join_search_thread(search_index_t *idx);
+static void * search_lines(void *arg);
+static int line_matches(const search_index_t *idx, const char line[],
+		char part[]);
+static int publish_matches(search_index_t *idx, const int found[], int nfound,
+		int scanned);
+static int find_indexed_match(view_info_t *vi, int line, int backward,
+		int wait_ms, int *match);
+static int lookup_match(const search_index_t *idx, int line, int backward,
+		int *match);
+static int count_matches(search_index_t *idx, int *complete);
+static void update_search(view_info_t *vi);
+TSTATIC void wait_for_search(void);
 static void display_error(const char error_msg[]);
 static void cmd_ctrl_l(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_ctrl_wH(key_info_t key_info, keys_info_t *keys_info);
@@ -172,8 +247,10 @@ static void cmd_k(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_n(key_info_t key_info, keys_info_t *keys_info);
 static void goto_search_result(int repeat_count, int inverse_direction);
 static void search(int repeat_count, int backward);
-static void find_previous(int vline_offset);
-static void find_next(void);
+static void do_search(int repeat_count, int backward, int wait_ms);
+static int find_previous(int vline_offset, int wait_ms);
+static int find_next(int wait_ms);
+static int find_part(view_info_t *vi, int l, int from, int backward);
 static void cmd_q(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_u(key_info_t key_info, keys_info_t *keys_info);
 static void update_with_half_win(key_info_t *key_info);
@@ -184,6 +261,7 @@ static void update_with_win(key_info_t *key_info);
 static int is_trying_the_same_file(void);
 static int get_file_to_explore(const view_t *view, char buf[], size_t buf_len);
 static int forward_if_changed(view_info_t *vi);
+static void forget_lines(view_info_t *vi, int first);
 static int scroll_to_bottom(view_info_t *vi);
 static void reload_view(view_info_t *vi, int silent);
 static view_info_t * view_info_alloc(void);
@@ -423,7 +501,17 @@ view_pre(void)
 	if(curr_stats.save_msg == 0)
 	{
 		const char *const suffix = vi->auto_forward ? "(auto forwarding)" : "";
-		ui_sb_msgf("-- VIEW -- %s", suffix);
+		if(vi->index == NULL)
+		{
+			ui_sb_msgf("-- VIEW -- %s", suffix);
+		}
+		else
+		{
+			int complete;
+			const int nmatches = count_matches(vi->index, &complete);
+			ui_sb_msgf("-- VIEW -- %s%s(matches: %d%s)", suffix,
+					(*suffix == '\0') ? "" : " ", nmatches, complete ? "" : "+");
+		}
 		curr_stats.save_msg = 2;
 	}
 }
@@ -439,6 +527,7 @@ void
 view_ruler_update(void)
 {
 	char buf[POS_WIN_MIN_WIDTH + 1];
+	sync_lines(vi, 0);
 	snprintf(buf, sizeof(buf), "%d-%d ", vi->line + 1, vi->nlines);
 
 	ui_ruler_set(buf);
@@ -539,8 +628,14 @@ init_view_info(view_info_t *vi)
 	vi->width = -1;
 	vi->last_search_backward = -1;
 	vi->search_repeat = NO_COUNT_GIVEN;
+	vi->pattern = NULL;
+	vi->index = NULL;
+	vi->shown_matches = -1;
 	vi->nlines = 0;
 	vi->lines = NULL;
+	vi->text = NULL;
+	vi->line_buf = NULL;
+	vi->line_buf_num = -1;
 	vi->widths = NULL;
 	vi->filename = NULL;
 	vi->viewer = NULL;
@@ -550,12 +645,24 @@ init_view_info(view_info_t *vi)
 static void
 free_view_info(view_info_t *vi)
 {
-	free_string_array(vi->lines, vi->nlines);
+	/* Searching thread might be reading the lines. */
+	stop_search_index(vi);
+
+	if(vi->text != NULL)
+	{
+		mapped_text_close(vi->text);
+	}
+	else
+	{
+		free_string_array(vi->lines, vi->nlines);
+	}
+	free(vi->line_buf);
 	free(vi->widths);
 	if(vi->last_search_backward != -1)
 	{
 		regfree(&vi->re);
 	}
+	free(vi->pattern);
 	free(vi->filename);
 	free(vi->viewer);
 }
@@ -582,42 +689,109 @@ calc_vlines(void)
 	vi->width = ui_qv_width(vi->view);
 	vi->wrap = cfg.wrap_quick_view;
 
-	if(vi->wrap)
-	{
-		calc_vlines_wrapped(vi);
-	}
-	else
+	/* Widths are computed on demand starting with the first line. */
+	vi->nwidths = 0;
+	vi->nlinesv = 0;
+	ensure_window(vi);
+}
+
+/* Makes sure that widths are known for lines that can be displayed in the
+ * window. */
+static void
+ensure_window(view_info_t *vi)
+{
+	ensure_lines_after(vi, vi->line, ui_qv_height(vi->view) + 1);
+}
+
+/* Makes sure that widths are known for n lines after the specified one. */
+static void
+ensure_lines_after(view_info_t *vi, int line, int n)
+{
+	ensure_widths(vi, (n > INT_MAX - line - 1) ? INT_MAX : line + n + 1);
+}
+
+/* Computes widths of lines up to the specified one (exclusive) or up to the
+ * last line.  Lines of mapped text are waited for if they aren't indexed
+ * yet. */
+static void
+ensure_widths(view_info_t *vi, int n)
+{
+	sync_lines(vi, n);
+
+	n = MIN(n, MIN(vi->nlines, vi->widths_cap));
+	for(; vi->nwidths < n; ++vi->nwidths)
 	{
-		calc_vlines_non_wrapped(vi);
+		const int i = vi->nwidths;
+		if(vi->wrap)
+		{
+			const char *const line = get_line(vi, i);
+			vi->widths[i][0] = vi->nlinesv++;
+			vi->widths[i][1] = utf8_strsw_with_tabs(line, cfg.tab_stop) -
+				esc_str_overhead(line);
+			vi->nlinesv += vi->widths[i][1]/vi->width;
+		}
+		else
+		{
+			vi->widths[i][0] = i;
+			vi->widths[i][1] = vi->width;
+			vi->nlinesv = i + 1;
+		}
 	}
 }
 
-/* Recalculates virtual lines of a view with line wrapping. */
+/* Updates number of known lines of mapped text waiting until at least n lines
+ * are available or the whole file is indexed (n can be zero to not wait). */
 static void
-calc_vlines_wrapped(view_info_t *vi)
+sync_lines(view_info_t *vi, int n)
 {
-	int i;
-	vi->nlinesv = 0;
-	for(i = 0; i < vi->nlines; i++)
+	int count, complete;
+	int capacity;
+	int (*widths)[2];
+
+	if(vi->text == NULL)
 	{
-		vi->widths[i][0] = vi->nlinesv++;
-		vi->widths[i][1] = utf8_strsw_with_tabs(vi->lines[i], cfg.tab_stop) -
-			esc_str_overhead(vi->lines[i]);
-		vi->nlinesv += vi->widths[i][1]/vi->width;
+		return;
+	}
+
+	count = (n > vi->nlines) ? mapped_text_wait(vi->text, n)
+	                         : mapped_text_count(vi->text, &complete);
+	if(count <= vi->widths_cap)
+	{
+		vi->nlines = MAX(vi->nlines, count);
+		return;
+	}
+
+	capacity = (vi->widths_cap > INT_MAX/2) ? INT_MAX : vi->widths_cap*2;
+	capacity = MAX(capacity, count);
+	widths = reallocarray(vi->widths, capacity, sizeof(*vi->widths));
+	if(widths != NULL)
+	{
+		vi->widths = widths;
+		vi->widths_cap = capacity;
+		vi->nlines = count;
 	}
 }
 
-/* Recalculates virtual lines of a view without line wrapping. */
-static void
-calc_vlines_non_wrapped(view_info_t *vi)
+/* Retrieves contents of a line.  For mapped text the result is valid until the
+ * next call.  Returns pointer to the line, which is empty on error. */
+static const char *
+get_line(view_info_t *vi, int n)
 {
-	int i;
-	vi->nlinesv = vi->nlines;
-	for(i = 0; i < vi->nlines; i++)
+	if(vi->text == NULL)
 	{
-		vi->widths[i][0] = i;
-		vi->widths[i][1] = vi->width;
+		return vi->lines[n];
 	}
+
+	if(vi->line_buf_num != n)
+	{
+		vi->line_buf_num = -1;
+		if(mapped_text_get(vi->text, n, &vi->line_buf, &vi->line_buf_len) == NULL)
+		{
+			return "";
+		}
+		vi->line_buf_num = n;
+	}
+	return vi->line_buf;
 }
 
 static void
@@ -627,16 +801,24 @@ draw(void)
 	const col_scheme_t *cs = ui_view_get_cs(vi->view);
 	const int height = ui_qv_height(vi->view);
 	const int width = ui_qv_width(vi->view);
-	const int max_l = MIN(vi->line + height, vi->nlines);
 	const int searched = (vi->last_search_backward != -1);
+	int max_l;
 	esc_state state;
 
+	if(vi->text != NULL && !mapped_text_is_valid(vi->text))
+	{
+		/* The file was truncated, its mapping can't be used anymore. */
+		reload_view(vi, SILENT);
+		return;
+	}
+
 	if(vi->kind != VK_TEXTUAL)
 	{
 		const char *cmd = qv_get_viewer(vi->filename);
 		cmd = (cmd != NULL) ? ma_get_clear_cmd(cmd) : NULL;
 		qv_cleanup(vi->view, cmd);
 
+		stop_search_index(vi);
 		free_string_array(vi->lines, vi->nlines);
 		(void)get_view_data(vi, vi->filename);
 
@@ -653,6 +835,9 @@ draw(void)
 		 * previewer that handles both textual and graphical previews. */
 	}
 
+	ensure_window(vi);
+	max_l = MIN(vi->line + height, vi->nlines);
+
 	esc_state_init(&state, &cs->color[WIN_COLOR], COLORS);
 
 	ui_view_erase(vi->view);
@@ -662,8 +847,8 @@ draw(void)
 	{
 		int offset = 0;
 		int processed = 0;
-		char *const line = vi->lines[l];
-		char *p = searched ? esc_highlight_pattern(line, &vi->re) : line;
+		const char *const line = get_line(vi, l);
+		char *p = searched ? esc_highlight_pattern(line, &vi->re) : (char *)line;
 		do
 		{
 			int printed;
@@ -705,6 +890,8 @@ view_find_pattern(const char pattern[], int backward)
 	}
 
 	vi->last_search_backward = backward;
+	(void)replace_string(&vi->pattern, pattern);
+	stop_search_index(vi);
 
 	search(vi->search_repeat, backward);
 
@@ -921,7 +1108,9 @@ cmd_percent(key_info_t key_info, keys_info_t *keys_info)
 	if(key_info.count > 100)
 		key_info.count = 100;
 
-	vi->line = (key_info.count*vi->nlinesv)/100;
+	ensure_widths(vi, INT_MAX);
+
+	vi->line = ((long long)key_info.count*vi->nlinesv)/100;
 	if(vi->line >= vi->nlines)
 		vi->line = vi->nlines - 1;
 	vi->linev = vi->widths[vi->line][0];
@@ -1054,7 +1243,8 @@ load_view_data(view_info_t *vi, const char action[], const char file_to_view[],
 			return 1;
 	}
 
-	if(vi->nlines != 0)
+	/* Widths of mapped text are allocated as lines get indexed. */
+	if(vi->text == NULL && vi->nlines != 0)
 	{
 		vi->widths = reallocarray(NULL, vi->nlines, sizeof(*vi->widths));
 		if(vi->widths == NULL)
@@ -1065,6 +1255,7 @@ load_view_data(view_info_t *vi, const char action[], const char file_to_view[],
 			show_error_msg(action, "Not enough memory");
 			return 1;
 		}
+		vi->widths_cap = vi->nlines;
 	}
 
 	return 0;
@@ -1089,6 +1280,14 @@ get_view_data(view_info_t *vi, const char file_to_view[])
 		}
 		else
 		{
+			/* Big files are neither read nor processed as a whole. */
+			vi->text = mapped_text_open(file_to_view);
+			if(vi->text != NULL)
+			{
+				sync_lines(vi, 1);
+				return 0;
+			}
+
 			fp = os_fopen(file_to_view, "rb");
 		}
 
@@ -1185,6 +1384,9 @@ replace_vi(view_info_t *orig, view_info_t *new)
 		orig->last_search_backward = -1;
 	}
 
+	new->pattern = orig->pattern;
+	orig->pattern = NULL;
+
 	new->win_size = orig->win_size;
 	new->half_win = orig->half_win;
 	new->line = orig->line;
@@ -1234,6 +1436,8 @@ cmd_g(key_info_t key_info, keys_info_t *keys_info)
 	if(key_info.count == NO_COUNT_GIVEN)
 		key_info.count = 1;
 
+	ensure_lines_after(vi, key_info.count, ui_qv_height(vi->view));
+
 	key_info.count = MIN(vi->nlinesv - ui_qv_height(vi->view), key_info.count);
 	key_info.count = MAX(1, key_info.count);
 
@@ -1247,6 +1451,11 @@ cmd_g(key_info_t key_info, keys_info_t *keys_info)
 static void
 cmd_j(key_info_t key_info, keys_info_t *keys_info)
 {
+	/* The count is in virtual lines, each of which is at most one real line. */
+	ensure_lines_after(vi, vi->line,
+			(key_info.count == NO_COUNT_GIVEN ? 1 : key_info.count) +
+			ui_qv_height(vi->view));
+
 	if(key_info.reg == NO_REG_GIVEN)
 	{
 		if((vi->linev + 1) + ui_qv_height(vi->view) > vi->nlinesv)
@@ -1317,6 +1526,15 @@ goto_search_result(int repeat_count, int inverse_direction)
 /* Performs search and navigation to the first match. */
 static void
 search(int repeat_count, int backward)
+{
+	do_search(repeat_count, backward, SEARCH_WAIT_MS);
+}
+
+/* Performs search waiting for background search for at most wait_ms
+ * milliseconds.  If results aren't available by then, the search is finished
+ * later by update_search(). */
+static void
+do_search(int repeat_count, int backward, int wait_ms)
 {
 	if(vi->last_search_backward == -1)
 	{
@@ -1328,104 +1546,132 @@ search(int repeat_count, int backward)
 		repeat_count = 1;
 	}
 
-	while(repeat_count-- > 0 && curr_stats.save_msg == 0)
+	vi->search_pending = 0;
+	(void)ensure_search_index(vi);
+
+	while(repeat_count > 0 && curr_stats.save_msg == 0)
 	{
-		if(backward)
+		const int pending = backward ? find_previous(1, wait_ms)
+		                             : find_next(wait_ms);
+		if(pending)
 		{
-			find_previous(1);
-		}
-		else
-		{
-			find_next();
+			vi->search_pending = repeat_count;
+			vi->pending_backward = backward;
+			vi->pending_linev = vi->linev;
+			ui_sb_msgf("Searching... %d matches so far",
+					count_matches(vi->index, NULL));
+			curr_stats.save_msg = 1;
+			break;
 		}
+		--repeat_count;
 	}
 }
 
-static void
-find_previous(int vline_offset)
+/* Looks for a match above current position.  Returns non-zero if results of
+ * background search aren't available yet, otherwise zero is returned. */
+static int
+find_previous(int vline_offset, int wait_ms)
 {
-	int i;
-	int offset = 0;
-	char buf[ui_qv_width(vi->view)*4];
-	int vl, l;
-
-	vl = vi->linev - vline_offset;
-	l = vi->line;
+	int vl = vi->linev - vline_offset;
+	int l = vi->line;
+	int part;
 
 	if(l > 0 && vl < vi->widths[l][0])
 		l--;
 
-	for(i = 0; i <= vl - vi->widths[l][0]; i++)
-		offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
-
-	/* Don't stop until we go above first virtual line of the first line. */
-	while(l >= 0 && vl >= 0)
+	part = find_part(vi, l, vl - vi->widths[l][0], 1);
+	while(part < 0)
 	{
-		if(regexec(&vi->re, buf, 0, NULL, 0) == 0)
+		const int found = find_indexed_match(vi, l, 1, wait_ms, &l);
+		if(found == -1)
 		{
-			vi->linev = vl;
-			vi->line = l;
-			break;
+			return 1;
 		}
-		if(l > 0 && vl - 1 < vi->widths[l][0])
+		if(found == 0)
 		{
-			l--;
-			offset = 0;
-			for(i = 0; i <= vl - 1 - vi->widths[l][0]; i++)
-				offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
+			draw();
+			display_error("Pattern not found");
+			return 0;
 		}
-		else
-			offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
-		vl--;
+
+		part = find_part(vi, l, INT_MAX, 1);
 	}
+
+	vi->line = l;
+	vi->linev = vi->widths[l][0] + part;
 	draw();
-	if(vi->line != l)
-	{
-		display_error("Pattern not found");
-	}
+	return 0;
 }
 
-static void
-find_next(void)
+/* Looks for a match below current position.  Returns non-zero if results of
+ * background search aren't available yet, otherwise zero is returned. */
+static int
+find_next(int wait_ms)
 {
-	int i;
-	int offset = 0;
-	char buf[ui_qv_width(vi->view)*4];
-	int vl, l;
-
-	vl = vi->linev + 1;
-	l = vi->line;
+	int vl = vi->linev + 1;
+	int l = vi->line;
+	int part;
 
+	ensure_lines_after(vi, l, 1);
 	if(l < vi->nlines - 1 && vl == vi->widths[l + 1][0])
 		l++;
 
-	for(i = 0; i <= vl - vi->widths[l][0]; i++)
-		offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
-
-	while(l < vi->nlines)
+	part = find_part(vi, l, vl - vi->widths[l][0], 0);
+	while(part < 0)
 	{
-		if(regexec(&vi->re, buf, 0, NULL, 0) == 0)
+		const int found = find_indexed_match(vi, l, 0, wait_ms, &l);
+		if(found == -1)
 		{
-			vi->linev = vl;
-			vi->line = l;
-			break;
+			return 1;
 		}
-		if(l < vi->nlines && (l == vi->nlines - 1 ||
-				vl + 1 >= vi->widths[l + 1][0]))
+		if(found == 0)
 		{
-			if(l == vi->nlines - 1)
-				break;
-			l++;
-			offset = 0;
+			draw();
+			display_error("Pattern not found");
+			return 0;
 		}
-		offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
-		vl++;
+
+		ensure_lines_after(vi, l, 1);
+		part = find_part(vi, l, 0, 0);
 	}
+
+	vi->line = l;
+	vi->linev = vi->widths[l][0] + part;
 	draw();
-	if(vi->line != l)
+	return 0;
+}
+
+/* Finds part of a line (virtual line) that matches the pattern.  Parts are
+ * checked starting with the specified one and up to the end of the line or, for
+ * backward search, down to its beginning.  Widths of the line must be known.
+ * Returns index of the part or -1 if there is no match. */
+static int
+find_part(view_info_t *vi, int l, int from, int backward)
+{
+	const int width = ui_qv_width(vi->view);
+	const int end = (l + 1 < vi->nwidths) ? vi->widths[l + 1][0] : vi->nlinesv;
+	const int nparts = end - vi->widths[l][0];
+	const int last = backward ? MIN(from, nparts - 1) : nparts - 1;
+	const char *const line = get_line(vi, l);
+	char part[width*4 + 1];
+	int offset = 0;
+	int found = -1;
+	int i;
+
+	for(i = 0; i <= last; ++i)
 	{
-		display_error("Pattern not found");
+		offset = get_part(line, offset, width, part);
+		if((backward || i >= from) && regexec(&vi->re, part, 0, NULL, 0) == 0)
+		{
+			found = i;
+			if(!backward)
+			{
+				break;
+			}
+		}
 	}
+
+	return found;
 }
 
 /* Extracts part of the line replacing all occurrences of horizontal tabulation
@@ -1444,6 +1690,418 @@ get_part(const char line[], int offset, size_t max_len, char part[])
 	return processed_chars;
 }
 
+/* Starts building search index for the current pattern unless there is an
+ * index built for current display settings.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+ensure_search_index(view_info_t *vi)
+{
+	const search_index_t *const idx = vi->index;
+	if(idx != NULL && idx->width == MAX(ui_qv_width(vi->view), 1) &&
+			idx->wrap == vi->wrap && idx->tab_stop == cfg.tab_stop)
+	{
+		return 0;
+	}
+
+	stop_search_index(vi);
+	return start_search_index(vi);
+}
+
+/* Starts building search index from scratch.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+start_search_index(view_info_t *vi)
+{
+	search_index_t *const idx = malloc(sizeof(*idx));
+	if(idx == NULL)
+	{
+		return 1;
+	}
+
+	if(regcomp(&idx->re, vi->pattern, get_regexp_cflags(vi->pattern)) != 0)
+	{
+		regfree(&idx->re);
+		free(idx);
+		return 1;
+	}
+
+	if(pthread_mutex_init(&idx->lock, NULL) != 0)
+	{
+		regfree(&idx->re);
+		free(idx);
+		return 1;
+	}
+	if(pthread_cond_init(&idx->progress, NULL) != 0)
+	{
+		pthread_mutex_destroy(&idx->lock);
+		regfree(&idx->re);
+		free(idx);
+		return 1;
+	}
+
+	idx->lines = vi->lines;
+	idx->nlines = (vi->text == NULL) ? vi->nlines : 0;
+	idx->text = vi->text;
+	idx->width = MAX(ui_qv_width(vi->view), 1);
+	idx->wrap = vi->wrap;
+	idx->tab_stop = cfg.tab_stop;
+	idx->matches = NULL;
+	idx->nmatches = 0;
+	idx->capacity = 0;
+	idx->scanned = 0;
+	idx->has_thread = 0;
+
+	vi->index = idx;
+	vi->shown_matches = -1;
+	run_search_index(idx);
+	return 0;
+}
+
+/* Continues building search index of mapped text from the specified line,
+ * which is used after more data was appended to the file. */
+static void
+resume_search_index(view_info_t *vi, int first)
+{
+	search_index_t *const idx = vi->index;
+	if(idx == NULL)
+	{
+		return;
+	}
+
+	join_search_thread(idx);
+
+	while(idx->nmatches > 0 && idx->matches[idx->nmatches - 1] >= first)
+	{
+		--idx->nmatches;
+	}
+	idx->scanned = MIN(idx->scanned, first);
+
+	vi->shown_matches = -1;
+	run_search_index(idx);
+}
+
+/* Starts thread that searches for matches starting with idx->scanned line. */
+static void
+run_search_index(search_index_t *idx)
+{
+	idx->complete = 0;
+	idx->stop = 0;
+
+	idx->has_thread = (pthread_create(&idx->thread, NULL, &search_lines,
+				idx) == 0);
+	if(!idx->has_thread)
+	{
+		/* Do all the work right away. */
+		(void)search_lines(idx);
+	}
+}
+
+/* Stops building search index and frees it. */
+static void
+stop_search_index(view_info_t *vi)
+{
+	search_index_t *const idx = vi->index;
+	if(idx == NULL)
+	{
+		return;
+	}
+
+	join_search_thread(idx);
+
+	pthread_cond_destroy(&idx->progress);
+	pthread_mutex_destroy(&idx->lock);
+	regfree(&idx->re);
+	free(idx->matches);
+	free(idx);
+
+	vi->index = NULL;
+	vi->search_pending = 0;
+}
+
+/* Requests searching thread to stop and waits for it to finish. */
+static void
+join_search_thread(search_index_t *idx)
+{
+	if(idx->has_thread)
+	{
+		pthread_mutex_lock(&idx->lock);
+		idx->stop = 1;
+		pthread_mutex_unlock(&idx->lock);
+		(void)pthread_join(idx->thread, NULL);
+		idx->has_thread = 0;
+	}
+}
+
+/* Entry point of searching thread, which matches lines in chunks and publishes
+ * results after each chunk.  Returns NULL. */
+static void *
+search_lines(void *arg)
+{
+	search_index_t *const idx = arg;
+	char *const part = malloc(idx->width*4 + 1);
+	char *buf = NULL;
+	size_t buf_len = 0U;
+	int found[SEARCH_CHUNK];
+	int line = idx->scanned;
+	int stop = (part == NULL);
+
+	while(!stop)
+	{
+		int nfound = 0;
+		int last = line + MIN(SEARCH_CHUNK, INT_MAX - line);
+
+		last = (idx->text == NULL) ? MIN(last, idx->nlines)
+		                           : MIN(last, mapped_text_wait(idx->text, last));
+		if(last <= line)
+		{
+			break;
+		}
+
+		for(; line < last; ++line)
+		{
+			const char *const l = (idx->text == NULL)
+			                    ? idx->lines[line]
+			                    : mapped_text_get(idx->text, line, &buf, &buf_len);
+			if(l != NULL && line_matches(idx, l, part))
+			{
+				found[nfound++] = line;
+			}
+		}
+
+		stop = publish_matches(idx, found, nfound, line);
+	}
+
+	free(buf);
+	free(part);
+
+	pthread_mutex_lock(&idx->lock);
+	idx->complete = 1;
+	pthread_cond_broadcast(&idx->progress);
+	pthread_mutex_unlock(&idx->lock);
+	return NULL;
+}
+
+/* Checks whether any part of the line matches the pattern.  The part buffer is
+ * used to hold parts.  Returns non-zero if so, otherwise zero is returned. */
+static int
+line_matches(const search_index_t *idx, const char line[], char part[])
+{
+	int nparts = 1;
+	int offset = 0;
+	int i;
+
+	char *const no_esc = esc_remove(line);
+	if(no_esc == NULL)
+	{
+		return 0;
+	}
+
+	if(idx->wrap)
+	{
+		nparts += (utf8_strsw_with_tabs(line, idx->tab_stop) -
+				esc_str_overhead(line))/idx->width;
+	}
+
+	for(i = 0; i < nparts; ++i)
+	{
+		const char *const end = expand_tabulation(no_esc + offset, idx->width,
+				idx->tab_stop, part);
+		offset = end - no_esc;
+		if(regexec(&idx->re, part, 0, NULL, 0) == 0)
+		{
+			free(no_esc);
+			return 1;
+		}
+	}
+
+	free(no_esc);
+	return 0;
+}
+
+/* Appends matches found by the searching thread to the index and records that
+ * lines up to the scanned one are processed.  Returns non-zero if searching
+ * should stop, otherwise zero is returned. */
+static int
+publish_matches(search_index_t *idx, const int found[], int nfound,
+		int scanned)
+{
+	int stop;
+
+	pthread_mutex_lock(&idx->lock);
+
+	if(idx->nmatches + nfound > idx->capacity)
+	{
+		const int capacity = MAX(idx->capacity*2, idx->nmatches + nfound);
+		int *const matches = reallocarray(idx->matches, capacity,
+				sizeof(*matches));
+		if(matches == NULL)
+		{
+			pthread_mutex_unlock(&idx->lock);
+			return 1;
+		}
+		idx->matches = matches;
+		idx->capacity = capacity;
+	}
+
+	memcpy(idx->matches + idx->nmatches, found, nfound*sizeof(*found));
+	idx->nmatches += nfound;
+	idx->scanned = scanned;
+	stop = idx->stop;
+	pthread_cond_broadcast(&idx->progress);
+
+	pthread_mutex_unlock(&idx->lock);
+	return stop;
+}
+
+/* Looks up the closest matching line after the specified one (or before it for
+ * backward search) waiting for the index for at most wait_ms milliseconds.
+ * Returns 1 if *match was set, 0 if there is no match and -1 if it's not known
+ * yet. */
+static int
+find_indexed_match(view_info_t *vi, int line, int backward, int wait_ms,
+		int *match)
+{
+	search_index_t *const idx = vi->index;
+	struct timeval tv;
+	struct timespec deadline;
+	int result;
+
+	if(idx == NULL)
+	{
+		return 0;
+	}
+
+	gettimeofday(&tv, NULL);
+	deadline.tv_sec = tv.tv_sec;
+	deadline.tv_nsec = (tv.tv_usec + wait_ms*1000L)*1000L;
+	deadline.tv_sec += deadline.tv_nsec/1000000000L;
+	deadline.tv_nsec %= 1000000000L;
+
+	pthread_mutex_lock(&idx->lock);
+	while((result = lookup_match(idx, line, backward, match)) == -1)
+	{
+		if(wait_ms <= 0 ||
+				pthread_cond_timedwait(&idx->progress, &idx->lock, &deadline) ==
+				ETIMEDOUT)
+		{
+			break;
+		}
+	}
+	pthread_mutex_unlock(&idx->lock);
+
+	return result;
+}
+
+/* Looks up the closest matching line in the index.  Should be called with the
+ * lock of the index held.  Returns 1 if *match was set, 0 if there is no match
+ * and -1 if it's not known yet. */
+static int
+lookup_match(const search_index_t *idx, int line, int backward, int *match)
+{
+	/* Find first match that is not above the line (or below it for forward
+	 * search). */
+	const int target = backward ? line : line + 1;
+	int lo = 0, hi = idx->nmatches;
+	while(lo < hi)
+	{
+		const int mid = lo + (hi - lo)/2;
+		if(idx->matches[mid] < target)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if(backward)
+	{
+		if(!idx->complete && idx->scanned < line)
+		{
+			return -1;
+		}
+		if(lo == 0)
+		{
+			return 0;
+		}
+		*match = idx->matches[lo - 1];
+		return 1;
+	}
+
+	if(lo == idx->nmatches)
+	{
+		return idx->complete ? 0 : -1;
+	}
+	*match = idx->matches[lo];
+	return 1;
+}
+
+/* Retrieves number of matches found so far.  *complete is set to non-zero if
+ * search is over, complete can be NULL.  Returns the number. */
+static int
+count_matches(search_index_t *idx, int *complete)
+{
+	int count;
+
+	if(idx == NULL)
+	{
+		if(complete != NULL)
+		{
+			*complete = 1;
+		}
+		return 0;
+	}
+
+	pthread_mutex_lock(&idx->lock);
+	count = idx->nmatches;
+	if(complete != NULL)
+	{
+		*complete = idx->complete;
+	}
+	pthread_mutex_unlock(&idx->lock);
+
+	return count;
+}
+
+/* Handles progress of background search: finishes pending search commands and
+ * updates displayed number of matches. */
+static void
+update_search(view_info_t *vi)
+{
+	int nmatches, complete;
+
+	if(vi->index == NULL)
+	{
+		return;
+	}
+
+	nmatches = count_matches(vi->index, &complete);
+	if(nmatches == vi->shown_matches && complete == vi->shown_complete)
+	{
+		return;
+	}
+	vi->shown_matches = nmatches;
+	vi->shown_complete = complete;
+
+	/* Moving around cancels the search. */
+	if(vi->search_pending > 0 && vi->pending_linev == vi->linev)
+	{
+		curr_stats.save_msg = 0;
+		do_search(vi->search_pending, vi->pending_backward, 0);
+	}
+	else
+	{
+		vi->search_pending = 0;
+	}
+
+	if(curr_stats.save_msg != 1)
+	{
+		curr_stats.save_msg = 0;
+		view_pre();
+	}
+}
+
 /* Displays the error message in the status bar. */
 static void
 display_error(const char error_msg[])
@@ -1620,10 +2278,32 @@ view_check_for_updates(void)
 	{
 		stats_redraw_schedule();
 	}
+
+	if(vle_mode_is(VIEW_MODE))
+	{
+		update_search(vi);
+	}
+}
+
+/* Waits for background search to finish and handles its results. */
+TSTATIC void
+wait_for_search(void)
+{
+	if(vi->index != NULL)
+	{
+		pthread_mutex_lock(&vi->index->lock);
+		while(!vi->index->complete)
+		{
+			pthread_cond_wait(&vi->index->progress, &vi->index->lock);
+		}
+		pthread_mutex_unlock(&vi->index->lock);
+	}
+	update_search(vi);
 }
 
-/* Forwards the view if underlying file changed.  Returns non-zero if reload
- * occurred, otherwise zero is returned. */
+/* Forwards the view if underlying file changed.  Mapped files are extended
+ * with appended data instead of being reloaded.  Returns non-zero if view needs
+ * to be redrawn, otherwise zero is returned. */
 static int
 forward_if_changed(view_info_t *vi)
 {
@@ -1634,6 +2314,37 @@ forward_if_changed(view_info_t *vi)
 		return 0;
 	}
 
+	if(vi->text != NULL)
+	{
+		int nkept, complete;
+
+		/* Searching thread would prevent remapping the file. */
+		(void)count_matches(vi->index, &complete);
+		if(!complete)
+		{
+			return 0;
+		}
+
+		switch(mapped_text_update(vi->text, vi->filename, &nkept))
+		{
+			case MTU_SAME:
+				return 0;
+			case MTU_GREW:
+				forget_lines(vi, nkept);
+				resume_search_index(vi, nkept);
+				(void)scroll_to_bottom(vi);
+				return 1;
+			case MTU_REPLACED:
+				reload_view(vi, SILENT);
+				if(vi->text != NULL && !mapped_text_is_valid(vi->text))
+				{
+					/* Failed to reload truncated file, there is nothing to scroll. */
+					return 0;
+				}
+				return scroll_to_bottom(vi);
+		}
+	}
+
 	if(filemon_from_file(vi->filename, FMT_MODIFIED, &mon) != 0)
 	{
 		return 0;
@@ -1649,11 +2360,27 @@ forward_if_changed(view_info_t *vi)
 	return scroll_to_bottom(vi);
 }
 
+/* Drops information about lines of mapped text starting with the specified
+ * one, so that they are retrieved anew. */
+static void
+forget_lines(view_info_t *vi, int first)
+{
+	vi->line_buf_num = -1;
+	vi->nlines = MIN(vi->nlines, first);
+	if(vi->nwidths > vi->nlines)
+	{
+		vi->nwidths = vi->nlines;
+		vi->nlinesv = vi->widths[vi->nwidths][0];
+	}
+}
+
 /* Scrolls view to the bottom if there is any room for that.  Returns non-zero
  * if position was changed, otherwise zero is returned. */
 static int
 scroll_to_bottom(view_info_t *vi)
 {
+	ensure_widths(vi, INT_MAX);
+
 	if(vi->linev + 1 + ui_qv_height(vi->view) > vi->nlinesv)
 	{
 		return 0;
@@ -19,6 +19,8 @@
 #ifndef VIFM__MODES__VIEW_H__
 #define VIFM__MODES__VIEW_H__
 
+#include "../utils/test_helpers.h"
+
 struct view_t;
 
 /* Holds state of a single view mode window. */
@@ -86,6 +88,10 @@ const char * view_detached_get_viewer(void);
 /* Frees view info.  The parameter can be NULL. */
 void view_info_free(view_info_t *vi);
 
+TSTATIC_DEFS(
+	void wait_for_search(void);
+)
+
 #endif /* VIFM__MODES__VIEW_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
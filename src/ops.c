@@ -83,6 +83,7 @@ ConflictAction;
 /* Type of function that implements single operation. */
 typedef int (*op_func)(ops_t *ops, void *data, const char *src, const char *dst);
 
+static int op_changes_sizes(OPS op);
 static int op_none(ops_t *ops, void *data, const char *src, const char *dst);
 static int op_remove(ops_t *ops, void *data, const char *src, const char *dst);
 static int op_removesl(ops_t *ops, void *data, const char *src,
@@ -173,6 +174,7 @@ ops_alloc(OPS main_op, int bg, const char descr[], const char base_dir[],
 	update_string(&ops->delete_prg, cfg.delete_prg);
 	ops->use_system_calls = cfg.use_system_calls;
 	ops->fast_file_cloning = cfg.fast_file_cloning;
+	ops->io_threads = cfg.io_threads;
 	ops->base_dir = strdup(base_dir);
 	ops->target_dir = strdup(target_dir);
 	ops->bg = bg;
@@ -268,7 +270,44 @@ int
 perform_operation(OPS op, ops_t *ops, void *data, const char src[],
 		const char dst[])
 {
-	return op_funcs[op](ops, data, src, dst);
+	const int result = op_funcs[op](ops, data, src, dst);
+	if(result == 0 && op_changes_sizes(op))
+	{
+		if(src != NULL)
+		{
+			dcache_invalidate(src);
+		}
+		if(dst != NULL)
+		{
+			dcache_invalidate(dst);
+		}
+	}
+	return result;
+}
+
+/* Checks whether operation can affect sizes of directories or number of items
+ * in them.  Returns non-zero if so, otherwise zero is returned. */
+static int
+op_changes_sizes(OPS op)
+{
+	switch(op)
+	{
+		case OP_NONE:
+		case OP_USR:
+		case OP_CHOWN:
+		case OP_CHGRP:
+#ifndef _WIN32
+		case OP_CHMOD:
+		case OP_CHMODR:
+#else
+		case OP_ADDATTR:
+		case OP_SUBATTR:
+#endif
+			return 0;
+
+		default:
+			return 1;
+	}
 }
 
 static int
@@ -510,6 +549,7 @@ op_cp(ops_t *ops, void *data, const char src[], const char dst[],
 		.arg2.dst = dst,
 		.arg3.crs = ca_to_crs(conflict_action),
 		.arg4.fast_file_cloning = fast_file_cloning,
+		.arg5.max_jobs = (ops == NULL) ? cfg.io_threads : ops->io_threads,
 	};
 	return exec_io_op(ops, &ior_cp, &args, data == NULL);
 }
@@ -611,6 +651,7 @@ op_mv(ops_t *ops, void *data, const char src[], const char dst[],
 			.arg3.crs = ca_to_crs(conflict_action),
 			/* It's safe to always use fast file cloning on moving files. */
 			.arg4.fast_file_cloning = 1,
+			.arg5.max_jobs = (ops == NULL) ? cfg.io_threads : ops->io_threads,
 		};
 		result = exec_io_op(ops, &ior_mv, &args, data == NULL);
 	}
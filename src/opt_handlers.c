@@ -33,6 +33,7 @@
 #include "cfg/config.h"
 #include "engine/options.h"
 #include "engine/text_buffer.h"
+#include "int/file_magic.h"
 #include "int/term_title.h"
 #include "ui/fileview.h"
 #include "ui/quickview.h"
@@ -62,6 +63,9 @@
 /* Default value of 'viewcolumns' option, used when it's empty. */
 #define DEFAULT_VIEW_COLUMNS "-{name},{}"
 
+/* Upper limit on value of 'iothreads' option. */
+#define MAX_IO_THREADS 256
+
 typedef union
 {
 	int *bool_val;
@@ -140,12 +144,14 @@ static void iec_handler(OPT_OP op, optval_t val);
 static void ignorecase_handler(OPT_OP op, optval_t val);
 static void incsearch_handler(OPT_OP op, optval_t val);
 static void iooptions_handler(OPT_OP op, optval_t val);
+static void iothreads_handler(OPT_OP op, optval_t val);
 static void laststatus_handler(OPT_OP op, optval_t val);
 static void lines_handler(OPT_OP op, optval_t val);
 static void locateprg_handler(OPT_OP op, optval_t val);
 #ifndef _WIN32
 static void mediaprg_handler(OPT_OP op, optval_t val);
 #endif
+static void mimecachesize_handler(OPT_OP op, optval_t val);
 static void mintimeoutlen_handler(OPT_OP op, optval_t val);
 static void scroll_line_down(view_t *view);
 static void quickview_handler(OPT_OP op, optval_t val);
@@ -528,6 +534,8 @@ static const char *vifminfo_set[][2] = {
 	[BIT(VINFO_REGISTERS)] = { "registers", "contents of registers" },
 	[BIT(VINFO_PHISTORY)]  = { "phistory",  "prompt history" },
 	[BIT(VINFO_FHISTORY)]  = { "fhistory",  "local filter history" },
+	[BIT(VINFO_DCACHE)]    = { "dcache",    "sizes of directories" },
+	[BIT(VINFO_DIGESTS)]   = { "digests",   "digests of file contents" },
 };
 ARRAY_GUARD(vifminfo_set, NUM_VINFO);
 
@@ -672,6 +680,10 @@ options[] = {
 		NULL,
 	  { .init = &init_iooptions },
 	},
+	{ "iothreads", "", "number of threads of file operations",
+	  OPT_INT, 0, NULL, &iothreads_handler, NULL,
+	  { .ref.int_val = &cfg.io_threads },
+	},
 	{ "laststatus", "ls", "visibility of status bar",
 	  OPT_BOOL, 0, NULL, &laststatus_handler, NULL,
 	  { .ref.bool_val = &cfg.display_statusline },
@@ -690,6 +702,10 @@ options[] = {
 	  { .ref.str_val = &cfg.media_prg },
 	},
 #endif
+	{ "mimecachesize", "", "number of cached mime-types",
+	  OPT_INT, 0, NULL, &mimecachesize_handler, NULL,
+	  { .ref.int_val = &cfg.mime_cache_size },
+	},
 	{ "mintimeoutlen", "", "delay between input polls",
 	  OPT_INT, 0, NULL, &mintimeoutlen_handler, NULL,
 	  { .ref.int_val = &cfg.min_timeout_len },
@@ -2111,6 +2127,22 @@ iooptions_handler(OPT_OP op, optval_t val)
 	cfg.fast_file_cloning = ((val.set_items & 1) != 0);
 }
 
+/* Handles changes of 'iothreads'.  Validates and updates configuration
+ * value. */
+static void
+iothreads_handler(OPT_OP op, optval_t val)
+{
+	if(val.int_val < 0 || val.int_val > MAX_IO_THREADS)
+	{
+		vle_tb_append_linef(vle_err, "Invalid number of threads: %d", val.int_val);
+		error = 1;
+		vle_opts_restore_default("iothreads", OPT_GLOBAL);
+		return;
+	}
+
+	cfg.io_threads = val.int_val;
+}
+
 static void
 laststatus_handler(OPT_OP op, optval_t val)
 {
@@ -2180,6 +2212,23 @@ mediaprg_handler(OPT_OP op, optval_t val)
 
 #endif
 
+/* Handles changes of 'mimecachesize'.  Validates the value and shrinks the
+ * cache if necessary. */
+static void
+mimecachesize_handler(OPT_OP op, optval_t val)
+{
+	if(val.int_val < 0)
+	{
+		vle_tb_append_linef(vle_err, "Argument must be >= 0: %d", val.int_val);
+		error = 1;
+		vle_opts_restore_default("mimecachesize", OPT_GLOBAL);
+		return;
+	}
+
+	cfg.mime_cache_size = val.int_val;
+	mimetype_cache_resize(cfg.mime_cache_size);
+}
+
 /* Minimum period on waiting for the input.  Works together with timeoutlen. */
 static void
 mintimeoutlen_handler(OPT_OP op, optval_t val)
@@ -23,11 +23,15 @@
 
 #include <assert.h> /* assert() */
 #include <ctype.h>
-#include <stdlib.h> /* abs() */
-#include <string.h> /* strcmp() strrchr() */
+#include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uint64_t */
+#include <stdlib.h> /* abs() free() malloc() */
+#include <string.h> /* memcpy() strcmp() strdup() strrchr() */
 
 #include "cfg/config.h"
 #include "compat/fs_limits.h"
+#include "compat/pthread.h"
+#include "compat/reallocarray.h"
 #include "ui/ui.h"
 #include "utils/dynarray.h"
 #include "utils/fs.h"
@@ -43,29 +47,128 @@
 #include "status.h"
 #include "types.h"
 
+/* Lists shorter than this are sorted on a single thread. */
+#define PAR_SORT_THRESHOLD 16384
+
+/* Maximum number of threads used for sorting. */
+#define MAX_SORT_THREADS 8
+
+/* Cache of group keys is emptied when it grows larger than this many entries
+ * above twice the size of the list being sorted. */
+#define GROUP_KEYS_SLACK 1024
+
+/* Single key of composite sorting. */
+typedef struct
+{
+	SortingKey type; /* Type of the key. */
+	int descending;  /* Whether order by this key is reversed. */
+	int group;       /* Index of the group for SK_BY_GROUPS key. */
+}
+sort_key_t;
+
+/* Value of a sorting key precomputed for an entry. */
+typedef struct
+{
+	const char *str;  /* String form of the key, might be owned by the value. */
+	const char *orig; /* Original string for case-insensitive comparison. */
+	uint64_t num;     /* Numeric form of the key. */
+}
+key_value_t;
+
+/* Entry prepared for sorting. */
+typedef struct
+{
+	const dir_entry_t *entry; /* The entry. */
+	key_value_t *values;      /* Values of keys of the entry. */
+	int index;                /* Initial position of the entry. */
+	int is_dir;               /* Whether entry is a directory. */
+	int is_parent;            /* Whether entry is a ".." directory. */
+}
+sort_item_t;
+
+/* Keys of composite sorting in the order of their significance. */
+typedef struct
+{
+	sort_key_t *keys; /* List of keys. */
+	int nkeys;        /* Number of keys. */
+}
+sort_keys_t;
+
+/* Keys of sorting groups extracted from a single file name. */
+typedef struct
+{
+	char *name;  /* Name of the file. */
+	char **keys; /* Matched part of the name for each of the groups. */
+}
+group_key_t;
+
+typedef struct group_keys_t group_keys_t;
+
+/* Keys of sorting groups extracted from file names of a view.  Entries of the
+ * view refer to elements of this cache by index. */
+struct group_keys_t
+{
+	char *groups;     /* Value of 'sortgroups' keys were extracted for. */
+	char **exprs;     /* Regular expressions of the groups. */
+	int ngroups;      /* Number of groups. */
+	regex_t *regexes; /* Compiled groups or NULL if not compiled yet. */
+	char *compiled;   /* Whether compilation of each group has succeeded. */
+
+	group_key_t *slots; /* Extracted keys. */
+	int nslots;         /* Number of used slots. */
+	int capacity;       /* Number of allocated slots. */
+};
+
+/* Part of parallel sorting performed by a thread. */
+typedef struct
+{
+	sort_item_t *items; /* Items to process. */
+	sort_item_t *tmp;   /* Buffer for merging. */
+	size_t mid;         /* End of the first sorted run (for merging). */
+	size_t n;           /* Number of items. */
+}
+sort_part_t;
+
 static void sort_tree_slice(dir_entry_t *entries, const dir_entry_t *children,
 		size_t nchildren, int root);
 static void sort_sequence(dir_entry_t *entries, size_t nentries);
-static void sort_by_groups(dir_entry_t *entries, size_t nentries);
-static void sort_by_key(dir_entry_t *entries, size_t nentries, char key,
-		void *data);
-static int sort_dir_list(const void *one, const void *two);
+static int make_sort_keys(sort_keys_t *keys);
+static void free_sort_keys(sort_keys_t *keys);
+static int add_sort_key(sort_keys_t *keys, char key, int group);
+static int extract_group_keys(dir_entry_t entries[], size_t nentries,
+		size_t nexpected);
+static int add_group_keys(dir_entry_t entries[], size_t nentries);
+static int prepare_group_keys(size_t nexpected);
+static void clear_group_keys(group_keys_t *cache);
+static void drop_group_slots(group_keys_t *cache);
+static int compile_groups(group_keys_t *cache);
+static int get_group_key(group_keys_t *cache, dir_entry_t *entry);
+static const char * group_key_of(const dir_entry_t *entry, int group);
+static void fill_key_value(const sort_key_t *key, const sort_item_t *item,
+		key_value_t *value);
+static void free_key_value(const sort_key_t *key, key_value_t *value);
+static void fill_items(dir_entry_t entries[], size_t nentries, int first_index,
+		const sort_keys_t *keys, sort_item_t items[], key_value_t values[]);
+static void free_values(const sort_keys_t *keys, key_value_t values[],
+		size_t nitems);
+static void sort_items(sort_item_t items[], size_t n);
+static void * sort_part(void *arg);
+static void * merge_part(void *arg);
+static int sort_items_cmp(const void *a, const void *b);
+static int compare_items(const sort_item_t *a, const sort_item_t *b);
+static int compare_values(const sort_key_t *key, const sort_item_t *a,
+		const key_value_t *av, const sort_item_t *b, const key_value_t *bv);
+static int compare_extensions(SortingKey type, const sort_item_t *a,
+		const key_value_t *av, const sort_item_t *b, const key_value_t *bv);
+static int compare_prepared_names(const key_value_t *a, const key_value_t *b,
+		int ignore_case);
 TSTATIC int strnumcmp(const char s[], const char t[]);
 #if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
 static int vercmp(const char s[], const char t[]);
 #else
 static char * skip_leading_zeros(const char str[]);
 #endif
-static int compare_entry_names(const dir_entry_t *a, const dir_entry_t *b,
-		int ignore_case);
-static int compare_full_file_names(const char s[], const char t[],
-		int ignore_case);
 static int compare_file_names(const char s[], const char t[], int ignore_case);
-static int compare_file_sizes(const dir_entry_t *f, const dir_entry_t *s);
-static int compare_item_count(const dir_entry_t *f, int fdir,
-		const dir_entry_t *s, int sdir);
-static int compare_group(const char f[], const char s[], regex_t *regex);
-static int compare_targets(const dir_entry_t *f, const dir_entry_t *s);
 
 /* View which is being sorted. */
 static view_t *view;
@@ -75,12 +178,8 @@ static const signed char *view_sort;
 static const char *view_sort_groups;
 /* Whether the view displays custom file list. */
 static int custom_view;
-/* Whether it's descending sort. */
-static int sort_descending;
-/* Key used to sort entries in current sorting round. */
-static SortingKey sort_type;
-/* Sorting key specific data. */
-static void *sort_data;
+/* Keys of composite sorting, which is in progress. */
+static const sort_keys_t *sort_keys;
 
 void
 sort_view(view_t *v)
@@ -174,6 +273,34 @@ sort_tree_slice(dir_entry_t *entries, const dir_entry_t *children,
 	}
 }
 
+void
+sort_tree(view_t *v, dir_entry_t entries[], int nentries)
+{
+	dir_entry_t *sorted;
+
+	if(v->sort[0] > SK_LAST)
+	{
+		/* Completely skip sorting if primary key isn't set. */
+		return;
+	}
+
+	view = v;
+	view_sort = v->sort;
+	view_sort_groups = v->sort_groups;
+	custom_view = flist_custom_active(v);
+
+	sorted = reallocarray(NULL, nentries, sizeof(*sorted));
+	if(sorted == NULL)
+	{
+		/* Just do nothing on memory error. */
+		return;
+	}
+
+	sort_tree_slice(sorted, entries, nentries, 1);
+	memcpy(entries, sorted, nentries*sizeof(*entries));
+	free(sorted);
+}
+
 void
 sort_entries(view_t *v, entries_t entries)
 {
@@ -191,411 +318,1004 @@ sort_entries(view_t *v, entries_t entries)
 	sort_sequence(entries.entries, entries.nentries);
 }
 
-/* Sorts sequence of file entries (plain list, not tree). */
-static void
-sort_sequence(dir_entry_t *entries, size_t nentries)
+int
+sort_insert_entries(view_t *v, dir_entry_t entries[], int nentries)
 {
-	int i = SK_COUNT;
-	while(--i >= 0)
+	dir_entry_t *merged;
+	sort_keys_t keys;
+	sort_item_t *items;
+	key_value_t *values;
+	const int total = v->list_rows + nentries;
+	int i, j, k;
+
+	assert(!flist_custom_active(v) && "Only flat lists are supported.");
+
+	merged = dynarray_extend(NULL, total*sizeof(*merged));
+	if(merged == NULL)
 	{
-		const char sorting_key = view_sort[i];
+		return 1;
+	}
 
-		if(abs(sorting_key) > SK_LAST)
+	if(v->sort[0] > SK_LAST)
+	{
+		/* No particular order, just append new entries. */
+		memcpy(merged, v->dir_entry, v->list_rows*sizeof(*merged));
+		memcpy(merged + v->list_rows, entries, nentries*sizeof(*merged));
+
+		dynarray_free(v->dir_entry);
+		v->dir_entry = merged;
+		v->list_rows += nentries;
+		return 0;
+	}
+
+	view = v;
+	view_sort = v->sort;
+	view_sort_groups = v->sort_groups;
+	custom_view = 0;
+
+	/* Keys of old entries are most likely to be in the cache already. */
+	if(ui_view_sort_list_contains(view_sort, SK_BY_GROUPS) &&
+			(extract_group_keys(v->dir_entry, v->list_rows, total) != 0 ||
+			 add_group_keys(entries, nentries) != 0))
+	{
+		dynarray_free(merged);
+		return 1;
+	}
+
+	if(make_sort_keys(&keys) != 0)
+	{
+		dynarray_free(merged);
+		return 1;
+	}
+
+	items = reallocarray(NULL, total, sizeof(*items));
+	values = reallocarray(NULL, total, keys.nkeys*sizeof(*values));
+	if(items == NULL || values == NULL)
+	{
+		free(items);
+		free(values);
+		free_sort_keys(&keys);
+		dynarray_free(merged);
+		return 1;
+	}
+
+	/* Old entries precede new ones in initial order, so they win on ties. */
+	fill_items(v->dir_entry, v->list_rows, 0, &keys, items, values);
+	fill_items(entries, nentries, v->list_rows, &keys, &items[v->list_rows],
+			&values[v->list_rows*keys.nkeys]);
+
+	sort_keys = &keys;
+	sort_items(&items[v->list_rows], nentries);
+
+	/* Merge two sorted sequences of items. */
+	i = 0;
+	j = v->list_rows;
+	k = 0;
+	while(i < v->list_rows || j < total)
+	{
+		if(j == total ||
+				(i < v->list_rows && compare_items(&items[i], &items[j]) < 0))
 		{
-			continue;
+			merged[k++] = *items[i++].entry;
 		}
-
-		if(sorting_key == SK_BY_GROUPS)
+		else
 		{
-			sort_by_groups(entries, nentries);
-			continue;
+			merged[k++] = *items[j++].entry;
 		}
-
-		sort_by_key(entries, nentries, sorting_key, NULL);
 	}
+	sort_keys = NULL;
 
-	if(!ui_view_sort_list_contains(view_sort, SK_BY_DIR))
+	free_values(&keys, values, total);
+	free(values);
+	free(items);
+	free_sort_keys(&keys);
+
+	dynarray_free(v->dir_entry);
+	v->dir_entry = merged;
+	v->list_rows = k;
+	return 0;
+}
+
+void
+sort_drop_group_keys(view_t *v)
+{
+	group_keys_t *const cache = v->group_keys;
+	if(cache == NULL)
 	{
-		sort_by_key(entries, nentries, SK_BY_DIR, NULL);
+		return;
 	}
+
+	clear_group_keys(cache);
+	free(cache->slots);
+	free(cache);
+	v->group_keys = NULL;
 }
 
-/* Sorts specified range of entries according to sorting groups option. */
+/* Sorts sequence of file entries (plain list, not tree).  Values of all keys
+ * are computed once per entry, after which entries are ordered by a single
+ * stable sort by all keys at once, which yields the same result as stable
+ * sorting by each key starting with the least significant one. */
 static void
-sort_by_groups(dir_entry_t *entries, size_t nentries)
+sort_sequence(dir_entry_t *entries, size_t nentries)
 {
-	char **groups = NULL;
-	int ngroups = 0;
-	const int optimize = (view_sort_groups != view->sort_groups_g);
-	int i;
+	sort_keys_t keys;
+	sort_item_t *items;
+	key_value_t *values;
+	dir_entry_t *sorted;
+	size_t i;
 
-	char *const copy = strdup(view_sort_groups);
-	char *group = copy, *state = NULL;
-	while((group = split_and_get(group, ',', &state)) != NULL)
+	if(nentries < 2U)
 	{
-		ngroups = add_to_string_array(&groups, ngroups, 1, group);
+		return;
 	}
-	free(copy);
 
-	for(i = ngroups - (optimize ? 1 : 0); i >= 1; --i)
+	if(ui_view_sort_list_contains(view_sort, SK_BY_GROUPS) &&
+			extract_group_keys(entries, nentries, nentries) != 0)
 	{
-		regex_t regex;
-		(void)regcomp(&regex, groups[i], REG_EXTENDED | REG_ICASE);
-		sort_by_key(entries, nentries, SK_BY_GROUPS, &regex);
-		regfree(&regex);
+		/* Just do nothing on memory error. */
+		return;
 	}
-	if(optimize && ngroups != 0)
+
+	if(make_sort_keys(&keys) != 0)
 	{
-		sort_by_key(entries, nentries, SK_BY_GROUPS, &view->primary_group);
+		return;
 	}
 
-	free_string_array(groups, ngroups);
-}
+	items = reallocarray(NULL, nentries, sizeof(*items));
+	values = reallocarray(NULL, nentries, keys.nkeys*sizeof(*values));
+	sorted = reallocarray(NULL, nentries, sizeof(*sorted));
+	if(items == NULL || values == NULL || sorted == NULL)
+	{
+		/* Just do nothing on memory error. */
+		free(items);
+		free(values);
+		free(sorted);
+		free_sort_keys(&keys);
+		return;
+	}
 
-/* Sorts specified range of entries by the key in a stable way. */
-static void
-sort_by_key(dir_entry_t *entries, size_t nentries, char key, void *data)
-{
-	sort_descending = (key < 0);
-	sort_type = (SortingKey)abs(key);
-	sort_data = data;
+	fill_items(entries, nentries, 0, &keys, items, values);
+
+	sort_keys = &keys;
+	sort_items(items, nentries);
+	sort_keys = NULL;
 
-	unsigned int i;
 	for(i = 0U; i < nentries; ++i)
 	{
-		entries[i].tag = i;
+		sorted[i] = *items[i].entry;
 	}
+	memcpy(entries, sorted, nentries*sizeof(*entries));
 
-	safe_qsort(entries, nentries, sizeof(*entries), &sort_dir_list);
-}
-
-/* Compares file names containing numbers correctly. */
-TSTATIC int
-strnumcmp(const char s[], const char t[])
-{
-#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
-	return vercmp(s, t);
-#else
-	const char *new_s = skip_leading_zeros(s);
-	const char *new_t = skip_leading_zeros(t);
-	return strverscmp(new_s, new_t);
-#endif
+	free_values(&keys, values, nentries);
+	free(sorted);
+	free(values);
+	free(items);
+	free_sort_keys(&keys);
 }
 
-#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
+/* Builds list of keys of composite sorting according to sorting settings of the
+ * view.  Expects group keys to be extracted if they are used.  Returns zero on
+ * success, otherwise non-zero is returned. */
 static int
-vercmp(const char s[], const char t[])
+make_sort_keys(sort_keys_t *keys)
 {
-	while(*s != '\0' && *t != '\0')
+	int i;
+	int error = 0;
+
+	keys->keys = NULL;
+	keys->nkeys = 0;
+
+	if(!ui_view_sort_list_contains(view_sort, SK_BY_DIR))
 	{
-		if(isdigit(*s) && isdigit(*t))
-		{
-			int num_a, num_b;
-			const char *os = s, *ot = t;
-			char *p;
+		error |= add_sort_key(keys, SK_BY_DIR, -1);
+	}
 
-			num_a = strtol(s, &p, 10);
-			s = p;
+	for(i = 0; i < SK_COUNT && !error; ++i)
+	{
+		const char sorting_key = view_sort[i];
+		int j;
 
-			num_b = strtol(t, &p, 10);
-			t = p;
+		if(abs(sorting_key) > SK_LAST)
+		{
+			continue;
+		}
 
-			if(num_a != num_b)
-				return num_a - num_b;
-			else if(*os != *ot)
-				return *os - *ot;
+		if(abs(sorting_key) != SK_BY_GROUPS)
+		{
+			error |= add_sort_key(keys, sorting_key, -1);
+			continue;
 		}
-		else if(*s == *t)
+
+		/* Each group is a separate key. */
+		for(j = 0; j < view->group_keys->ngroups && !error; ++j)
 		{
-			s++;
-			t++;
+			error |= add_sort_key(keys, sorting_key, j);
 		}
-		else
-			break;
 	}
 
-	return *s - *t;
+	if(error)
+	{
+		free_sort_keys(keys);
+		return 1;
+	}
+	return 0;
 }
-#else
-/* Skips all zeros in front of numbers (correctly handles zero).  Returns str, a
- * pointer to '0' or a pointer to non-zero digit. */
-static char *
-skip_leading_zeros(const char str[])
+
+/* Frees resources allocated by make_sort_keys(). */
+static void
+free_sort_keys(sort_keys_t *keys)
 {
-	while(str[0] == '0' && isdigit(str[1]))
+	free(keys->keys);
+}
+
+/* Appends key to the list of sorting keys.  Returns zero on success, otherwise
+ * non-zero is returned. */
+static int
+add_sort_key(sort_keys_t *keys, char key, int group)
+{
+	sort_key_t *const new_keys = reallocarray(keys->keys, keys->nkeys + 1,
+			sizeof(*keys->keys));
+	if(new_keys == NULL)
 	{
-		str++;
+		return 1;
 	}
-	return (char *)str;
+
+	keys->keys = new_keys;
+	keys->keys[keys->nkeys].type = (SortingKey)abs(key);
+	keys->keys[keys->nkeys].descending = (key < 0);
+	keys->keys[keys->nkeys].group = group;
+	++keys->nkeys;
+	return 0;
 }
-#endif
 
+/* Makes sure that keys of sorting groups are cached for all entries, those
+ * that are cached already are reused.  nexpected is the number of entries the
+ * view is expected to hold.  Returns zero on success, otherwise non-zero is
+ * returned. */
 static int
-sort_dir_list(const void *one, const void *two)
+extract_group_keys(dir_entry_t entries[], size_t nentries, size_t nexpected)
 {
-	/* TODO: refactor this function sort_dir_list(). */
-
-	int retval;
-	const dir_entry_t *const first = one;
-	const dir_entry_t *const second = two;
+	if(prepare_group_keys(nexpected) != 0)
+	{
+		return 1;
+	}
 
-	const int first_is_dir = fentry_is_dir(first);
-	const int second_is_dir = fentry_is_dir(second);
+	return add_group_keys(entries, nentries);
+}
 
-	if(first_is_dir && is_parent_dir(first->name))
+/* Makes sure that keys of sorting groups are cached for all entries without
+ * dropping any of the cached keys.  Returns zero on success, otherwise non-zero
+ * is returned. */
+static int
+add_group_keys(dir_entry_t entries[], size_t nentries)
+{
+	size_t i;
+	for(i = 0U; i < nentries; ++i)
 	{
-		return -1;
+		if(get_group_key(view->group_keys, &entries[i]) != 0)
+		{
+			return 1;
+		}
 	}
-	if(second_is_dir && is_parent_dir(second->name))
+	return 0;
+}
+
+/* Makes group keys cache of the view correspond to the current value of
+ * 'sortgroups' dropping outdated or excessive data.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+prepare_group_keys(size_t nexpected)
+{
+	group_keys_t *cache = view->group_keys;
+	char *copy, *group, *state = NULL;
+
+	if(cache == NULL)
 	{
-		return 1;
+		cache = calloc(1, sizeof(*cache));
+		if(cache == NULL)
+		{
+			return 1;
+		}
+		view->group_keys = cache;
 	}
 
-	retval = 0;
-	switch(sort_type)
+	if(cache->groups != NULL && strcmp(cache->groups, view_sort_groups) == 0)
 	{
-		char *pfirst, *psecond;
+		/* Don't let cache grow indefinitely as directories change. */
+		if((size_t)cache->nslots > 2U*nexpected + GROUP_KEYS_SLACK)
+		{
+			drop_group_slots(cache);
+		}
+		return 0;
+	}
 
-		case SK_BY_NAME:
-		case SK_BY_INAME:
-			if(custom_view)
-			{
-				retval = compare_entry_names(first, second, sort_type == SK_BY_INAME);
-			}
-			else
-			{
-				retval = compare_full_file_names(first->name, second->name,
-						sort_type == SK_BY_INAME);
-			}
-			break;
+	clear_group_keys(cache);
 
-		case SK_BY_DIR:
-			if(first_is_dir != second_is_dir)
-			{
-				retval = first_is_dir ? -1 : 1;
-			}
-			break;
+	cache->groups = strdup(view_sort_groups);
+	copy = strdup(view_sort_groups);
+	if(cache->groups == NULL || copy == NULL)
+	{
+		free(copy);
+		return 1;
+	}
 
-		case SK_BY_TYPE:
-			retval = strcmp(get_type_str(first->type), get_type_str(second->type));
-			break;
+	group = copy;
+	while((group = split_and_get(group, ',', &state)) != NULL)
+	{
+		cache->ngroups = add_to_string_array(&cache->exprs, cache->ngroups, 1,
+				group);
+	}
+	free(copy);
+	return 0;
+}
 
-		case SK_BY_FILEEXT:
-		case SK_BY_EXTENSION:
-			pfirst = strrchr(first->name,  '.');
-			psecond = strrchr(second->name, '.');
+/* Frees all data of the cache except for the array of slots. */
+static void
+clear_group_keys(group_keys_t *cache)
+{
+	int i;
 
-			if(first_is_dir && second_is_dir && sort_type == SK_BY_FILEEXT)
-			{
-				retval = compare_file_names(first->name, second->name, 0);
-			}
-			else if(first_is_dir != second_is_dir && sort_type == SK_BY_FILEEXT)
-			{
-				retval = first_is_dir ? -1 : 1;
-			}
-			else if(pfirst && psecond)
+	drop_group_slots(cache);
+
+	if(cache->regexes != NULL)
+	{
+		for(i = 0; i < cache->ngroups; ++i)
+		{
+			if(cache->compiled[i])
 			{
-				if(pfirst == first->name && psecond != second->name)
-				{
-					retval = -1;
-				}
-				else if(pfirst != first->name && psecond == second->name)
-				{
-					retval = 1;
-				}
-				else
-				{
-					retval = compare_file_names(++pfirst, ++psecond, 0);
-				}
+				regfree(&cache->regexes[i]);
 			}
-			else if(pfirst || psecond)
-				retval = pfirst ? -1 : 1;
-			else
-				retval = compare_file_names(first->name, second->name, 0);
-			break;
-
-		case SK_BY_SIZE:
-			retval = compare_file_sizes(first, second);
-			break;
+		}
+	}
+	free(cache->regexes);
+	cache->regexes = NULL;
+	free(cache->compiled);
+	cache->compiled = NULL;
 
-		case SK_BY_NITEMS:
-			retval = compare_item_count(first, first_is_dir, second, second_is_dir);
-			break;
+	free_string_array(cache->exprs, cache->ngroups);
+	cache->exprs = NULL;
+	cache->ngroups = 0;
 
-		case SK_BY_GROUPS:
-			retval = compare_group(first->name, second->name, sort_data);
-			break;
+	update_string(&cache->groups, NULL);
+}
 
-		case SK_BY_TARGET:
-			retval = compare_targets(first, second);
-			break;
+/* Frees all extracted keys. */
+static void
+drop_group_slots(group_keys_t *cache)
+{
+	int i;
+	for(i = 0; i < cache->nslots; ++i)
+	{
+		free(cache->slots[i].name);
+		free_string_array(cache->slots[i].keys, cache->ngroups);
+	}
+	cache->nslots = 0;
+}
 
-		case SK_BY_TIME_MODIFIED:
-			retval = first->mtime - second->mtime;
-			break;
+/* Compiles regular expressions of groups on first use.  Returns zero on
+ * success, otherwise non-zero is returned. */
+static int
+compile_groups(group_keys_t *cache)
+{
+	int i;
 
-		case SK_BY_TIME_ACCESSED:
-			retval = first->atime - second->atime;
-			break;
+	if(cache->regexes != NULL || cache->ngroups == 0)
+	{
+		return 0;
+	}
 
-		case SK_BY_TIME_CHANGED:
-			retval = first->ctime - second->ctime;
-			break;
+	cache->regexes = reallocarray(NULL, cache->ngroups, sizeof(*cache->regexes));
+	cache->compiled = malloc(cache->ngroups);
+	if(cache->regexes == NULL || cache->compiled == NULL)
+	{
+		free(cache->regexes);
+		cache->regexes = NULL;
+		free(cache->compiled);
+		cache->compiled = NULL;
+		return 1;
+	}
+
+	for(i = 0; i < cache->ngroups; ++i)
+	{
+		cache->compiled[i] = (regcomp(&cache->regexes[i], cache->exprs[i],
+					REG_EXTENDED | REG_ICASE) == 0);
+	}
+	return 0;
+}
+
+/* Makes sure keys of the entry are in the cache and entry refers to them.
+ * Returns zero on success, otherwise non-zero is returned. */
+static int
+get_group_key(group_keys_t *cache, dir_entry_t *entry)
+{
+	const int idx = entry->group_key;
+	group_key_t *slot;
+	int i;
+
+	/* Index is validated by name because copies of entries outlive the cache
+	 * and keys depend only on the name. */
+	if(idx >= 0 && idx < cache->nslots &&
+			strcmp(cache->slots[idx].name, entry->name) == 0)
+	{
+		return 0;
+	}
+
+	if(compile_groups(cache) != 0)
+	{
+		return 1;
+	}
+
+	if(cache->nslots == cache->capacity)
+	{
+		const int capacity = (cache->capacity == 0 ? 64 : cache->capacity*2);
+		group_key_t *const slots = reallocarray(cache->slots, capacity,
+				sizeof(*slots));
+		if(slots == NULL)
+		{
+			return 1;
+		}
+		cache->slots = slots;
+		cache->capacity = capacity;
+	}
+
+	slot = &cache->slots[cache->nslots];
+	slot->name = strdup(entry->name);
+	slot->keys = calloc(cache->ngroups + 1, sizeof(*slot->keys));
+	if(slot->name == NULL || slot->keys == NULL)
+	{
+		free(slot->name);
+		free(slot->keys);
+		return 1;
+	}
+
+	for(i = 0; i < cache->ngroups; ++i)
+	{
+		char key[NAME_MAX + 1] = "";
+		if(cache->compiled[i])
+		{
+			const regmatch_t match = get_group_match(&cache->regexes[i],
+					entry->name);
+			copy_str(key, MIN(sizeof(key), (size_t)match.rm_eo - match.rm_so + 1U),
+					entry->name + match.rm_so);
+		}
+
+		slot->keys[i] = strdup(key);
+		if(slot->keys[i] == NULL)
+		{
+			free_string_array(slot->keys, i);
+			free(slot->name);
+			return 1;
+		}
+	}
+
+	entry->group_key = cache->nslots++;
+	return 0;
+}
+
+/* Retrieves cached key of the entry for the specified group.  Returns the
+ * key. */
+static const char *
+group_key_of(const dir_entry_t *entry, int group)
+{
+	return view->group_keys->slots[entry->group_key].keys[group];
+}
+
+/* Computes value of the key for an entry so that comparisons don't need to
+ * derive it over and over again. */
+static void
+fill_key_value(const sort_key_t *key, const sort_item_t *item,
+		key_value_t *value)
+{
+	const dir_entry_t *const entry = item->entry;
+
+	value->str = NULL;
+	value->orig = NULL;
+	value->num = 0U;
+
+	switch(key->type)
+	{
+		char buf[PATH_MAX + 1];
+		char lower[NAME_MAX + 1];
 
+		case SK_BY_NAME:
+		case SK_BY_INAME:
+			value->orig = entry->name;
+			if(custom_view)
+			{
+				get_short_path_of(view, entry, NF_NONE, 0, sizeof(buf), buf);
+				value->orig = strdup(buf);
+			}
+			value->str = value->orig;
+			if(key->type == SK_BY_INAME && value->orig != NULL)
+			{
+				/* Ignore too small buffer errors by not caring about part that didn't
+				 * fit. */
+				(void)str_to_lower(value->orig, lower, sizeof(lower));
+				value->str = strdup(lower);
+			}
+			break;
+		case SK_BY_TYPE:
+			value->str = get_type_str(entry->type);
+			break;
+		case SK_BY_FILEEXT:
+		case SK_BY_EXTENSION:
+			value->str = strrchr(entry->name, '.');
+			break;
+		case SK_BY_SIZE:
+			value->num = fentry_get_size(view, entry);
+			break;
+		case SK_BY_NITEMS:
+			/* We don't want to call fentry_get_nitems() for files as sorting huge
+			 * lists of files can call this function a lot of times, thus even small
+			 * extra performance overhead is not desirable. */
+			value->num = item->is_dir ? fentry_get_nitems(view, entry) : 0U;
+			break;
+		case SK_BY_GROUPS:
+			value->str = group_key_of(entry, key->group);
+			break;
+		case SK_BY_TARGET:
+			value->num = (entry->type == FT_LINK);
+			if(value->num)
+			{
+				char full_path[PATH_MAX + 1];
+				get_full_path_of(entry, sizeof(full_path), full_path);
+				if(get_link_target(full_path, buf, sizeof(buf)) == 0)
+				{
+					value->str = strdup(buf);
+				}
+			}
+			break;
 #ifndef _WIN32
-		case SK_BY_MODE:
-			retval = first->mode - second->mode;
+		case SK_BY_PERMISSIONS:
+			get_perm_string(lower, sizeof(lower), entry->mode);
+			value->str = strdup(lower);
 			break;
+#endif
 
-		case SK_BY_INODE:
-			retval = first->inode - second->inode;
+		default:
+			/* Other keys are compared using fields of entries directly. */
 			break;
+	}
+}
 
-		case SK_BY_OWNER_NAME: /* FIXME */
-		case SK_BY_OWNER_ID:
-			retval = first->uid - second->uid;
+/* Frees memory owned by the value of a key. */
+static void
+free_key_value(const sort_key_t *key, key_value_t *value)
+{
+	switch(key->type)
+	{
+		case SK_BY_NAME:
+		case SK_BY_INAME:
+			if(value->str != value->orig)
+			{
+				free((char *)value->str);
+			}
+			if(custom_view)
+			{
+				free((char *)value->orig);
+			}
+			break;
+		case SK_BY_TARGET:
+#ifndef _WIN32
+		case SK_BY_PERMISSIONS:
+#endif
+			free((char *)value->str);
 			break;
 
-		case SK_BY_GROUP_NAME: /* FIXME */
-		case SK_BY_GROUP_ID:
-			retval = first->gid - second->gid;
+		default:
 			break;
+	}
+}
 
-		case SK_BY_PERMISSIONS:
+/* Prepares entries for sorting by filling items and values of their keys.
+ * first_index is the initial position of the first entry. */
+static void
+fill_items(dir_entry_t entries[], size_t nentries, int first_index,
+		const sort_keys_t *keys, sort_item_t items[], key_value_t values[])
+{
+	size_t i;
+	int j;
+
+	for(i = 0U; i < nentries; ++i)
+	{
+		sort_item_t *const item = &items[i];
+		item->entry = &entries[i];
+		item->values = &values[i*keys->nkeys];
+		item->index = first_index + i;
+		item->is_dir = fentry_is_dir(&entries[i]);
+		item->is_parent = item->is_dir && is_parent_dir(entries[i].name);
+
+		for(j = 0; j < keys->nkeys; ++j)
+		{
+			fill_key_value(&keys->keys[j], item, &item->values[j]);
+		}
+	}
+}
+
+/* Frees values of keys of items filled by fill_items(). */
+static void
+free_values(const sort_keys_t *keys, key_value_t values[], size_t nitems)
+{
+	size_t i;
+	int j;
+
+	for(i = 0U; i < nitems; ++i)
+	{
+		for(j = 0; j < keys->nkeys; ++j)
+		{
+			free_key_value(&keys->keys[j], &values[i*keys->nkeys + j]);
+		}
+	}
+}
+
+/* Sorts items by all keys, large lists are sorted by several threads. */
+static void
+sort_items(sort_item_t items[], size_t n)
+{
+	sort_part_t parts[MAX_SORT_THREADS];
+	pthread_t threads[MAX_SORT_THREADS];
+	int started[MAX_SORT_THREADS];
+	sort_item_t *tmp;
+	size_t nparts;
+	size_t i;
+
+	nparts = MIN(get_cpu_count(), MAX_SORT_THREADS);
+	if(n < PAR_SORT_THRESHOLD || nparts < 2U ||
+			(tmp = reallocarray(NULL, n, sizeof(*tmp))) == NULL)
+	{
+		safe_qsort(items, n, sizeof(*items), &sort_items_cmp);
+		return;
+	}
+
+	/* Sort runs of items in parallel. */
+	for(i = 0U; i < nparts; ++i)
+	{
+		const size_t begin = n*i/nparts;
+		parts[i].items = &items[begin];
+		parts[i].tmp = &tmp[begin];
+		parts[i].n = n*(i + 1U)/nparts - begin;
+		started[i] = (pthread_create(&threads[i], NULL, &sort_part,
+					&parts[i]) == 0);
+		if(!started[i])
+		{
+			(void)sort_part(&parts[i]);
+		}
+	}
+	for(i = 0U; i < nparts; ++i)
+	{
+		if(started[i])
+		{
+			(void)pthread_join(threads[i], NULL);
+		}
+	}
+
+	/* Merge pairs of adjacent runs in parallel until there is only one left. */
+	while(nparts > 1U)
+	{
+		const size_t npairs = nparts/2U;
+
+		for(i = 0U; i < npairs; ++i)
+		{
+			sort_part_t *const first = &parts[2U*i];
+			const sort_part_t *const second = &parts[2U*i + 1U];
+			first->mid = first->n;
+			first->n += second->n;
+			started[i] = (pthread_create(&threads[i], NULL, &merge_part,
+						first) == 0);
+			if(!started[i])
 			{
-				char first_perm[11], second_perm[11];
-				get_perm_string(first_perm, sizeof(first_perm), first->mode);
-				get_perm_string(second_perm, sizeof(second_perm), second->mode);
-				retval = strcmp(first_perm, second_perm);
+				(void)merge_part(first);
 			}
-			break;
+		}
+		for(i = 0U; i < npairs; ++i)
+		{
+			if(started[i])
+			{
+				(void)pthread_join(threads[i], NULL);
+			}
+			parts[i] = parts[2U*i];
+		}
 
-		case SK_BY_NLINKS:
-			retval = first->nlinks - second->nlinks;
-			break;
-#endif
+		if(nparts%2U != 0U)
+		{
+			parts[npairs] = parts[nparts - 1U];
+		}
+		nparts = npairs + nparts%2U;
 	}
 
-	if(retval == 0)
+	free(tmp);
+}
+
+/* Entry point of a thread that sorts a run of items.  Returns NULL. */
+static void *
+sort_part(void *arg)
+{
+	sort_part_t *const part = arg;
+	safe_qsort(part->items, part->n, sizeof(*part->items), &sort_items_cmp);
+	return NULL;
+}
+
+/* Entry point of a thread that merges two adjacent sorted runs of items.
+ * Returns NULL. */
+static void *
+merge_part(void *arg)
+{
+	sort_part_t *const part = arg;
+	size_t i = 0U, j = part->mid, k = 0U;
+
+	while(i < part->mid && j < part->n)
+	{
+		if(compare_items(&part->items[j], &part->items[i]) < 0)
+		{
+			part->tmp[k++] = part->items[j++];
+		}
+		else
+		{
+			part->tmp[k++] = part->items[i++];
+		}
+	}
+	while(i < part->mid)
 	{
-		retval = first->tag - second->tag;
+		part->tmp[k++] = part->items[i++];
 	}
-	else if(sort_descending)
+	while(j < part->n)
 	{
-		retval = -retval;
+		part->tmp[k++] = part->items[j++];
 	}
 
-	return retval;
+	memcpy(part->items, part->tmp, part->n*sizeof(*part->items));
+	return NULL;
 }
 
-/* Compares two file sizes.  Returns standard -1, 0, 1 for comparisons. */
+/* qsort() callback that compares items by all keys.  Returns standard -1, 0, 1
+ * for comparisons. */
 static int
-compare_file_sizes(const dir_entry_t *f, const dir_entry_t *s)
+sort_items_cmp(const void *a, const void *b)
 {
-	const uint64_t fsize = fentry_get_size(view, f);
-	const uint64_t ssize = fentry_get_size(view, s);
-	return (fsize < ssize) ? -1 : (fsize > ssize);
+	return compare_items(a, b);
 }
 
-/* Compares number of items in two directories (taken as zero for files).
- * Returns standard -1, 0, 1 for comparisons. */
+/* Compares items by all keys falling back to their initial order.  Returns
+ * standard -1, 0, 1 for comparisons. */
 static int
-compare_item_count(const dir_entry_t *f, int fdir, const dir_entry_t *s,
-		int sdir)
+compare_items(const sort_item_t *a, const sort_item_t *b)
 {
-	/* We don't want to call fentry_get_nitems() for files as sorting huge lists
-	 * of files can call this function a lot of times, thus even small extra
-	 * performance overhead is not desirable. */
-	const uint64_t fsize = fdir ? fentry_get_nitems(view, f) : 0U;
-	const uint64_t ssize = sdir ? fentry_get_nitems(view, s) : 0U;
-	return (fsize > ssize) ? 1 : (fsize < ssize) ? -1 : 0;
+	int i;
+
+	if(a->is_parent)
+	{
+		return -1;
+	}
+	if(b->is_parent)
+	{
+		return 1;
+	}
+
+	for(i = 0; i < sort_keys->nkeys; ++i)
+	{
+		const sort_key_t *const key = &sort_keys->keys[i];
+		const int retval = compare_values(key, a, &a->values[i], b,
+				&b->values[i]);
+		if(retval != 0)
+		{
+			return (key->descending ? -retval : retval);
+		}
+	}
+
+	return a->index - b->index;
 }
 
-/* Compares two file names according to grouping regular expression.  Returns
- * standard -1, 0, 1 for comparisons. */
+/* Compares precomputed values of a key for two items.  Returns standard -1, 0,
+ * 1 for comparisons. */
 static int
-compare_group(const char f[], const char s[], regex_t *regex)
+compare_values(const sort_key_t *key, const sort_item_t *a,
+		const key_value_t *av, const sort_item_t *b, const key_value_t *bv)
 {
-	char fname[NAME_MAX + 1], sname[NAME_MAX + 1];
-	regmatch_t fmatch = get_group_match(regex, f);
-	regmatch_t smatch = get_group_match(regex, s);
+	const dir_entry_t *const first = a->entry;
+	const dir_entry_t *const second = b->entry;
+
+	switch(key->type)
+	{
+		case SK_BY_NAME:
+		case SK_BY_INAME:
+			return compare_prepared_names(av, bv, key->type == SK_BY_INAME);
 
-	copy_str(fname, MIN(sizeof(fname), (size_t)fmatch.rm_eo - fmatch.rm_so + 1U),
-			f + fmatch.rm_so);
-	copy_str(sname, MIN(sizeof(sname), (size_t)smatch.rm_eo - smatch.rm_so + 1U),
-			s + smatch.rm_so);
+		case SK_BY_DIR:
+			return (a->is_dir == b->is_dir ? 0 : (a->is_dir ? -1 : 1));
+
+		case SK_BY_TYPE:
+			return strcmp(av->str, bv->str);
+
+		case SK_BY_FILEEXT:
+		case SK_BY_EXTENSION:
+			return compare_extensions(key->type, a, av, b, bv);
+
+		case SK_BY_SIZE:
+		case SK_BY_NITEMS:
+			return (av->num < bv->num) ? -1 : (av->num > bv->num);
+
+		case SK_BY_GROUPS:
+			return strcmp(av->str, bv->str);
+
+		case SK_BY_TARGET:
+			if(av->num != bv->num)
+			{
+				/* One of the entries is not a link. */
+				return av->num ? 1 : -1;
+			}
+			if(av->str == NULL || bv->str == NULL)
+			{
+				/* Entries are not symbolic links or targets are unknown. */
+				return 0;
+			}
+			return stroscmp(av->str, bv->str);
+
+		case SK_BY_TIME_MODIFIED:
+			return first->mtime - second->mtime;
+		case SK_BY_TIME_ACCESSED:
+			return first->atime - second->atime;
+		case SK_BY_TIME_CHANGED:
+			return first->ctime - second->ctime;
+
+#ifndef _WIN32
+		case SK_BY_MODE:
+			return first->mode - second->mode;
+		case SK_BY_INODE:
+			return first->inode - second->inode;
+		case SK_BY_OWNER_NAME: /* FIXME */
+		case SK_BY_OWNER_ID:
+			return first->uid - second->uid;
+		case SK_BY_GROUP_NAME: /* FIXME */
+		case SK_BY_GROUP_ID:
+			return first->gid - second->gid;
+		case SK_BY_PERMISSIONS:
+			return strcmp(av->str, bv->str);
+		case SK_BY_NLINKS:
+			return first->nlinks - second->nlinks;
+#endif
+	}
 
-	return strcmp(fname, sname);
+	return 0;
 }
 
-/* Compares two file names according to symbolic link target.  Returns standard
- * -1, 0, 1 for comparisons. */
+/* Compares items by extensions of their names.  Returns standard -1, 0, 1 for
+ * comparisons. */
 static int
-compare_targets(const dir_entry_t *f, const dir_entry_t *s)
+compare_extensions(SortingKey type, const sort_item_t *a,
+		const key_value_t *av, const sort_item_t *b, const key_value_t *bv)
 {
-	char full_path[PATH_MAX + 1];
-	char nlink[PATH_MAX + 1], plink[PATH_MAX + 1];
+	const char *const first = a->entry->name;
+	const char *const second = b->entry->name;
+	const char *const pfirst = av->str;
+	const char *const psecond = bv->str;
 
-	if((f->type == FT_LINK) != (s->type == FT_LINK))
+	if(a->is_dir && b->is_dir && type == SK_BY_FILEEXT)
 	{
-		/* One of the entries is not a link. */
-		return (f->type == FT_LINK) ? 1 : -1;
+		return compare_file_names(first, second, 0);
 	}
-	if(f->type != FT_LINK)
+	if(a->is_dir != b->is_dir && type == SK_BY_FILEEXT)
 	{
-		/* Both entries are not symbolic links. */
-		return 0;
+		return a->is_dir ? -1 : 1;
 	}
-
-	/* Both entries are symbolic links. */
-
-	get_full_path_of(f, sizeof(full_path), full_path);
-	if(get_link_target(full_path, nlink, sizeof(nlink)) != 0)
+	if(pfirst != NULL && psecond != NULL)
 	{
-		return 0;
+		if(pfirst == first && psecond != second)
+		{
+			return -1;
+		}
+		if(pfirst != first && psecond == second)
+		{
+			return 1;
+		}
+		return compare_file_names(pfirst + 1, psecond + 1, 0);
 	}
-	get_full_path_of(s, sizeof(full_path), full_path);
-	if(get_link_target(full_path, plink, sizeof(plink)) != 0)
+	if(pfirst != NULL || psecond != NULL)
 	{
-		return 0;
+		return pfirst != NULL ? -1 : 1;
 	}
-
-	return stroscmp(nlink, plink);
+	return compare_file_names(first, second, 0);
 }
 
-/* Compares names of two file entries.  Returns positive value if a is greater
+/* Compares names prepared by fill_key_value() assuming that dot character is
+ * smaller than any other character.  Returns positive value if a is greater
  * than b, zero if they are equal, otherwise negative value is returned. */
 static int
-compare_entry_names(const dir_entry_t *a, const dir_entry_t *b, int ignore_case)
+compare_prepared_names(const key_value_t *a, const key_value_t *b,
+		int ignore_case)
 {
-	char a_short_path[PATH_MAX + 1];
-	char b_short_path[PATH_MAX + 1];
-
-	get_short_path_of(view, a, NF_NONE, 0, sizeof(a_short_path), a_short_path);
-	get_short_path_of(view, b, NF_NONE, 0, sizeof(b_short_path), b_short_path);
+	int result;
 
-	return compare_full_file_names(a_short_path, b_short_path, ignore_case);
-}
+	if(a->orig == NULL || b->orig == NULL)
+	{
+		/* Memory error, there is no meaningful order. */
+		return (a->orig == NULL) - (b->orig == NULL);
+	}
 
-/* Compares two full filenames and assumes that dot character is smaller than
- * any other character.  Returns positive value if s is greater than t, zero if
- * they are equal, otherwise negative value is returned. */
-static int
-compare_full_file_names(const char s[], const char t[], int ignore_case)
-{
-	if(s[0] == '.' && t[0] != '.')
+	if(a->orig[0] == '.' && b->orig[0] != '.')
 	{
 		return -1;
 	}
-	else if(s[0] != '.' && t[0] == '.')
+	if(a->orig[0] != '.' && b->orig[0] == '.')
 	{
 		return 1;
 	}
-	else
+
+	if(a->str == NULL || b->str == NULL)
+	{
+		return (a->str == NULL) - (b->str == NULL);
+	}
+
+	result = cfg.sort_numbers ? strnumcmp(a->str, b->str)
+	                          : strcmp(a->str, b->str);
+	if(result == 0 && ignore_case)
+	{
+		/* Resort to comparing original names when their normalized versions match
+		 * to always solve ties in deterministic way. */
+		result = strcmp(a->orig, b->orig);
+	}
+	return result;
+}
+
+/* Compares file names containing numbers correctly. */
+TSTATIC int
+strnumcmp(const char s[], const char t[])
+{
+#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
+	return vercmp(s, t);
+#else
+	const char *new_s = skip_leading_zeros(s);
+	const char *new_t = skip_leading_zeros(t);
+	return strverscmp(new_s, new_t);
+#endif
+}
+
+#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
+static int
+vercmp(const char s[], const char t[])
+{
+	while(*s != '\0' && *t != '\0')
+	{
+		if(isdigit(*s) && isdigit(*t))
+		{
+			int num_a, num_b;
+			const char *os = s, *ot = t;
+			char *p;
+
+			num_a = strtol(s, &p, 10);
+			s = p;
+
+			num_b = strtol(t, &p, 10);
+			t = p;
+
+			if(num_a != num_b)
+				return num_a - num_b;
+			else if(*os != *ot)
+				return *os - *ot;
+		}
+		else if(*s == *t)
+		{
+			s++;
+			t++;
+		}
+		else
+			break;
+	}
+
+	return *s - *t;
+}
+#else
+/* Skips all zeros in front of numbers (correctly handles zero).  Returns str, a
+ * pointer to '0' or a pointer to non-zero digit. */
+static char *
+skip_leading_zeros(const char str[])
+{
+	while(str[0] == '0' && isdigit(str[1]))
 	{
-		return compare_file_names(s, t, ignore_case);
+		str++;
 	}
+	return (char *)str;
 }
+#endif
 
 /* Compares two file names or their parts (e.g. extensions).  Returns positive
  * value if s is greater than t, zero if they are equal, otherwise negative
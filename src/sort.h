@@ -26,9 +26,22 @@
 /* Sorts entries of the view according to its sorting configuration. */
 void sort_view(view_t *view);
 
+/* Sorts detached tree of entries (its top-level entries have zero child_pos)
+ * according to sorting configuration of the view. */
+void sort_tree(view_t *view, dir_entry_t entries[], int nentries);
+
 /* Sorts specified entries using global settings of the view. */
 void sort_entries(view_t *view, entries_t entries);
 
+/* Inserts entries into already sorted flat list of the view at positions that
+ * sorting would have put them.  Contents of entries is moved into the view, but
+ * the array itself remains owned by the caller.  Returns zero on success,
+ * otherwise non-zero is returned and the view is left unchanged. */
+int sort_insert_entries(view_t *view, dir_entry_t entries[], int nentries);
+
+/* Frees keys of sorting groups cached for entries of the view. */
+void sort_drop_group_keys(view_t *view);
+
 /* Maps primary sort key to second column type.  Returns secondary key that
  * corresponds to the primary one. */
 SortingKey get_secondary_key(SortingKey primary_key);
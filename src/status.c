@@ -26,25 +26,34 @@
 #undef MIN
 #endif
 
+#include <sys/stat.h> /* stat */
+
 #include <assert.h> /* assert() */
 #include <limits.h> /* INT_MIN */
-#include <stddef.h> /* NULL */
+#include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uint32_t uint64_t */
+#include <stdio.h> /* snprintf() */
 #include <string.h>
 #include <time.h> /* time_t time() */
 
 #include "cfg/config.h"
+#include "cfg/dcache_file.h"
 #include "compat/fs_limits.h"
+#include "compat/os.h"
 #include "compat/pthread.h"
 #include "compat/reallocarray.h"
 #include "modes/modes.h"
 #include "ui/colors.h"
 #include "ui/ui.h"
 #include "utils/env.h"
+#include "utils/fs.h"
 #include "utils/fsdata.h"
 #include "utils/log.h"
 #include "utils/macros.h"
 #include "utils/path.h"
 #include "utils/str.h"
+#include "utils/string_array.h"
+#include "utils/trie.h"
 #include "utils/utils.h"
 #include "cmd_completion.h"
 #include "cmd_core.h"
@@ -57,21 +66,45 @@
 #define SCREEN_ENVVAR "STY"
 #define TMUX_ENVVAR "TMUX"
 
-/* dcache entry. */
+/* Initializer of a dcache shard. */
+#define DCACHE_SHARD_INIT { PTHREAD_MUTEX_INITIALIZER, NULL }
+
+/* dcache entry.  Timestamps are zero for values that were invalidated. */
 typedef struct
 {
-	uint64_t value;   /* Stored value. */
-	time_t timestamp; /* When the value was set. */
+	uint64_t size;    /* Size of the directory. */
+	time_t size_ts;   /* When size was set. */
+	uint64_t nitems;  /* Number of items in the directory. */
+	time_t nitems_ts; /* When nitems was set. */
 }
 dcache_data_t;
 
+/* Independently locked part of dcache.  Path is assigned to a shard by a hash
+ * of its resolved form, so that readers rarely wait for writers. */
+typedef struct
+{
+	pthread_mutex_t lock; /* Thread-safety guard for the tree. */
+	fsdata_t *tree;       /* Entries of paths that belong to this shard. */
+}
+dcache_shard_t;
+
 static void load_def_values(status_t *stats, config_t *config);
 static void determine_fuse_umount_cmd(status_t *stats);
 static void set_gtk_available(status_t *stats);
 static int reset_dircache(void);
 static void set_last_cmdline_command(const char cmd[]);
 static void save_into_history(const char item[], hist_t *hist, int len);
-static void size_updater(void *data, void *arg);
+static void get_data(const char path[], dcache_data_t *data);
+static int lookup_data(const char path[], dcache_data_t *data);
+static int lookup_real(const char real_path[], dcache_data_t *data);
+static dcache_shard_t * get_shard(const char real_path[]);
+static int load_from_file(const char path[]);
+static int is_record_valid(const char path[], const dcache_record_t *record);
+static int remember_path(const char path[]);
+static dcache_file_t * get_dcache_file(void);
+static int make_record(const char path[], dcache_record_t *record);
+static void update_parents(char real_path[], uint64_t by);
+static void invalidate_path(char real_path[]);
 
 status_t curr_stats;
 
@@ -79,14 +112,27 @@ static int pending_redraw;
 static int inside_screen;
 static int inside_tmux;
 
-/* Thread-safety guard for dcache_size variable. */
-static pthread_mutex_t dcache_size_mutex = PTHREAD_MUTEX_INITIALIZER;
-/* Thread-safety guard for dcache_nitems variable. */
-static pthread_mutex_t dcache_nitems_mutex = PTHREAD_MUTEX_INITIALIZER;
-/* Cache for directory sizes. */
-static fsdata_t *dcache_size;
-/* Cache for directory item count. */
-static fsdata_t *dcache_nitems;
+/* Cache of sizes and item counts of directories split into shards. */
+static dcache_shard_t dcache_shards[] = {
+	DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT,
+	DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT,
+	DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT,
+	DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT, DCACHE_SHARD_INIT,
+};
+
+/* Thread-safety guard for dcache_file and dcache_paths* variables. */
+static pthread_mutex_t dcache_file_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Persistent storage of dcache, which is opened on first use. */
+static dcache_file_t *dcache_file;
+/* Whether opening of dcache_file was already attempted. */
+static int dcache_file_loaded;
+/* Paths that are either present in memory or were looked up in dcache_file.
+ * Once a path is here, persistent storage isn't queried for it. */
+static trie_t *dcache_paths_trie;
+/* Same paths as in dcache_paths_trie, but as a list. */
+static char **dcache_paths;
+/* Number of elements in dcache_paths. */
+static int dcache_npaths;
 
 /* Whether UI updates should be "paused" (a counter, not a flag). */
 static int silent_ui;
@@ -242,13 +288,33 @@ stats_reset(const config_t *config)
 static int
 reset_dircache(void)
 {
-	fsdata_free(dcache_size);
-	dcache_size = fsdata_create(0, 1);
+	int error = 0;
+	size_t i;
 
-	fsdata_free(dcache_nitems);
-	dcache_nitems = fsdata_create(0, 1);
+	for(i = 0U; i < ARRAY_LEN(dcache_shards); ++i)
+	{
+		dcache_shard_t *const shard = &dcache_shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+		fsdata_free(shard->tree);
+		/* Paths are resolved before taking the lock. */
+		shard->tree = fsdata_create(0, 0);
+		error |= (shard->tree == NULL);
+		pthread_mutex_unlock(&shard->lock);
+	}
 
-	return (dcache_size == NULL || dcache_nitems == NULL);
+	pthread_mutex_lock(&dcache_file_mutex);
+	dcache_file_close(dcache_file);
+	dcache_file = NULL;
+	dcache_file_loaded = 0;
+	trie_free(dcache_paths_trie);
+	dcache_paths_trie = trie_create();
+	free_string_array(dcache_paths, dcache_npaths);
+	dcache_paths = NULL;
+	dcache_npaths = 0;
+	pthread_mutex_unlock(&dcache_file_mutex);
+
+	return (error || dcache_paths_trie == NULL);
 }
 
 void
@@ -513,30 +579,17 @@ hists_search_last(void)
 void
 dcache_get_at(const char path[], uint64_t *size, uint64_t *nitems)
 {
-	/* Initialization to make condition false by default. */
-	dcache_data_t size_data, nitems_data;
-
-	pthread_mutex_lock(&dcache_size_mutex);
-	if(fsdata_get(dcache_size, path, &size_data, sizeof(size_data)) != 0)
-	{
-		size_data.value = DCACHE_UNKNOWN;
-	}
-	pthread_mutex_unlock(&dcache_size_mutex);
-
-	pthread_mutex_lock(&dcache_nitems_mutex);
-	if(fsdata_get(dcache_nitems, path, &nitems_data, sizeof(nitems_data)) != 0)
-	{
-		nitems_data.value = DCACHE_UNKNOWN;
-	}
-	pthread_mutex_unlock(&dcache_nitems_mutex);
+	dcache_data_t data;
+	get_data(path, &data);
 
+	/* Invalidated values can't be used as they are. */
 	if(size != NULL)
 	{
-		*size = size_data.value;
+		*size = (data.size_ts == 0 ? DCACHE_UNKNOWN : data.size);
 	}
 	if(nitems != NULL)
 	{
-		*nitems = nitems_data.value;
+		*nitems = (data.nitems_ts == 0 ? DCACHE_UNKNOWN : data.nitems);
 	}
 }
 
@@ -544,81 +597,443 @@ void
 dcache_get_of(const dir_entry_t *entry, dcache_result_t *size,
 		dcache_result_t *nitems)
 {
-	dcache_data_t size_data, nitems_data;
+	dcache_data_t data;
 
 	char full_path[PATH_MAX + 1];
 	get_full_path_of(entry, sizeof(full_path), full_path);
 
-	size->value = DCACHE_UNKNOWN;
-	size->is_valid = 0;
+	get_data(full_path, &data);
+
+	/* We check strictly for less than to handle scenario when multiple changes
+	 * occurred during the same second. */
 
-	nitems->value = DCACHE_UNKNOWN;
-	nitems->is_valid = 0;
+	size->value = data.size;
+	size->is_valid = (data.size != DCACHE_UNKNOWN && entry->mtime < data.size_ts);
 
-	pthread_mutex_lock(&dcache_size_mutex);
-	if(fsdata_get(dcache_size, full_path, &size_data, sizeof(size_data)) == 0)
+	nitems->value = data.nitems;
+	nitems->is_valid = (data.nitems != DCACHE_UNKNOWN &&
+			entry->mtime < data.nitems_ts);
+}
+
+/* Retrieves cached data of the path loading it from persistent storage on the
+ * first request if necessary.  Absent values are set to DCACHE_UNKNOWN. */
+static void
+get_data(const char path[], dcache_data_t *data)
+{
+	if(!lookup_data(path, data) && load_from_file(path))
 	{
-		size->value = size_data.value;
-		/* We check strictly for less than to handle scenario when multiple changes
-		 * occurred during the same second. */
-		size->is_valid = (entry->mtime < size_data.timestamp);
+		(void)lookup_data(path, data);
 	}
-	pthread_mutex_unlock(&dcache_size_mutex);
+}
 
-	pthread_mutex_lock(&dcache_nitems_mutex);
-	if(fsdata_get(dcache_nitems, full_path, &nitems_data,
-				sizeof(nitems_data)) == 0)
+/* Retrieves in-memory data of the path.  Absent values are set to
+ * DCACHE_UNKNOWN.  Returns non-zero if the path was found, otherwise zero is
+ * returned. */
+static int
+lookup_data(const char path[], dcache_data_t *data)
+{
+	char real_path[PATH_MAX + 1];
+	if(os_realpath(path, real_path) != real_path)
 	{
-		nitems->value = nitems_data.value;
-		/* We check strictly for less than to handle scenario when multiple changes
-		 * occurred during the same second. */
-		nitems->is_valid = (entry->mtime < nitems_data.timestamp);
+		const dcache_data_t unknown = {
+			.size = DCACHE_UNKNOWN, .nitems = DCACHE_UNKNOWN
+		};
+		*data = unknown;
+		return 0;
 	}
-	pthread_mutex_unlock(&dcache_nitems_mutex);
+
+	return lookup_real(real_path, data);
+}
+
+/* Same as lookup_data(), but accepts already resolved path. */
+static int
+lookup_real(const char real_path[], dcache_data_t *data)
+{
+	dcache_shard_t *const shard = get_shard(real_path);
+	int found;
+
+	pthread_mutex_lock(&shard->lock);
+	found = (shard->tree != NULL &&
+			fsdata_get(shard->tree, real_path, data, sizeof(*data)) == 0);
+	pthread_mutex_unlock(&shard->lock);
+
+	if(!found)
+	{
+		const dcache_data_t unknown = {
+			.size = DCACHE_UNKNOWN, .nitems = DCACHE_UNKNOWN
+		};
+		*data = unknown;
+	}
+	return found;
+}
+
+/* Picks shard that is responsible for the path.  Returns the shard. */
+static dcache_shard_t *
+get_shard(const char real_path[])
+{
+	/* FNV-1a hash. */
+	uint32_t hash = 2166136261U;
+	while(*real_path != '\0')
+	{
+		hash = (hash ^ (unsigned char)*real_path++)*16777619U;
+	}
+	return &dcache_shards[hash%ARRAY_LEN(dcache_shards)];
+}
+
+/* Loads information about the path from persistent storage if it's enabled,
+ * wasn't done before, stored data is available and is still valid.  Returns
+ * non-zero if something was loaded, otherwise zero is returned. */
+static int
+load_from_file(const char path[])
+{
+	char real_path[PATH_MAX + 1];
+	dcache_record_t record;
+	dcache_shard_t *shard;
+	dcache_data_t data;
+	int found;
+
+	if(!(cfg.vifm_info & VINFO_DCACHE) ||
+			os_realpath(path, real_path) != real_path)
+	{
+		return 0;
+	}
+
+	/* Stored records are keyed by resolved paths just like in-memory data. */
+	pthread_mutex_lock(&dcache_file_mutex);
+	found = remember_path(real_path)
+	     && get_dcache_file() != NULL
+	     && dcache_file_find(dcache_file, real_path, &record) == 0;
+	pthread_mutex_unlock(&dcache_file_mutex);
+
+	if(!found || !is_record_valid(real_path, &record))
+	{
+		return 0;
+	}
+
+	data.size = record.size;
+	data.size_ts = (record.size == DCACHE_UNKNOWN ? 0 : record.size_ts);
+	data.nitems = record.nitems;
+	data.nitems_ts = (record.nitems == DCACHE_UNKNOWN ? 0 : record.nitems_ts);
+
+	/* Don't overwrite values that might have been set in the meantime. */
+	shard = get_shard(real_path);
+	pthread_mutex_lock(&shard->lock);
+	if(shard->tree != NULL)
+	{
+		dcache_data_t existing;
+		if(fsdata_get(shard->tree, real_path, &existing, sizeof(existing)) != 0)
+		{
+			(void)fsdata_set(shard->tree, real_path, &data, sizeof(data));
+		}
+	}
+	pthread_mutex_unlock(&shard->lock);
+
+	return 1;
+}
+
+/* Checks whether stored record still describes the directory in the same way
+ * filemon_t would do it.  Returns non-zero if so, otherwise zero is
+ * returned. */
+static int
+is_record_valid(const char path[], const dcache_record_t *record)
+{
+	struct stat st;
+	return os_stat(path, &st) == 0
+	    && (int64_t)st.st_mtime == record->mtime
+	    && (uint64_t)st.st_ino == record->inode
+	    && (uint64_t)st.st_dev == record->dev;
+}
+
+/* Adds resolved path to the list of known paths.  Should be called with
+ * dcache_file_mutex locked.  Returns non-zero if path wasn't known before,
+ * otherwise zero is returned. */
+static int
+remember_path(const char path[])
+{
+	if(trie_put(dcache_paths_trie, path) != 0)
+	{
+		return 0;
+	}
+
+	dcache_npaths = add_to_string_array(&dcache_paths, dcache_npaths, 1, path);
+	return 1;
+}
+
+/* Opens persistent storage on the first call.  Should be called with
+ * dcache_file_mutex locked.  Returns the storage or NULL if it's
+ * unavailable. */
+static dcache_file_t *
+get_dcache_file(void)
+{
+	if(!dcache_file_loaded)
+	{
+		char path[PATH_MAX + 16];
+		snprintf(path, sizeof(path), "%s/dcache", cfg.config_dir);
+
+		dcache_file = dcache_file_open(path);
+		dcache_file_loaded = 1;
+	}
+	return dcache_file;
+}
+
+void
+dcache_save(void)
+{
+	char path[PATH_MAX + 16];
+	const char **paths = NULL;
+	dcache_record_t *records = NULL;
+	int count = 0;
+	int i;
+
+	if(!(cfg.vifm_info & VINFO_DCACHE))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&dcache_file_mutex);
+
+	paths = reallocarray(NULL, dcache_npaths, sizeof(*paths));
+	records = reallocarray(NULL, dcache_npaths, sizeof(*records));
+	if((paths == NULL || records == NULL) && dcache_npaths != 0)
+	{
+		pthread_mutex_unlock(&dcache_file_mutex);
+		free(paths);
+		free(records);
+		return;
+	}
+
+	for(i = 0; i < dcache_npaths; ++i)
+	{
+		if(make_record(dcache_paths[i], &records[count]) == 0)
+		{
+			paths[count++] = dcache_paths[i];
+		}
+	}
+
+	/* Preserve records of the old file which weren't used during this
+	 * session. */
+	if(get_dcache_file() != NULL)
+	{
+		const int nold = dcache_file_count(dcache_file);
+		const char **const new_paths = reallocarray(paths, count + nold,
+				sizeof(*paths));
+		dcache_record_t *const new_records = reallocarray(records, count + nold,
+				sizeof(*records));
+		paths = (new_paths == NULL ? paths : new_paths);
+		records = (new_records == NULL ? records : new_records);
+
+		for(i = 0; i < nold && new_paths != NULL && new_records != NULL; ++i)
+		{
+			void *data;
+			const char *const old_path = dcache_file_get(dcache_file, i,
+					&records[count]);
+			if(old_path != NULL && trie_get(dcache_paths_trie, old_path, &data) != 0)
+			{
+				paths[count++] = old_path;
+			}
+		}
+	}
+
+	snprintf(path, sizeof(path), "%s/dcache", cfg.config_dir);
+	if(dcache_file_write(path, paths, records, count) != 0)
+	{
+		LOG_ERROR_MSG("Failed to write dcache file: %s", path);
+	}
+
+	pthread_mutex_unlock(&dcache_file_mutex);
+
+	free(paths);
+	free(records);
+}
+
+/* Fills record for storing with in-memory information about the path.  Returns
+ * zero on success and non-zero if there is nothing valid to store. */
+static int
+make_record(const char path[], dcache_record_t *record)
+{
+	struct stat st;
+	dcache_data_t data;
+
+	if(!lookup_data(path, &data) || os_stat(path, &st) != 0)
+	{
+		return 1;
+	}
+
+	/* Outdated values are dropped. */
+	if(data.size_ts <= st.st_mtime)
+	{
+		data.size = DCACHE_UNKNOWN;
+	}
+	if(data.nitems_ts <= st.st_mtime)
+	{
+		data.nitems = DCACHE_UNKNOWN;
+	}
+	if(data.size == DCACHE_UNKNOWN && data.nitems == DCACHE_UNKNOWN)
+	{
+		return 1;
+	}
+
+	record->size = data.size;
+	record->nitems = data.nitems;
+	record->size_ts = data.size_ts;
+	record->nitems_ts = data.nitems_ts;
+	record->mtime = st.st_mtime;
+	record->inode = st.st_ino;
+	record->dev = st.st_dev;
+	return 0;
 }
 
 void
 dcache_update_parent_sizes(const char path[], uint64_t by)
 {
-	pthread_mutex_lock(&dcache_size_mutex);
-	(void)fsdata_map_parents(dcache_size, path, &size_updater, &by);
-	pthread_mutex_unlock(&dcache_size_mutex);
+	char real_path[PATH_MAX + 1];
+	if(os_realpath(path, real_path) == real_path)
+	{
+		update_parents(real_path, by);
+	}
+}
+
+/* Adds the amount to sizes of all cached parents of the path.  Modifies the
+ * path. */
+static void
+update_parents(char real_path[], uint64_t by)
+{
+	while(!is_root_dir(real_path))
+	{
+		dcache_shard_t *shard;
+		dcache_data_t data;
+
+		remove_last_path_component(real_path);
+		if(real_path[0] == '\0')
+		{
+			strcpy(real_path, "/");
+		}
+
+		/* Shards are locked one at a time for the sake of readers. */
+		shard = get_shard(real_path);
+		pthread_mutex_lock(&shard->lock);
+		if(shard->tree != NULL &&
+				fsdata_get(shard->tree, real_path, &data, sizeof(data)) == 0 &&
+				data.size != DCACHE_UNKNOWN)
+		{
+			data.size += by;
+			(void)fsdata_set(shard->tree, real_path, &data, sizeof(data));
+		}
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+void
+dcache_invalidate(const char path[])
+{
+	char dir[PATH_MAX + 1];
+	char real_path[PATH_MAX + 1];
+	copy_str(dir, sizeof(dir), path);
+
+	/* Path could have been removed, in which case its parent is what needs to be
+	 * invalidated. */
+	while(!path_exists(dir, DEREF) && !is_root_dir(dir) && dir[0] != '\0')
+	{
+		remove_last_path_component(dir);
+	}
+
+	if(os_realpath(dir, real_path) == real_path)
+	{
+		invalidate_path(real_path);
+	}
 }
 
-/* Updates cached value by a fixed amount. */
+/* Marks cached values of the path and all of its parents as outdated.
+ * Modifies the path. */
 static void
-size_updater(void *data, void *arg)
+invalidate_path(char real_path[])
 {
-	const uint64_t *const by = arg;
-	dcache_data_t *const what = data;
+	while(1)
+	{
+		dcache_data_t data;
+		dcache_shard_t *const shard = get_shard(real_path);
+
+		pthread_mutex_lock(&shard->lock);
+		if(shard->tree != NULL &&
+				fsdata_get(shard->tree, real_path, &data, sizeof(data)) == 0)
+		{
+			data.size_ts = 0;
+			data.nitems_ts = 0;
+			(void)fsdata_set(shard->tree, real_path, &data, sizeof(data));
+		}
+		pthread_mutex_unlock(&shard->lock);
+
+		if(is_root_dir(real_path))
+		{
+			break;
+		}
 
-	what->value += *by;
+		remove_last_path_component(real_path);
+		if(real_path[0] == '\0')
+		{
+			strcpy(real_path, "/");
+		}
+	}
 }
 
 int
 dcache_set_at(const char path[], uint64_t size, uint64_t nitems)
 {
-	int ret = 0;
+	char real_path[PATH_MAX + 1];
+	dcache_shard_t *shard;
+	dcache_data_t data;
+	int ret;
 	const time_t ts = time(NULL);
 
-	if(size != DCACHE_UNKNOWN)
+	if(size == DCACHE_UNKNOWN && nitems == DCACHE_UNKNOWN)
 	{
-		const dcache_data_t data = { .value = size, .timestamp = ts };
+		return 0;
+	}
 
-		pthread_mutex_lock(&dcache_size_mutex);
-		ret |= fsdata_set(dcache_size, path, &data, sizeof(data));
-		pthread_mutex_unlock(&dcache_size_mutex);
+	if(os_realpath(path, real_path) != real_path)
+	{
+		return -1;
 	}
 
-	if(nitems != DCACHE_UNKNOWN)
+	if(cfg.vifm_info & VINFO_DCACHE)
 	{
-		const dcache_data_t data = { .value = nitems, .timestamp = ts };
+		pthread_mutex_lock(&dcache_file_mutex);
+		(void)remember_path(real_path);
+		pthread_mutex_unlock(&dcache_file_mutex);
+	}
+
+	shard = get_shard(real_path);
+	pthread_mutex_lock(&shard->lock);
 
-		pthread_mutex_lock(&dcache_nitems_mutex);
-		ret |= fsdata_set(dcache_nitems, path, &data, sizeof(data));
-		pthread_mutex_unlock(&dcache_nitems_mutex);
+	if(shard->tree == NULL)
+	{
+		pthread_mutex_unlock(&shard->lock);
+		return -1;
 	}
 
+	/* Value that isn't specified is preserved. */
+	if(fsdata_get(shard->tree, real_path, &data, sizeof(data)) != 0)
+	{
+		const dcache_data_t unknown = {
+			.size = DCACHE_UNKNOWN, .nitems = DCACHE_UNKNOWN
+		};
+		data = unknown;
+	}
+
+	if(size != DCACHE_UNKNOWN)
+	{
+		data.size = size;
+		data.size_ts = ts;
+	}
+	if(nitems != DCACHE_UNKNOWN)
+	{
+		data.nitems = nitems;
+		data.nitems_ts = ts;
+	}
+
+	ret = fsdata_set(shard->tree, real_path, &data, sizeof(data));
+	pthread_mutex_unlock(&shard->lock);
+
 	return ret;
 }
 
@@ -316,6 +316,14 @@ void dcache_update_parent_sizes(const char path[], uint64_t by);
  * non-zero is returned. */
 int dcache_set_at(const char path[], uint64_t size, uint64_t nitems);
 
+/* Marks cached information about the path and all its parents as outdated.
+ * Path doesn't need to exist. */
+void dcache_invalidate(const char path[]);
+
+/* Stores cached information in configuration directory for future runs if
+ * that's enabled via 'vifminfo'.  Stored data is loaded lazily on demand. */
+void dcache_save(void);
+
 #endif /* VIFM__STATUS_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
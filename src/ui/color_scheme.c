@@ -39,6 +39,7 @@
 #include "../utils/fs.h"
 #include "../utils/fsddata.h"
 #include "../utils/macros.h"
+#include "../utils/matcher_set.h"
 #include "../utils/matchers.h"
 #include "../utils/str.h"
 #include "../utils/string_array.h"
@@ -439,6 +440,7 @@ static void restore_primary_cs(const col_scheme_t *cs);
 static void reset_to_default_cs(col_scheme_t *cs);
 static void free_cs_highlights(col_scheme_t *cs);
 static file_hi_t * clone_cs_highlights(const col_scheme_t *from);
+static void build_file_hi_set(col_scheme_t *cs);
 static void reset_cs_colors(col_scheme_t *cs);
 static int source_cs(const char name[]);
 static void get_cs_path(const char name[], char buf[], size_t buf_size);
@@ -821,6 +823,8 @@ cs_assign(col_scheme_t *to, const col_scheme_t *from)
 	free_cs_highlights(to);
 	*to = *from;
 	to->file_hi = clone_cs_highlights(from);
+	to->file_hi_set = NULL;
+	build_file_hi_set(to);
 }
 
 /* Resets color scheme to default builtin values. */
@@ -847,9 +851,11 @@ free_cs_highlights(col_scheme_t *cs)
 	}
 
 	free(cs->file_hi);
+	matcher_set_free(cs->file_hi_set);
 
 	cs->file_hi = NULL;
 	cs->file_hi_count = 0;
+	cs->file_hi_set = NULL;
 }
 
 /* Clones filename specific highlight array of the *from color scheme and
@@ -871,6 +877,26 @@ clone_cs_highlights(const col_scheme_t *from)
 	return file_hi;
 }
 
+/* (Re)creates set of matchers for looking up file highlight.  On failure the
+ * set is left absent and matchers are tried one by one. */
+static void
+build_file_hi_set(col_scheme_t *cs)
+{
+	int i;
+
+	matcher_set_free(cs->file_hi_set);
+	cs->file_hi_set = matcher_set_alloc();
+
+	for(i = 0; i < cs->file_hi_count && cs->file_hi_set != NULL; ++i)
+	{
+		if(matcher_set_add(cs->file_hi_set, cs->file_hi[i].matchers) != 0)
+		{
+			matcher_set_free(cs->file_hi_set);
+			cs->file_hi_set = NULL;
+		}
+	}
+}
+
 int
 cs_load_local(int left, const char dir[])
 {
@@ -1128,11 +1154,19 @@ cs_add_file_hi(struct matchers_t *matchers, const col_attr_t *hi)
 	file_hi->hi = *hi;
 
 	++cs->file_hi_count;
+
+	if(cs->file_hi_set == NULL ||
+			matcher_set_add(cs->file_hi_set, matchers) != 0)
+	{
+		build_file_hi_set(cs);
+	}
 }
 
 const col_attr_t *
 cs_get_file_hi(const col_scheme_t *cs, const char fname[], int *hi_hint)
 {
+	int i;
+
 	if(*hi_hint == INT_MAX)
 	{
 		return NULL;
@@ -1144,7 +1178,13 @@ cs_get_file_hi(const col_scheme_t *cs, const char fname[], int *hi_hint)
 		return &cs->file_hi[*hi_hint].hi;
 	}
 
-	int i;
+	if(cs->file_hi_set != NULL)
+	{
+		i = matcher_set_find(cs->file_hi_set, fname, 0);
+		*hi_hint = (i == -1 ? INT_MAX : i);
+		return (i == -1 ? NULL : &cs->file_hi[i].hi);
+	}
+
 	for(i = 0; i < cs->file_hi_count; ++i)
 	{
 		const file_hi_t *const file_hi = &cs->file_hi[i];
@@ -1173,6 +1213,7 @@ cs_del_file_hi(const char matchers_expr[])
 			memmove(&cs->file_hi[i], &cs->file_hi[i + 1],
 					sizeof(*cs->file_hi)*((cs->file_hi_count - 1) - i));
 			--cs->file_hi_count;
+			build_file_hi_set(cs);
 			return 1;
 		}
 	}
@@ -40,6 +40,7 @@ typedef enum
 }
 ColorSchemeState;
 
+struct matcher_set_t;
 struct matchers_t;
 
 /* Single file highlight description. */
@@ -61,6 +62,8 @@ typedef struct
 
 	file_hi_t *file_hi; /* List of file highlight preferences. */
 	int file_hi_count;  /* Number of file highlight definitions. */
+	/* Matchers of file_hi compiled for lookup or NULL to try them in order. */
+	struct matcher_set_t *file_hi_set;
 }
 col_scheme_t;
 
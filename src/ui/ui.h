@@ -222,6 +222,8 @@ struct dir_entry_t
 	                     INT_MAX signifies absence of a match. */
 	int name_dec_num; /* File decoration parameters cache (initially -1).  The
 	                     value is shifted by one, 0 means type decoration. */
+	int group_key;    /* Index of keys of sorting groups in view::group_keys or
+	                     -1.  Might be stale, so it's checked on use. */
 
 	int child_count; /* Number of child entries (all, not just direct). */
 	int child_pos;   /* Position of this entry in among children of its parent.
@@ -238,6 +240,8 @@ struct dir_entry_t
 	unsigned int marked : 1;       /* Whether file should be processed. */
 	unsigned int temporary : 1;    /* Whether this is temporary node. */
 	unsigned int dir_link : 1;     /* Whether this is symlink to a directory. */
+	unsigned int folded : 1;       /* Whether contents of this directory isn't
+	                                  loaded in tree-view. */
 };
 
 /* List of entries bundled with its size. */
@@ -279,6 +283,20 @@ struct cv_data_t
 	 * by tree-view. */
 	struct trie_t *excluded_paths;
 
+	/* Folding state of directories set by the user in tree-view.  Maps paths of
+	 * folded directories to non-NULL and of unfolded ones to NULL. */
+	struct trie_t *folds;
+	/* Depth of tree-view starting with which directories are folded.  Zero
+	 * stands for a small default depth with the rest of the tree being loaded in
+	 * background. */
+	int tree_depth;
+	/* Whether tree-view has directories that are yet to be loaded in
+	 * background. */
+	int tree_loading;
+	/* Position in the list starting from which directories are loaded in
+	 * background. */
+	int tree_cursor;
+
 	/* Names of files in custom view while it's being composed.  Used for
 	 * duplicate elimination during construction of custom list. */
 	struct trie_t *paths_cache;
@@ -306,6 +324,11 @@ struct local_filter_t
 	size_t unfiltered_count;
 	/* Number of entries filtered in other ways. */
 	size_t prefiltered_count;
+	/* Names of unfiltered directories with trailing slash (NULL for other
+	 * entries) that are matched against the filter. */
+	char **match_names;
+	/* Number of elements in the match_names field. */
+	size_t match_names_len;
 
 	/* List of previous cursor positions in the unfiltered array. */
 	int *poshist;
@@ -407,6 +430,9 @@ struct view_t
 	char *sort_groups, *sort_groups_g;
 	/* Primary group in compiled form. */
 	regex_t primary_group;
+	/* Keys of sorting groups extracted from names of files (see sort.c).  Can be
+	 * NULL. */
+	struct group_keys_t *group_keys;
 
 	int history_num;    /* Number of used history elements. */
 	int history_pos;    /* Current position in history. */
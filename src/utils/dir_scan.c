@@ -0,0 +1,473 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "dir_scan.h"
+
+#ifndef _WIN32
+#include <sys/stat.h> /* S_ISDIR() S_ISLNK() fstatat() stat */
+#include <fcntl.h> /* AT_SYMLINK_NOFOLLOW */
+#endif
+
+#include <stddef.h> /* NULL */
+#include <stdlib.h> /* calloc() free() */
+#include <string.h> /* strdup() */
+
+#include "../compat/os.h"
+#include "../compat/pthread.h"
+#include "../compat/reallocarray.h"
+#include "fs.h"
+#include "path.h"
+#include "str.h"
+
+/* State of a directory of a scanner. */
+typedef enum
+{
+	NS_QUEUED,  /* Waits to be read. */
+	NS_READING, /* Is being read. */
+	NS_READ,    /* Was read. */
+}
+NodeState;
+
+/* Directory of a scanner. */
+struct dir_scan_node_t
+{
+	char *path;              /* Full path to the directory. */
+	int depth;               /* Depth of entries of the directory. */
+	dir_scan_node_t *parent; /* Containing directory or NULL for root. */
+	dir_scan_node_t *next;   /* Next node in the list of all nodes. */
+
+	NodeState state;           /* State of the directory. */
+	int dropped;               /* Whether listing won't be retrieved. */
+	int failed;                /* Whether reading has failed. */
+	dir_scan_entry_t *entries; /* Listing or NULL. */
+	int count;                 /* Number of entries in the listing. */
+};
+
+/* State of a scanner. */
+struct dir_scan_t
+{
+	dir_scan_pred_t pred;  /* Whether to scan a subdirectory. */
+	void *arg;             /* Argument for pred. */
+	dir_scan_node_t *root; /* Root of the hierarchy. */
+
+	pthread_mutex_t lock;    /* Protects fields below and nodes. */
+	pthread_cond_t queued;   /* Signaled when stack is extended or on stop. */
+	pthread_cond_t read;     /* Signaled when a directory is read. */
+	dir_scan_node_t *all;    /* List of all nodes. */
+	dir_scan_node_t **stack; /* Stack of directories to read. */
+	int depth;               /* Number of items on the stack. */
+	int capacity;            /* Capacity of the stack. */
+	int stop;                /* Whether threads should quit. */
+
+	pthread_t *threads; /* Threads of the scanner. */
+	int nthreads;       /* Number of successfully started threads. */
+};
+
+static int add_entry(dir_scan_entry_t **entries, int *count, int *capacity,
+		const char name[]);
+static void * scan_thread(void *arg);
+static int is_dropped(const dir_scan_node_t *node);
+static void read_node(dir_scan_t *scan, dir_scan_node_t *node);
+static dir_scan_node_t * add_node(dir_scan_t *scan, dir_scan_node_t *parent,
+		const char path[]);
+
+int
+dir_scan_list(const char path[], dir_scan_entry_t **entries, int *count)
+{
+	DIR *dir;
+	struct dirent *d;
+	int capacity = 0;
+
+	dir = os_opendir(path);
+	if(dir == NULL)
+	{
+		return 1;
+	}
+
+	*entries = NULL;
+	*count = 0;
+
+	while((d = os_readdir(dir)) != NULL)
+	{
+		dir_scan_entry_t *entry;
+
+		if(is_builtin_dir(d->d_name))
+		{
+			continue;
+		}
+
+		if(add_entry(entries, count, &capacity, d->d_name) != 0)
+		{
+			os_closedir(dir);
+			dir_scan_free_list(*entries, *count);
+			return 1;
+		}
+		entry = &(*entries)[*count - 1];
+
+#ifndef _WIN32
+		/* Files that disappear between reading directory and querying their
+		 * attributes are just skipped. */
+		if(fstatat(dirfd(dir), d->d_name, &entry->stat, AT_SYMLINK_NOFOLLOW) != 0)
+		{
+			free(entry->name);
+			--*count;
+			continue;
+		}
+
+		entry->is_link = S_ISLNK(entry->stat.st_mode);
+		entry->is_dir = S_ISDIR(entry->stat.st_mode);
+		if(entry->is_link)
+		{
+			struct stat s;
+			entry->is_dir = (fstatat(dirfd(dir), d->d_name, &s, 0) == 0)
+			             && S_ISDIR(s.st_mode);
+		}
+#else
+		{
+			char *const full_path = format_str("%s/%s", path, d->d_name);
+			entry->is_link = is_symlink(full_path);
+			entry->is_dir = is_dir(full_path);
+			free(full_path);
+		}
+#endif
+	}
+	os_closedir(dir);
+
+	return 0;
+}
+
+/* Appends an entry with the name to the listing.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+add_entry(dir_scan_entry_t **entries, int *count, int *capacity,
+		const char name[])
+{
+	if(*count == *capacity)
+	{
+		const int new_capacity = (*capacity == 0 ? 16 : *capacity*2);
+		dir_scan_entry_t *const new_entries = reallocarray(*entries, new_capacity,
+				sizeof(**entries));
+		if(new_entries == NULL)
+		{
+			return 1;
+		}
+		*entries = new_entries;
+		*capacity = new_capacity;
+	}
+
+	(*entries)[*count].name = strdup(name);
+	if((*entries)[*count].name == NULL)
+	{
+		return 1;
+	}
+	(*entries)[*count].child = NULL;
+	++*count;
+	return 0;
+}
+
+void
+dir_scan_free_list(dir_scan_entry_t *entries, int count)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		free(entries[i].name);
+	}
+	free(entries);
+}
+
+dir_scan_t *
+dir_scan_start(const char path[], int nthreads, dir_scan_pred_t pred,
+		void *arg)
+{
+	dir_scan_t *const scan = calloc(1, sizeof(*scan));
+	if(scan == NULL)
+	{
+		return NULL;
+	}
+
+	scan->pred = pred;
+	scan->arg = arg;
+	pthread_mutex_init(&scan->lock, NULL);
+	pthread_cond_init(&scan->queued, NULL);
+	pthread_cond_init(&scan->read, NULL);
+
+	scan->root = add_node(scan, NULL, path);
+	scan->threads = reallocarray(NULL, nthreads, sizeof(*scan->threads));
+	if(scan->root == NULL || (nthreads > 0 && scan->threads == NULL))
+	{
+		dir_scan_free(scan);
+		return NULL;
+	}
+
+	for(scan->nthreads = 0; scan->nthreads < nthreads; ++scan->nthreads)
+	{
+		if(pthread_create(&scan->threads[scan->nthreads], NULL, &scan_thread,
+					scan) != 0)
+		{
+			/* Directories which aren't picked up by threads are read on
+			 * retrieval. */
+			break;
+		}
+	}
+
+	return scan;
+}
+
+void
+dir_scan_free(dir_scan_t *scan)
+{
+	int i;
+
+	if(scan == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&scan->lock);
+	scan->stop = 1;
+	pthread_cond_broadcast(&scan->queued);
+	pthread_mutex_unlock(&scan->lock);
+
+	for(i = 0; i < scan->nthreads; ++i)
+	{
+		(void)pthread_join(scan->threads[i], NULL);
+	}
+	free(scan->threads);
+
+	while(scan->all != NULL)
+	{
+		dir_scan_node_t *const node = scan->all;
+		scan->all = node->next;
+
+		dir_scan_free_list(node->entries, node->count);
+		free(node->path);
+		free(node);
+	}
+
+	free(scan->stack);
+	pthread_cond_destroy(&scan->read);
+	pthread_cond_destroy(&scan->queued);
+	pthread_mutex_destroy(&scan->lock);
+	free(scan);
+}
+
+dir_scan_node_t *
+dir_scan_root(dir_scan_t *scan)
+{
+	return scan->root;
+}
+
+int
+dir_scan_get(dir_scan_t *scan, dir_scan_node_t *node,
+		dir_scan_entry_t **entries, int *count)
+{
+	int failed;
+
+	pthread_mutex_lock(&scan->lock);
+	if(node->state == NS_QUEUED)
+	{
+		/* Don't wait for threads to get to it. */
+		node->state = NS_READING;
+		pthread_mutex_unlock(&scan->lock);
+		read_node(scan, node);
+		pthread_mutex_lock(&scan->lock);
+	}
+
+	while(node->state != NS_READ)
+	{
+		pthread_cond_wait(&scan->read, &scan->lock);
+	}
+
+	failed = node->failed;
+	*entries = node->entries;
+	*count = node->count;
+	node->entries = NULL;
+	node->count = 0;
+	pthread_mutex_unlock(&scan->lock);
+
+	return failed;
+}
+
+void
+dir_scan_drop(dir_scan_t *scan, dir_scan_node_t *node)
+{
+	pthread_mutex_lock(&scan->lock);
+	node->dropped = 1;
+	if(node->state == NS_READ)
+	{
+		/* The listing was read ahead of time and is of no use anymore. */
+		dir_scan_free_list(node->entries, node->count);
+		node->entries = NULL;
+		node->count = 0;
+	}
+	pthread_mutex_unlock(&scan->lock);
+}
+
+/* Entry point of a thread of a scanner.  Returns NULL. */
+static void *
+scan_thread(void *arg)
+{
+	dir_scan_t *const scan = arg;
+
+	pthread_mutex_lock(&scan->lock);
+	while(!scan->stop)
+	{
+		dir_scan_node_t *node;
+
+		if(scan->depth == 0)
+		{
+			pthread_cond_wait(&scan->queued, &scan->lock);
+			continue;
+		}
+
+		node = scan->stack[--scan->depth];
+		if(node->state != NS_QUEUED)
+		{
+			/* Already picked up by the consumer. */
+			continue;
+		}
+
+		node->state = NS_READING;
+		if(is_dropped(node))
+		{
+			node->state = NS_READ;
+			continue;
+		}
+
+		pthread_mutex_unlock(&scan->lock);
+		read_node(scan, node);
+		pthread_mutex_lock(&scan->lock);
+	}
+	pthread_mutex_unlock(&scan->lock);
+
+	return NULL;
+}
+
+/* Checks whether the node or any of its parents was dropped.  Should be called
+ * with the lock held.  Returns non-zero if so, otherwise zero is returned. */
+static int
+is_dropped(const dir_scan_node_t *node)
+{
+	for(; node != NULL; node = node->parent)
+	{
+		if(node->dropped)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Reads a directory in NS_READING state and queues its subdirectories. */
+static void
+read_node(dir_scan_t *scan, dir_scan_node_t *node)
+{
+	dir_scan_entry_t *entries;
+	int count;
+	int i;
+
+	const int failed = dir_scan_list(node->path, &entries, &count);
+	if(failed)
+	{
+		entries = NULL;
+		count = 0;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		if(entries[i].is_dir && !entries[i].is_link)
+		{
+			char *const path = format_str("%s/%s", node->path, entries[i].name);
+			if(path != NULL && scan->pred(path, node->depth, scan->arg))
+			{
+				entries[i].child = add_node(scan, node, path);
+			}
+			free(path);
+		}
+	}
+
+	pthread_mutex_lock(&scan->lock);
+
+	/* Push subdirectories in reverse order for the first of them to be read
+	 * first, which is the order in which they are likely to be retrieved. */
+	for(i = count - 1; i >= 0; --i)
+	{
+		if(entries[i].child == NULL)
+		{
+			continue;
+		}
+
+		if(scan->depth == scan->capacity)
+		{
+			const int new_capacity = (scan->capacity == 0 ? 64 : scan->capacity*2);
+			dir_scan_node_t **const new_stack = reallocarray(scan->stack,
+					new_capacity, sizeof(*scan->stack));
+			if(new_stack == NULL)
+			{
+				/* It will be read on retrieval. */
+				continue;
+			}
+			scan->stack = new_stack;
+			scan->capacity = new_capacity;
+		}
+		scan->stack[scan->depth++] = entries[i].child;
+	}
+
+	node->failed = failed;
+	node->entries = entries;
+	node->count = count;
+	node->state = NS_READ;
+
+	pthread_cond_broadcast(&scan->queued);
+	pthread_cond_broadcast(&scan->read);
+	pthread_mutex_unlock(&scan->lock);
+}
+
+/* Allocates a queued node for a directory at the path.  Returns the node or
+ * NULL on error. */
+static dir_scan_node_t *
+add_node(dir_scan_t *scan, dir_scan_node_t *parent, const char path[])
+{
+	dir_scan_node_t *const node = calloc(1, sizeof(*node));
+	if(node == NULL)
+	{
+		return NULL;
+	}
+
+	node->path = strdup(path);
+	if(node->path == NULL)
+	{
+		free(node);
+		return NULL;
+	}
+
+	node->parent = parent;
+	node->depth = (parent == NULL ? 1 : parent->depth + 1);
+	node->state = NS_QUEUED;
+
+	pthread_mutex_lock(&scan->lock);
+	node->next = scan->all;
+	scan->all = node;
+	pthread_mutex_unlock(&scan->lock);
+
+	return node;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,93 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__UTILS__DIR_SCAN_H__
+#define VIFM__UTILS__DIR_SCAN_H__
+
+#ifndef _WIN32
+#include <sys/stat.h> /* stat */
+#endif
+
+/* Listing of directories along with attributes of their entries.  A listing
+ * can be obtained directly or from a scanner which reads a hierarchy ahead of
+ * its consumer on a pool of threads.  The consumer walks the hierarchy in
+ * whatever order it likes requesting listings of directories and is never
+ * affected by the order in which they are actually read. */
+
+/* Opaque handle of a scanner. */
+typedef struct dir_scan_t dir_scan_t;
+
+/* Opaque handle of a directory of a scanner. */
+typedef struct dir_scan_node_t dir_scan_node_t;
+
+/* Single entry of a directory listing. */
+typedef struct
+{
+	char *name;             /* Name of the entry. */
+	int is_link;            /* Whether entry is a symbolic link. */
+	int is_dir;             /* Whether entry is a directory or a link to one. */
+#ifndef _WIN32
+	struct stat stat;       /* Result of lstat() for the entry. */
+#endif
+	dir_scan_node_t *child; /* Scanned listing of this directory or NULL. */
+}
+dir_scan_entry_t;
+
+/* Callback that decides whether directory should be scanned.  depth is the
+ * depth of the directory, where entries of the root are at depth one.  Invoked
+ * on threads of the scanner, so must be safe to call concurrently.  Should
+ * return non-zero to scan the directory. */
+typedef int (*dir_scan_pred_t)(const char path[], int depth, void *arg);
+
+/* Lists directory reading attributes of each entry once and in order of their
+ * appearance in the directory.  *entries should be freed with
+ * dir_scan_free_list().  Returns zero on success, otherwise non-zero is
+ * returned. */
+int dir_scan_list(const char path[], dir_scan_entry_t **entries, int *count);
+
+/* Frees a listing. */
+void dir_scan_free_list(dir_scan_entry_t *entries, int count);
+
+/* Starts scanning hierarchy at the path on nthreads threads.  Subdirectories
+ * (but not symbolic links to them) for which pred returns non-zero are
+ * scanned.  Returns the scanner or NULL on error. */
+dir_scan_t * dir_scan_start(const char path[], int nthreads,
+		dir_scan_pred_t pred, void *arg);
+
+/* Stops the scanner and frees all resources including listings that weren't
+ * retrieved.  scan can be NULL. */
+void dir_scan_free(dir_scan_t *scan);
+
+/* Retrieves root directory of the scanner.  Returns the directory. */
+dir_scan_node_t * dir_scan_root(dir_scan_t *scan);
+
+/* Retrieves listing of a directory of the scanner waiting for it if needed
+ * (directory that wasn't read yet is read by the calling thread).  The listing
+ * can be retrieved only once, its ownership is passed to the caller.  Returns
+ * zero on success, otherwise non-zero is returned. */
+int dir_scan_get(dir_scan_t *scan, dir_scan_node_t *node,
+		dir_scan_entry_t **entries, int *count);
+
+/* Lets the scanner know that listing of the directory and of its
+ * subdirectories won't be retrieved. */
+void dir_scan_drop(dir_scan_t *scan, dir_scan_node_t *node);
+
+#endif /* VIFM__UTILS__DIR_SCAN_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
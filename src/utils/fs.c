@@ -30,8 +30,10 @@
 #endif
 
 #include <sys/stat.h> /* S_* statbuf */
-#include <sys/types.h> /* size_t mode_t */
-#include <unistd.h> /* pathconf() readlink() */
+#include <sys/types.h> /* off_t size_t mode_t */
+#include <fcntl.h> /* O_RDONLY open() */
+#include <unistd.h> /* SEEK_DATA SEEK_HOLE close() lseek() pathconf()
+                       readlink() */
 
 #include <ctype.h> /* isalpha() */
 #include <errno.h> /* errno */
@@ -512,6 +514,61 @@ get_file_size(const char path[])
 #endif
 }
 
+uint64_t
+get_file_data_size(const char path[])
+{
+#if !defined(_WIN32) && defined(SEEK_DATA) && defined(SEEK_HOLE)
+	struct stat st;
+	int fd;
+	off_t data;
+	uint64_t size;
+
+	if(os_lstat(path, &st) != 0)
+	{
+		return 0U;
+	}
+
+	/* Only files that occupy less space than their size can contain holes. */
+	if(!S_ISREG(st.st_mode) ||
+			(uint64_t)st.st_blocks*512U >= (uint64_t)st.st_size)
+	{
+		return (uint64_t)st.st_size;
+	}
+
+	fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		return (uint64_t)st.st_size;
+	}
+
+	size = 0U;
+	data = 0;
+	while((data = lseek(fd, data, SEEK_DATA)) >= 0)
+	{
+		const off_t hole = lseek(fd, data, SEEK_HOLE);
+		if(hole < 0)
+		{
+			break;
+		}
+
+		size += hole - data;
+		data = hole;
+	}
+
+	/* ENXIO means that there is no more data after the offset, anything else
+	 * is an error or lack of support of hole detection. */
+	if(data < 0 && errno != ENXIO)
+	{
+		size = (uint64_t)st.st_size;
+	}
+
+	close(fd);
+	return size;
+#else
+	return get_file_size(path);
+#endif
+}
+
 char **
 list_regular_files(const char path[], char *list[], int *len)
 {
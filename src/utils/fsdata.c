@@ -63,6 +63,8 @@ static node_t * get_or_create_node(node_t *root, const char path[],
 static node_t * make_node(const char name[], size_t name_len, size_t data_size);
 static int map_parents(node_t *root, const char path[],
 		fsdata_visit_func visitor, void *arg);
+static void map_path(node_t *root, const char path[],
+		fsdata_visit_func visitor, void *arg);
 static int resolve_path(const fsdata_t *fsd, const char path[],
 		char real_path[]);
 static int traverse_node(node_t *node, const node_t *parent,
@@ -313,6 +315,61 @@ fsdata_map_parents(fsdata_t *fsd, const char path[], fsdata_visit_func visitor,
 	return map_parents(fsd->root, real_path, visitor, arg);
 }
 
+int
+fsdata_map_path(fsdata_t *fsd, const char path[], fsdata_visit_func visitor,
+		void *arg)
+{
+	char real_path[PATH_MAX + 1];
+	if(resolve_path(fsd, path, real_path) != 0)
+	{
+		return 1;
+	}
+
+	if(fsd->root != NULL)
+	{
+		map_path(fsd->root, real_path, visitor, arg);
+	}
+	return 0;
+}
+
+/* Invokes visitor once per valid node starting with the root and descending
+ * along the path while corresponding nodes exist. */
+static void
+map_path(node_t *root, const char path[], fsdata_visit_func visitor, void *arg)
+{
+	const char *end;
+	size_t name_len;
+	node_t *curr;
+
+	if(root->valid)
+	{
+		visitor(&root->data, arg);
+	}
+
+	path = skip_char(path, '/');
+	if(*path == '\0')
+	{
+		return;
+	}
+
+	end = until_first(path, '/');
+
+	name_len = end - path;
+	for(curr = root->child; curr != NULL; curr = curr->next)
+	{
+		const int cmp = strnoscmp(path, curr->name, name_len);
+		if(cmp == 0 && curr->name_len == name_len)
+		{
+			map_path(curr, end, visitor, arg);
+			break;
+		}
+		else if(cmp < 0)
+		{
+			break;
+		}
+	}
+}
+
 /* Performs optional path resolution (configured at tree creation).  real_path
  * should be at least PATH_MAX chars in length.  Returns zero on success,
  * otherwise non-zero is returned. */
@@ -59,6 +59,13 @@ int fsdata_get(fsdata_t *fsd, const char path[], void *data, size_t len);
 int fsdata_map_parents(fsdata_t *fsd, const char path[],
 		fsdata_visit_func visitor, void *arg);
 
+/* Invokes visitor once per valid node on the way from root to the path
+ * including the node of the path itself.  The path doesn't need to be present
+ * in the tree.  Returns zero on success or non-zero if path couldn't be
+ * resolved. */
+int fsdata_map_path(fsdata_t *fsd, const char path[], fsdata_visit_func visitor,
+		void *arg);
+
 /* Calls the callback for each node.  Return non-zero if traversing was stopped
  * prematurely, otherwise zero is returned. */
 int fsdata_traverse(fsdata_t *fsd, fsdata_traverser_func traverser, void *arg);
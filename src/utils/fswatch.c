@@ -0,0 +1,60 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Parts of fswatch that don't depend on the way changes are detected. */
+
+#include "fswatch.h"
+
+#include <stddef.h> /* NULL */
+#include <stdlib.h> /* free() */
+
+#ifndef HAVE_INOTIFY
+
+/* Without notifications about particular entries any change requires reload of
+ * the whole directory. */
+FSWatchState
+fswatch_poll(fswatch_t *w, fswatch_delta_t **deltas, int *count)
+{
+	int error;
+	const int changed = fswatch_changed(w, &error);
+
+	*deltas = NULL;
+	*count = 0;
+
+	if(error)
+	{
+		return FSWS_ERROR;
+	}
+	return (changed ? FSWS_REPLACED : FSWS_UNCHANGED);
+}
+
+#endif
+
+void
+fswatch_free_deltas(fswatch_delta_t deltas[], int count)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		free(deltas[i].name);
+	}
+	free(deltas);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
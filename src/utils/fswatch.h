@@ -24,6 +24,35 @@
 /* Opaque type of a watcher. */
 typedef struct fswatch_t fswatch_t;
 
+/* Kind of change that happened to an entry of watched directory. */
+typedef enum
+{
+	FSWE_CREATED,    /* Entry was created. */
+	FSWE_DELETED,    /* Entry was deleted. */
+	FSWE_MODIFIED,   /* Contents or metadata of the entry has changed. */
+	FSWE_MOVED_FROM, /* Entry was moved out of the directory or renamed. */
+	FSWE_MOVED_TO,   /* Entry was moved into the directory or renamed. */
+}
+FSWatchEvent;
+
+/* Result of querying watcher for changes. */
+typedef enum
+{
+	FSWS_UNCHANGED, /* Nothing has changed. */
+	FSWS_UPDATED,   /* Changes are fully described by the list of deltas. */
+	FSWS_REPLACED,  /* Changes can't be described by deltas, reload is needed. */
+	FSWS_ERROR,     /* Failed to query for changes. */
+}
+FSWatchState;
+
+/* Single change of a directory entry. */
+typedef struct
+{
+	char *name;         /* Name of the entry within watched directory. */
+	FSWatchEvent event; /* What has happened to the entry. */
+}
+fswatch_delta_t;
+
 /* Creates new watcher for the specified path.  Returns the watcher or NULL on
  * error. */
 fswatch_t * fswatch_create(const char path[]);
@@ -36,6 +65,15 @@ void fswatch_free(fswatch_t *w);
  * non-zero if so, otherwise zero is returned. */
 int fswatch_changed(fswatch_t *w, int *error);
 
+/* Same as fswatch_changed(), but also reports which entries have changed.
+ * *deltas and *count are set only for FSWS_UPDATED and list changes in the
+ * order they happened, the list should be freed by the caller with
+ * fswatch_free_deltas().  Returns state of the watched entity. */
+FSWatchState fswatch_poll(fswatch_t *w, fswatch_delta_t **deltas, int *count);
+
+/* Frees list of deltas returned by fswatch_poll(). */
+void fswatch_free_deltas(fswatch_delta_t deltas[], int count);
+
 #endif /* VIFM__UTILS__FSWATCH_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -29,9 +29,11 @@
 #include <stddef.h> /* NULL */
 #include <stdint.h> /* uint32_t */
 #include <stdlib.h> /* free() */
+#include <string.h> /* strcmp() strdup() */
 #include <time.h> /* time_t time() */
 
 #include "../compat/fs_limits.h"
+#include "../compat/reallocarray.h"
 #include "trie.h"
 
 /* TODO: consider implementation that could reuse already available descriptor
@@ -44,6 +46,9 @@ struct fswatch_t
 	int fd;
 	/* Trie to keep track of per file frequency of notifications. */
 	trie_t *stats;
+	/* When the whole directory should be reloaded to account for events that
+	 * were ignored during bans or zero. */
+	time_t refresh_at;
 };
 
 /* Per file statistics information. */
@@ -57,6 +62,8 @@ typedef struct
 }
 notif_stat_t;
 
+static int add_delta(fswatch_delta_t **deltas, int *count,
+		const struct inotify_event *e);
 static int update_file_stats(fswatch_t *w, const struct inotify_event *e,
 		time_t now);
 
@@ -101,6 +108,7 @@ fswatch_create(const char path[])
 		return NULL;
 	}
 
+	w->refresh_at = 0;
 	return w;
 }
 
@@ -117,17 +125,35 @@ fswatch_free(fswatch_t *w)
 
 int
 fswatch_changed(fswatch_t *w, int *error)
+{
+	fswatch_delta_t *deltas;
+	int count;
+
+	const FSWatchState state = fswatch_poll(w, &deltas, &count);
+	if(state == FSWS_UPDATED)
+	{
+		fswatch_free_deltas(deltas, count);
+	}
+
+	*error = (state == FSWS_ERROR);
+	return (state != FSWS_UNCHANGED);
+}
+
+FSWatchState
+fswatch_poll(fswatch_t *w, fswatch_delta_t **deltas, int *count)
 {
 	enum { MAX_READS = 100 };
 	enum { BUF_LEN = (10 * (sizeof(struct inotify_event) + NAME_MAX + 1)) };
 
 	char buf[BUF_LEN];
 	int nread;
-	int changed = 0;
 	int nreads = 0;
 	const time_t now = time(NULL);
+	FSWatchState state = FSWS_UNCHANGED;
+
+	*deltas = NULL;
+	*count = 0;
 
-	*error = 0;
 	do
 	{
 		char *p;
@@ -142,7 +168,7 @@ fswatch_changed(fswatch_t *w, int *error)
 				break;
 			}
 
-			*error = 1;
+			state = FSWS_ERROR;
 			break;
 		}
 
@@ -150,10 +176,20 @@ fswatch_changed(fswatch_t *w, int *error)
 		for(p = buf; p < buf + nread; p += sizeof(struct inotify_event) + e->len)
 		{
 			e = (struct inotify_event *)p;
-			if(update_file_stats(w, e, now))
+			if(!update_file_stats(w, e, now) || state == FSWS_REPLACED)
 			{
-				changed = 1;
+				continue;
 			}
+
+			/* Overflow of the queue or change of the directory itself can't be
+			 * expressed as a change of some entry. */
+			if(e->len == 0U || add_delta(deltas, count, e) != 0)
+			{
+				state = FSWS_REPLACED;
+				continue;
+			}
+
+			state = FSWS_UPDATED;
 		}
 
 		/* Limit maximum number of reads to ensure that we won't spend all our time
@@ -165,7 +201,84 @@ fswatch_changed(fswatch_t *w, int *error)
 	}
 	while(nread != 0);
 
-	return changed;
+	/* Entries whose events were ignored are out of date once their ban is over,
+	 * which isn't expressible via deltas. */
+	if(w->refresh_at != 0 && now >= w->refresh_at && state != FSWS_ERROR)
+	{
+		state = FSWS_REPLACED;
+	}
+	if(state == FSWS_REPLACED)
+	{
+		w->refresh_at = 0;
+	}
+
+	if(state != FSWS_UPDATED)
+	{
+		fswatch_free_deltas(*deltas, *count);
+		*deltas = NULL;
+		*count = 0;
+	}
+
+	return state;
+}
+
+/* Appends a delta that corresponds to the event to the list.  Returns zero on
+ * success, otherwise non-zero is returned. */
+static int
+add_delta(fswatch_delta_t **deltas, int *count, const struct inotify_event *e)
+{
+	fswatch_delta_t *delta;
+	FSWatchEvent event;
+
+	if(e->mask & IN_CREATE)
+	{
+		event = FSWE_CREATED;
+	}
+	else if(e->mask & IN_DELETE)
+	{
+		event = FSWE_DELETED;
+	}
+	else if(e->mask & IN_MOVED_FROM)
+	{
+		event = FSWE_MOVED_FROM;
+	}
+	else if(e->mask & IN_MOVED_TO)
+	{
+		event = FSWE_MOVED_TO;
+	}
+	else
+	{
+		event = FSWE_MODIFIED;
+	}
+
+	/* Skip repeated modifications of the same entry, which are very common (e.g.,
+	 * IN_MODIFY followed by IN_CLOSE_WRITE). */
+	if(*count != 0 && event == FSWE_MODIFIED)
+	{
+		const fswatch_delta_t *const last = &(*deltas)[*count - 1];
+		if(last->event == FSWE_MODIFIED && strcmp(last->name, e->name) == 0)
+		{
+			return 0;
+		}
+	}
+
+	delta = reallocarray(*deltas, *count + 1, sizeof(**deltas));
+	if(delta == NULL)
+	{
+		return 1;
+	}
+	*deltas = delta;
+
+	delta = &delta[*count];
+	delta->name = strdup(e->name);
+	delta->event = event;
+	if(delta->name == NULL)
+	{
+		return 1;
+	}
+
+	++*count;
+	return 0;
 }
 
 /* Updates information about a file event is about.  Returns non-zero if this is
@@ -211,9 +324,14 @@ update_file_stats(fswatch_t *w, const struct inotify_event *e, time_t now)
 		stats->count = 1;
 	}
 
-	/* Ignore events during banned period, unless it's something new. */
+	/* Ignore events during banned period, unless it's something new, but
+	 * schedule reload of the directory for when the ban is over. */
 	if(now < stats->banned_until && !(e->mask & ~stats->ban_mask))
 	{
+		if(w->refresh_at < stats->banned_until)
+		{
+			w->refresh_at = stats->banned_until;
+		}
 		return 0;
 	}
 
@@ -0,0 +1,619 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "mapped_text.h"
+
+#include <sys/stat.h> /* S_ISREG() fstat() stat */
+#ifndef _WIN32
+#include <sys/mman.h> /* MAP_* PROT_* mmap() munmap() */
+#include <fcntl.h> /* O_RDONLY open() */
+#include <unistd.h> /* close() */
+#endif
+
+#include <limits.h> /* INT_MAX */
+#include <stddef.h> /* NULL size_t */
+#include <stdio.h> /* FILE SEEK_END SEEK_SET fclose() fread() fseek() ftell() */
+#include <stdlib.h> /* free() malloc() realloc() */
+#include <string.h> /* memcmp() memcpy() */
+
+#include "../compat/os.h"
+#include "../compat/pthread.h"
+#include "../compat/reallocarray.h"
+#include "macros.h"
+
+/* Number of bytes indexed between checks for being stopped. */
+#define CHUNK_SIZE (1024*1024)
+
+/* Number of offsets collected before publishing them. */
+#define BATCH_SIZE 4096
+
+/* Mapped file. */
+struct mapped_text_t
+{
+	const char *data; /* Contents of the file. */
+	size_t size;      /* Size of the data. */
+	size_t start;     /* Where text starts (after byte order mark). */
+	size_t resume;    /* Where indexing starts. */
+#ifndef _WIN32
+	int fd;           /* Descriptor of the file for validity checks. */
+#endif
+
+	pthread_mutex_t lock; /* Protects fields below. */
+	pthread_cond_t added; /* Signaled when new lines are indexed. */
+	size_t *offsets;      /* Offsets of beginnings of lines. */
+	int count;            /* Number of indexed lines. */
+	int capacity;         /* Number of allocated offsets. */
+	int complete;         /* Whether indexing is over. */
+	int stop;             /* Whether indexing should stop. */
+
+	pthread_t thread; /* Indexing thread. */
+	int has_thread;   /* Whether the thread was started. */
+};
+
+static int map_file(mapped_text_t *text, const char path[]);
+static int is_replaced(const mapped_text_t *text, const char path[]);
+static int get_size(const mapped_text_t *text, const char path[],
+		size_t *size);
+static int remap_file(mapped_text_t *text, const char path[], size_t size);
+static void unmap_file(mapped_text_t *text);
+static void start_indexing(mapped_text_t *text);
+static void * index_lines(void *arg);
+static int publish_offsets(mapped_text_t *text, const size_t offsets[],
+		int count);
+static size_t find_line_end(const mapped_text_t *text, size_t pos);
+static size_t skip_separator(const mapped_text_t *text, size_t end);
+static int is_stopped(mapped_text_t *text);
+static int has_shrunk(const mapped_text_t *text);
+
+mapped_text_t *
+mapped_text_open(const char path[])
+{
+	static const char bom[] = "\xef\xbb\xbf";
+
+	mapped_text_t *const text = malloc(sizeof(*text));
+	if(text == NULL)
+	{
+		return NULL;
+	}
+
+	if(map_file(text, path) != 0)
+	{
+		free(text);
+		return NULL;
+	}
+
+	text->start = 0U;
+	if(text->size >= sizeof(bom) - 1U &&
+			memcmp(text->data, bom, sizeof(bom) - 1U) == 0)
+	{
+		text->start = sizeof(bom) - 1U;
+	}
+
+	if(text->start == text->size)
+	{
+		unmap_file(text);
+		free(text);
+		return NULL;
+	}
+
+	text->resume = text->start;
+	text->offsets = NULL;
+	text->count = 0;
+	text->capacity = 0;
+	text->complete = 0;
+	text->stop = 0;
+
+	if(pthread_mutex_init(&text->lock, NULL) != 0)
+	{
+		unmap_file(text);
+		free(text);
+		return NULL;
+	}
+	if(pthread_cond_init(&text->added, NULL) != 0)
+	{
+		pthread_mutex_destroy(&text->lock);
+		unmap_file(text);
+		free(text);
+		return NULL;
+	}
+
+	start_indexing(text);
+	return text;
+}
+
+/* Starts indexing lines from the resume position in background. */
+static void
+start_indexing(mapped_text_t *text)
+{
+	text->has_thread = (pthread_create(&text->thread, NULL, &index_lines,
+				text) == 0);
+	if(!text->has_thread)
+	{
+		/* Do all the work right away. */
+		(void)index_lines(text);
+	}
+}
+
+void
+mapped_text_close(mapped_text_t *text)
+{
+	if(text == NULL)
+	{
+		return;
+	}
+
+	if(text->has_thread)
+	{
+		pthread_mutex_lock(&text->lock);
+		text->stop = 1;
+		pthread_mutex_unlock(&text->lock);
+		(void)pthread_join(text->thread, NULL);
+	}
+
+	pthread_cond_destroy(&text->added);
+	pthread_mutex_destroy(&text->lock);
+	free(text->offsets);
+	unmap_file(text);
+	free(text);
+}
+
+MappedTextUpdate
+mapped_text_update(mapped_text_t *text, const char path[], int *nkept)
+{
+	int complete;
+	size_t size;
+
+	*nkept = mapped_text_count(text, &complete);
+	if(!complete)
+	{
+		return MTU_SAME;
+	}
+
+	if(is_replaced(text, path) || get_size(text, path, &size) != 0 ||
+			size < text->size)
+	{
+		return MTU_REPLACED;
+	}
+	if(size == text->size)
+	{
+		return MTU_SAME;
+	}
+
+	if(text->has_thread)
+	{
+		(void)pthread_join(text->thread, NULL);
+		text->has_thread = 0;
+	}
+
+	if(remap_file(text, path, size) != 0)
+	{
+		return MTU_SAME;
+	}
+
+	/* The last line can continue in the appended data, so it's indexed anew,
+	 * which also handles "\r" that is followed by "\n" now. */
+	pthread_mutex_lock(&text->lock);
+	if(text->count != 0)
+	{
+		text->resume = text->offsets[--text->count];
+	}
+	text->complete = 0;
+	pthread_mutex_unlock(&text->lock);
+
+	*nkept = text->count;
+	start_indexing(text);
+	return MTU_GREW;
+}
+
+/* Makes contents of a file available in memory.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+map_file(mapped_text_t *text, const char path[])
+{
+#ifndef _WIN32
+	struct stat st;
+	void *mapped;
+
+	const int fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		return 1;
+	}
+
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+	{
+		close(fd);
+		return 1;
+	}
+
+	mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(mapped == MAP_FAILED)
+	{
+		close(fd);
+		return 1;
+	}
+
+	text->data = mapped;
+	text->size = st.st_size;
+	text->fd = fd;
+	return 0;
+#else
+	char *buf;
+	long len;
+
+	FILE *const fp = os_fopen(path, "rb");
+	if(fp == NULL)
+	{
+		return 1;
+	}
+
+	if(fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= 0 ||
+			fseek(fp, 0, SEEK_SET) != 0)
+	{
+		fclose(fp);
+		return 1;
+	}
+
+	buf = malloc(len);
+	if(buf == NULL || fread(buf, len, 1, fp) != 1)
+	{
+		free(buf);
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	text->data = buf;
+	text->size = len;
+	return 0;
+#endif
+}
+
+/* Checks whether path refers to a file different from the mapped one.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+is_replaced(const mapped_text_t *text, const char path[])
+{
+#ifndef _WIN32
+	struct stat mapped_st, path_st;
+	return fstat(text->fd, &mapped_st) != 0
+	    || os_stat(path, &path_st) != 0
+	    || mapped_st.st_dev != path_st.st_dev
+	    || mapped_st.st_ino != path_st.st_ino;
+#else
+	return 0;
+#endif
+}
+
+/* Retrieves current size of the mapped file.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+get_size(const mapped_text_t *text, const char path[], size_t *size)
+{
+	struct stat st;
+#ifndef _WIN32
+	if(fstat(text->fd, &st) != 0)
+#else
+	if(os_stat(path, &st) != 0)
+#endif
+	{
+		return 1;
+	}
+	*size = st.st_size;
+	return 0;
+}
+
+/* Makes the first size bytes of the file available in memory replacing
+ * current mapping.  Returns zero on success, otherwise non-zero is returned. */
+static int
+remap_file(mapped_text_t *text, const char path[], size_t size)
+{
+#ifndef _WIN32
+	void *const mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, text->fd, 0);
+	if(mapped == MAP_FAILED)
+	{
+		return 1;
+	}
+
+	(void)munmap((void *)text->data, text->size);
+	text->data = mapped;
+	text->size = size;
+	return 0;
+#else
+	char *buf;
+	long len;
+
+	FILE *const fp = os_fopen(path, "rb");
+	if(fp == NULL)
+	{
+		return 1;
+	}
+
+	if(fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= (long)text->size ||
+			fseek(fp, text->size, SEEK_SET) != 0)
+	{
+		fclose(fp);
+		return 1;
+	}
+
+	buf = realloc((void *)text->data, len);
+	if(buf == NULL)
+	{
+		fclose(fp);
+		return 1;
+	}
+	text->data = buf;
+
+	/* Only the tail is read, the rest is already in memory. */
+	if(fread(buf + text->size, len - text->size, 1, fp) != 1)
+	{
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	text->size = len;
+	return 0;
+#endif
+}
+
+/* Frees resources allocated by map_file(). */
+static void
+unmap_file(mapped_text_t *text)
+{
+#ifndef _WIN32
+	(void)munmap((void *)text->data, text->size);
+	close(text->fd);
+#else
+	free((void *)text->data);
+#endif
+}
+
+/* Entry point of indexing thread, which records beginnings of all lines.
+ * Returns NULL. */
+static void *
+index_lines(void *arg)
+{
+	mapped_text_t *const text = arg;
+	size_t batch[BATCH_SIZE];
+	int nbatch = 0;
+	size_t pos = text->resume;
+
+	while(pos < text->size)
+	{
+		const size_t chunk_end = pos + MIN((size_t)CHUNK_SIZE, text->size - pos);
+
+		if(is_stopped(text) || has_shrunk(text))
+		{
+			break;
+		}
+
+		while(pos < chunk_end)
+		{
+			batch[nbatch++] = pos;
+			pos = skip_separator(text, find_line_end(text, pos));
+
+			if(nbatch == BATCH_SIZE)
+			{
+				if(publish_offsets(text, batch, nbatch) != 0)
+				{
+					pos = text->size;
+				}
+				nbatch = 0;
+			}
+		}
+
+		if(publish_offsets(text, batch, nbatch) != 0)
+		{
+			break;
+		}
+		nbatch = 0;
+	}
+
+	pthread_mutex_lock(&text->lock);
+	text->complete = 1;
+	pthread_cond_broadcast(&text->added);
+	pthread_mutex_unlock(&text->lock);
+	return NULL;
+}
+
+/* Appends offsets of lines to the index and notifies waiters.  Returns zero on
+ * success, otherwise non-zero is returned. */
+static int
+publish_offsets(mapped_text_t *text, const size_t offsets[], int count)
+{
+	int error = 0;
+
+	pthread_mutex_lock(&text->lock);
+
+	if(count > INT_MAX - text->count)
+	{
+		error = 1;
+	}
+	else if(text->count + count > text->capacity)
+	{
+		const int doubled = (text->capacity > INT_MAX/2)
+		                  ? INT_MAX
+		                  : text->capacity*2;
+		const int capacity = MAX(doubled, text->count + count);
+		size_t *const new_offsets = reallocarray(text->offsets, capacity,
+				sizeof(*new_offsets));
+		if(new_offsets == NULL)
+		{
+			error = 1;
+		}
+		else
+		{
+			text->offsets = new_offsets;
+			text->capacity = capacity;
+		}
+	}
+
+	if(!error)
+	{
+		memcpy(text->offsets + text->count, offsets, count*sizeof(*offsets));
+		text->count += count;
+		pthread_cond_broadcast(&text->added);
+	}
+
+	pthread_mutex_unlock(&text->lock);
+	return error;
+}
+
+int
+mapped_text_count(mapped_text_t *text, int *complete)
+{
+	int count;
+
+	pthread_mutex_lock(&text->lock);
+	count = text->count;
+	*complete = text->complete;
+	pthread_mutex_unlock(&text->lock);
+
+	return count;
+}
+
+int
+mapped_text_wait(mapped_text_t *text, int n)
+{
+	int count;
+
+	pthread_mutex_lock(&text->lock);
+	while(text->count < n && !text->complete)
+	{
+		pthread_cond_wait(&text->added, &text->lock);
+	}
+	count = text->count;
+	pthread_mutex_unlock(&text->lock);
+
+	return count;
+}
+
+const char *
+mapped_text_get(mapped_text_t *text, int n, char **buf, size_t *buf_len)
+{
+	size_t begin, end;
+
+	pthread_mutex_lock(&text->lock);
+	if(n < 0 || n >= text->count)
+	{
+		pthread_mutex_unlock(&text->lock);
+		return NULL;
+	}
+	begin = text->offsets[n];
+	pthread_mutex_unlock(&text->lock);
+
+	end = find_line_end(text, begin);
+
+	if(*buf_len < end - begin + 1U)
+	{
+		char *const new_buf = realloc(*buf, end - begin + 1U);
+		if(new_buf == NULL)
+		{
+			return NULL;
+		}
+		*buf = new_buf;
+		*buf_len = end - begin + 1U;
+	}
+
+	memcpy(*buf, text->data + begin, end - begin);
+	(*buf)[end - begin] = '\0';
+	return *buf;
+}
+
+/* Finds end of a line that starts at the specified position.  Returns offset
+ * of the separator or size of the data. */
+static size_t
+find_line_end(const mapped_text_t *text, size_t pos)
+{
+	const char *const data = text->data;
+	while(pos < text->size && data[pos] != '\n' && data[pos] != '\r' &&
+			data[pos] != '\0')
+	{
+		++pos;
+	}
+	return pos;
+}
+
+/* Skips line separator at the specified position.  Returns offset of the next
+ * line. */
+static size_t
+skip_separator(const mapped_text_t *text, size_t end)
+{
+	const char *const data = text->data;
+
+	if(end >= text->size)
+	{
+		return text->size;
+	}
+
+	if(data[end] == '\n')
+	{
+		return end + 1U;
+	}
+
+	if(data[end] == '\r')
+	{
+		return (end + 1U < text->size && data[end + 1U] == '\n')
+		     ? end + 2U
+		     : end + 1U;
+	}
+
+	/* A sequence of null characters is a single separator. */
+	do
+	{
+		++end;
+	}
+	while(end < text->size && data[end] == '\0');
+	return end;
+}
+
+/* Checks whether indexing was requested to stop.  Returns non-zero if so,
+ * otherwise zero is returned. */
+static int
+is_stopped(mapped_text_t *text)
+{
+	int stop;
+	pthread_mutex_lock(&text->lock);
+	stop = text->stop;
+	pthread_mutex_unlock(&text->lock);
+	return stop;
+}
+
+int
+mapped_text_is_valid(mapped_text_t *text)
+{
+	return !has_shrunk(text);
+}
+
+/* Checks whether the file became shorter than its mapping, in which case
+ * accessing the tail of the mapping would crash the application.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+has_shrunk(const mapped_text_t *text)
+{
+#ifndef _WIN32
+	struct stat st;
+	return (fstat(text->fd, &st) != 0 || (size_t)st.st_size < text->size);
+#else
+	return 0;
+#endif
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,76 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__UTILS__MAPPED_TEXT_H__
+#define VIFM__UTILS__MAPPED_TEXT_H__
+
+#include <stddef.h> /* size_t */
+
+/* Text file mapped into memory, lines of which are indexed by a background
+ * thread, so that beginning of a file can be accessed without waiting for the
+ * whole file to be processed.  Lines are split the same way
+ * break_into_lines() does it. */
+
+/* Opaque handle of a mapped file. */
+typedef struct mapped_text_t mapped_text_t;
+
+/* Result of checking mapped file for changes. */
+typedef enum
+{
+	MTU_SAME,     /* Nothing was appended to the file (yet). */
+	MTU_GREW,     /* New data was appended and is being indexed. */
+	MTU_REPLACED, /* The file was truncated or replaced and needs reopening. */
+}
+MappedTextUpdate;
+
+/* Maps a file and starts indexing its lines.  Returns the handle or NULL if the
+ * file is not a regular one, is empty or can't be mapped. */
+mapped_text_t * mapped_text_open(const char path[]);
+
+/* Stops indexing and frees resources of the text.  text can be NULL. */
+void mapped_text_close(mapped_text_t *text);
+
+/* Retrieves number of lines indexed so far.  *complete is set to non-zero if
+ * indexing is over.  Returns the number. */
+int mapped_text_count(mapped_text_t *text, int *complete);
+
+/* Waits until at least n lines are indexed or indexing is over.  Returns number
+ * of indexed lines. */
+int mapped_text_wait(mapped_text_t *text, int n);
+
+/* Retrieves contents of an indexed line.  *buf of size *buf_len is reallocated
+ * as needed to hold the line.  Returns pointer to the line or NULL on
+ * error. */
+const char * mapped_text_get(mapped_text_t *text, int n, char **buf,
+		size_t *buf_len);
+
+/* Extends mapping and index of the text if data was appended to the file at
+ * the path, only the new tail is processed.  *nkept is set to number of lines
+ * that weren't affected by the change (the last line might be extended).  Files
+ * are checked only after indexing is over.  Returns status of the update. */
+MappedTextUpdate mapped_text_update(mapped_text_t *text, const char path[],
+		int *nkept);
+
+/* Checks whether the mapping can still be accessed (e.g., the file wasn't
+ * truncated).  Returns non-zero if so, otherwise zero is returned. */
+int mapped_text_is_valid(mapped_text_t *text);
+
+#endif /* VIFM__UTILS__MAPPED_TEXT_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -445,5 +445,27 @@ matcher_is_full_path(const matcher_t *matcher)
 	return matcher->full_path;
 }
 
+const char *
+matcher_get_name_globs(const matcher_t *matcher)
+{
+	if(matcher->type != MT_GLOBS || matcher->negated || matcher->full_path ||
+			matcher_is_empty(matcher))
+	{
+		return NULL;
+	}
+	return matcher->undec;
+}
+
+const char *
+matcher_get_regex(const matcher_t *matcher, int *cflags)
+{
+	if(matcher->type == MT_MIME || matcher->negated || matcher_is_empty(matcher))
+	{
+		return NULL;
+	}
+	*cflags = matcher->cflags;
+	return matcher->raw;
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -64,6 +64,15 @@ int matcher_includes(const matcher_t *matcher, const matcher_t *like);
  * otherwise zero is returned. */
 int matcher_is_full_path(const matcher_t *matcher);
 
+/* Retrieves list of globs of a matcher that is a non-negated glob matcher of
+ * file names.  Returns comma-separated globs or NULL for other matchers. */
+const char * matcher_get_name_globs(const matcher_t *matcher);
+
+/* Retrieves regular expression that is used by a non-negated glob or regexp
+ * matcher along with flags it's compiled with.  Returns the expression or NULL
+ * for other matchers (including empty ones). */
+const char * matcher_get_regex(const matcher_t *matcher, int *cflags);
+
 #endif /* VIFM__UTILS__MATCHER_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
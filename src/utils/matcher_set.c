@@ -0,0 +1,634 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "matcher_set.h"
+
+#include <regex.h> /* regex_t regcomp() regexec() regfree() */
+
+#include <ctype.h> /* isdigit() tolower() */
+#include <limits.h> /* INT_MAX */
+#include <stddef.h> /* NULL size_t */
+#include <stdlib.h> /* free() malloc() */
+#include <string.h> /* strchr() strdup() strlen() strpbrk() */
+
+#include "../compat/reallocarray.h"
+#include "macros.h"
+#include "matcher.h"
+#include "matchers.h"
+#include "path.h"
+#include "str.h"
+#include "trie.h"
+
+/* Maximum number of regular expressions compiled together.  POSIX regular
+ * expressions can't tell which alternative has matched, so rules of a matched
+ * group are checked one by one and groups should be small. */
+#define GROUP_SIZE 16
+
+/* Ascending list of indexes of rules. */
+typedef struct
+{
+	int *items; /* Indexes of rules. */
+	int count;  /* Number of items. */
+}
+rule_list_t;
+
+/* Rules with regular expressions of the same kind compiled together. */
+typedef struct
+{
+	rule_list_t rules; /* Rules of the group. */
+	int cflags;        /* Compilation flags of the expressions. */
+	int full_path;     /* Whether expressions match full path. */
+	regex_t regex;     /* Alternation of expressions of the rules. */
+	int compiled;      /* Whether regex is valid (checked always otherwise). */
+}
+re_group_t;
+
+/* Set of matchers. */
+struct matcher_set_t
+{
+	const matchers_t **rules; /* All rules in order. */
+	int count;                /* Number of rules. */
+
+	int compiled;           /* Whether fields below are up to date. */
+	trie_t *exts;           /* Lowercase extensions to rule_list_t. */
+	trie_t *names;          /* Lowercase file names to rule_list_t. */
+	rule_list_t name_rules; /* Rules in exts and names tries. */
+	re_group_t *groups;     /* Groups of regular expressions. */
+	int ngroups;            /* Number of groups. */
+	rule_list_t others;     /* Rules that are matched individually. */
+};
+
+static int compile_set(matcher_set_t *set);
+static int add_rule(matcher_set_t *set, int index);
+static int add_name_rule(matcher_set_t *set, const char globs[], int index);
+static int is_simple_glob(const char glob[], int *is_ext);
+static int add_key(trie_t *trie, const char key[], int index);
+static int has_backrefs(const char regex[]);
+static int add_group_rule(matcher_set_t *set, int cflags, int full_path,
+		int index);
+static int compile_groups(matcher_set_t *set);
+static void drop_compiled(matcher_set_t *set);
+static void free_rule_list(void *ptr);
+static int append_rule(rule_list_t *list, int index);
+static int find_by_name(const matcher_set_t *set, const char name[], int from);
+static int find_in_list(const matcher_set_t *set, const rule_list_t *list,
+		const char path[], int from, int best);
+static int first_after(const rule_list_t *list, int from);
+static int is_ascii(const char str[]);
+
+matcher_set_t *
+matcher_set_alloc(void)
+{
+	matcher_set_t *const set = malloc(sizeof(*set));
+	if(set == NULL)
+	{
+		return NULL;
+	}
+
+	set->rules = NULL;
+	set->count = 0;
+	set->compiled = 0;
+	set->exts = NULL;
+	set->names = NULL;
+	set->name_rules = (rule_list_t){};
+	set->groups = NULL;
+	set->ngroups = 0;
+	set->others = (rule_list_t){};
+	return set;
+}
+
+void
+matcher_set_free(matcher_set_t *set)
+{
+	if(set != NULL)
+	{
+		drop_compiled(set);
+		free(set->rules);
+		free(set);
+	}
+}
+
+int
+matcher_set_add(matcher_set_t *set, const matchers_t *matchers)
+{
+	const matchers_t **const rules = reallocarray(set->rules, set->count + 1,
+			sizeof(*rules));
+	if(rules == NULL)
+	{
+		return 1;
+	}
+
+	set->rules = rules;
+	set->rules[set->count++] = matchers;
+
+	drop_compiled(set);
+	return 0;
+}
+
+int
+matcher_set_find(matcher_set_t *set, const char path[], int from)
+{
+	const char *name;
+	int best = INT_MAX;
+	int i;
+
+	if(!set->compiled && compile_set(set) != 0)
+	{
+		/* Fallback to trying rules in order. */
+		for(i = from; i < set->count; ++i)
+		{
+			if(matchers_match(set->rules[i], path))
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	name = get_last_path_component(path);
+
+	/* Case folding is done only for ASCII and names with other characters are
+	 * matched the slow way. */
+	if(is_ascii(name))
+	{
+		best = find_by_name(set, name, from);
+	}
+	else
+	{
+		best = find_in_list(set, &set->name_rules, path, from, best);
+	}
+
+	for(i = 0; i < set->ngroups; ++i)
+	{
+		const re_group_t *const group = &set->groups[i];
+		const rule_list_t *const rules = &group->rules;
+		if(rules->items[rules->count - 1] < from || rules->items[0] >= best)
+		{
+			continue;
+		}
+
+		if(group->compiled &&
+				regexec(&group->regex, group->full_path ? path : name, 0, NULL, 0) != 0)
+		{
+			continue;
+		}
+
+		best = find_in_list(set, rules, path, from, best);
+	}
+
+	best = find_in_list(set, &set->others, path, from, best);
+
+	return (best == INT_MAX ? -1 : best);
+}
+
+/* Splits rules into categories and compiles groups of regular expressions.
+ * Returns zero on success, otherwise non-zero is returned. */
+static int
+compile_set(matcher_set_t *set)
+{
+	int i;
+
+	set->exts = trie_create();
+	set->names = trie_create();
+	if(set->exts == NULL || set->names == NULL)
+	{
+		drop_compiled(set);
+		return 1;
+	}
+
+	for(i = 0; i < set->count; ++i)
+	{
+		if(add_rule(set, i) != 0)
+		{
+			drop_compiled(set);
+			return 1;
+		}
+	}
+
+	if(compile_groups(set) != 0)
+	{
+		drop_compiled(set);
+		return 1;
+	}
+
+	set->compiled = 1;
+	return 0;
+}
+
+/* Puts rule into appropriate category.  Returns zero on success, otherwise
+ * non-zero is returned. */
+static int
+add_rule(matcher_set_t *set, int index)
+{
+	const matcher_t *const m = matchers_get_single(set->rules[index]);
+	const char *globs, *regex;
+	int cflags;
+
+	if(m == NULL)
+	{
+		return append_rule(&set->others, index);
+	}
+
+	globs = matcher_get_name_globs(m);
+	if(globs != NULL)
+	{
+		const int result = add_name_rule(set, globs, index);
+		if(result <= 0)
+		{
+			return -result;
+		}
+	}
+
+	regex = matcher_get_regex(m, &cflags);
+	if(regex != NULL && !has_backrefs(regex))
+	{
+		return add_group_rule(set, cflags, matcher_is_full_path(m), index);
+	}
+
+	return append_rule(&set->others, index);
+}
+
+/* Adds rule to lookup tries if all of its globs are "*.ext" or plain names.
+ * Returns zero on success, positive number if globs aren't suitable and
+ * negative number on error. */
+static int
+add_name_rule(matcher_set_t *set, const char globs[], int index)
+{
+	char *const copy = strdup(globs);
+	char *glob, *state;
+	int error = 0;
+	int is_ext;
+
+	if(copy == NULL)
+	{
+		return -1;
+	}
+
+	/* The list is split the same way globs_to_regex() does it. */
+	for(glob = copy, state = NULL;
+			(glob = split_and_get(glob, ',', &state)) != NULL; )
+	{
+		if(!is_simple_glob(glob, &is_ext))
+		{
+			free(copy);
+			return 1;
+		}
+	}
+
+	for(glob = copy, state = NULL;
+			(glob = split_and_get(glob, ',', &state)) != NULL && !error; )
+	{
+		(void)is_simple_glob(glob, &is_ext);
+		/* Skip "*" of an extension, but keep the dot. */
+		error |= add_key(is_ext ? set->exts : set->names, glob + is_ext, index);
+	}
+
+	free(copy);
+
+	if(error || append_rule(&set->name_rules, index) != 0)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/* Checks whether glob is either "*.ext" or a plain name, that consist of ASCII
+ * characters that aren't special.  Sets *is_ext. Returns non-zero if so,
+ * otherwise zero is returned. */
+static int
+is_simple_glob(const char glob[], int *is_ext)
+{
+	*is_ext = (glob[0] == '*' && glob[1] == '.');
+	if(*is_ext)
+	{
+		glob += 2;
+	}
+
+	return is_ascii(glob) && strpbrk(glob, "*?[]\\/") == NULL;
+}
+
+/* Adds index of a rule to the list associated with lowercase version of the
+ * key.  Returns zero on success, otherwise non-zero is returned. */
+static int
+add_key(trie_t *trie, const char key[], int index)
+{
+	void *data;
+	rule_list_t *list;
+	char *const lower = strdup(key);
+	char *p;
+
+	if(lower == NULL)
+	{
+		return 1;
+	}
+
+	for(p = lower; *p != '\0'; ++p)
+	{
+		*p = tolower((unsigned char)*p);
+	}
+
+	if(trie_get(trie, lower, &data) == 0)
+	{
+		list = data;
+		free(lower);
+		/* Same rule can have several globs that are equal ignoring case. */
+		if(list->items[list->count - 1] == index)
+		{
+			return 0;
+		}
+		return append_rule(list, index);
+	}
+
+	list = malloc(sizeof(*list));
+	if(list == NULL)
+	{
+		free(lower);
+		return 1;
+	}
+	*list = (rule_list_t){};
+
+	if(append_rule(list, index) != 0 || trie_set(trie, lower, list) < 0)
+	{
+		free_rule_list(list);
+		free(lower);
+		return 1;
+	}
+
+	free(lower);
+	return 0;
+}
+
+/* Checks whether regular expression refers to its subexpressions, numbers of
+ * which change when it's combined with other expressions.  Returns non-zero if
+ * so, otherwise zero is returned. */
+static int
+has_backrefs(const char regex[])
+{
+	const char *p = regex;
+	while((p = strchr(p, '\\')) != NULL)
+	{
+		if(isdigit((unsigned char)p[1]))
+		{
+			return 1;
+		}
+		p += (p[1] == '\0') ? 1 : 2;
+	}
+	return 0;
+}
+
+/* Adds regular expression of a rule to the last group of the same kind or
+ * creates a new one.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+add_group_rule(matcher_set_t *set, int cflags, int full_path, int index)
+{
+	re_group_t *group = NULL;
+	int i;
+
+	for(i = set->ngroups - 1; i >= 0; --i)
+	{
+		if(set->groups[i].cflags == cflags && set->groups[i].full_path == full_path)
+		{
+			group = &set->groups[i];
+			break;
+		}
+	}
+
+	if(group == NULL || group->rules.count == GROUP_SIZE)
+	{
+		re_group_t *const groups = reallocarray(set->groups, set->ngroups + 1,
+				sizeof(*groups));
+		if(groups == NULL)
+		{
+			return 1;
+		}
+		set->groups = groups;
+
+		group = &set->groups[set->ngroups++];
+		group->rules = (rule_list_t){};
+		group->cflags = cflags;
+		group->full_path = full_path;
+		group->compiled = 0;
+	}
+
+	return append_rule(&group->rules, index);
+}
+
+/* Compiles alternations of regular expressions of all groups.  Returns zero on
+ * success, otherwise non-zero is returned. */
+static int
+compile_groups(matcher_set_t *set)
+{
+	int i, j;
+	for(i = 0; i < set->ngroups; ++i)
+	{
+		re_group_t *const group = &set->groups[i];
+		char *combined = NULL;
+		size_t len = 0U;
+
+		for(j = 0; j < group->rules.count; ++j)
+		{
+			const int index = group->rules.items[j];
+			const matcher_t *const m = matchers_get_single(set->rules[index]);
+			int cflags;
+			const char *const regex = matcher_get_regex(m, &cflags);
+
+			if(strappend(&combined, &len, (j == 0) ? "(" : "|(") != 0 ||
+					strappend(&combined, &len, regex) != 0 ||
+					strappendch(&combined, &len, ')') != 0)
+			{
+				free(combined);
+				return 1;
+			}
+		}
+
+		/* An expression might be valid only on its own, in which case the group
+		 * is always checked rule by rule. */
+		group->compiled = (regcomp(&group->regex, combined, group->cflags) == 0);
+		if(!group->compiled)
+		{
+			regfree(&group->regex);
+		}
+		free(combined);
+	}
+	return 0;
+}
+
+/* Frees data derived from the list of rules. */
+static void
+drop_compiled(matcher_set_t *set)
+{
+	int i;
+
+	trie_free_with_data(set->exts, &free_rule_list);
+	set->exts = NULL;
+	trie_free_with_data(set->names, &free_rule_list);
+	set->names = NULL;
+
+	free(set->name_rules.items);
+	set->name_rules = (rule_list_t){};
+
+	for(i = 0; i < set->ngroups; ++i)
+	{
+		if(set->groups[i].compiled)
+		{
+			regfree(&set->groups[i].regex);
+		}
+		free(set->groups[i].rules.items);
+	}
+	free(set->groups);
+	set->groups = NULL;
+	set->ngroups = 0;
+
+	free(set->others.items);
+	set->others = (rule_list_t){};
+
+	set->compiled = 0;
+}
+
+/* Frees rule list stored in a trie.  ptr can be NULL. */
+static void
+free_rule_list(void *ptr)
+{
+	rule_list_t *const list = ptr;
+	if(list != NULL)
+	{
+		free(list->items);
+		free(list);
+	}
+}
+
+/* Appends index of a rule to the list.  Returns zero on success, otherwise
+ * non-zero is returned. */
+static int
+append_rule(rule_list_t *list, int index)
+{
+	int *const items = reallocarray(list->items, list->count + 1,
+			sizeof(*items));
+	if(items == NULL)
+	{
+		return 1;
+	}
+
+	list->items = items;
+	list->items[list->count++] = index;
+	return 0;
+}
+
+/* Looks up rules that match the name literally or by its extension.  Returns
+ * the first matching rule not before from or INT_MAX. */
+static int
+find_by_name(const matcher_set_t *set, const char name[], int from)
+{
+	void *data;
+	int best = INT_MAX;
+	char *p;
+
+	char *const lower = strdup(name);
+	if(lower == NULL)
+	{
+		return find_in_list(set, &set->name_rules, name, from, best);
+	}
+
+	for(p = lower; *p != '\0'; ++p)
+	{
+		*p = tolower((unsigned char)*p);
+	}
+
+	if(trie_get(set->names, lower, &data) == 0)
+	{
+		best = MIN(best, first_after(data, from));
+	}
+
+	/* "*" of a glob doesn't match leading dot and must match at least one
+	 * character. */
+	if(lower[0] != '.' && lower[0] != '\0')
+	{
+		for(p = strchr(lower + 1, '.'); p != NULL; p = strchr(p + 1, '.'))
+		{
+			if(trie_get(set->exts, p, &data) == 0)
+			{
+				best = MIN(best, first_after(data, from));
+			}
+		}
+	}
+
+	free(lower);
+	return best;
+}
+
+/* Matches rules of the list one by one in the range [from, best).  Returns
+ * index of the first matching rule or best. */
+static int
+find_in_list(const matcher_set_t *set, const rule_list_t *list,
+		const char path[], int from, int best)
+{
+	int i;
+	for(i = 0; i < list->count; ++i)
+	{
+		const int index = list->items[i];
+		if(index >= best)
+		{
+			break;
+		}
+		if(index >= from && matchers_match(set->rules[index], path))
+		{
+			return index;
+		}
+	}
+	return best;
+}
+
+/* Finds the first item of the list that isn't less than from.  Returns the
+ * item or INT_MAX. */
+static int
+first_after(const rule_list_t *list, int from)
+{
+	int lo = 0, hi = list->count;
+	while(lo < hi)
+	{
+		const int mid = lo + (hi - lo)/2;
+		if(list->items[mid] < from)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return (lo == list->count ? INT_MAX : list->items[lo]);
+}
+
+/* Checks whether the string consists of ASCII characters only.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+is_ascii(const char str[])
+{
+	while(*str != '\0')
+	{
+		if((unsigned char)*str++ >= 0x80)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
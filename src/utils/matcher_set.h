@@ -0,0 +1,52 @@
+/* vifm
+ * Copyright (C) 2026 xaizek.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__UTILS__MATCHER_SET_H__
+#define VIFM__UTILS__MATCHER_SET_H__
+
+/* Ordered list of matchers (rules) compiled for quick lookup of the first rule
+ * that matches a path.  Globs like "*.ext" and literal names are looked up by
+ * name, regular expressions are checked in groups and only the rest is matched
+ * one by one.  The result is the same as of trying rules in order with
+ * matchers_match(). */
+
+struct matchers_t;
+
+/* Opaque handle of a set. */
+typedef struct matcher_set_t matcher_set_t;
+
+/* Allocates an empty set.  Returns the set or NULL on error. */
+matcher_set_t * matcher_set_alloc(void);
+
+/* Frees the set.  set can be NULL. */
+void matcher_set_free(matcher_set_t *set);
+
+/* Appends a rule to the set, its index is the number of rules added before it.
+ * The matchers aren't owned by the set and must outlive it.  Returns zero on
+ * success, otherwise non-zero is returned. */
+int matcher_set_add(matcher_set_t *set, const struct matchers_t *matchers);
+
+/* Finds the first rule that matches the path among rules starting with the one
+ * at the specified index.  Returns index of the rule or -1 if there is no
+ * match. */
+int matcher_set_find(matcher_set_t *set, const char path[], int from);
+
+#endif /* VIFM__UTILS__MATCHER_SET_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -21,6 +21,8 @@
 
 #include "test_helpers.h"
 
+struct matcher_t;
+
 /* Opaque matchers type. */
 typedef struct matchers_t matchers_t;
 
@@ -46,6 +48,10 @@ int matchers_match_dir(const matchers_t *matchers, const char path[]);
 /* Retrieves original matcher expression.  Returns the expression. */
 const char * matchers_get_expr(const matchers_t *matchers);
 
+/* Retrieves the only matcher of the list.  Returns the matcher or NULL if there
+ * are several of them. */
+const struct matcher_t * matchers_get_single(const matchers_t *matchers);
+
 /* Checks whether everything matched by the matcher is also matched by the like.
  * Returns non-zero if so, otherwise zero is returned. */
 int matchers_includes(const matchers_t *matchers, const matchers_t *like);
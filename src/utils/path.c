@@ -769,6 +769,12 @@ find_cmd_in_path(const char cmd[], size_t path_len, char path[])
 	for(i = 0; i < paths_count; i++)
 	{
 		char tmp_path[PATH_MAX + 1];
+
+		if(!may_contain_executable(i, cmd))
+		{
+			continue;
+		}
+
 		snprintf(tmp_path, sizeof(tmp_path), "%s/%s", paths[i], cmd);
 
 		/* Need to check for executable, not just a file, as this additionally
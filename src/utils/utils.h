@@ -115,6 +115,10 @@ const char * make_name_unique(const char filename[]);
 /* Returns process identification in a portable way. */
 unsigned int get_pid(void);
 
+/* Retrieves number of processors available to the process.  Returns the
+ * number, which is at least one. */
+unsigned int get_cpu_count(void);
+
 /* Finds command name in the command line and writes it to the buf.
  * Raw mode will preserve quotes on Windows.
  * Returns a pointer to the argument list. */
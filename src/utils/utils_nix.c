@@ -702,6 +702,13 @@ get_pid(void)
 	return getpid();
 }
 
+unsigned int
+get_cpu_count(void)
+{
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count < 1 ? 1U : (unsigned int)count);
+}
+
 int
 get_uid(const char user[], uid_t *uid)
 {
@@ -151,6 +151,14 @@ get_pid(void)
 	return GetCurrentProcessId();
 }
 
+unsigned int
+get_cpu_count(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors < 1 ? 1U : info.dwNumberOfProcessors);
+}
+
 int
 wcwidth(wchar_t c)
 {
@@ -1,5 +1,6 @@
 #include <stic.h>
 
+#include <stdio.h> /* snprintf() */
 #include <stdlib.h> /* free() */
 #include <string.h>
 
@@ -184,6 +185,38 @@ TEST(can_handle_extra_formats_of_command_builtin)
 	assert_int_equal(0, vle_cmds_run("command cmd"));
 }
 
+TEST(many_commands_are_resolved_by_name_and_prefix)
+{
+	char cmd[64];
+	int i;
+
+	for(i = 0; i < 26*26; ++i)
+	{
+		snprintf(cmd, sizeof(cmd), "command x%c%c body%d", 'a' + i/26, 'a' + i%26,
+				i);
+		assert_success(vle_cmds_run(cmd));
+	}
+
+	assert_success(vle_cmds_run("xaa"));
+	assert_string_equal("body0", user_cmd_info.cmd);
+	assert_success(vle_cmds_run("xmn"));
+	assert_string_equal("body325", user_cmd_info.cmd);
+	assert_success(vle_cmds_run("xzz"));
+	assert_string_equal("body675", user_cmd_info.cmd);
+
+	assert_int_equal(CMDS_ERR_UDF_IS_AMBIGUOUS, vle_cmds_run("x"));
+	assert_int_equal(CMDS_ERR_UDF_IS_AMBIGUOUS, vle_cmds_run("xm"));
+
+	assert_success(vle_cmds_run("delcommand xmn"));
+	assert_int_equal(CMDS_ERR_INVALID_CMD, vle_cmds_run("xmn"));
+	assert_success(vle_cmds_run("xmo"));
+	assert_string_equal("body326", user_cmd_info.cmd);
+
+	assert_success(vle_cmds_run("comclear"));
+	assert_int_equal(CMDS_ERR_INVALID_CMD, vle_cmds_run("xaa"));
+	assert_success(vle_cmds_run("m"));
+}
+
 static int
 dummy_cmd(const cmd_info_t *cmd_info)
 {
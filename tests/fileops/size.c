@@ -5,6 +5,7 @@
 #include <string.h> /* strcpy() strdup() */
 
 #include "../../src/cfg/config.h"
+#include "../../src/utils/cancellation.h"
 #include "../../src/utils/dynarray.h"
 #include "../../src/filelist.h"
 #include "../../src/fops_misc.h"
@@ -24,6 +25,7 @@ TEARDOWN()
 {
 	view_teardown(&lwin);
 
+	cfg.io_threads = 0;
 	stats_reset(&cfg);
 }
 
@@ -47,6 +49,72 @@ TEST(parent_dir_entry_triggers_calculation_of_current_dir)
 	assert_int_equal(73728, wait_for_size(TEST_DATA_PATH "/various-sizes"));
 }
 
+TEST(parallel_calculation_matches_sequential_one)
+{
+	uint64_t seq_size, par_size;
+	uint64_t size, nitems;
+
+	cfg.io_threads = 1;
+	seq_size = fops_dir_size(TEST_DATA_PATH, 1, &no_cancellation);
+	assert_true(seq_size != 0U);
+	assert_success(stats_reset(&cfg));
+
+	cfg.io_threads = 4;
+	par_size = fops_dir_size(TEST_DATA_PATH, 1, &no_cancellation);
+	assert_ulong_equal(seq_size, par_size);
+
+	/* Subdirectories are cached as well. */
+	dcache_get_at(TEST_DATA_PATH "/various-sizes", &size, &nitems);
+	assert_ulong_equal(73728, size);
+	dcache_get_at(TEST_DATA_PATH, &size, &nitems);
+	assert_ulong_equal(par_size, size);
+}
+
+TEST(parallel_calculation_uses_cached_sizes)
+{
+	uint64_t full_size;
+
+	cfg.io_threads = 4;
+
+	full_size = fops_dir_size(TEST_DATA_PATH, 1, &no_cancellation);
+	assert_success(dcache_set_at(TEST_DATA_PATH "/various-sizes", 10,
+				DCACHE_UNKNOWN));
+	assert_ulong_equal(full_size - 73728 + 10,
+			fops_dir_size(TEST_DATA_PATH, 0, &no_cancellation));
+}
+
+TEST(directory_size_is_calculated_in_bg_in_parallel)
+{
+	cfg.io_threads = 3;
+
+	strcpy(lwin.curr_dir, TEST_DATA_PATH);
+	setup_single_entry(&lwin, "various-sizes");
+	lwin.dir_entry[0].selected = 1;
+
+	fops_size_bg(&lwin, 0);
+	assert_int_equal(73728, wait_for_size(TEST_DATA_PATH "/various-sizes"));
+}
+
+TEST(number_of_threads_is_picked_automatically)
+{
+	uint64_t seq_size;
+
+	cfg.io_threads = 3;
+	assert_int_equal(3, cfg_read_threads());
+
+	cfg.io_threads = 0;
+	assert_true(cfg_read_threads() >= 1);
+	assert_true(cfg_read_threads() <= 16);
+
+	cfg.io_threads = 1;
+	seq_size = fops_dir_size(TEST_DATA_PATH, 1, &no_cancellation);
+	assert_success(stats_reset(&cfg));
+
+	cfg.io_threads = 0;
+	assert_ulong_equal(seq_size,
+			fops_dir_size(TEST_DATA_PATH, 1, &no_cancellation));
+}
+
 static void
 setup_single_entry(view_t *view, const char name[])
 {
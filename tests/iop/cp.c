@@ -6,13 +6,15 @@
 #endif
 #include <sys/stat.h> /* chmod() stat */
 #include <sys/types.h> /* stat */
-#include <unistd.h> /* _Exit() lstat() */
+#include <unistd.h> /* _Exit() lstat() truncate() */
 
 #include <signal.h> /* SIGXFSZ SIG_IGN signal() */
+#include <stdio.h> /* FILE fclose() fgetc() fopen() fputc() fputs() fseek() */
 #include <stdlib.h> /* EXIT_FAILURE EXIT_SUCCESS */
 
 #include "../../src/compat/fs_limits.h"
 #include "../../src/compat/os.h"
+#include "../../src/io/ioeta.h"
 #include "../../src/io/iop.h"
 #include "../../src/utils/fs.h"
 
@@ -20,6 +22,8 @@
 
 static void file_is_copied(const char original[]);
 
+static const io_cancellation_t no_cancellation;
+
 TEST(dir_is_not_copied)
 {
 	io_args_t args = {
@@ -174,6 +178,112 @@ file_is_copied(const char original[])
 	delete_test_file(SANDBOX_PATH "/copy");
 }
 
+TEST(progress_of_large_file_copying_is_reported)
+{
+	/* Make the file span several blocks of kernel copying. */
+	enum { SIZE = 3*1024*1024 + 1 };
+
+	int i;
+	FILE *const f = fopen(SANDBOX_PATH "/large", "wb");
+	assert_non_null(f);
+	for(i = 0; i < SIZE; ++i)
+	{
+		fputc(i%251, f);
+	}
+	fclose(f);
+
+	{
+		io_args_t args = {
+			.arg1.src = SANDBOX_PATH "/large",
+			.arg2.dst = SANDBOX_PATH "/large-copy",
+
+			.estim = ioeta_alloc(NULL, no_cancellation),
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		ioeta_calculate(args.estim, SANDBOX_PATH "/large", 0);
+		assert_int_equal(SIZE, args.estim->total_bytes);
+
+		assert_success(iop_cp(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+
+		assert_int_equal(1, args.estim->current_item);
+		assert_int_equal(SIZE, args.estim->current_byte);
+
+		ioeta_free(args.estim);
+	}
+
+	assert_true(files_are_identical(SANDBOX_PATH "/large",
+				SANDBOX_PATH "/large-copy"));
+
+	delete_test_file(SANDBOX_PATH "/large");
+	delete_test_file(SANDBOX_PATH "/large-copy");
+}
+
+/* Windows doesn't report allocated size of files. */
+TEST(holes_of_sparse_files_are_preserved, IF(not_windows))
+{
+	enum { SIZE = 8*1024*1024, DATA_AT = 4*1024*1024 };
+
+	struct stat src;
+	struct stat dst;
+	uint64_t data_size;
+
+	FILE *f = fopen(SANDBOX_PATH "/sparse", "wb");
+	assert_non_null(f);
+	assert_success(fseek(f, DATA_AT, SEEK_SET));
+	fputs("data", f);
+	fclose(f);
+	assert_success(truncate(SANDBOX_PATH "/sparse", SIZE));
+
+	data_size = get_file_data_size(SANDBOX_PATH "/sparse");
+
+	{
+		io_args_t args = {
+			.arg1.src = SANDBOX_PATH "/sparse",
+			.arg2.dst = SANDBOX_PATH "/sparse-copy",
+
+			.estim = ioeta_alloc(NULL, no_cancellation),
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		ioeta_calculate(args.estim, SANDBOX_PATH "/sparse", 0);
+		assert_int_equal(data_size, args.estim->total_bytes);
+
+		assert_success(iop_cp(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+
+		/* Only data is counted, holes aren't. */
+		assert_int_equal(data_size, args.estim->current_byte);
+
+		ioeta_free(args.estim);
+	}
+
+	assert_success(lstat(SANDBOX_PATH "/sparse", &src));
+	assert_success(lstat(SANDBOX_PATH "/sparse-copy", &dst));
+	assert_int_equal(SIZE, dst.st_size);
+	if((uint64_t)src.st_blocks*512U < SIZE)
+	{
+		/* The file system supports sparse files. */
+		assert_true(data_size < SIZE);
+		assert_true((uint64_t)dst.st_blocks*512U < SIZE);
+	}
+
+	f = fopen(SANDBOX_PATH "/sparse-copy", "rb");
+	assert_non_null(f);
+	assert_int_equal('\0', fgetc(f));
+	assert_success(fseek(f, DATA_AT, SEEK_SET));
+	assert_int_equal('d', fgetc(f));
+	assert_int_equal('a', fgetc(f));
+	assert_success(fseek(f, SIZE - 1, SEEK_SET));
+	assert_int_equal('\0', fgetc(f));
+	assert_int_equal(EOF, fgetc(f));
+	fclose(f);
+
+	delete_test_file(SANDBOX_PATH "/sparse");
+	delete_test_file(SANDBOX_PATH "/sparse-copy");
+}
+
 TEST(appending_works_for_files)
 {
 	uint64_t size;
@@ -4,13 +4,21 @@
 #include <sys/types.h> /* stat */
 #include <unistd.h> /* F_OK access() */
 
+#include <stdio.h> /* snprintf() */
+
+#include "../../src/compat/fs_limits.h"
 #include "../../src/compat/os.h"
+#include "../../src/io/ioeta.h"
 #include "../../src/io/iop.h"
 #include "../../src/io/ior.h"
 #include "../../src/utils/fs.h"
 
 #include "utils.h"
 
+static void create_tree(const char root[]);
+
+static const io_cancellation_t no_cancellation;
+
 TEST(file_is_copied)
 {
 	{
@@ -596,5 +604,98 @@ TEST(symlink_to_dir_is_symlink_after_copy, IF(not_windows))
 	}
 }
 
+TEST(directory_is_copied_in_parallel)
+{
+	create_tree(SANDBOX_PATH "/tree");
+
+	{
+		io_args_t args = {
+			.arg1.src = SANDBOX_PATH "/tree",
+			.arg2.dst = SANDBOX_PATH "/tree-copy",
+			.arg5.max_jobs = 4,
+			.estim = ioeta_alloc(NULL, no_cancellation),
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		ioeta_calculate(args.estim, SANDBOX_PATH "/tree", 0);
+
+		assert_success(ior_cp(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+
+		assert_int_equal(args.estim->total_items, args.estim->current_item);
+		assert_int_equal(args.estim->total_bytes, args.estim->current_byte);
+		ioeta_free(args.estim);
+	}
+
+	assert_true(is_dir(SANDBOX_PATH "/tree-copy/sub0/nested"));
+	assert_true(file_exists(SANDBOX_PATH "/tree-copy/file"));
+	assert_true(file_exists(SANDBOX_PATH "/tree-copy/sub0/file0"));
+	assert_true(file_exists(SANDBOX_PATH "/tree-copy/sub3/nested/file7"));
+	assert_int_equal(get_file_size(TEST_DATA_PATH "/read/binary-data"),
+			get_file_size(SANDBOX_PATH "/tree-copy/sub2/nested/data"));
+
+	delete_tree(SANDBOX_PATH "/tree");
+	delete_tree(SANDBOX_PATH "/tree-copy");
+}
+
+TEST(parallel_copy_fails_to_overwrite_by_default)
+{
+	create_tree(SANDBOX_PATH "/tree");
+	create_tree(SANDBOX_PATH "/tree-copy");
+
+	{
+		io_args_t args = {
+			.arg1.src = SANDBOX_PATH "/tree",
+			.arg2.dst = SANDBOX_PATH "/tree-copy",
+			.arg3.crs = IO_CRS_FAIL,
+			.arg5.max_jobs = 4,
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		assert_failure(ior_cp(&args));
+
+		assert_true(args.result.errors.error_count != 0);
+		ioe_errlst_free(&args.result.errors);
+	}
+
+	delete_tree(SANDBOX_PATH "/tree");
+	delete_tree(SANDBOX_PATH "/tree-copy");
+}
+
+/* Creates a directory tree with two levels of nesting, lots of empty files and
+ * a few non-empty ones. */
+static void
+create_tree(const char root[])
+{
+	char path[PATH_MAX + 1];
+	int i;
+
+	create_empty_dir(root);
+
+	snprintf(path, sizeof(path), "%s/file", root);
+	create_empty_file(path);
+
+	for(i = 0; i < 4; ++i)
+	{
+		int j;
+
+		snprintf(path, sizeof(path), "%s/sub%d", root, i);
+		create_empty_dir(path);
+		snprintf(path, sizeof(path), "%s/sub%d/nested", root, i);
+		create_empty_dir(path);
+
+		for(j = 0; j < 8; ++j)
+		{
+			snprintf(path, sizeof(path), "%s/sub%d/file%d", root, i, j);
+			create_empty_file(path);
+			snprintf(path, sizeof(path), "%s/sub%d/nested/file%d", root, i, j);
+			create_empty_file(path);
+		}
+
+		snprintf(path, sizeof(path), "%s/sub%d/nested/data", root, i);
+		clone_file(TEST_DATA_PATH "/read/binary-data", path);
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
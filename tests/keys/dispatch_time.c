@@ -0,0 +1,82 @@
+#include <stic.h>
+
+#include <stddef.h> /* size_t */
+#include <wchar.h> /* wchar_t */
+
+#include "../../src/engine/keys.h"
+#include "../../src/modes/modes.h"
+
+static size_t count_probes(int nmappings);
+static void add_mappings(int from, int to);
+
+TEST(children_are_looked_up_by_binary_search)
+{
+	/* Binary search needs at most ceil(log2(n + 1)) probes per lookup. */
+	assert_true(count_probes(100) <= 7);
+	assert_true(count_probes(20000) <= 15);
+}
+
+TEST(all_mappings_are_reachable)
+{
+	int i;
+
+	add_mappings(0, 5000);
+
+	for(i = 0; i < 5000; ++i)
+	{
+		const wchar_t keys[] = { L'\x4e00' + i, L'\0' };
+		assert_true(vle_keys_user_exists(keys, NORMAL_MODE));
+		assert_success(vle_keys_exec(keys));
+	}
+
+	for(i = 0; i < 5000; i += 2)
+	{
+		const wchar_t keys[] = { L'\x4e00' + i, L'\0' };
+		assert_success(vle_keys_user_remove(keys, NORMAL_MODE));
+	}
+
+	for(i = 0; i < 5000; ++i)
+	{
+		const wchar_t keys[] = { L'\x4e00' + i, L'\0' };
+		assert_int_equal(i%2 == 1, vle_keys_user_exists(keys, NORMAL_MODE));
+	}
+}
+
+/* Looks up every key after defining the specified number of user mappings.
+ * Returns maximum number of children examined for a single key. */
+static size_t
+count_probes(int nmappings)
+{
+	size_t max = 0;
+	int i;
+
+	vle_keys_user_clear();
+	add_mappings(0, nmappings);
+
+	for(i = 0; i < nmappings; ++i)
+	{
+		const wchar_t keys[] = { L'\x4e00' + i, L'\0' };
+		const size_t before = child_probes;
+		assert_true(vle_keys_user_exists(keys, NORMAL_MODE));
+		if(child_probes - before > max)
+		{
+			max = child_probes - before;
+		}
+	}
+	return max;
+}
+
+/* Maps keys with codes in the range [from, to) to nothing. */
+static void
+add_mappings(int from, int to)
+{
+	int i;
+	for(i = from; i < to; ++i)
+	{
+		const wchar_t lhs[] = { L'\x4e00' + i, L'\0' };
+		assert_success(vle_keys_user_add(lhs, L"", NORMAL_MODE, KEYS_FLAG_NONE));
+	}
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0: */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -1,23 +1,71 @@
 #include <stic.h>
 
+#ifndef _WIN32
+#include <sys/resource.h> /* getrlimit() setrlimit() */
+#include <sys/stat.h> /* mkfifo() */
+#include <sys/wait.h> /* waitpid() */
+#endif
+#include <fcntl.h> /* O_CLOEXEC O_RDONLY O_RDWR open() */
+#include <unistd.h> /* close() unlink() usleep() */
+
+#include <stdlib.h> /* free() */
+#include <string.h> /* strcat() strcpy() */
+
 #include "../../src/cfg/config.h"
+#include "../../src/compat/pthread.h"
 #include "../../src/utils/cancellation.h"
+#include "../../src/utils/macros.h"
 #include "../../src/utils/str.h"
 #include "../../src/ui/ui.h"
 #include "../../src/background.h"
 
 #include "utils.h"
 
+/* Number of external jobs to run at the same time in a stress test. */
+#define NJOBS 1000
+
+static int can_have_many_fds(void);
+static int has_errors(bg_job_t *job);
+static void wait_for_flag(const int *flag);
+static void blocking_task(bg_op_t *bg_op, void *arg);
+static void gated_task(bg_op_t *bg_op, void *arg);
+static void recording_task(bg_op_t *bg_op, void *arg);
+static void counting_task(bg_op_t *bg_op, void *arg);
+static void pausable_task(bg_op_t *bg_op, void *arg);
+
+/* Guards state below, which is shared with tasks. */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+/* Flag that unblocks blocking_task(). */
+static int release;
+/* Flag that is set by blocking_task() when it starts. */
+static int started;
+/* Order in which recording_task() was invoked. */
+static char order[16];
+/* Number of counting_task() running at the moment. */
+static int nrunning;
+/* Maximum value of nrunning. */
+static int max_running;
+/* Number of iterations done by pausable_task(). */
+static int iterations;
+
 SETUP()
 {
 	/* curr_view shouldn't be NULL, because of iteration over tabs before doing
 	 * exec(). */
 	curr_view = &lwin;
+
+	release = 0;
+	started = 0;
+	order[0] = '\0';
+	nrunning = 0;
+	max_running = 0;
+	iterations = 0;
 }
 
 TEARDOWN()
 {
 	curr_view = NULL;
+	bg_check();
 }
 
 TEST(background_redirects_streams_properly, IF(not_windows))
@@ -29,5 +77,359 @@ TEST(background_redirects_streams_properly, IF(not_windows))
 	update_string(&cfg.shell_cmd_flag, NULL);
 }
 
+TEST(tasks_of_the_same_class_run_one_at_a_time)
+{
+	int i;
+	for(i = 0; i < 10; ++i)
+	{
+		assert_success(bg_execute("", "", 0, BJC_BULK_IO, SANDBOX_PATH,
+					&counting_task, NULL));
+	}
+	wait_for_bg();
+
+	assert_int_equal(1, max_running);
+}
+
+TEST(tasks_of_different_classes_run_in_parallel)
+{
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &blocking_task,
+				NULL));
+	wait_for_flag(&started);
+
+	/* This would hang if it waited for the first task. */
+	assert_success(bg_execute("", "", 0, BJC_SIZE_CALC, NULL, &recording_task,
+				"a"));
+	while(bg_job_is_running(bg_jobs))
+	{
+		usleep(1000);
+	}
+
+	release = 1;
+	wait_for_bg();
+	assert_string_equal("a", order);
+}
+
+TEST(queued_tasks_can_be_reordered)
+{
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &blocking_task,
+				NULL));
+	wait_for_flag(&started);
+
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &recording_task,
+				"a"));
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &recording_task,
+				"b"));
+	assert_int_equal(2, bg_job_queue_pos(bg_jobs));
+
+	/* Reorder last two tasks. */
+	assert_success(bg_job_move(bg_jobs, -1));
+	assert_failure(bg_job_move(bg_jobs, -1));
+	assert_int_equal(1, bg_job_queue_pos(bg_jobs));
+	assert_int_equal(2, bg_job_queue_pos(bg_jobs->next));
+
+	release = 1;
+	wait_for_bg();
+	assert_string_equal("ba", order);
+	assert_int_equal(0, bg_job_queue_pos(bg_jobs));
+}
+
+TEST(task_of_higher_priority_is_started_first)
+{
+	int bulk_gate = 0, size_gate = 0;
+	char order_copy[sizeof(order)];
+	bg_job_t *bulk_job, *bulk_queued, *size_queued;
+
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &gated_task,
+				&bulk_gate));
+	bulk_job = bg_jobs;
+	wait_for_flag(&started);
+
+	pthread_mutex_lock(&lock);
+	started = 0;
+	pthread_mutex_unlock(&lock);
+
+	assert_success(bg_execute("", "", 0, BJC_SIZE_CALC, NULL, &gated_task,
+				&size_gate));
+	wait_for_flag(&started);
+
+	/* Both classes are busy, so these are queued with calculation of sizes going
+	 * first. */
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &recording_task,
+				"b"));
+	bulk_queued = bg_jobs;
+	assert_success(bg_execute("", "", 0, BJC_SIZE_CALC, NULL, &recording_task,
+				"s"));
+	size_queued = bg_jobs;
+	assert_int_equal(1, bg_job_queue_pos(size_queued));
+	assert_int_equal(2, bg_job_queue_pos(bulk_queued));
+
+	/* Tasks of different classes can't be reordered. */
+	assert_failure(bg_job_move(size_queued, 1));
+	assert_failure(bg_job_move(bulk_queued, -1));
+
+	/* Bulk operation is finished first, but the next one has to wait for
+	 * calculation of sizes. */
+	pthread_mutex_lock(&lock);
+	bulk_gate = 1;
+	pthread_mutex_unlock(&lock);
+	while(bg_job_is_running(bulk_job))
+	{
+		usleep(1000);
+	}
+	usleep(10000);
+	pthread_mutex_lock(&lock);
+	strcpy(order_copy, order);
+	pthread_mutex_unlock(&lock);
+	assert_string_equal("", order_copy);
+
+	pthread_mutex_lock(&lock);
+	size_gate = 1;
+	pthread_mutex_unlock(&lock);
+	wait_for_bg();
+	assert_string_equal("sb", order);
+}
+
+TEST(paused_task_is_not_started)
+{
+	bg_job_t *job;
+
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &blocking_task,
+				NULL));
+	wait_for_flag(&started);
+
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &recording_task,
+				"a"));
+	job = bg_jobs;
+	assert_success(bg_job_set_paused(job, 1));
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &recording_task,
+				"b"));
+
+	release = 1;
+	while(bg_job_is_running(bg_jobs))
+	{
+		usleep(1000);
+	}
+	assert_true(bg_job_is_running(job));
+	assert_string_equal("b", order);
+
+	assert_success(bg_job_set_paused(job, 0));
+	wait_for_bg();
+	assert_string_equal("ba", order);
+}
+
+TEST(running_task_is_paused_on_checking_for_cancellation)
+{
+	int count;
+
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL, &pausable_task,
+				NULL));
+	wait_for_flag(&started);
+
+	assert_success(bg_job_set_paused(bg_jobs, 1));
+	usleep(10000);
+	pthread_mutex_lock(&lock);
+	count = iterations;
+	pthread_mutex_unlock(&lock);
+	usleep(10000);
+	pthread_mutex_lock(&lock);
+	assert_int_equal(count, iterations);
+	pthread_mutex_unlock(&lock);
+
+	/* Cancellation resumes the task. */
+	assert_true(bg_job_cancel(bg_jobs));
+	wait_for_bg();
+	assert_false(bg_job_is_paused(bg_jobs));
+}
+
+TEST(many_jobs_are_handled_at_the_same_time, IF(can_have_many_fds))
+{
+	int gate;
+	int reserved[64];
+	int i;
+	char *cmd;
+	bg_job_t *job;
+
+	update_string(&cfg.shell, "/bin/sh");
+	update_string(&cfg.shell_cmd_flag, "-c");
+
+	/* Make sure that descriptors of streams go beyond FD_SETSIZE. */
+	for(i = 0; i < (int)ARRAY_LEN(reserved); ++i)
+	{
+		reserved[i] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	}
+
+	/* Jobs can't finish before the only writer of the FIFO closes it. */
+	assert_success(mkfifo(SANDBOX_PATH "/gate", 0600));
+	gate = open(SANDBOX_PATH "/gate", O_RDWR | O_CLOEXEC);
+	assert_true(gate != -1);
+
+	cmd = format_str("exec 3<%s/gate; echo err >&2; read x <&3", SANDBOX_PATH);
+	for(i = 0; i < NJOBS; ++i)
+	{
+		assert_success(bg_run_external(cmd, 1, SHELL_BY_APP));
+	}
+	free(cmd);
+
+	/* Errors are collected from all jobs while they are running. */
+	i = 0;
+	for(job = bg_jobs; job != NULL; job = job->next)
+	{
+		int counter = 0;
+		while(!has_errors(job) && ++counter < 1000)
+		{
+			usleep(10000);
+		}
+		assert_true(has_errors(job));
+		assert_true(bg_job_is_running(job));
+		++i;
+	}
+	assert_int_equal(NJOBS, i);
+
+	close(gate);
+	assert_success(unlink(SANDBOX_PATH "/gate"));
+
+	for(job = bg_jobs; job != NULL; job = job->next)
+	{
+		int status;
+		(void)waitpid(job->pid, &status, 0);
+		bg_process_finished_cb(job->pid, 0);
+	}
+
+	/* Jobs are released by error thread once their streams are closed. */
+	i = 0;
+	while(bg_jobs != NULL && ++i < 1000)
+	{
+		bg_check();
+		usleep(10000);
+	}
+	assert_null(bg_jobs);
+
+	for(i = 0; i < (int)ARRAY_LEN(reserved); ++i)
+	{
+		close(reserved[i]);
+	}
+
+	update_string(&cfg.shell, NULL);
+	update_string(&cfg.shell_cmd_flag, NULL);
+}
+
+/* Checks whether this process can open enough files to run the stress test,
+ * raising the limit if needed.  Descriptors beyond FD_SETSIZE can't be polled
+ * with select(), so epoll is required.  Returns non-zero if so, otherwise zero
+ * is returned. */
+static int
+can_have_many_fds(void)
+{
+#if !defined(_WIN32) && defined(HAVE_EPOLL)
+	struct rlimit rlim;
+	if(getrlimit(RLIMIT_NOFILE, &rlim) != 0)
+	{
+		return 0;
+	}
+
+	if(rlim.rlim_cur < 2*NJOBS && rlim.rlim_cur < rlim.rlim_max)
+	{
+		rlim.rlim_cur = (rlim.rlim_max < 2*NJOBS ? rlim.rlim_max : 2*NJOBS);
+		(void)setrlimit(RLIMIT_NOFILE, &rlim);
+		(void)getrlimit(RLIMIT_NOFILE, &rlim);
+	}
+
+	return rlim.rlim_cur >= NJOBS + 200;
+#else
+	return 0;
+#endif
+}
+
+/* Checks whether any errors were collected from the job.  Returns non-zero if
+ * so, otherwise zero is returned. */
+static int
+has_errors(bg_job_t *job)
+{
+	int result;
+	pthread_spin_lock(&job->errors_lock);
+	result = (job->errors != NULL);
+	pthread_spin_unlock(&job->errors_lock);
+	return result;
+}
+
+/* Waits until the flag is set. */
+static void
+wait_for_flag(const int *flag)
+{
+	while(1)
+	{
+		int value;
+		pthread_mutex_lock(&lock);
+		value = *flag;
+		pthread_mutex_unlock(&lock);
+		if(value)
+		{
+			break;
+		}
+		usleep(1000);
+	}
+}
+
+static void
+blocking_task(bg_op_t *bg_op, void *arg)
+{
+	pthread_mutex_lock(&lock);
+	started = 1;
+	pthread_mutex_unlock(&lock);
+
+	wait_for_flag(&release);
+}
+
+static void
+gated_task(bg_op_t *bg_op, void *arg)
+{
+	pthread_mutex_lock(&lock);
+	started = 1;
+	pthread_mutex_unlock(&lock);
+
+	wait_for_flag(arg);
+}
+
+static void
+recording_task(bg_op_t *bg_op, void *arg)
+{
+	pthread_mutex_lock(&lock);
+	strcat(order, arg);
+	pthread_mutex_unlock(&lock);
+}
+
+static void
+counting_task(bg_op_t *bg_op, void *arg)
+{
+	pthread_mutex_lock(&lock);
+	if(++nrunning > max_running)
+	{
+		max_running = nrunning;
+	}
+	pthread_mutex_unlock(&lock);
+
+	usleep(1000);
+
+	pthread_mutex_lock(&lock);
+	--nrunning;
+	pthread_mutex_unlock(&lock);
+}
+
+static void
+pausable_task(bg_op_t *bg_op, void *arg)
+{
+	pthread_mutex_lock(&lock);
+	started = 1;
+	pthread_mutex_unlock(&lock);
+
+	while(!bg_op_cancelled(bg_op))
+	{
+		pthread_mutex_lock(&lock);
+		++iterations;
+		pthread_mutex_unlock(&lock);
+		usleep(100);
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
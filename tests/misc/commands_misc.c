@@ -2,6 +2,8 @@
 
 #include <unistd.h> /* F_OK access() chdir() rmdir() symlink() unlink() */
 
+#include <limits.h> /* INT_MAX */
+#include <stdio.h> /* snprintf() */
 #include <string.h> /* strcpy() strdup() */
 
 #include "../../src/cfg/config.h"
@@ -263,7 +265,7 @@ TEST(putting_files_works)
 	regs_init();
 
 	assert_success(os_mkdir(SANDBOX_PATH "/empty-dir", 0700));
-	assert_success(flist_load_tree(&lwin, sandbox));
+	assert_success(flist_load_tree(&lwin, sandbox, INT_MAX));
 
 	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "read/binary-data", cwd);
 	assert_success(regs_append(DEFAULT_REG_NAME, path));
@@ -683,6 +685,32 @@ TEST(tree_command)
 	assert_true(cv_tree(lwin.custom.type));
 }
 
+TEST(tree_command_depth)
+{
+	snprintf(lwin.curr_dir, sizeof(lwin.curr_dir), "%s/tree", test_data);
+
+	assert_success(exec_commands("tree depth=1", &lwin, CIT_COMMAND));
+	assert_true(cv_tree(lwin.custom.type));
+	assert_int_equal(3, lwin.list_rows);
+	assert_int_equal(1, lwin.custom.tree_depth);
+
+	ui_sb_msg("");
+	assert_failure(exec_commands("tree depth=0", &lwin, CIT_COMMAND));
+	assert_string_equal("Invalid argument: depth=0", ui_sb_last());
+	assert_failure(exec_commands("tree deep", &lwin, CIT_COMMAND));
+	assert_string_equal("Invalid argument: deep", ui_sb_last());
+	assert_int_equal(3, lwin.list_rows);
+
+	assert_success(exec_commands("tree", &lwin, CIT_COMMAND));
+	assert_int_equal(0, lwin.custom.tree_depth);
+	assert_int_equal(9, lwin.list_rows);
+	while(flist_continue_tree(&lwin))
+	{
+		/* Do nothing. */
+	}
+	assert_int_equal(12, lwin.list_rows);
+}
+
 TEST(regular_command)
 {
 	strcpy(lwin.curr_dir, sandbox);
@@ -0,0 +1,206 @@
+#include <stic.h>
+
+#include <sys/stat.h> /* chmod() */
+#include <sys/time.h> /* timeval utimes() */
+#include <unistd.h> /* rmdir() */
+
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() */
+#include <string.h> /* strcpy() */
+#include <time.h> /* time_t */
+
+#include "../../src/cfg/config.h"
+#include "../../src/compat/os.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/fs.h"
+#include "../../src/compare.h"
+#include "../../src/digests.h"
+#include "../../src/filelist.h"
+
+#include "utils.h"
+
+static void make_file(const char path[], const char contents[], time_t mtime);
+
+static char *saved_cwd;
+
+SETUP()
+{
+	curr_view = &lwin;
+	other_view = &rwin;
+
+	view_setup(&lwin);
+	view_setup(&rwin);
+
+	opt_handlers_setup();
+
+	columns_setup_column(SK_BY_NAME);
+	columns_setup_column(SK_BY_SIZE);
+
+	saved_cwd = save_cwd();
+
+	digests_reset();
+}
+
+TEARDOWN()
+{
+	digests_reset();
+
+	restore_cwd(saved_cwd);
+
+	columns_teardown();
+
+	view_teardown(&lwin);
+	view_teardown(&rwin);
+
+	opt_handlers_teardown();
+}
+
+TEST(digests_of_unchanged_files_are_reused, IF(not_windows))
+{
+	make_file(SANDBOX_PATH "/a", "contents", 1000);
+	make_file(SANDBOX_PATH "/b", "contents", 1000);
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	compare_one_pane(&lwin, CT_CONTENTS, LT_DUPS, 0);
+	assert_int_equal(2, lwin.list_rows);
+
+	/* Files can't be read anymore, but they haven't changed. */
+	assert_success(chmod(SANDBOX_PATH "/a", 0000));
+	assert_success(chmod(SANDBOX_PATH "/b", 0000));
+
+	compare_one_pane(&lwin, CT_CONTENTS, LT_DUPS, 0);
+	assert_int_equal(2, lwin.list_rows);
+	assert_int_equal(lwin.dir_entry[0].id, lwin.dir_entry[1].id);
+
+	assert_success(remove(SANDBOX_PATH "/a"));
+	assert_success(remove(SANDBOX_PATH "/b"));
+}
+
+TEST(digests_of_changed_files_are_recomputed)
+{
+	make_file(SANDBOX_PATH "/a", "contents", 1000);
+	make_file(SANDBOX_PATH "/b", "contents", 1000);
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	compare_one_pane(&lwin, CT_CONTENTS, LT_DUPS, 0);
+	assert_int_equal(2, lwin.list_rows);
+
+	/* Same size, different contents and modification time. */
+	make_file(SANDBOX_PATH "/b", "Contents", 2000);
+
+	compare_one_pane(&lwin, CT_CONTENTS, LT_ALL, 0);
+	assert_int_equal(2, lwin.list_rows);
+	assert_true(lwin.dir_entry[0].id != lwin.dir_entry[1].id);
+
+	assert_success(remove(SANDBOX_PATH "/a"));
+	assert_success(remove(SANDBOX_PATH "/b"));
+}
+
+TEST(digests_are_persisted, IF(not_windows))
+{
+	strcpy(cfg.config_dir, SANDBOX_PATH);
+	cfg.vifm_info = VINFO_DIGESTS;
+
+	make_file(SANDBOX_PATH "/a", "contents", 1000);
+	make_file(SANDBOX_PATH "/b", "contents", 1000);
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	compare_one_pane(&lwin, CT_CONTENTS, LT_DUPS, 0);
+	assert_int_equal(2, lwin.list_rows);
+
+	digests_save();
+	digests_reset();
+
+	assert_success(chmod(SANDBOX_PATH "/a", 0000));
+	assert_success(chmod(SANDBOX_PATH "/b", 0000));
+
+	compare_one_pane(&lwin, CT_CONTENTS, LT_DUPS, 0);
+	assert_int_equal(2, lwin.list_rows);
+	assert_int_equal(lwin.dir_entry[0].id, lwin.dir_entry[1].id);
+
+	cfg.vifm_info = 0;
+	cfg.config_dir[0] = '\0';
+	assert_success(remove(SANDBOX_PATH "/digests"));
+	assert_success(remove(SANDBOX_PATH "/a"));
+	assert_success(remove(SANDBOX_PATH "/b"));
+}
+
+TEST(digests_are_computed_in_parallel)
+{
+	copy_file(TEST_DATA_PATH "/read/dos-eof", SANDBOX_PATH "/dos-eof-1");
+	copy_file(TEST_DATA_PATH "/read/dos-eof", SANDBOX_PATH "/dos-eof-2");
+	copy_file(TEST_DATA_PATH "/read/utf8-bom", SANDBOX_PATH "/utf8-bom-1");
+	copy_file(TEST_DATA_PATH "/read/utf8-bom", SANDBOX_PATH "/utf8-bom-2");
+
+	cfg.io_threads = 4;
+	curr_view = &rwin;
+	other_view = &lwin;
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	strcpy(rwin.curr_dir, TEST_DATA_PATH "/read");
+	compare_two_panes(CT_CONTENTS, LT_ALL, 1, 0);
+	cfg.io_threads = 0;
+
+	assert_int_equal(8, lwin.list_rows);
+	assert_int_equal(8, rwin.list_rows);
+
+	assert_int_equal(1, lwin.dir_entry[0].id);
+	assert_int_equal(2, lwin.dir_entry[1].id);
+	assert_int_equal(3, lwin.dir_entry[2].id);
+	assert_int_equal(4, lwin.dir_entry[3].id);
+	assert_int_equal(2, lwin.dir_entry[4].id);
+	assert_int_equal(5, lwin.dir_entry[5].id);
+	assert_int_equal(6, lwin.dir_entry[6].id);
+	assert_int_equal(5, lwin.dir_entry[7].id);
+
+	assert_success(remove(SANDBOX_PATH "/dos-eof-1"));
+	assert_success(remove(SANDBOX_PATH "/dos-eof-2"));
+	assert_success(remove(SANDBOX_PATH "/utf8-bom-1"));
+	assert_success(remove(SANDBOX_PATH "/utf8-bom-2"));
+}
+
+TEST(parallel_pipeline_preserves_order_of_listing)
+{
+	assert_success(os_mkdir(SANDBOX_PATH "/sub", 0700));
+	make_file(SANDBOX_PATH "/a", "x", 1000);
+	make_file(SANDBOX_PATH "/sub/b", "y", 1000);
+	make_file(SANDBOX_PATH "/sub/c", "x", 1000);
+	make_file(SANDBOX_PATH "/d", "y", 1000);
+
+	cfg.io_threads = 4;
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	compare_one_pane(&lwin, CT_CONTENTS, LT_ALL, 0);
+	cfg.io_threads = 0;
+
+	/* Files of subdirectories are listed first and get smaller ids. */
+	assert_int_equal(4, lwin.list_rows);
+	assert_string_equal("b", lwin.dir_entry[0].name);
+	assert_string_equal("d", lwin.dir_entry[1].name);
+	assert_string_equal("c", lwin.dir_entry[2].name);
+	assert_string_equal("a", lwin.dir_entry[3].name);
+	assert_int_equal(1, lwin.dir_entry[0].id);
+	assert_int_equal(1, lwin.dir_entry[1].id);
+	assert_int_equal(2, lwin.dir_entry[2].id);
+	assert_int_equal(2, lwin.dir_entry[3].id);
+
+	assert_success(remove(SANDBOX_PATH "/a"));
+	assert_success(remove(SANDBOX_PATH "/sub/b"));
+	assert_success(remove(SANDBOX_PATH "/sub/c"));
+	assert_success(remove(SANDBOX_PATH "/d"));
+	assert_success(rmdir(SANDBOX_PATH "/sub"));
+}
+
+/* Writes contents to a file and sets its modification time. */
+static void
+make_file(const char path[], const char contents[], time_t mtime)
+{
+	struct timeval tvs[2] = { { mtime, 0 }, { mtime, 0 } };
+
+	FILE *const fp = fopen(path, "w");
+	assert_non_null(fp);
+	fputs(contents, fp);
+	fclose(fp);
+
+	assert_success(utimes(path, tvs));
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
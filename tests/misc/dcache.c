@@ -1,25 +1,40 @@
 #include <stic.h>
 
+#include <sys/stat.h> /* stat */
+#include <sys/time.h> /* timeval utimes() */
+#include <unistd.h> /* rmdir() symlink() unlink() */
+
 #include <stddef.h> /* NULL */
+#include <stdio.h> /* remove() */
 #include <string.h> /* memset() strcpy() */
 #include <time.h> /* time() */
 
 #include "../../src/cfg/config.h"
+#include "../../src/compat/fs_limits.h"
+#include "../../src/compat/os.h"
 #include "../../src/ui/ui.h"
+#include "../../src/utils/fs.h"
 #include "../../src/utils/str.h"
 #include "../../src/status.h"
 
 #include "utils.h"
 
+static void setup_persistence(char dir[], size_t dir_len);
+static void teardown_persistence(const char dir[]);
+static void set_mtime(const char path[], time_t mtime);
+
+static char cwd[PATH_MAX + 1];
+
 SETUP()
 {
+	assert_non_null(get_cwd(cwd, sizeof(cwd)));
 	update_string(&cfg.shell, "");
 	assert_success(stats_init(&cfg));
 }
 
 TEARDOWN()
 {
-	update_string(&cfg.shell, NULL);
+	update_string(&cfg.shell, cwd);
 }
 
 TEST(size_does_not_clobber_nitems)
@@ -69,5 +84,169 @@ TEST(outdated_data_is_detected)
 	assert_false(nitems.is_valid);
 }
 
+TEST(cached_data_is_persisted_and_loaded_lazily, IF(not_windows))
+{
+	char dir[PATH_MAX + 1];
+	uint64_t size, nitems;
+
+	setup_persistence(dir, sizeof(dir));
+
+	dcache_set_at(dir, 10, 11);
+	dcache_save();
+	assert_success(stats_reset(&cfg));
+
+	dcache_get_at(dir, &size, &nitems);
+	assert_ulong_equal(10, size);
+	assert_ulong_equal(11, nitems);
+
+	teardown_persistence(dir);
+}
+
+TEST(persisted_data_is_ignored_if_directory_changed, IF(not_windows))
+{
+	char dir[PATH_MAX + 1];
+	uint64_t size, nitems;
+
+	setup_persistence(dir, sizeof(dir));
+
+	dcache_set_at(dir, 10, 11);
+	dcache_save();
+	assert_success(stats_reset(&cfg));
+
+	set_mtime(dir, time(NULL) - 5);
+
+	dcache_get_at(dir, &size, &nitems);
+	assert_ulong_equal(DCACHE_UNKNOWN, size);
+	assert_ulong_equal(DCACHE_UNKNOWN, nitems);
+
+	teardown_persistence(dir);
+}
+
+TEST(persisted_data_is_found_through_symlink, IF(not_windows))
+{
+	char dir[PATH_MAX + 1];
+	char link[PATH_MAX + 1];
+	uint64_t size, nitems;
+
+	setup_persistence(dir, sizeof(dir));
+	make_abs_path(link, sizeof(link), SANDBOX_PATH, "link", cwd);
+	assert_success(symlink(dir, link));
+
+	dcache_set_at(link, 10, 11);
+	dcache_save();
+	assert_success(stats_reset(&cfg));
+
+	dcache_get_at(dir, &size, &nitems);
+	assert_ulong_equal(10, size);
+	assert_ulong_equal(11, nitems);
+
+	assert_success(stats_reset(&cfg));
+
+	dcache_get_at(link, &size, &nitems);
+	assert_ulong_equal(10, size);
+	assert_ulong_equal(11, nitems);
+
+	assert_success(unlink(link));
+	teardown_persistence(dir);
+}
+
+TEST(nothing_is_persisted_if_not_enabled, IF(not_windows))
+{
+	char dir[PATH_MAX + 1];
+
+	setup_persistence(dir, sizeof(dir));
+	cfg.vifm_info = 0;
+
+	dcache_set_at(dir, 10, 11);
+	dcache_save();
+	assert_false(path_exists(SANDBOX_PATH "/dcache", NODEREF));
+
+	teardown_persistence(dir);
+}
+
+TEST(invalidation_affects_path_and_its_parents)
+{
+	char parent[PATH_MAX + 1], child[PATH_MAX + 1], missing[PATH_MAX + 1];
+	uint64_t size, nitems;
+
+	make_abs_path(parent, sizeof(parent), TEST_DATA_PATH, "", cwd);
+	make_abs_path(child, sizeof(child), TEST_DATA_PATH, "read", cwd);
+	make_abs_path(missing, sizeof(missing), TEST_DATA_PATH, "read/no-such-file",
+			cwd);
+
+	dcache_set_at(parent, 10, 11);
+	dcache_set_at(child, 1, 2);
+
+	dcache_invalidate(missing);
+
+	dcache_get_at(parent, &size, &nitems);
+	assert_ulong_equal(DCACHE_UNKNOWN, size);
+	assert_ulong_equal(DCACHE_UNKNOWN, nitems);
+	dcache_get_at(child, &size, &nitems);
+	assert_ulong_equal(DCACHE_UNKNOWN, size);
+	assert_ulong_equal(DCACHE_UNKNOWN, nitems);
+
+	/* Setting new value makes it valid again. */
+	dcache_set_at(child, 3, DCACHE_UNKNOWN);
+	dcache_get_at(child, &size, &nitems);
+	assert_ulong_equal(3, size);
+	assert_ulong_equal(DCACHE_UNKNOWN, nitems);
+}
+
+TEST(parent_sizes_are_updated)
+{
+	char parent[PATH_MAX + 1], child[PATH_MAX + 1];
+	uint64_t size, nitems;
+
+	make_abs_path(parent, sizeof(parent), TEST_DATA_PATH, "", cwd);
+	make_abs_path(child, sizeof(child), TEST_DATA_PATH, "read", cwd);
+
+	dcache_set_at(parent, 10, 11);
+	dcache_set_at(child, 1, 2);
+
+	dcache_update_parent_sizes(child, 5);
+
+	dcache_get_at(parent, &size, &nitems);
+	assert_ulong_equal(15, size);
+	assert_ulong_equal(11, nitems);
+	dcache_get_at(child, &size, &nitems);
+	assert_ulong_equal(1, size);
+	assert_ulong_equal(2, nitems);
+}
+
+/* Prepares for testing of persistent storage of dcache. */
+static void
+setup_persistence(char dir[], size_t dir_len)
+{
+	make_abs_path(dir, dir_len, SANDBOX_PATH, "dir", cwd);
+	assert_success(os_mkdir(dir, 0700));
+	/* Modification time must precede time of caching for data to be valid. */
+	set_mtime(dir, time(NULL) - 10);
+
+	make_abs_path(cfg.config_dir, sizeof(cfg.config_dir), SANDBOX_PATH, "",
+			cwd);
+	cfg.vifm_info = VINFO_DCACHE;
+}
+
+/* Cleans up after setup_persistence(). */
+static void
+teardown_persistence(const char dir[])
+{
+	cfg.vifm_info = 0;
+	cfg.config_dir[0] = '\0';
+	assert_success(rmdir(dir));
+	(void)remove(SANDBOX_PATH "/dcache");
+}
+
+/* Changes modification time of a file. */
+static void
+set_mtime(const char path[], time_t mtime)
+{
+#ifndef _WIN32
+	struct timeval tvs[2] = { { .tv_sec = mtime }, { .tv_sec = mtime } };
+	assert_success(utimes(path, tvs));
+#endif
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -1,7 +1,21 @@
 #include <stic.h>
 
+#include <unistd.h> /* unlink() usleep() */
+
+#include <stdlib.h> /* free() */
+#include <string.h> /* strdup() */
+#include <time.h> /* time() */
+
+#include "../../src/compat/fs_limits.h"
+#include "../../src/int/path_env.h"
+#include "../../src/utils/env.h"
+#include "../../src/utils/fs.h"
 #include "../../src/cmd_completion.h"
 
+#include "utils.h"
+
+static void wait_for_next_second(void);
+
 TEST(system_shell_exists)
 {
 #ifdef _WIN32
@@ -13,5 +27,41 @@ TEST(system_shell_exists)
 	assert_true(exists);
 }
 
+TEST(changes_of_directories_in_path_are_noticed)
+{
+	char cwd[PATH_MAX + 1];
+	char sandbox[PATH_MAX + 1];
+	char *const original_path_env = strdup(env_get("PATH"));
+
+	assert_non_null(get_cwd(cwd, sizeof(cwd)));
+	make_abs_path(sandbox, sizeof(sandbox), SANDBOX_PATH, "", cwd);
+	env_set("PATH", sandbox);
+	update_path_env(1);
+
+	assert_false(external_command_exists("exec-in-path"));
+	create_executable(SANDBOX_PATH "/exec-in-path" EXE_SUFFIX);
+
+	/* Directories are checked for changes at most once a second. */
+	wait_for_next_second();
+	assert_true(external_command_exists("exec-in-path"));
+
+	assert_success(unlink(SANDBOX_PATH "/exec-in-path" EXE_SUFFIX));
+
+	env_set("PATH", original_path_env);
+	update_path_env(1);
+	free(original_path_env);
+}
+
+/* Sleeps until current second is over. */
+static void
+wait_for_next_second(void)
+{
+	const time_t start = time(NULL);
+	while(time(NULL) == start)
+	{
+		usleep(10000);
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -1,14 +1,19 @@
 #include <stic.h>
 
+#include <sys/time.h> /* timeval utimes() */
 #include <unistd.h> /* symlink() unlink() */
 
-#include <stdio.h> /* fopen() fclose() */
+#include <stdio.h> /* fopen() fclose() rename() */
+#include <stdlib.h> /* free() */
+#include <string.h> /* strdup() */
 
+#include "../../src/cfg/config.h"
 #include "../../src/compat/fs_limits.h"
 #include "../../src/compat/os.h"
 #include "../../src/int/file_magic.h"
 #include "../../src/utils/fs.h"
 #include "../../src/utils/path.h"
+#include "../../src/status.h"
 
 #include "utils.h"
 
@@ -16,6 +21,18 @@ static void check_empty_file(const char fname[]);
 static int has_mime_type_detection_and_symlinks(void);
 static int has_mime_type_detection(void);
 
+SETUP()
+{
+	mimetype_cache_reset();
+	cfg.mime_cache_size = 2;
+}
+
+TEARDOWN()
+{
+	cfg.mime_cache_size = 0;
+	mimetype_cache_reset();
+}
+
 TEST(escaping_for_determining_mime_type, IF(has_mime_type_detection))
 {
 	check_empty_file(SANDBOX_PATH "/start'end");
@@ -59,6 +76,143 @@ TEST(relatively_large_file_name_does_not_crash,
 	assert_success(rmdir(SANDBOX_PATH "/A"));
 }
 
+TEST(mime_types_are_cached, IF(has_mime_type_detection))
+{
+	mime_cache_stats_t stats;
+	char *mimetype;
+
+	mimetype_cache_reset();
+
+	mimetype = strdup(get_mimetype(TEST_DATA_PATH "/read/binary-data", 0));
+	assert_string_equal(mimetype,
+			get_mimetype(TEST_DATA_PATH "/read/binary-data", 0));
+	free(mimetype);
+
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(1, stats.misses);
+	assert_int_equal(1, stats.hits);
+	assert_int_equal(1, stats.size);
+}
+
+TEST(cache_can_be_disabled, IF(has_mime_type_detection))
+{
+	mime_cache_stats_t stats;
+
+	mimetype_cache_reset();
+	cfg.mime_cache_size = 0;
+
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/binary-data", 0));
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/binary-data", 0));
+
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(0, stats.misses);
+	assert_int_equal(0, stats.hits);
+	assert_int_equal(0, stats.size);
+}
+
+TEST(least_recently_used_entry_is_evicted, IF(has_mime_type_detection))
+{
+	mime_cache_stats_t stats;
+
+	mimetype_cache_reset();
+
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/binary-data", 0));
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/dos-eof", 0));
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/binary-data", 0));
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/two-lines", 0));
+
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(3, stats.misses);
+	assert_int_equal(1, stats.hits);
+	assert_int_equal(1, stats.evictions);
+	assert_int_equal(2, stats.size);
+
+	/* "dos-eof" was evicted, "binary-data" wasn't. */
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/binary-data", 0));
+	assert_non_null(get_mimetype(TEST_DATA_PATH "/read/dos-eof", 0));
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(4, stats.misses);
+	assert_int_equal(2, stats.hits);
+
+	mimetype_cache_resize(0);
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(0, stats.size);
+}
+
+TEST(changed_file_is_probed_again, IF(has_mime_type_detection))
+{
+	mime_cache_stats_t stats;
+	struct timeval tvs[2] = { { 1000, 0 }, { 1000, 0 } };
+
+	mimetype_cache_reset();
+
+	create_file(SANDBOX_PATH "/file");
+	assert_success(utimes(SANDBOX_PATH "/file", tvs));
+	assert_non_null(get_mimetype(SANDBOX_PATH "/file", 0));
+
+	tvs[0].tv_sec = tvs[1].tv_sec = 2000;
+	assert_success(utimes(SANDBOX_PATH "/file", tvs));
+	assert_non_null(get_mimetype(SANDBOX_PATH "/file", 0));
+
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(2, stats.misses);
+	assert_int_equal(0, stats.hits);
+
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
+TEST(renamed_file_is_found_in_cache, IF(has_mime_type_detection))
+{
+	mime_cache_stats_t stats;
+
+	create_file(SANDBOX_PATH "/file");
+
+	assert_non_null(get_mimetype(SANDBOX_PATH "/file", 0));
+	assert_success(rename(SANDBOX_PATH "/file", SANDBOX_PATH "/file.txt"));
+	assert_non_null(get_mimetype(SANDBOX_PATH "/file.txt", 0));
+
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(1, stats.misses);
+	assert_int_equal(1, stats.hits);
+
+#ifdef HAVE_LIBGTK
+	/* Type guessed by name can change on renaming. */
+	curr_stats.gtk_available = 1;
+	assert_non_null(get_mimetype(SANDBOX_PATH "/file.txt", 0));
+	assert_success(rename(SANDBOX_PATH "/file.txt", SANDBOX_PATH "/file"));
+	assert_non_null(get_mimetype(SANDBOX_PATH "/file", 0));
+	curr_stats.gtk_available = 0;
+
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(3, stats.misses);
+	assert_int_equal(1, stats.hits);
+
+	assert_success(unlink(SANDBOX_PATH "/file"));
+#else
+	assert_success(unlink(SANDBOX_PATH "/file.txt"));
+#endif
+}
+
+TEST(symlink_and_its_target_are_cached_separately,
+		IF(has_mime_type_detection_and_symlinks))
+{
+	mime_cache_stats_t stats;
+
+	create_file(SANDBOX_PATH "/file");
+	assert_success(symlink("file", SANDBOX_PATH "/link"));
+
+	assert_non_null(get_mimetype(SANDBOX_PATH "/file", 0));
+	assert_non_null(get_mimetype(SANDBOX_PATH "/link", 0));
+	assert_non_null(get_mimetype(SANDBOX_PATH "/link", 0));
+
+	mimetype_cache_get_stats(&stats);
+	assert_int_equal(2, stats.misses);
+	assert_int_equal(1, stats.hits);
+
+	assert_success(unlink(SANDBOX_PATH "/link"));
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
 static void
 check_empty_file(const char fname[])
 {
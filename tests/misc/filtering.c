@@ -1,5 +1,6 @@
 #include <stic.h>
 
+#include <limits.h> /* INT_MAX */
 #include <stdlib.h> /* free() */
 #include <string.h> /* strcpy() strdup() */
 
@@ -11,6 +12,7 @@
 #include "../../src/utils/dynarray.h"
 #include "../../src/utils/filter.h"
 #include "../../src/utils/fs.h"
+#include "../../src/utils/macros.h"
 #include "../../src/utils/matcher.h"
 #include "../../src/utils/str.h"
 #include "../../src/cmd_core.h"
@@ -30,6 +32,8 @@
 	assert_true( \
 			filters_file_is_visible(&view, flist_get_dir(&view), name, is_dir, 1))
 
+static void assert_same_lists(const view_t *a, const view_t *b);
+
 static char cwd[PATH_MAX + 1];
 
 SETUP_ONCE()
@@ -432,7 +436,7 @@ TEST(custom_tree_can_restore_files_after_local_filter_interactive)
 	flist_custom_add(&lwin, path);
 	assert_true(flist_custom_finish(&lwin, CV_REGULAR, 0) == 0);
 
-	assert_success(flist_load_tree(&lwin, test_data));
+	assert_success(flist_load_tree(&lwin, test_data, INT_MAX));
 	assert_int_equal(5, lwin.list_rows);
 
 	assert_int_equal(0, local_filter_set(&lwin, "t"));
@@ -462,7 +466,7 @@ TEST(custom_tree_can_restore_files_after_local_filter_non_interactive)
 	flist_custom_add(&lwin, path);
 	assert_true(flist_custom_finish(&lwin, CV_REGULAR, 0) == 0);
 
-	assert_success(flist_load_tree(&lwin, test_data));
+	assert_success(flist_load_tree(&lwin, test_data, INT_MAX));
 	assert_int_equal(5, lwin.list_rows);
 
 	local_filter_apply(&lwin, "t");
@@ -490,7 +494,7 @@ TEST(sorting_tree_preserves_parent_dot_dir)
 	flist_custom_add(&lwin, path);
 	assert_true(flist_custom_finish(&lwin, CV_REGULAR, 0) == 0);
 
-	assert_success(flist_load_tree(&lwin, test_data));
+	assert_success(flist_load_tree(&lwin, test_data, INT_MAX));
 	assert_int_equal(4, lwin.list_rows);
 
 	local_filter_apply(&lwin, "/");
@@ -504,5 +508,86 @@ TEST(sorting_tree_preserves_parent_dot_dir)
 	cfg.dot_dirs = 0;
 }
 
+TEST(extending_local_filter_narrows_list_of_files)
+{
+	assert_int_equal(0, local_filter_set(&lwin, "with"));
+	assert_int_equal(7, lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "withn"));
+	assert_int_equal(1, lwin.list_rows);
+	assert_string_equal("withnonodots", lwin.dir_entry[0].name);
+
+	/* Removing characters makes filtered out files visible again. */
+	assert_int_equal(0, local_filter_set(&lwin, "with"));
+	assert_int_equal(7, lwin.list_rows);
+
+	/* Appending a special character isn't just narrowing. */
+	assert_int_equal(0, local_filter_set(&lwin, "with<"));
+	assert_int_equal(1, lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "with<|n"));
+	assert_int_equal(3, lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "with<|no"));
+	assert_int_equal(2, lwin.list_rows);
+
+	local_filter_accept(&lwin);
+	assert_int_equal(2, lwin.list_rows);
+}
+
+TEST(resetting_filters_frees_names_of_directories)
+{
+	char path[PATH_MAX + 1];
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+	assert_success(flist_load_tree(&lwin, path, INT_MAX));
+
+	(void)local_filter_set(&lwin, "dir");
+	assert_non_null(lwin.local_filter.match_names);
+	assert_true(lwin.local_filter.match_names_len != 0U);
+
+	filters_view_reset(&lwin);
+	assert_null(lwin.local_filter.match_names);
+	assert_int_equal(0, lwin.local_filter.match_names_len);
+}
+
+TEST(narrowed_tree_matches_tree_filtered_at_once)
+{
+	static const char *const filters[] = {
+		"d", "di", "dir", "dir2", "dir", "", "i", "il", "ile", "ile2", "e",
+	};
+
+	char path[PATH_MAX + 1];
+	size_t i;
+
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+	assert_success(flist_load_tree(&lwin, path, INT_MAX));
+
+	for(i = 0U; i < ARRAY_LEN(filters); ++i)
+	{
+		assert_success(flist_load_tree(&rwin, path, INT_MAX));
+		(void)local_filter_set(&rwin, filters[i]);
+
+		(void)local_filter_set(&lwin, filters[i]);
+		assert_same_lists(&lwin, &rwin);
+
+		local_filter_cancel(&rwin);
+	}
+
+	local_filter_accept(&lwin);
+	assert_int_equal(7, lwin.list_rows);
+}
+
+/* Checks that two lists of files are the same including their structure. */
+static void
+assert_same_lists(const view_t *a, const view_t *b)
+{
+	int i;
+	assert_int_equal(b->list_rows, a->list_rows);
+	for(i = 0; i < a->list_rows && i < b->list_rows; ++i)
+	{
+		assert_string_equal(b->dir_entry[i].name, a->dir_entry[i].name);
+		assert_int_equal(b->dir_entry[i].child_pos, a->dir_entry[i].child_pos);
+		assert_int_equal(b->dir_entry[i].child_count,
+				a->dir_entry[i].child_count);
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,192 @@
+#include <stic.h>
+
+#include <unistd.h> /* chdir() */
+
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() rename() */
+
+#include "../../src/cfg/config.h"
+#include "../../src/compat/fs_limits.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/fs.h"
+#include "../../src/utils/matcher.h"
+#include "../../src/utils/str.h"
+#include "../../src/filelist.h"
+#include "../../src/status.h"
+
+#include "utils.h"
+
+static void check_for_changes(view_t *view, UiUpdateEvent expected);
+static int using_inotify(void);
+
+SETUP()
+{
+	char cwd[PATH_MAX + 1];
+
+	update_string(&cfg.fuse_home, "no");
+	update_string(&cfg.slow_fs_list, "");
+	cfg.dot_dirs = DD_NONROOT_PARENT;
+
+	view_setup(&lwin);
+	curr_view = &lwin;
+	other_view = &rwin;
+
+	create_file(SANDBOX_PATH "/a");
+	create_file(SANDBOX_PATH "/c");
+	create_file(SANDBOX_PATH "/e");
+
+	assert_non_null(get_cwd(cwd, sizeof(cwd)));
+	make_abs_path(lwin.curr_dir, sizeof(lwin.curr_dir), SANDBOX_PATH, "", cwd);
+
+	curr_stats.load_stage = 2;
+	populate_dir_list(&lwin, 0);
+	curr_stats.load_stage = 0;
+
+	assert_int_equal(4, lwin.list_rows);
+	(void)ui_view_query_scheduled_event(&lwin);
+}
+
+TEARDOWN()
+{
+	view_teardown(&lwin);
+
+	(void)remove(SANDBOX_PATH "/a");
+	(void)remove(SANDBOX_PATH "/b");
+	(void)remove(SANDBOX_PATH "/c");
+	(void)remove(SANDBOX_PATH "/d");
+	(void)remove(SANDBOX_PATH "/e");
+
+	cfg.dot_dirs = 0;
+	update_string(&cfg.slow_fs_list, NULL);
+	update_string(&cfg.fuse_home, NULL);
+}
+
+TEST(no_changes_means_no_update)
+{
+	check_for_changes(&lwin, UUE_NONE);
+	assert_int_equal(4, lwin.list_rows);
+}
+
+TEST(new_files_are_inserted_in_sorted_order, IF(using_inotify))
+{
+	create_file(SANDBOX_PATH "/d");
+	create_file(SANDBOX_PATH "/b");
+
+	check_for_changes(&lwin, UUE_REDRAW);
+
+	assert_int_equal(6, lwin.list_rows);
+	assert_string_equal("..", lwin.dir_entry[0].name);
+	assert_string_equal("a", lwin.dir_entry[1].name);
+	assert_string_equal("b", lwin.dir_entry[2].name);
+	assert_string_equal("c", lwin.dir_entry[3].name);
+	assert_string_equal("d", lwin.dir_entry[4].name);
+	assert_string_equal("e", lwin.dir_entry[5].name);
+}
+
+TEST(deleted_files_are_removed_preserving_selection, IF(using_inotify))
+{
+	lwin.dir_entry[1].selected = 1;
+	lwin.dir_entry[2].selected = 1;
+	lwin.selected_files = 2;
+
+	assert_success(remove(SANDBOX_PATH "/c"));
+
+	check_for_changes(&lwin, UUE_REDRAW);
+
+	assert_int_equal(3, lwin.list_rows);
+	assert_string_equal("a", lwin.dir_entry[1].name);
+	assert_true(lwin.dir_entry[1].selected);
+	assert_string_equal("e", lwin.dir_entry[2].name);
+	assert_int_equal(1, lwin.selected_files);
+}
+
+TEST(cursor_stays_on_the_same_file, IF(using_inotify))
+{
+	lwin.list_pos = 2;
+	assert_string_equal("c", lwin.dir_entry[lwin.list_pos].name);
+
+	assert_success(remove(SANDBOX_PATH "/a"));
+	create_file(SANDBOX_PATH "/b");
+	create_file(SANDBOX_PATH "/d");
+
+	check_for_changes(&lwin, UUE_REDRAW);
+
+	assert_int_equal(5, lwin.list_rows);
+	assert_string_equal("c", lwin.dir_entry[lwin.list_pos].name);
+}
+
+TEST(rename_is_handled, IF(using_inotify))
+{
+	assert_success(rename(SANDBOX_PATH "/a", SANDBOX_PATH "/d"));
+
+	check_for_changes(&lwin, UUE_REDRAW);
+
+	assert_int_equal(4, lwin.list_rows);
+	assert_string_equal("c", lwin.dir_entry[1].name);
+	assert_string_equal("d", lwin.dir_entry[2].name);
+	assert_string_equal("e", lwin.dir_entry[3].name);
+}
+
+TEST(modified_files_are_updated_and_resorted, IF(using_inotify))
+{
+	FILE *fp;
+
+	lwin.sort[0] = SK_BY_SIZE;
+	lwin.sort[1] = SK_BY_NAME;
+	resort_dir_list(0, &lwin);
+
+	fp = fopen(SANDBOX_PATH "/a", "w");
+	assert_non_null(fp);
+	fputs("contents", fp);
+	fclose(fp);
+
+	check_for_changes(&lwin, UUE_REDRAW);
+
+	assert_int_equal(4, lwin.list_rows);
+	assert_string_equal("c", lwin.dir_entry[1].name);
+	assert_string_equal("e", lwin.dir_entry[2].name);
+	assert_string_equal("a", lwin.dir_entry[3].name);
+	assert_ulong_equal(8, lwin.dir_entry[3].size);
+}
+
+TEST(filtered_out_files_are_not_added, IF(using_inotify))
+{
+	char *error;
+
+	matcher_free(lwin.manual_filter);
+	lwin.manual_filter = matcher_alloc("{b}", 0, 1, "", &error);
+	assert_non_null(lwin.manual_filter);
+	lwin.invert = 1;
+
+	create_file(SANDBOX_PATH "/b");
+	create_file(SANDBOX_PATH "/d");
+
+	check_for_changes(&lwin, UUE_REDRAW);
+
+	assert_int_equal(5, lwin.list_rows);
+	assert_string_equal("d", lwin.dir_entry[3].name);
+	assert_int_equal(1, lwin.filtered);
+}
+
+/* Checks view for changes and verifies which update was scheduled. */
+static void
+check_for_changes(view_t *view, UiUpdateEvent expected)
+{
+	curr_stats.load_stage = 2;
+	check_if_filelist_has_changed(view);
+	curr_stats.load_stage = 0;
+
+	assert_int_equal(expected, ui_view_query_scheduled_event(view));
+}
+
+static int
+using_inotify(void)
+{
+#ifdef HAVE_INOTIFY
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -2,6 +2,7 @@
 
 #include <sys/stat.h> /* chmod() */
 
+#include <limits.h> /* INT_MAX */
 #include <string.h> /* memset() strcpy() */
 #include <time.h> /* time() */
 
@@ -22,6 +23,8 @@
 
 #include "utils.h"
 
+static void check_same_trees(const view_t *expected, const view_t *actual);
+
 static char cwd[PATH_MAX + 1];
 
 SETUP_ONCE()
@@ -143,7 +146,7 @@ TEST(find_first_and_last_siblings)
 {
 	make_abs_path(lwin.curr_dir, sizeof(lwin.curr_dir), TEST_DATA_PATH, "tree",
 			cwd);
-	assert_success(flist_load_tree(&lwin, lwin.curr_dir));
+	assert_success(flist_load_tree(&lwin, lwin.curr_dir, INT_MAX));
 	assert_int_equal(12, lwin.list_rows);
 
 	assert_int_equal(0, fpos_first_sibling(&lwin));
@@ -163,7 +166,7 @@ TEST(find_next_and_prev_dir_sibling)
 {
 	make_abs_path(lwin.curr_dir, sizeof(lwin.curr_dir), TEST_DATA_PATH, "tree",
 			cwd);
-	assert_success(flist_load_tree(&lwin, lwin.curr_dir));
+	assert_success(flist_load_tree(&lwin, lwin.curr_dir, INT_MAX));
 	assert_int_equal(12, lwin.list_rows);
 
 	assert_int_equal(0, fpos_prev_dir_sibling(&lwin));
@@ -212,6 +215,182 @@ TEST(find_next_and_prev_mismatches)
 	view_teardown(&rwin);
 }
 
+TEST(tree_depth_limits_loaded_entries)
+{
+	char path[PATH_MAX + 1];
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+
+	assert_success(flist_load_tree(&lwin, path, 1));
+	assert_int_equal(3, lwin.list_rows);
+	assert_true(lwin.dir_entry[fpos_find_by_name(&lwin, "dir1")].folded);
+	assert_true(lwin.dir_entry[fpos_find_by_name(&lwin, "dir5")].folded);
+	assert_false(lwin.dir_entry[fpos_find_by_name(&lwin, ".hidden")].folded);
+
+	assert_success(flist_load_tree(&lwin, path, 2));
+	assert_int_equal(7, lwin.list_rows);
+	assert_false(lwin.dir_entry[fpos_find_by_name(&lwin, "dir1")].folded);
+	assert_true(lwin.dir_entry[fpos_find_by_name(&lwin, "dir2")].folded);
+}
+
+TEST(tree_folds_are_toggled)
+{
+	char path[PATH_MAX + 1];
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+	assert_success(flist_load_tree(&lwin, path, 1));
+
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir1");
+	flist_toggle_fold(&lwin);
+	assert_int_equal(5, lwin.list_rows);
+	assert_string_equal("dir1", get_current_file_name(&lwin));
+	assert_false(lwin.dir_entry[lwin.list_pos].folded);
+
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir2");
+	flist_toggle_fold(&lwin);
+	assert_int_equal(7, lwin.list_rows);
+	assert_true(lwin.dir_entry[fpos_find_by_name(&lwin, "dir3")].folded);
+
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir1");
+	flist_toggle_fold(&lwin);
+	assert_int_equal(3, lwin.list_rows);
+	assert_true(lwin.dir_entry[lwin.list_pos].folded);
+
+	/* State of nested directory is remembered. */
+	flist_toggle_fold(&lwin);
+	assert_int_equal(7, lwin.list_rows);
+
+	/* And survives reloading. */
+	load_dir_list(&lwin, 1);
+	assert_int_equal(7, lwin.list_rows);
+
+	/* Loading a tree anew drops it. */
+	assert_success(flist_load_tree(&lwin, path, 1));
+	assert_int_equal(3, lwin.list_rows);
+}
+
+TEST(only_directories_in_tree_are_folded)
+{
+	char path[PATH_MAX + 1];
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+
+	strcpy(lwin.curr_dir, path);
+	load_dir_list(&lwin, 1);
+	assert_int_equal(3, lwin.list_rows);
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir1");
+	flist_toggle_fold(&lwin);
+	assert_int_equal(3, lwin.list_rows);
+
+	assert_success(flist_load_tree(&lwin, path, 1));
+	lwin.list_pos = fpos_find_by_name(&lwin, ".hidden");
+	flist_toggle_fold(&lwin);
+	assert_int_equal(3, lwin.list_rows);
+}
+
+TEST(unfolding_and_folding_keep_tree_consistent)
+{
+	char path[PATH_MAX + 1];
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+	assert_success(flist_load_tree(&lwin, path, 2));
+
+	view_setup(&rwin);
+
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir2");
+	flist_toggle_fold(&lwin);
+	assert_string_equal("dir2", get_current_file_name(&lwin));
+	assert_success(flist_clone_tree(&rwin, &lwin));
+	check_same_trees(&rwin, &lwin);
+
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir3");
+	flist_toggle_fold(&lwin);
+	assert_success(flist_clone_tree(&rwin, &lwin));
+	check_same_trees(&rwin, &lwin);
+
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir1");
+	flist_toggle_fold(&lwin);
+	assert_string_equal("dir1", get_current_file_name(&lwin));
+	assert_success(flist_clone_tree(&rwin, &lwin));
+	check_same_trees(&rwin, &lwin);
+
+	view_teardown(&rwin);
+}
+
+TEST(default_tree_depth_is_extended_in_background)
+{
+	char path[PATH_MAX + 1];
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+
+	view_setup(&rwin);
+	assert_success(flist_load_tree(&rwin, path, INT_MAX));
+
+	assert_success(flist_load_tree(&lwin, path, 0));
+	assert_true(lwin.list_rows < rwin.list_rows);
+	assert_true(lwin.dir_entry[fpos_find_by_name(&lwin, "dir3")].folded);
+
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir5");
+	while(flist_continue_tree(&lwin))
+	{
+		/* Do nothing. */
+	}
+	assert_string_equal("dir5", get_current_file_name(&lwin));
+	check_same_trees(&rwin, &lwin);
+
+	/* Directories loaded in background remain unfolded on reload. */
+	load_dir_list(&lwin, 1);
+	check_same_trees(&rwin, &lwin);
+
+	/* Directories folded by the user remain folded. */
+	lwin.list_pos = fpos_find_by_name(&lwin, "dir2");
+	flist_toggle_fold(&lwin);
+	assert_false(flist_continue_tree(&lwin));
+	assert_true(lwin.dir_entry[lwin.list_pos].folded);
+
+	/* Explicit depth isn't extended. */
+	assert_success(flist_load_tree(&lwin, path, 1));
+	assert_false(flist_continue_tree(&lwin));
+	assert_int_equal(3, lwin.list_rows);
+
+	view_teardown(&rwin);
+}
+
+TEST(parallel_tree_building_produces_the_same_tree)
+{
+	int i;
+	int hide_dot;
+	char path[PATH_MAX + 1];
+	make_abs_path(path, sizeof(path), TEST_DATA_PATH, "tree", cwd);
+
+	for(hide_dot = 0; hide_dot < 2; ++hide_dot)
+	{
+		dir_entry_t *seq;
+		int nseq;
+
+		lwin.hide_dot = hide_dot;
+
+		cfg.io_threads = 1;
+		assert_success(flist_load_tree(&lwin, path, INT_MAX));
+		nseq = lwin.list_rows;
+		seq = lwin.dir_entry;
+		lwin.dir_entry = NULL;
+		lwin.list_rows = 0;
+
+		cfg.io_threads = 4;
+		assert_success(flist_load_tree(&lwin, path, INT_MAX));
+		assert_int_equal(nseq, lwin.list_rows);
+		for(i = 0; i < nseq; ++i)
+		{
+			assert_string_equal(seq[i].name, lwin.dir_entry[i].name);
+			assert_string_equal(seq[i].origin, lwin.dir_entry[i].origin);
+			assert_int_equal(seq[i].type, lwin.dir_entry[i].type);
+			assert_int_equal(seq[i].child_count, lwin.dir_entry[i].child_count);
+			assert_int_equal(seq[i].child_pos, lwin.dir_entry[i].child_pos);
+			assert_int_equal(seq[i].inode, lwin.dir_entry[i].inode);
+		}
+
+		free_dir_entries(&lwin, &seq, &nseq);
+	}
+
+	cfg.io_threads = 0;
+}
+
 TEST(current_unselected_file_is_marked)
 {
 	make_abs_path(lwin.curr_dir, sizeof(lwin.curr_dir), TEST_DATA_PATH,
@@ -489,5 +668,23 @@ TEST(filename_is_formatted_according_to_column_and_filetype)
 	assert_string_equal("a.b", name);
 }
 
+/* Checks that two views contain the same tree. */
+static void
+check_same_trees(const view_t *expected, const view_t *actual)
+{
+	int i;
+	assert_int_equal(expected->list_rows, actual->list_rows);
+	for(i = 0; i < expected->list_rows; ++i)
+	{
+		const dir_entry_t *const a = &expected->dir_entry[i];
+		const dir_entry_t *const b = &actual->dir_entry[i];
+		assert_string_equal(a->name, b->name);
+		assert_string_equal(a->origin, b->origin);
+		assert_int_equal(a->child_count, b->child_count);
+		assert_int_equal(a->child_pos, b->child_pos);
+		assert_int_equal(a->folded, b->folded);
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
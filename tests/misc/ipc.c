@@ -130,7 +130,8 @@ TEST(expr_is_evaluated, IF(enabled_and_not_in_wine))
 	ipc_t *const ipc1 = ipc_init(NAME, &test_ipc_args, &test_ipc_eval);
 	ipc_t *const ipc2 = ipc_init(NAME, &test_ipc_args2, &test_ipc_eval);
 
-	assert_success(bg_execute("", "", 0, 1, &other_instance, ipc2));
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL,
+				&other_instance, ipc2));
 
 	result = ipc_eval(ipc1, ipc_get_name(ipc2), expr);
 	assert_false(ipc_check(ipc1));
@@ -157,7 +158,8 @@ TEST(eval_error_is_handled, IF(enabled_and_not_in_wine))
 	ipc_t *const ipc1 = ipc_init(NAME, &test_ipc_args, &test_ipc_eval);
 	ipc_t *const ipc2 = ipc_init(NAME, &test_ipc_args2, &test_ipc_eval_error);
 
-	assert_success(bg_execute("", "", 0, 1, &other_instance, ipc2));
+	assert_success(bg_execute("", "", 0, BJC_BULK_IO, NULL,
+				&other_instance, ipc2));
 
 	result = ipc_eval(ipc1, ipc_get_name(ipc2), expr);
 	assert_false(ipc_check(ipc1));
@@ -8,13 +8,18 @@
 #include "../../src/cfg/config.h"
 #include "../../src/compat/fs_limits.h"
 #include "../../src/engine/keys.h"
+#include "../../src/int/file_magic.h"
 #include "../../src/menus/map_menu.h"
 #include "../../src/menus/menus.h"
+#include "../../src/menus/vifm_menu.h"
+#include "../../src/modes/menu.h"
 #include "../../src/modes/modes.h"
+#include "../../src/modes/wk.h"
 #include "../../src/ui/statusbar.h"
 #include "../../src/ui/ui.h"
 #include "../../src/utils/fs.h"
 #include "../../src/utils/string_array.h"
+#include "../../src/status.h"
 
 #include "utils.h"
 
@@ -226,5 +231,23 @@ TEST(empty_mappings_menu_is_not_displayed)
 	vle_keys_reset();
 }
 
+TEST(version_menu_contains_statistics_of_mime_cache)
+{
+	const menu_data_t *menu;
+
+	init_modes();
+	mimetype_cache_reset();
+	curr_stats.load_stage = -1;
+
+	assert_success(show_vifm_menu(&lwin));
+	menu = menu_get_current();
+	assert_string_equal("Mime-type cache: 0 entries, 0 hits, 0 misses, "
+			"0 evictions", menu->items[menu->len - 1]);
+	(void)vle_keys_exec(WK_ESC);
+
+	curr_stats.load_stage = 0;
+	vle_keys_reset();
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
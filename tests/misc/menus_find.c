@@ -1,13 +1,21 @@
 #include <stic.h>
 
-#include <unistd.h> /* chdir() */
-
-#include <stdio.h> /* snprintf() */
+#ifndef _WIN32
+#include <sys/types.h> /* pid_t */
+#include <sys/wait.h> /* WIFSIGNALED() WTERMSIG() waitpid() */
+#endif
+#include <signal.h> /* SIGINT */
+#include <unistd.h> /* chdir() unlink() usleep() */
+
+#include <stdio.h> /* FILE fclose() fopen() fscanf() snprintf() */
 #include <string.h> /* strcpy() */
 
 #include "../../src/cfg/config.h"
 #include "../../src/engine/cmds.h"
 #include "../../src/engine/keys.h"
+#include "../../src/engine/mode.h"
+#include "../../src/menus/menus.h"
+#include "../../src/modes/menu.h"
 #include "../../src/modes/modes.h"
 #include "../../src/modes/wk.h"
 #include "../../src/ui/ui.h"
@@ -118,5 +126,67 @@ TEST(p_macro_works, IF(not_windows))
 	assert_failure(exec_commands("find a$NO_SUCH_VAR", &lwin, CIT_COMMAND));
 }
 
+TEST(menu_is_filled_while_command_runs, IF(not_windows))
+{
+	int i;
+
+	assert_success(exec_commands("set findprg='echo first; sleep 0.2; "
+				"echo second; echo third; true'", &lwin, CIT_COMMAND));
+
+	strcpy(lwin.curr_dir, test_data);
+
+	assert_success(exec_commands("find x", &lwin, CIT_COMMAND));
+	assert_true(vle_mode_is(MENU_MODE));
+	assert_int_equal(1, menu_get_current()->len);
+	assert_string_equal("first", menu_get_current()->items[0]);
+
+	assert_success(menus_search("d$", menu_get_current(), 0));
+
+	for(i = 0; i < 100 && menu_get_current()->len < 3; ++i)
+	{
+		usleep(10000);
+		menus_check_for_updates();
+	}
+
+	assert_int_equal(3, menu_get_current()->len);
+	assert_string_equal("second", menu_get_current()->items[1]);
+	assert_string_equal("third", menu_get_current()->items[2]);
+	assert_int_equal(2, menus_search_matched(menu_get_current()->state));
+
+	(void)vle_keys_exec(WK_ESC);
+}
+
+TEST(leaving_menu_stops_command, IF(not_windows))
+{
+#ifndef _WIN32
+	FILE *fp;
+	int pid, status;
+
+	assert_success(exec_commands("set findprg='echo $$ > " SANDBOX_PATH "/pid; "
+				"echo first; exec sleep 10 #'", &lwin, CIT_COMMAND));
+
+	strcpy(lwin.curr_dir, test_data);
+
+	assert_success(exec_commands("find x", &lwin, CIT_COMMAND));
+	assert_true(vle_mode_is(MENU_MODE));
+	(void)vle_keys_exec(WK_ESC);
+	assert_true(vle_mode_is(NORMAL_MODE));
+
+	menus_check_for_updates();
+
+	fp = fopen(SANDBOX_PATH "/pid", "r");
+	assert_non_null(fp);
+	assert_int_equal(1, fscanf(fp, "%d", &pid));
+	fclose(fp);
+	assert_success(unlink(SANDBOX_PATH "/pid"));
+
+	/* There is no SIGCHLD handler in tests, so the command is still a child of
+	 * this process and must have been killed by the signal. */
+	assert_int_equal(pid, waitpid((pid_t)pid, &status, 0));
+	assert_true(WIFSIGNALED(status));
+	assert_int_equal(SIGINT, WTERMSIG(status));
+#endif
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 : */
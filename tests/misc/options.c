@@ -676,5 +676,19 @@ TEST(shellcmdflag)
 	assert_string_equal("-c", cfg.shell_cmd_flag);
 }
 
+TEST(iothreads)
+{
+	assert_success(exec_commands("set iothreads=4", &lwin, CIT_COMMAND));
+	assert_int_equal(4, cfg.io_threads);
+
+	assert_success(exec_commands("set iothreads=0", &lwin, CIT_COMMAND));
+	assert_int_equal(0, cfg.io_threads);
+
+	assert_failure(exec_commands("set iothreads=-1", &lwin, CIT_COMMAND));
+	assert_true(cfg.io_threads >= 0);
+	assert_failure(exec_commands("set iothreads=100000", &lwin, CIT_COMMAND));
+	assert_true(cfg.io_threads != 100000);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
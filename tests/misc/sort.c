@@ -3,7 +3,8 @@
 #include <unistd.h> /* chdir() unlink() */
 
 #include <locale.h> /* LC_ALL setlocale() */
-#include <string.h> /* memset() strcpy() */
+#include <stdio.h> /* snprintf() */
+#include <string.h> /* memset() strcmp() strcpy() */
 
 #include "../../src/cfg/config.h"
 #include "../../src/ui/ui.h"
@@ -432,6 +433,209 @@ TEST(groups_sorting_works)
 	assert_string_equal("11-todo-publish", lwin.dir_entry[6].name);
 }
 
+TEST(group_keys_are_reused_by_resorting)
+{
+	int keys[3];
+
+	view_teardown(&lwin);
+	assert_success(stats_init(&cfg));
+
+	strcpy(lwin.curr_dir, TEST_DATA_PATH);
+	lwin.list_rows = 3;
+	lwin.dir_entry = dynarray_cextend(NULL,
+			lwin.list_rows*sizeof(*lwin.dir_entry));
+	lwin.dir_entry[0].name = strdup("a-2");
+	lwin.dir_entry[0].origin = lwin.curr_dir;
+	lwin.dir_entry[1].name = strdup("b-1");
+	lwin.dir_entry[1].origin = lwin.curr_dir;
+	lwin.dir_entry[2].name = strdup("c-3");
+	lwin.dir_entry[2].origin = lwin.curr_dir;
+
+	lwin.sort[0] = SK_BY_GROUPS;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+	update_string(&lwin.sort_groups, "-(.)");
+
+	sort_view(&lwin);
+	assert_string_equal("b-1", lwin.dir_entry[0].name);
+	assert_string_equal("a-2", lwin.dir_entry[1].name);
+	assert_string_equal("c-3", lwin.dir_entry[2].name);
+	keys[0] = lwin.dir_entry[0].group_key;
+	keys[1] = lwin.dir_entry[1].group_key;
+	keys[2] = lwin.dir_entry[2].group_key;
+
+	lwin.sort[0] = -SK_BY_GROUPS;
+	sort_view(&lwin);
+	assert_string_equal("c-3", lwin.dir_entry[0].name);
+	assert_string_equal("a-2", lwin.dir_entry[1].name);
+	assert_string_equal("b-1", lwin.dir_entry[2].name);
+	assert_int_equal(keys[2], lwin.dir_entry[0].group_key);
+	assert_int_equal(keys[1], lwin.dir_entry[1].group_key);
+	assert_int_equal(keys[0], lwin.dir_entry[2].group_key);
+
+	update_string(&lwin.sort_groups, NULL);
+}
+
+TEST(group_keys_are_updated_on_changing_groups_or_names)
+{
+	view_teardown(&lwin);
+	assert_success(stats_init(&cfg));
+
+	strcpy(lwin.curr_dir, TEST_DATA_PATH);
+	lwin.list_rows = 3;
+	lwin.dir_entry = dynarray_cextend(NULL,
+			lwin.list_rows*sizeof(*lwin.dir_entry));
+	lwin.dir_entry[0].name = strdup("a-2");
+	lwin.dir_entry[0].origin = lwin.curr_dir;
+	lwin.dir_entry[1].name = strdup("b-1");
+	lwin.dir_entry[1].origin = lwin.curr_dir;
+	lwin.dir_entry[2].name = strdup("c-3");
+	lwin.dir_entry[2].origin = lwin.curr_dir;
+
+	lwin.sort[0] = SK_BY_GROUPS;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+	update_string(&lwin.sort_groups, "-(.)");
+	sort_view(&lwin);
+
+	update_string(&lwin.sort_groups, "^(.)-");
+	sort_view(&lwin);
+	assert_string_equal("a-2", lwin.dir_entry[0].name);
+	assert_string_equal("b-1", lwin.dir_entry[1].name);
+	assert_string_equal("c-3", lwin.dir_entry[2].name);
+
+	/* Entry with a different name but same index of cached keys. */
+	replace_string(&lwin.dir_entry[0].name, "d-0");
+	sort_view(&lwin);
+	assert_string_equal("b-1", lwin.dir_entry[0].name);
+	assert_string_equal("c-3", lwin.dir_entry[1].name);
+	assert_string_equal("d-0", lwin.dir_entry[2].name);
+
+	update_string(&lwin.sort_groups, NULL);
+}
+
+TEST(parent_dir_is_first_regardless_of_sorting_order)
+{
+	view_teardown(&lwin);
+
+	lwin.list_rows = 3;
+	lwin.dir_entry = dynarray_cextend(NULL,
+			lwin.list_rows*sizeof(*lwin.dir_entry));
+	lwin.dir_entry[0].name = strdup("dir");
+	lwin.dir_entry[0].type = FT_DIR;
+	lwin.dir_entry[1].name = strdup("..");
+	lwin.dir_entry[1].type = FT_DIR;
+	lwin.dir_entry[2].name = strdup("file");
+	lwin.dir_entry[2].type = FT_REG;
+
+	lwin.sort[0] = -SK_BY_DIR;
+	lwin.sort[1] = -SK_BY_NAME;
+	memset(&lwin.sort[2], SK_NONE, sizeof(lwin.sort) - 2);
+
+	sort_view(&lwin);
+
+	assert_string_equal("..", lwin.dir_entry[0].name);
+	assert_string_equal("file", lwin.dir_entry[1].name);
+	assert_string_equal("dir", lwin.dir_entry[2].name);
+}
+
+TEST(large_lists_are_sorted_by_all_keys)
+{
+	enum { N = 40000 };
+	int i;
+
+	view_teardown(&lwin);
+	assert_success(stats_init(&cfg));
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+
+	lwin.list_rows = N;
+	lwin.dir_entry = dynarray_cextend(NULL,
+			lwin.list_rows*sizeof(*lwin.dir_entry));
+	for(i = 0; i < N; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "%05d", N - 1 - i);
+		lwin.dir_entry[i].name = strdup(name);
+		lwin.dir_entry[i].type = (i%10 == 0 ? FT_DIR : FT_REG);
+		lwin.dir_entry[i].size = i%7;
+		lwin.dir_entry[i].origin = lwin.curr_dir;
+	}
+
+	lwin.sort[0] = -SK_BY_SIZE;
+	lwin.sort[1] = SK_BY_NAME;
+	memset(&lwin.sort[2], SK_NONE, sizeof(lwin.sort) - 2);
+
+	sort_view(&lwin);
+
+	for(i = 1; i < N; ++i)
+	{
+		const dir_entry_t *const prev = &lwin.dir_entry[i - 1];
+		const dir_entry_t *const curr = &lwin.dir_entry[i];
+
+		if(prev->type != curr->type)
+		{
+			assert_true(prev->type == FT_DIR);
+		}
+		else if(prev->size != curr->size)
+		{
+			assert_true(prev->size > curr->size);
+		}
+		else
+		{
+			assert_true(strcmp(prev->name, curr->name) < 0);
+		}
+	}
+}
+
+TEST(inserted_entries_are_placed_where_sorting_would_put_them)
+{
+	dir_entry_t entries[3] = {};
+
+	view_teardown(&lwin);
+	assert_success(stats_init(&cfg));
+
+	strcpy(lwin.curr_dir, TEST_DATA_PATH);
+	lwin.list_rows = 3;
+	lwin.dir_entry = dynarray_cextend(NULL,
+			lwin.list_rows*sizeof(*lwin.dir_entry));
+	lwin.dir_entry[0].name = strdup("4-todo-edit");
+	lwin.dir_entry[0].type = FT_REG;
+	lwin.dir_entry[0].origin = lwin.curr_dir;
+	lwin.dir_entry[1].name = strdup("1-done");
+	lwin.dir_entry[1].type = FT_REG;
+	lwin.dir_entry[1].origin = lwin.curr_dir;
+	lwin.dir_entry[2].name = strdup("2-todo-replace");
+	lwin.dir_entry[2].type = FT_REG;
+	lwin.dir_entry[2].origin = lwin.curr_dir;
+
+	entries[0].name = strdup("10-bla-todo-edit");
+	entries[0].type = FT_REG;
+	entries[0].origin = lwin.curr_dir;
+	entries[1].name = strdup("5-todo-publish");
+	entries[1].type = FT_REG;
+	entries[1].origin = lwin.curr_dir;
+	entries[2].name = strdup("3-done");
+	entries[2].type = FT_REG;
+	entries[2].origin = lwin.curr_dir;
+
+	lwin.sort[0] = SK_BY_GROUPS;
+	lwin.sort[1] = SK_BY_NAME;
+	memset(&lwin.sort[2], SK_NONE, sizeof(lwin.sort) - 2);
+	update_string(&lwin.sort_groups, "-(done|todo).*");
+
+	sort_view(&lwin);
+	assert_success(sort_insert_entries(&lwin, entries, 3));
+
+	update_string(&lwin.sort_groups, NULL);
+
+	assert_int_equal(6, lwin.list_rows);
+	assert_string_equal("1-done", lwin.dir_entry[0].name);
+	assert_string_equal("3-done", lwin.dir_entry[1].name);
+	assert_string_equal("2-todo-replace", lwin.dir_entry[2].name);
+	assert_string_equal("4-todo-edit", lwin.dir_entry[3].name);
+	assert_string_equal("5-todo-publish", lwin.dir_entry[4].name);
+	assert_string_equal("10-bla-todo-edit", lwin.dir_entry[5].name);
+}
+
 #ifndef _WIN32
 
 TEST(inode_sorting_works)
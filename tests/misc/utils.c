@@ -3,6 +3,7 @@
 #include <sys/stat.h> /* chmod() */
 #include <unistd.h> /* access() usleep() */
 
+#include <limits.h> /* INT_MAX */
 #include <locale.h> /* LC_ALL setlocale() */
 #include <stddef.h> /* NULL */
 #include <stdio.h> /* FILE fclose() fopen() fread() */
@@ -170,6 +171,7 @@ view_setup(view_t *view)
 
 	view->custom.entry_count = 0;
 	view->custom.entries = NULL;
+	view->custom.tree_depth = INT_MAX;
 
 	view->local_filter.entry_count = 0;
 	view->local_filter.entries = NULL;
@@ -0,0 +1,192 @@
+#include <stic.h>
+
+#include <stdio.h> /* FILE fclose() fopen() fprintf() fputs() remove() */
+
+#include "../../src/cfg/config.h"
+#include "../../src/compat/fs_limits.h"
+#include "../../src/engine/keys.h"
+#include "../../src/engine/mode.h"
+#include "../../src/modes/modes.h"
+#include "../../src/modes/view.h"
+#include "../../src/modes/wk.h"
+#include "../../src/ui/statusbar.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/fs.h"
+#include "../../src/filelist.h"
+#include "../../src/status.h"
+
+#include "utils.h"
+
+SETUP()
+{
+	char cwd[PATH_MAX + 1];
+	FILE *f;
+	int i;
+
+	view_setup(&lwin);
+	setup_grid(&lwin, 1, 1, 1);
+	curr_view = &lwin;
+	view_setup(&rwin);
+	setup_grid(&rwin, 1, 1, 1);
+	other_view = &rwin;
+
+	init_modes();
+
+	cfg.tab_stop = 8;
+
+	f = fopen(SANDBOX_PATH "/big", "w");
+	assert_non_null(f);
+	for(i = 0; i < 100000; ++i)
+	{
+		fprintf(f, "line\t%d\n", i);
+	}
+	fclose(f);
+
+	assert_non_null(get_cwd(cwd, sizeof(cwd)));
+	make_abs_path(lwin.curr_dir, sizeof(lwin.curr_dir), SANDBOX_PATH, "", cwd);
+	populate_dir_list(&lwin, 0);
+}
+
+TEARDOWN()
+{
+	vle_keys_reset();
+
+	cfg.tab_stop = 0;
+
+	view_teardown(&lwin);
+	view_teardown(&rwin);
+
+	assert_success(remove(SANDBOX_PATH "/big"));
+}
+
+TEST(mapped_file_can_be_navigated)
+{
+	(void)vle_keys_exec_timed_out(WK_e);
+	assert_true(vle_mode_is(VIEW_MODE));
+
+	(void)vle_keys_exec_timed_out(WK_j);
+	(void)vle_keys_exec_timed_out(WK_G);
+	(void)vle_keys_exec_timed_out(WK_k);
+	(void)vle_keys_exec_timed_out(L"50" WK_PERCENT);
+	(void)vle_keys_exec_timed_out(WK_g WK_g);
+	(void)vle_keys_exec_timed_out(L"1000" WK_j);
+
+	(void)vle_keys_exec_timed_out(WK_q);
+	assert_true(vle_mode_is(NORMAL_MODE));
+}
+
+TEST(wrapping_of_mapped_file_works)
+{
+	cfg.wrap_quick_view = 1;
+
+	(void)vle_keys_exec_timed_out(WK_e);
+	assert_true(vle_mode_is(VIEW_MODE));
+
+	(void)vle_keys_exec_timed_out(WK_G);
+	(void)vle_keys_exec_timed_out(WK_g WK_g);
+	(void)vle_keys_exec_timed_out(WK_q);
+
+	cfg.wrap_quick_view = 0;
+}
+
+TEST(auto_forwarding_picks_up_appended_lines)
+{
+	FILE *f;
+
+	/* Lines are searched for by parts that fit into the window. */
+	lwin.window_rows = 10;
+	lwin.window_cols = 80;
+
+	(void)vle_keys_exec_timed_out(WK_e);
+	assert_true(vle_mode_is(VIEW_MODE));
+	(void)vle_keys_exec_timed_out(WK_F);
+
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("^appended$", 0);
+	wait_for_search();
+	assert_string_equal("Pattern not found", ui_sb_last());
+
+	f = fopen(SANDBOX_PATH "/big", "a");
+	assert_non_null(f);
+	fputs("appended\n", f);
+	fclose(f);
+
+	view_check_for_updates();
+
+	(void)vle_keys_exec_timed_out(WK_g WK_g);
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("^appended$", 0);
+	wait_for_search();
+	assert_string_equal("-- VIEW -- (auto forwarding) (matches: 1)",
+			ui_sb_last());
+
+	(void)vle_keys_exec_timed_out(WK_q);
+}
+
+TEST(search_goes_through_index_of_matches)
+{
+	lwin.window_rows = 10;
+	lwin.window_cols = 80;
+
+	(void)vle_keys_exec_timed_out(WK_e);
+	assert_true(vle_mode_is(VIEW_MODE));
+
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("0000$", 0);
+	wait_for_search();
+	assert_string_equal("-- VIEW -- (matches: 9)", ui_sb_last());
+
+	/* Moves to line 40000 and then back to line 30000. */
+	curr_stats.save_msg = 0;
+	(void)vle_keys_exec_timed_out(L"3" WK_n);
+	curr_stats.save_msg = 0;
+	(void)vle_keys_exec_timed_out(WK_N);
+
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("^line +30000$", 1);
+	wait_for_search();
+	assert_string_equal("Pattern not found", ui_sb_last());
+
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("^line +29999$", 1);
+	wait_for_search();
+	assert_string_equal("-- VIEW -- (matches: 1)", ui_sb_last());
+
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("^line +30000$", 0);
+	wait_for_search();
+	assert_string_equal("-- VIEW -- (matches: 1)", ui_sb_last());
+
+	(void)vle_keys_exec_timed_out(WK_q);
+}
+
+TEST(search_in_wrapped_lines_finds_later_parts)
+{
+	FILE *const f = fopen(SANDBOX_PATH "/big", "a");
+	assert_non_null(f);
+	fputs("0123456789abcdef\n", f);
+	fclose(f);
+
+	lwin.window_rows = 10;
+	lwin.window_cols = 10;
+	cfg.wrap_quick_view = 1;
+
+	(void)vle_keys_exec_timed_out(WK_e);
+	assert_true(vle_mode_is(VIEW_MODE));
+
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("^abc", 0);
+	wait_for_search();
+	assert_string_equal("-- VIEW -- (matches: 1)", ui_sb_last());
+
+	curr_stats.save_msg = 0;
+	(void)view_find_pattern("^0123456789$", 1);
+	wait_for_search();
+	assert_string_equal("-- VIEW -- (matches: 1)", ui_sb_last());
+
+	(void)vle_keys_exec_timed_out(WK_q);
+	cfg.wrap_quick_view = 0;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
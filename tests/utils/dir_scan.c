@@ -0,0 +1,207 @@
+#include <stic.h>
+
+#include <unistd.h> /* rmdir() symlink() unlink() */
+
+#include <stddef.h> /* NULL */
+#include <string.h> /* strcmp() */
+
+#include "../../src/compat/os.h"
+#include "../../src/utils/dir_scan.h"
+
+#include "utils.h"
+
+static int count_entries(dir_scan_t *scan, dir_scan_node_t *node);
+static const dir_scan_entry_t * find_entry(const dir_scan_entry_t entries[],
+		int count, const char name[]);
+static int any_dir(const char path[], int depth, void *arg);
+static int shallow_dir(const char path[], int depth, void *arg);
+
+TEST(listing_contains_attributes_of_entries)
+{
+	dir_scan_entry_t *entries;
+	int count;
+	const dir_scan_entry_t *entry;
+
+	assert_success(dir_scan_list(TEST_DATA_PATH "/tree", &entries, &count));
+	assert_int_equal(3, count);
+
+	entry = find_entry(entries, count, "dir1");
+	assert_true(entry->is_dir);
+	assert_false(entry->is_link);
+	assert_null(entry->child);
+
+	entry = find_entry(entries, count, ".hidden");
+	assert_false(entry->is_dir);
+	assert_false(entry->is_link);
+
+	dir_scan_free_list(entries, count);
+}
+
+TEST(listing_missing_directory_fails)
+{
+	dir_scan_entry_t *entries;
+	int count;
+	assert_failure(dir_scan_list(TEST_DATA_PATH "/no-such-dir", &entries,
+				&count));
+}
+
+TEST(symbolic_links_are_recognized, IF(not_windows))
+{
+	dir_scan_entry_t *entries;
+	int count;
+	const dir_scan_entry_t *entry;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	assert_success(symlink("dir", SANDBOX_PATH "/dir-link"));
+	assert_success(symlink("no-file", SANDBOX_PATH "/broken-link"));
+
+	assert_success(dir_scan_list(SANDBOX_PATH, &entries, &count));
+	assert_int_equal(3, count);
+
+	entry = find_entry(entries, count, "dir-link");
+	assert_true(entry->is_link);
+	assert_true(entry->is_dir);
+
+	entry = find_entry(entries, count, "broken-link");
+	assert_true(entry->is_link);
+	assert_false(entry->is_dir);
+
+	dir_scan_free_list(entries, count);
+
+	assert_success(unlink(SANDBOX_PATH "/broken-link"));
+	assert_success(unlink(SANDBOX_PATH "/dir-link"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+}
+
+TEST(whole_hierarchy_is_scanned_without_threads)
+{
+	dir_scan_t *const scan = dir_scan_start(TEST_DATA_PATH "/tree", 0, &any_dir,
+			NULL);
+	assert_non_null(scan);
+	assert_int_equal(12, count_entries(scan, dir_scan_root(scan)));
+	dir_scan_free(scan);
+}
+
+TEST(whole_hierarchy_is_scanned_with_threads)
+{
+	int i;
+	for(i = 0; i < 50; ++i)
+	{
+		dir_scan_t *const scan = dir_scan_start(TEST_DATA_PATH "/tree", 4,
+				&any_dir, NULL);
+		assert_non_null(scan);
+		assert_int_equal(12, count_entries(scan, dir_scan_root(scan)));
+		dir_scan_free(scan);
+	}
+}
+
+TEST(predicate_limits_scanning)
+{
+	dir_scan_entry_t *entries, *nested;
+	int count, nested_count;
+	const dir_scan_entry_t *entry;
+	dir_scan_t *const scan = dir_scan_start(TEST_DATA_PATH "/tree", 2,
+			&shallow_dir, NULL);
+	assert_non_null(scan);
+
+	assert_success(dir_scan_get(scan, dir_scan_root(scan), &entries, &count));
+	assert_int_equal(3, count);
+
+	entry = find_entry(entries, count, "dir1");
+	assert_success(dir_scan_get(scan, entry->child, &nested, &nested_count));
+	assert_int_equal(2, nested_count);
+	assert_null(find_entry(nested, nested_count, "dir2")->child);
+	dir_scan_free_list(nested, nested_count);
+
+	entry = find_entry(entries, count, "dir5");
+	assert_int_equal(2, count_entries(scan, entry->child));
+
+	dir_scan_free_list(entries, count);
+	dir_scan_free(scan);
+}
+
+TEST(dropped_directories_are_not_retrieved)
+{
+	int i;
+	for(i = 0; i < 50; ++i)
+	{
+		dir_scan_entry_t *entries;
+		int count;
+		const dir_scan_entry_t *entry;
+		dir_scan_t *const scan = dir_scan_start(TEST_DATA_PATH "/tree", 2,
+				&any_dir, NULL);
+		assert_non_null(scan);
+
+		assert_success(dir_scan_get(scan, dir_scan_root(scan), &entries, &count));
+
+		entry = find_entry(entries, count, "dir1");
+		assert_non_null(entry->child);
+		dir_scan_drop(scan, entry->child);
+
+		entry = find_entry(entries, count, "dir5");
+		assert_int_equal(2, count_entries(scan, entry->child));
+
+		dir_scan_free_list(entries, count);
+		dir_scan_free(scan);
+	}
+}
+
+/* Counts entries of the directory recursively by retrieving listings from the
+ * scanner.  Returns the count. */
+static int
+count_entries(dir_scan_t *scan, dir_scan_node_t *node)
+{
+	dir_scan_entry_t *entries;
+	int count;
+	int i;
+	int total;
+
+	if(node == NULL)
+	{
+		return 0;
+	}
+
+	assert_success(dir_scan_get(scan, node, &entries, &count));
+
+	total = count;
+	for(i = 0; i < count; ++i)
+	{
+		assert_true(entries[i].child == NULL || entries[i].is_dir);
+		total += count_entries(scan, entries[i].child);
+	}
+
+	dir_scan_free_list(entries, count);
+	return total;
+}
+
+/* Finds entry by its name.  Returns the entry. */
+static const dir_scan_entry_t *
+find_entry(const dir_scan_entry_t entries[], int count, const char name[])
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		if(strcmp(entries[i].name, name) == 0)
+		{
+			return &entries[i];
+		}
+	}
+
+	assert_fail("Entry not found");
+	return NULL;
+}
+
+static int
+any_dir(const char path[], int depth, void *arg)
+{
+	return 1;
+}
+
+static int
+shallow_dir(const char path[], int depth, void *arg)
+{
+	return (depth < 2);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -202,6 +202,34 @@ TEST(parents_are_unchanged_in_fsdata_on_mismatch)
 	fsdata_free(fsd);
 }
 
+TEST(path_is_mapped_in_fsdata_including_target)
+{
+	char ch = '5';
+	fsdata_t *const fsd = fsdata_create(0, 1);
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/dir/sub", 0700));
+
+	assert_success(fsdata_set(fsd, SANDBOX_PATH, &ch, sizeof(ch)));
+	assert_success(fsdata_set(fsd, SANDBOX_PATH "/dir/sub", &ch, sizeof(ch)));
+
+	/* Target doesn't have to be in the tree. */
+	assert_success(fsdata_map_path(fsd, SANDBOX_PATH "/dir", visitor, NULL));
+	assert_success(fsdata_get(fsd, SANDBOX_PATH, &ch, sizeof(ch)));
+	assert_int_equal('6', ch);
+	assert_success(fsdata_get(fsd, SANDBOX_PATH "/dir/sub", &ch, sizeof(ch)));
+	assert_int_equal('5', ch);
+
+	assert_success(fsdata_map_path(fsd, SANDBOX_PATH "/dir/sub", visitor, NULL));
+	assert_success(fsdata_get(fsd, SANDBOX_PATH "/dir/sub", &ch, sizeof(ch)));
+	assert_int_equal('6', ch);
+
+	assert_failure(fsdata_map_path(fsd, SANDBOX_PATH "/wrong", visitor, NULL));
+
+	assert_success(rmdir(SANDBOX_PATH "/dir/sub"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+	fsdata_free(fsd);
+}
+
 TEST(root_can_carry_data)
 {
 	/* Big buffer that might overwrite some data. */
@@ -1,6 +1,6 @@
 #include <stic.h>
 
-#include <stdio.h> /* remove() snprintf() */
+#include <stdio.h> /* remove() rename() snprintf() */
 
 #include "../../src/compat/fs_limits.h"
 #include "../../src/compat/os.h"
@@ -155,6 +155,71 @@ TEST(file_recreation_removes_ban, IF(using_inotify))
 	assert_success(remove(SANDBOX_PATH "/testdir"));
 }
 
+TEST(poll_reports_no_deltas_without_changes)
+{
+	fswatch_t *watch;
+	fswatch_delta_t *deltas;
+	int count;
+
+	assert_non_null(watch = fswatch_create(sandbox));
+
+	assert_int_equal(FSWS_UNCHANGED, fswatch_poll(watch, &deltas, &count));
+	assert_null(deltas);
+	assert_int_equal(0, count);
+
+	fswatch_free(watch);
+}
+
+TEST(poll_reports_deltas_in_order, IF(using_inotify))
+{
+	fswatch_t *watch;
+	fswatch_delta_t *deltas;
+	int count;
+
+	assert_non_null(watch = fswatch_create(sandbox));
+
+	os_mkdir(SANDBOX_PATH "/testdir", 0700);
+	assert_success(rename(SANDBOX_PATH "/testdir", SANDBOX_PATH "/newdir"));
+	assert_success(os_chmod(SANDBOX_PATH "/newdir", 0777));
+	assert_success(remove(SANDBOX_PATH "/newdir"));
+
+	assert_int_equal(FSWS_UPDATED, fswatch_poll(watch, &deltas, &count));
+	assert_int_equal(5, count);
+	assert_string_equal("testdir", deltas[0].name);
+	assert_int_equal(FSWE_CREATED, deltas[0].event);
+	assert_string_equal("testdir", deltas[1].name);
+	assert_int_equal(FSWE_MOVED_FROM, deltas[1].event);
+	assert_string_equal("newdir", deltas[2].name);
+	assert_int_equal(FSWE_MOVED_TO, deltas[2].event);
+	assert_string_equal("newdir", deltas[3].name);
+	assert_int_equal(FSWE_MODIFIED, deltas[3].event);
+	assert_string_equal("newdir", deltas[4].name);
+	assert_int_equal(FSWE_DELETED, deltas[4].event);
+	fswatch_free_deltas(deltas, count);
+
+	assert_int_equal(FSWS_UNCHANGED, fswatch_poll(watch, &deltas, &count));
+
+	fswatch_free(watch);
+}
+
+TEST(change_of_directory_itself_requires_reload, IF(using_inotify))
+{
+	fswatch_t *watch;
+	fswatch_delta_t *deltas;
+	int count;
+
+	os_mkdir(SANDBOX_PATH "/testdir", 0700);
+	assert_non_null(watch = fswatch_create(SANDBOX_PATH "/testdir"));
+
+	assert_success(os_chmod(SANDBOX_PATH "/testdir", 0777));
+	assert_int_equal(FSWS_REPLACED, fswatch_poll(watch, &deltas, &count));
+	assert_null(deltas);
+	assert_int_equal(0, count);
+
+	fswatch_free(watch);
+	assert_success(remove(SANDBOX_PATH "/testdir"));
+}
+
 static int
 using_inotify(void)
 {
@@ -0,0 +1,214 @@
+#include <stic.h>
+
+#include <limits.h> /* INT_MAX */
+#include <stddef.h> /* NULL size_t */
+#include <stdio.h> /* FILE fclose() fopen() fprintf() fputs() remove()
+                      rename() */
+#include <stdlib.h> /* free() */
+
+#include "../../src/utils/mapped_text.h"
+#include "../../src/utils/string_array.h"
+
+static void check_file(const char path[]);
+
+TEST(lines_match_those_of_read_file)
+{
+	check_file(TEST_DATA_PATH "/read/binary-data");
+	check_file(TEST_DATA_PATH "/read/dos-eof");
+	check_file(TEST_DATA_PATH "/read/dos-line-endings");
+	check_file(TEST_DATA_PATH "/read/two-lines");
+	check_file(TEST_DATA_PATH "/read/utf8-bom");
+	check_file(TEST_DATA_PATH "/read/very-long-line");
+}
+
+TEST(empty_files_and_directories_are_not_mapped)
+{
+	FILE *const f = fopen(SANDBOX_PATH "/empty", "w");
+	assert_non_null(f);
+	fclose(f);
+
+	assert_null(mapped_text_open(SANDBOX_PATH "/empty"));
+	assert_null(mapped_text_open(SANDBOX_PATH));
+	assert_null(mapped_text_open(SANDBOX_PATH "/no-such-file"));
+
+	assert_success(remove(SANDBOX_PATH "/empty"));
+}
+
+TEST(files_larger_than_indexing_chunk_are_indexed)
+{
+	enum { NLINES = 300000 };
+	mapped_text_t *text;
+	char *buf = NULL;
+	size_t buf_len = 0U;
+	int complete;
+	int i;
+
+	FILE *const f = fopen(SANDBOX_PATH "/big", "w");
+	assert_non_null(f);
+	for(i = 0; i < NLINES; ++i)
+	{
+		fprintf(f, "line number %d\n", i);
+	}
+	fclose(f);
+
+	text = mapped_text_open(SANDBOX_PATH "/big");
+	assert_non_null(text);
+
+	assert_true(mapped_text_wait(text, 10) >= 10);
+	assert_string_equal("line number 9", mapped_text_get(text, 9, &buf,
+				&buf_len));
+
+	assert_int_equal(NLINES, mapped_text_wait(text, NLINES + 1));
+	assert_int_equal(NLINES, mapped_text_count(text, &complete));
+	assert_true(complete);
+	assert_true(mapped_text_is_valid(text));
+
+	assert_string_equal("line number 123456", mapped_text_get(text, 123456,
+				&buf, &buf_len));
+	assert_string_equal("line number 299999", mapped_text_get(text, NLINES - 1,
+				&buf, &buf_len));
+	assert_null(mapped_text_get(text, NLINES, &buf, &buf_len));
+
+	free(buf);
+	mapped_text_close(text);
+	assert_success(remove(SANDBOX_PATH "/big"));
+}
+
+TEST(truncation_invalidates_mapping)
+{
+	mapped_text_t *text;
+	FILE *f = fopen(SANDBOX_PATH "/file", "w");
+	assert_non_null(f);
+	fputs("first\nsecond\n", f);
+	fclose(f);
+
+	text = mapped_text_open(SANDBOX_PATH "/file");
+	assert_non_null(text);
+	assert_true(mapped_text_is_valid(text));
+
+	f = fopen(SANDBOX_PATH "/file", "w");
+	assert_non_null(f);
+	fputs("1\n", f);
+	fclose(f);
+
+	assert_false(mapped_text_is_valid(text));
+
+	mapped_text_close(text);
+	assert_success(remove(SANDBOX_PATH "/file"));
+}
+
+TEST(appended_data_is_indexed)
+{
+	mapped_text_t *text;
+	char *buf = NULL;
+	size_t buf_len = 0U;
+	int nkept;
+
+	FILE *f = fopen(SANDBOX_PATH "/file", "wb");
+	assert_non_null(f);
+	fputs("first\nsec", f);
+	fclose(f);
+
+	text = mapped_text_open(SANDBOX_PATH "/file");
+	assert_non_null(text);
+	assert_int_equal(2, mapped_text_wait(text, INT_MAX));
+	assert_int_equal(MTU_SAME, mapped_text_update(text, SANDBOX_PATH "/file",
+				&nkept));
+
+	f = fopen(SANDBOX_PATH "/file", "ab");
+	assert_non_null(f);
+	fputs("ond\r", f);
+	fclose(f);
+
+	assert_int_equal(MTU_GREW, mapped_text_update(text, SANDBOX_PATH "/file",
+				&nkept));
+	assert_int_equal(1, nkept);
+	assert_int_equal(2, mapped_text_wait(text, INT_MAX));
+	assert_string_equal("second", mapped_text_get(text, 1, &buf, &buf_len));
+
+	f = fopen(SANDBOX_PATH "/file", "ab");
+	assert_non_null(f);
+	fputs("\nthird\n", f);
+	fclose(f);
+
+	assert_int_equal(MTU_GREW, mapped_text_update(text, SANDBOX_PATH "/file",
+				&nkept));
+	assert_int_equal(1, nkept);
+	assert_int_equal(3, mapped_text_wait(text, INT_MAX));
+	assert_string_equal("first", mapped_text_get(text, 0, &buf, &buf_len));
+	assert_string_equal("second", mapped_text_get(text, 1, &buf, &buf_len));
+	assert_string_equal("third", mapped_text_get(text, 2, &buf, &buf_len));
+
+	free(buf);
+	mapped_text_close(text);
+	assert_success(remove(SANDBOX_PATH "/file"));
+}
+
+TEST(truncated_or_replaced_file_needs_reopening)
+{
+	mapped_text_t *text;
+	int nkept;
+
+	FILE *f = fopen(SANDBOX_PATH "/file", "w");
+	assert_non_null(f);
+	fputs("first\nsecond\n", f);
+	fclose(f);
+
+	f = fopen(SANDBOX_PATH "/other", "w");
+	assert_non_null(f);
+	fputs("first\nsecond\nthird\n", f);
+	fclose(f);
+
+	text = mapped_text_open(SANDBOX_PATH "/file");
+	assert_non_null(text);
+	(void)mapped_text_wait(text, INT_MAX);
+
+	assert_success(rename(SANDBOX_PATH "/other", SANDBOX_PATH "/file"));
+	assert_int_equal(MTU_REPLACED, mapped_text_update(text,
+				SANDBOX_PATH "/file", &nkept));
+	mapped_text_close(text);
+
+	text = mapped_text_open(SANDBOX_PATH "/file");
+	assert_non_null(text);
+	(void)mapped_text_wait(text, INT_MAX);
+
+	f = fopen(SANDBOX_PATH "/file", "w");
+	assert_non_null(f);
+	fputs("1\n", f);
+	fclose(f);
+
+	assert_int_equal(MTU_REPLACED, mapped_text_update(text,
+				SANDBOX_PATH "/file", &nkept));
+	mapped_text_close(text);
+
+	assert_success(remove(SANDBOX_PATH "/file"));
+}
+
+/* Verifies that mapped text has the same lines as read_file_of_lines()
+ * produces. */
+static void
+check_file(const char path[])
+{
+	int nlines, i;
+	char **lines;
+	mapped_text_t *text;
+	char *buf = NULL;
+	size_t buf_len = 0U;
+
+	lines = read_file_of_lines(path, &nlines);
+	text = mapped_text_open(path);
+	assert_non_null(text);
+
+	assert_int_equal(nlines, mapped_text_wait(text, nlines + 1));
+	for(i = 0; i < nlines; ++i)
+	{
+		assert_string_equal(lines[i], mapped_text_get(text, i, &buf, &buf_len));
+	}
+
+	free(buf);
+	mapped_text_close(text);
+	free_string_array(lines, nlines);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,144 @@
+#include <stic.h>
+
+#include <stddef.h> /* NULL */
+#include <stdlib.h> /* free() */
+
+#include "../../src/utils/macros.h"
+#include "../../src/utils/matcher_set.h"
+#include "../../src/utils/matchers.h"
+
+static void check_set(const char *exprs[], int nexprs, const char *paths[],
+		int npaths);
+
+TEST(freeing_null_set_does_nothing)
+{
+	matcher_set_free(NULL);
+}
+
+TEST(empty_set_matches_nothing)
+{
+	matcher_set_t *const set = matcher_set_alloc();
+	assert_int_equal(-1, matcher_set_find(set, "file", 0));
+	matcher_set_free(set);
+}
+
+TEST(first_matching_rule_is_found)
+{
+	char *error;
+	matchers_t *const c = matchers_alloc("{*.c}", 0, 1, "", &error);
+	matchers_t *const any = matchers_alloc("{*}", 0, 1, "", &error);
+	matchers_t *const c_too = matchers_alloc("/\\.c$/", 0, 1, "", &error);
+	matcher_set_t *const set = matcher_set_alloc();
+
+	assert_success(matcher_set_add(set, c));
+	assert_success(matcher_set_add(set, any));
+	assert_success(matcher_set_add(set, c_too));
+
+	assert_int_equal(0, matcher_set_find(set, "a.c", 0));
+	assert_int_equal(1, matcher_set_find(set, "a.c", 1));
+	assert_int_equal(2, matcher_set_find(set, "a.c", 2));
+	assert_int_equal(-1, matcher_set_find(set, "a.c", 3));
+	assert_int_equal(1, matcher_set_find(set, "a.h", 0));
+	assert_int_equal(2, matcher_set_find(set, ".c", 0));
+	assert_int_equal(-1, matcher_set_find(set, ".h", 0));
+
+	matcher_set_free(set);
+	matchers_free(c);
+	matchers_free(any);
+	matchers_free(c_too);
+}
+
+TEST(rules_added_after_lookup_are_considered)
+{
+	char *error;
+	matchers_t *const c = matchers_alloc("{*.c}", 0, 1, "", &error);
+	matchers_t *const h = matchers_alloc("{*.h}", 0, 1, "", &error);
+	matcher_set_t *const set = matcher_set_alloc();
+
+	assert_success(matcher_set_add(set, c));
+	assert_int_equal(-1, matcher_set_find(set, "a.h", 0));
+	assert_success(matcher_set_add(set, h));
+	assert_int_equal(1, matcher_set_find(set, "a.h", 0));
+
+	matcher_set_free(set);
+	matchers_free(c);
+	matchers_free(h);
+}
+
+TEST(results_are_the_same_as_of_trying_rules_in_order)
+{
+	const char *exprs[] = {
+		"{*.c}", "{*.tar.gz,*.tgz}", "{Makefile,*.mk}", "{*.C,*.cpp}", "{.*}",
+		"{*.}", "!{*.c}", "/\\.h$/", "/\\.H$/I", "//^/tmp/.*\\.log$//",
+		"/(.)\\1/", "{*.c}{a*}", "{ä*}", "{*.txt}", "{[ab].c}", "{*/}",
+		"{{/tmp/*}}", "<text/plain>", "/^x/", "{*.c}", "{c}", "/a|b/",
+	};
+	const char *paths[] = {
+		"a.c", "A.C", ".c", ".x.c", "x.tar.gz", "x.TGZ", "Makefile", "makefile",
+		"rules.MK", "dir/a.c", "/tmp/x.log", "/tmp/sub/y.log", "a.h", "A.H", "aa",
+		"abc.c", "ä.c", "ÄB.c", "c", "dir/", "x.", "b.c", "x.cpp", "", "a.c/",
+		"notes.txt.bak", "x",
+	};
+
+	check_set(exprs, ARRAY_LEN(exprs), paths, ARRAY_LEN(paths));
+}
+
+TEST(many_regexps_are_split_into_groups)
+{
+	const char *exprs[] = {
+		"/^a/", "/^b/", "/^c/", "/^d/", "/^e/", "/^f/", "/^g/", "/^h/", "/^i/",
+		"/^j/", "/^k/", "/^l/", "/^m/", "/^n/", "/^o/", "/^p/", "/^q/", "/^r/",
+		"/^s/", "/^t/", "/^u/", "/^v/", "/^w/", "/^x/", "/^y/", "/^z/", "/a$/I",
+		"/[[:digit:]]/", "//^/a//", "//b$//", "/^a/",
+	};
+	const char *paths[] = {
+		"apple", "Apple", "zebra", "1", "/a/b", "b/a", "mpa", "-", "",
+	};
+
+	check_set(exprs, ARRAY_LEN(exprs), paths, ARRAY_LEN(paths));
+}
+
+/* Compares results of matcher_set_find() with trying all rules in order. */
+static void
+check_set(const char *exprs[], int nexprs, const char *paths[], int npaths)
+{
+	int i, j, from;
+	matchers_t *rules[nexprs];
+	matcher_set_t *const set = matcher_set_alloc();
+	assert_non_null(set);
+
+	for(i = 0; i < nexprs; ++i)
+	{
+		char *error = NULL;
+		rules[i] = matchers_alloc(exprs[i], 0, 1, "", &error);
+		assert_string_equal(NULL, error);
+		assert_success(matcher_set_add(set, rules[i]));
+	}
+
+	for(j = 0; j < npaths; ++j)
+	{
+		for(from = 0; from <= nexprs; ++from)
+		{
+			int expected = -1;
+			for(i = from; i < nexprs; ++i)
+			{
+				if(matchers_match(rules[i], paths[j]))
+				{
+					expected = i;
+					break;
+				}
+			}
+
+			assert_int_equal(expected, matcher_set_find(set, paths[j], from));
+		}
+	}
+
+	matcher_set_free(set);
+	for(i = 0; i < nexprs; ++i)
+	{
+		matchers_free(rules[i]);
+	}
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */